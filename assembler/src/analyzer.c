@@ -13,8 +13,16 @@ static const asm_register BITFIELDS[] = {{"R0", 0x80}, {"R1", 0x40}, {"R2", 0x20
 
 static void analyzer_fatal_error(Analyzer *analyzer, const char *err_msg) {
     Token *t = analyzer->token;
-    printf("%s:%lu:%lu error: %s\n\t Token: '%s'\n", analyzer->file_path, t->line, t->col, err_msg, t->literal);
-    exit(EXIT_FAILURE);
+    diagnostics_error_at(analyzer->diagnostics, t->line, t->col, err_msg, "Token", t->literal);
+    diagnostics_abort(analyzer->diagnostics);
+}
+
+/* Reports an error on an identifier which was seen earlier in the stream than the current token. Assembly carries on so
+ * that every such error in the file is reported.
+ */
+static void analyzer_error_at(Analyzer *analyzer, unsigned long line, unsigned long col, const char *name,
+                              const char *err_msg) {
+    diagnostics_error_at(analyzer->diagnostics, line, col, err_msg, line == 0 ? "Identifier" : "Token", name);
 }
 
 static const operator_t *_get_op_by_name(char *operator) {
@@ -90,16 +98,17 @@ static uint8_t _char_literal(char *literal) {
     return _escape_character(literal[1]);
 }
 
-static uint16_t _convert_numeric_literal(Analyzer *analyzer, uint16_t bitmask) {
+/* Returns the value of the numeric literal at the current token, which the caller checks fits where it goes. */
+static long _convert_numeric_literal(Analyzer *analyzer) {
     switch (analyzer->token->type) {
     case TokenHex:
-        return strtol(analyzer->token->literal, NULL, 16) & bitmask;
+        return strtol(analyzer->token->literal, NULL, 16);
     case TokenBin:
-        return strtol(analyzer->token->literal, NULL, 2) & bitmask;
+        return strtol(analyzer->token->literal, NULL, 2);
     case TokenDec:
-        return atoi(analyzer->token->literal) & bitmask;
+        return strtol(analyzer->token->literal, NULL, 10);
     case TokenChar:
-        return _char_literal(analyzer->token->literal) & bitmask;
+        return _char_literal(analyzer->token->literal);
     default:
         analyzer_fatal_error(analyzer, "Expected numeric literal");
         return 0;
@@ -126,16 +135,648 @@ static uint8_t _get_bitfield(char *reg) {
     return 0;
 }
 
+/* Tops the lookahead ring back up from the lexer. Nothing is read past the EOF token. */
+static void _analyzer_fill(Analyzer *analyzer) {
+    while (!analyzer->__lexer_done && !token_ring_full(analyzer->lookahead)) {
+        Token *token = lexer_next_token(analyzer->lexer);
+        analyzer->__lexer_done = token->type == TokenEOF;
+        token_ring_push(analyzer->lookahead, token);
+    }
+}
+
 bool analyzer_finished(Analyzer *analyzer) {
-    return analyzer->token->type == TokenEOF || analyzer->stream->tokens[analyzer->stream_index]->type == TokenEOF;
+    Token *next = token_ring_peek(analyzer->lookahead, 0);
+    return analyzer->token->type == TokenEOF || next == NULL || next->type == TokenEOF;
 }
 
+/* Advances to the next token. The previous token is freed, so anything which must outlive it has to be copied. */
 static void _analyzer_read_token(Analyzer *analyzer) {
-    analyzer->token = analyzer->stream->tokens[analyzer->stream_index];
-    if (analyzer->token->type == TokenOperator) {
-        analyzer->position++;
+    Token *next = token_ring_pop(analyzer->lookahead);
+    if (next == NULL) {
+        return; // Stay on the EOF token
+    }
+    token_destruct(analyzer->token);
+    analyzer->token = next;
+    _analyzer_fill(analyzer);
+}
+
+/* Identifier resolution */
+static unsigned _analyzer_section(Analyzer *analyzer) {
+    return analyzer->out->section_count == 0 ? 0 : analyzer->out->section_count - 1;
+}
+
+static unsigned long _analyzer_section_start(Analyzer *analyzer) {
+    if (analyzer->out->section_count == 0) return 0;
+    return analyzer->out->sections[analyzer->out->section_count - 1].start;
+}
+
+/* A relocatable object stores the length of each section in 16 bits, so a longer section cannot be written. */
+static void _analyzer_check_section_length(Analyzer *analyzer) {
+    if (!analyzer->out->relocatable || analyzer->out->section_count == 0) return;
+    out_section_t *section = &analyzer->out->sections[analyzer->out->section_count - 1];
+    unsigned long length = object_writer_position(analyzer->out) - section->start;
+    if (length > OBJECT_MAX_SECTION_LENGTH) {
+        diagnostics_error(analyzer->diagnostics, "Section %s is %lu words long, the most an object can hold is %u.\n",
+                          section->name, length, OBJECT_MAX_SECTION_LENGTH);
+    }
+}
+
+/* Leaves the field of the instruction at address for the linker to fill in with the location of ident. */
+static void _analyzer_relocate(Analyzer *analyzer, ident_t *ident, unsigned long address, reloc_t kind) {
+    if (ident->symbol < 0) {
+        ident->symbol = object_writer_add_symbol(analyzer->out, ident->name);
+    }
+    object_writer_add_relocation(analyzer->out, address, kind, ident->symbol);
+}
+
+/* A defined identifier can be resolved by the assembler unless the linker may move it relative to the reference. In a
+ * relocatable object that is the case for absolute references and references across sections.
+ */
+static bool _analyzer_resolvable(Analyzer *analyzer, const ident_t *ident, unsigned long address, reloc_t kind) {
+    if (!analyzer->out->relocatable) return true;
+    if (kind == RelocAbsolute7 || kind == RelocAbsolute16) return false;
+    return ident->section == _analyzer_section(analyzer) && address >= _analyzer_section_start(analyzer);
+}
+
+/* Records that the instruction being assembled references the identifier in the current token. The field is only filled
+ * in once the instruction leaves the peephole window and has an address, so zero is returned for now.
+ */
+static uint16_t _analyzer_reference(Analyzer *analyzer, reloc_t kind) {
+    analyzer->__ref = lookup_tree_get_or_insert(&analyzer->lookup_tree, analyzer->token->literal);
+    analyzer->__ref_kind = kind;
+    analyzer->__ref_line = analyzer->token->line;
+    analyzer->__ref_col = analyzer->token->col;
+    return 0;
+}
+
+/* Reports a field which cannot hold the location of the identifier it refers to. */
+static void _analyzer_check_range(Analyzer *analyzer, const ident_t *ident, reloc_t kind, unsigned long address,
+                                  unsigned long line, unsigned long col) {
+    if (!reloc_in_range(kind, ident->location, address)) {
+        analyzer_error_at(analyzer, line, col, ident->name, "Identifier is out of range of the instruction.");
+    }
+}
+
+/* Returns the field value for a reference from the instruction at the current position. If the identifier is not
+ * defined yet, the reference is recorded so the instruction can be patched once the definition is reached, and zero is
+ * returned.
+ */
+static uint16_t _analyzer_resolve(Analyzer *analyzer, peep_insn_t *insn) {
+    ident_t *ident = insn->ref;
+    if (!ident->defined) {
+        ident->pending = fixup_construct(analyzer->position, insn->kind, insn->line, insn->col, ident->pending);
+        return 0;
+    }
+
+    if (_analyzer_resolvable(analyzer, ident, analyzer->position, insn->kind)) {
+        _analyzer_check_range(analyzer, ident, insn->kind, analyzer->position, insn->line, insn->col);
+        return reloc_value(insn->kind, ident->location, analyzer->position);
+    }
+    _analyzer_relocate(analyzer, ident, analyzer->position, insn->kind);
+    return 0;
+}
+
+/* Fills in a field of a word which is already in the output. */
+static void _analyzer_patch(Analyzer *analyzer, unsigned long address, uint16_t mask, uint16_t bits) {
+    object_writer_patch(analyzer->out, address, mask, bits);
+    if (analyzer->listing != NULL) listing_patch(analyzer->listing, address, mask, bits);
+}
+
+/* Gives an instruction the next address and hands it to the output. */
+static void _analyzer_place(peep_insn_t *insn, void *ctx) {
+    Analyzer *analyzer = ctx;
+    uint16_t word = insn->word;
+    if (insn->ref != NULL) word |= _analyzer_resolve(analyzer, insn);
+    if (insn->expr != NULL) {
+        expr_fixup_t *fixup = expr_fixup_construct(analyzer->position, insn->expr, insn->expr_mask, insn->expr_signed);
+        if (analyzer->__deferred_tail == NULL) {
+            analyzer->__deferred = fixup;
+        } else {
+            analyzer->__deferred_tail->next = fixup;
+        }
+        analyzer->__deferred_tail = fixup;
+    }
+    if (analyzer->listing != NULL)
+        listing_word(analyzer->listing, analyzer->position, word, insn->code, insn->src_line, insn->src_col);
+    object_writer_append(analyzer->out, word);
+    analyzer->position++;
+}
+
+/* Instructions leaving the peephole window may still be moved by branches which are lengthened before them. */
+static void _analyzer_commit(peep_insn_t *insn, void *ctx) {
+    Analyzer *analyzer = ctx;
+    relax_push(analyzer->relax, *insn);
+}
+
+/* A branch to an identifier which the assembler cannot place relative to it is left for the linker, or reported. */
+static bool _analyzer_fixed_target(const ident_t *ident, void *ctx) {
+    Analyzer *analyzer = ctx;
+    if (ident->imported || ident->equ != NULL) return true;
+    return ident->defined && !_analyzer_resolvable(analyzer, ident, analyzer->position, RelocRelative7);
+}
+
+/* Hands an assembled instruction, along with the identifier it references, to the peephole window. */
+static void _analyzer_emit(Analyzer *analyzer, uint16_t word, bool code) {
+    peep_insn_t insn = {word,
+                        code,
+                        analyzer->__ref,
+                        analyzer->__ref_kind,
+                        analyzer->__ref_line,
+                        analyzer->__ref_col,
+                        analyzer->__expr,
+                        analyzer->__expr_mask,
+                        analyzer->__expr_signed,
+                        analyzer->__stmt_line,
+                        analyzer->__stmt_col};
+    analyzer->__ref = NULL;
+    analyzer->__expr = NULL;
+    analyzer->assembled++;
+    peephole_push(analyzer->peephole, insn);
+}
+
+/* Whether a label with this name has been reached, even if it has no address yet */
+static bool _analyzer_label_seen(Analyzer *analyzer, const ident_t *ident) {
+    return ident->defined || relax_pending(analyzer->relax, ident);
+}
+
+/* Defines the label in the current token. It is given an address once every instruction before it has one. */
+static void _analyzer_define_label(Analyzer *analyzer) {
+    ident_t *ident = lookup_tree_get_or_insert(&analyzer->lookup_tree, analyzer->token->literal);
+    if (_analyzer_label_seen(analyzer, ident) || ident->equ != NULL) analyzer_fatal_error(analyzer, "Duplicate label.");
+    if (ident->imported) analyzer_fatal_error(analyzer, "Label was declared with .extern.");
+
+    // The label is a boundary for the peephole optimizer, since it can be branched to
+    peephole_flush(analyzer->peephole, ident);
+    relax_label(analyzer->relax, ident);
+}
+
+/* Gives a label the current position and patches every reference waiting on it. */
+static void _analyzer_place_label(ident_t *ident, void *ctx) {
+    Analyzer *analyzer = ctx;
+    ident->location = analyzer->position;
+    ident->section = _analyzer_section(analyzer);
+    ident->defined = true;
+    if (analyzer->listing != NULL) listing_label(analyzer->listing, ident->name);
+
+    while (ident->pending != NULL) {
+        fixup_t *fixup = ident->pending;
+        if (_analyzer_resolvable(analyzer, ident, fixup->address, fixup->kind)) {
+            _analyzer_check_range(analyzer, ident, fixup->kind, fixup->address, fixup->line, fixup->col);
+            uint16_t value = reloc_value(fixup->kind, ident->location, fixup->address);
+            _analyzer_patch(analyzer, fixup->address, reloc_mask(fixup->kind), value);
+        } else {
+            _analyzer_relocate(analyzer, ident, fixup->address, fixup->kind);
+        }
+        ident->pending = fixup->next;
+        free(fixup);
+    }
+}
+
+/* Literal pools */
+
+/* Places the words of the literal pool at the current position, each with the label its loads refer to. Unless the pool
+ * follows code which cannot fall through into it, such as at a .pool directive, a branch around it is placed first.
+ */
+static void _analyzer_place_pool(Analyzer *analyzer, bool skip) {
+    LiteralPool *pool = analyzer->literals;
+    if (pool->length == 0) return;
+
+    if (skip) {
+        isa_insn_t branch = {OP_Bcc, {0}};
+        branch.fields[FieldCond] = _condition_code("AL");
+        branch.fields[FieldImm] = pool->length + 1;
+        _analyzer_emit(analyzer, isa_encode(&branch), true);
+    }
+    for (unsigned i = 0; i < pool->length; i++) {
+        literal_t *literal = &pool->entries[i];
+        peephole_flush(analyzer->peephole, literal->label);
+        relax_label(analyzer->relax, literal->label);
+
+        switch (literal->kind) {
+        case LiteralAddress:
+            analyzer->__ref = literal->ref;
+            analyzer->__ref_kind = RelocAbsolute16;
+            analyzer->__ref_line = 0;
+            analyzer->__ref_col = 0;
+            break;
+        case LiteralExpression:
+            analyzer->__expr = literal->expr;
+            analyzer->__expr_mask = 0xFFFF;
+            analyzer->__expr_signed = false;
+            literal->expr = NULL;
+            break;
+        default:
+            break;
+        }
+        _analyzer_emit(analyzer, literal->value, false);
+    }
+    literal_pool_clear(pool);
+}
+
+/* Whether the first load from the literal pool could go out of range if the pool is not placed now. */
+static bool _analyzer_pool_due(Analyzer *analyzer) {
+    LiteralPool *pool = analyzer->literals;
+    if (pool->length == 0) return false;
+    return pool->length >= LITERAL_POOL_MAX || analyzer->assembled - pool->first + pool->length >= LITERAL_POOL_REACH;
+}
+
+/* Imported identifiers are only ever resolved by the linker. */
+static void _analyzer_relocate_imports(ident_t *ident, void *ctx) {
+    Analyzer *analyzer = ctx;
+    if (!ident->imported || !analyzer->out->relocatable) return;
+
+    while (ident->pending != NULL) {
+        fixup_t *fixup = ident->pending;
+        _analyzer_relocate(analyzer, ident, fixup->address, fixup->kind);
+        ident->pending = fixup->next;
+        free(fixup);
+    }
+}
+
+/* Every label is recorded in a relocatable object's symbol table, and exported if it was declared with .global. */
+static void _analyzer_record_symbol(ident_t *ident, void *ctx) {
+    Analyzer *analyzer = ctx;
+    if (!analyzer->out->relocatable || (!ident->defined && ident->symbol < 0)) return;
+
+    if (ident->symbol < 0) {
+        ident->symbol = object_writer_add_symbol(analyzer->out, ident->name);
+    }
+    binding_t binding = ident->imported ? BindImport : ident->exported ? BindGlobal : BindLocal;
+    object_writer_define_symbol(analyzer->out, ident->symbol, ident->location, binding);
+}
+
+static void _analyzer_check_export(ident_t *ident, void *ctx) {
+    if (ident->exported && !ident->defined) {
+        analyzer_error_at(ctx, 0, 0, ident->name, "Identifier declared with .global is never defined.");
+    }
+}
+
+static void _analyzer_check_defined(ident_t *ident, void *ctx) {
+    if (ident->defined || ident->pending == NULL) return;
+
+    // References are recorded newest first, so report the earliest one
+    fixup_t *fixup = ident->pending;
+    while (fixup->next != NULL) {
+        fixup = fixup->next;
+    }
+    const char *err_msg = ident->equ != NULL ? "Constant defined with EQU cannot be used as an address."
+                                             : "Undefined identifier.";
+    analyzer_error_at(ctx, fixup->line, fixup->col, ident->name, err_msg);
+}
+
+static const char *_expr_symbol(const expr_t *expr) {
+    switch (expr->kind) {
+    case ExprIdentifier:
+        return expr->ident->name;
+    case ExprNegate:
+    case ExprSub:
+        return "-";
+    case ExprAdd:
+        return "+";
+    case ExprMul:
+        return "*";
+    case ExprDiv:
+        return "/";
+    case ExprShiftLeft:
+        return "<<";
+    case ExprShiftRight:
+        return ">>";
+    case ExprAnd:
+        return "&";
+    case ExprOr:
+        return "|";
+    default:
+        return "";
+    }
+}
+
+/* Reports why an expression could not be evaluated. */
+static void _analyzer_expression_error(Analyzer *analyzer, eval_status_t status, eval_result_t *result) {
+    const char *err_msg = status == EvalUndefined ? "Undefined identifier." : result->err_msg;
+    analyzer_error_at(analyzer, result->culprit->line, result->culprit->col, _expr_symbol(result->culprit), err_msg);
+}
+
+/* Reports an expression whose value would be cut down to fit its field, naming the constant or giving the value. */
+static void _analyzer_check_fits(Analyzer *analyzer, const expr_t *expr, long value, uint16_t mask, bool signed_imm) {
+    if (expr_fits(value, mask, signed_imm)) return;
+    if (expr->kind == ExprIdentifier) {
+        analyzer_error_at(analyzer, expr->line, expr->col, expr->ident->name, "Value does not fit in its field.");
+        return;
+    }
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    diagnostics_error_at(analyzer->diagnostics, expr->line, expr->col, "Value does not fit in its field.", "Value", text);
+}
+
+/* Fills in every immediate whose expression referred to an identifier which was not defined when it was assembled. */
+static void _analyzer_evaluate_deferred(Analyzer *analyzer) {
+    while (analyzer->__deferred != NULL) {
+        expr_fixup_t *fixup = analyzer->__deferred;
+        eval_result_t result;
+        eval_status_t status = expr_evaluate(fixup->expr, analyzer->out->relocatable, &result);
+        if (status == EvalResolved) {
+            _analyzer_check_fits(analyzer, fixup->expr, result.value, fixup->mask, fixup->signed_imm);
+            _analyzer_patch(analyzer, fixup->address, fixup->mask, result.value & fixup->mask);
+        } else {
+            _analyzer_expression_error(analyzer, status, &result);
+        }
+
+        analyzer->__deferred = fixup->next;
+        expr_destruct(fixup->expr);
+        free(fixup);
+    }
+    analyzer->__deferred_tail = NULL;
+}
+
+/* Must be called once the whole stream has been analyzed. Reports every identifier which is referenced or exported but
+ * never defined, and completes the symbol table of a relocatable object.
+ */
+void analyzer_check_references(Analyzer *analyzer) {
+    _analyzer_place_pool(analyzer, false);
+    peephole_flush(analyzer->peephole, NULL);
+    relax_flush(analyzer->relax);
+    _analyzer_check_section_length(analyzer);
+    lookup_tree_for_each(analyzer->lookup_tree, _analyzer_relocate_imports, analyzer);
+    lookup_tree_for_each(analyzer->lookup_tree, _analyzer_check_export, analyzer);
+    lookup_tree_for_each(analyzer->lookup_tree, _analyzer_check_defined, analyzer);
+    _analyzer_evaluate_deferred(analyzer);
+    if (diagnostics_failed(analyzer->diagnostics)) diagnostics_abort(analyzer->diagnostics);
+
+    lookup_tree_for_each(analyzer->lookup_tree, _analyzer_record_symbol, analyzer);
+
+    if (analyzer->relax->lengthened > 0) {
+        diagnostics_note(analyzer->diagnostics, "%lu branch(es) out of range were lengthened, adding %lu words.",
+                         analyzer->relax->lengthened, analyzer->relax->added);
+    }
+}
+
+/* Expressions */
+static bool _is_numeric(token_t type) {
+    return type == TokenHex || type == TokenBin || type == TokenDec || type == TokenChar;
+}
+
+/* Binary operators, from lowest to highest precedence */
+static bool _binary_operator(token_t type, expr_kind_t *kind, int *precedence) {
+    switch (type) {
+    case TokenPipe:
+        *kind = ExprOr;
+        *precedence = 0;
+        return true;
+    case TokenAmpersand:
+        *kind = ExprAnd;
+        *precedence = 1;
+        return true;
+    case TokenShiftLeft:
+        *kind = ExprShiftLeft;
+        *precedence = 2;
+        return true;
+    case TokenShiftRight:
+        *kind = ExprShiftRight;
+        *precedence = 2;
+        return true;
+    case TokenPlus:
+        *kind = ExprAdd;
+        *precedence = 3;
+        return true;
+    case TokenMinus:
+        *kind = ExprSub;
+        *precedence = 3;
+        return true;
+    case TokenStar:
+        *kind = ExprMul;
+        *precedence = 4;
+        return true;
+    case TokenSlash:
+        *kind = ExprDiv;
+        *precedence = 4;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Whether the token after the current one continues an expression */
+static bool _analyzer_expression_continues(Analyzer *analyzer) {
+    Token *next = token_ring_peek(analyzer->lookahead, 0);
+    expr_kind_t kind;
+    int precedence;
+    return next != NULL && _binary_operator(next->type, &kind, &precedence);
+}
+
+/* Holds an expression which is still being parsed, so that it is freed if a fatal error abandons it. */
+static void _analyzer_hold(Analyzer *analyzer, expr_t *expr) {
+    if (analyzer->__partial_len == analyzer->__partial_cap) {
+        analyzer->__partial_cap = analyzer->__partial_cap == 0 ? 8 : analyzer->__partial_cap * 2;
+        analyzer->__partial = realloc(analyzer->__partial, sizeof(expr_t *) * analyzer->__partial_cap);
+    }
+    analyzer->__partial[analyzer->__partial_len++] = expr;
+}
+
+/* Takes back the expression held last. */
+static expr_t *_analyzer_release(Analyzer *analyzer) { return analyzer->__partial[--analyzer->__partial_len]; }
+
+static expr_t *_analyzer_parse_expression(Analyzer *analyzer, int min_precedence);
+
+static expr_t *_analyzer_parse_primary(Analyzer *analyzer) {
+    Token *token = analyzer->token;
+    expr_t *expr;
+
+    switch (token->type) {
+    case TokenHex:
+    case TokenBin:
+    case TokenDec:
+    case TokenChar: {
+        long value = _convert_numeric_literal(analyzer);
+        expr = expr_construct(ExprNumber, NULL, NULL, token->line, token->col);
+        expr->value = value;
+        return expr;
+    }
+    case TokenIdentifier:
+        expr = expr_construct(ExprIdentifier, NULL, NULL, token->line, token->col);
+        expr->ident = lookup_tree_get_or_insert(&analyzer->lookup_tree, token->literal);
+        return expr;
+    case TokenMinus: {
+        unsigned long line = token->line, col = token->col;
+        _analyzer_read_token(analyzer);
+        return expr_construct(ExprNegate, _analyzer_parse_primary(analyzer), NULL, line, col);
+    }
+    case TokenLParen:
+        _analyzer_read_token(analyzer);
+        _analyzer_hold(analyzer, _analyzer_parse_expression(analyzer, 0));
+        _analyzer_read_token(analyzer);
+        if (analyzer->token->type != TokenRParen) analyzer_fatal_error(analyzer, "Expected closing parenthesis.");
+        return _analyzer_release(analyzer);
+    default:
+        analyzer_fatal_error(analyzer, "Expected numeric literal, identifier or '('.");
+        return NULL;
+    }
+}
+
+/* Parses the expression which starts at the current token, leaving the current token on its last token. Operators of
+ * equal precedence are left associative.
+ */
+static expr_t *_analyzer_parse_expression(Analyzer *analyzer, int min_precedence) {
+    _analyzer_hold(analyzer, _analyzer_parse_primary(analyzer)); // The left operand
+
+    for (;;) {
+        Token *next = token_ring_peek(analyzer->lookahead, 0);
+        expr_kind_t kind;
+        int precedence;
+        if (next == NULL || !_binary_operator(next->type, &kind, &precedence) || precedence < min_precedence) {
+            return _analyzer_release(analyzer);
+        }
+
+        _analyzer_read_token(analyzer);
+        unsigned long line = analyzer->token->line, col = analyzer->token->col;
+        _analyzer_read_token(analyzer);
+        expr_t *right = _analyzer_parse_expression(analyzer, precedence + 1);
+        expr_t *left = _analyzer_release(analyzer);
+        _analyzer_hold(analyzer, expr_construct(kind, left, right, line, col));
+    }
+}
+
+/* Converts the immediate which starts at the current token. An expression which can be evaluated now is folded into
+ * the field. Otherwise it refers to an identifier which is not defined yet, so it is kept with the instruction and the
+ * field is filled in at the end of the file.
+ */
+static uint16_t _analyzer_immediate(Analyzer *analyzer, uint16_t bitmask, bool signed_imm) {
+
+    // Plain numbers are by far the most common immediate
+    if (_is_numeric(analyzer->token->type) && !_analyzer_expression_continues(analyzer)) {
+        long value = _convert_numeric_literal(analyzer);
+        if (!expr_fits(value, bitmask, signed_imm)) {
+            Token *t = analyzer->token;
+            analyzer_error_at(analyzer, t->line, t->col, t->literal, "Value does not fit in its field.");
+        }
+        return value & bitmask;
+    }
+
+    expr_t *expr = _analyzer_parse_expression(analyzer, 0);
+    eval_result_t result;
+    eval_status_t status = expr_evaluate(expr, analyzer->out->relocatable, &result);
+
+    switch (status) {
+    case EvalResolved:
+        _analyzer_check_fits(analyzer, expr, result.value, bitmask, signed_imm);
+        expr_destruct(expr);
+        return result.value & bitmask;
+    case EvalUndefined:
+        analyzer->__expr = expr;
+        analyzer->__expr_mask = bitmask;
+        analyzer->__expr_signed = signed_imm;
+        return 0;
+    default:
+        _analyzer_expression_error(analyzer, status, &result);
+        expr_destruct(expr);
+        diagnostics_abort(analyzer->diagnostics);
+    }
+}
+
+/* Converts the immediate which starts at the current token into the immediate field of an opcode. */
+static uint16_t _analyzer_field_immediate(Analyzer *analyzer, isa_opcode_t opcode) {
+    return _analyzer_immediate(analyzer, isa_field_mask(opcode, FieldImm), ISA[opcode].signed_imm);
+}
+
+/* Defines the constant named by the current token, which is followed by EQU and its value. The value is evaluated
+ * wherever the constant is used, so it may refer to labels which are defined later.
+ */
+static void _analyzer_define_constant(Analyzer *analyzer) {
+    ident_t *ident = lookup_tree_get_or_insert(&analyzer->lookup_tree, analyzer->token->literal);
+    if (_analyzer_label_seen(analyzer, ident) || ident->equ != NULL) analyzer_fatal_error(analyzer, "Duplicate label.");
+    if (ident->imported) analyzer_fatal_error(analyzer, "Identifier was already declared with .extern.");
+    if (ident->exported) analyzer_fatal_error(analyzer, "Constants cannot be exported with .global.");
+
+    _analyzer_read_token(analyzer); // EQU
+    _analyzer_read_token(analyzer);
+    ident->equ = _analyzer_parse_expression(analyzer, 0);
+}
+
+/* Adds the constant after '=' to the literal pool, and references its word from the load being assembled. The address
+ * of a label is left for the linker in a relocatable object, like any other absolute reference.
+ */
+static uint16_t _analyzer_literal(Analyzer *analyzer) {
+    unsigned long line = analyzer->token->line, col = analyzer->token->col;
+    _analyzer_read_token(analyzer);
+    expr_t *expr = _analyzer_parse_expression(analyzer, 0);
+    LiteralPool *pool = analyzer->literals;
+    ident_t *label;
+
+    if (expr->kind == ExprIdentifier && expr->ident->equ == NULL && analyzer->out->relocatable) {
+        label = literal_pool_address(pool, expr->ident, analyzer->assembled);
+        expr_destruct(expr);
+    } else {
+        eval_result_t result;
+        eval_status_t status = expr_evaluate(expr, analyzer->out->relocatable, &result);
+        switch (status) {
+        case EvalResolved:
+            _analyzer_check_fits(analyzer, expr, result.value, 0xFFFF, false);
+            label = literal_pool_value(pool, result.value & 0xFFFF, analyzer->assembled);
+            expr_destruct(expr);
+            break;
+        case EvalUndefined:
+            label = literal_pool_expression(pool, expr, analyzer->assembled);
+            break;
+        default:
+            _analyzer_expression_error(analyzer, status, &result);
+            expr_destruct(expr);
+            diagnostics_abort(analyzer->diagnostics);
+        }
+    }
+
+    analyzer->__ref = label;
+    analyzer->__ref_kind = RelocRelative9;
+    analyzer->__ref_line = line;
+    analyzer->__ref_col = col;
+    return 0;
+}
+
+/* Directives */
+static void _analyzer_expect_identifier(Analyzer *analyzer) {
+    _analyzer_read_token(analyzer);
+    if (analyzer->token->type != TokenIdentifier) analyzer_fatal_error(analyzer, "Expected identifier.");
+}
+
+static void _analyzer_convert_directive(Analyzer *analyzer) {
+    char *directive = analyzer->token->literal;
+
+    if (!strcmp(directive, "SECTION")) {
+        _analyzer_expect_identifier(analyzer);
+        out_section_t *previous = object_writer_find_section(analyzer->out, analyzer->token->literal);
+        bool current = previous != NULL && previous == &analyzer->out->sections[analyzer->out->section_count - 1];
+        if (current) return;
+
+        // A flat image has no linker to gather sections with the same name together
+        if (previous != NULL && !analyzer->out->relocatable)
+            analyzer_fatal_error(analyzer, "Sections cannot be reopened in a flat image, assemble with -c and link.");
+        // A flat image is one run of words, so branches waiting for their targets can carry on into the next section.
+        // In a relocatable object a target in another section is only ever placed by the linker.
+        _analyzer_place_pool(analyzer, false);
+        peephole_flush(analyzer->peephole, NULL);
+        if (analyzer->out->relocatable) relax_flush(analyzer->relax);
+        _analyzer_check_section_length(analyzer);
+        object_writer_begin_section(analyzer->out, analyzer->token->literal);
+        if (analyzer->listing != NULL) listing_section(analyzer->listing, analyzer->token->literal);
+
+    } else if (!strcmp(directive, "POOL")) {
+        _analyzer_place_pool(analyzer, false);
+
+    } else if (!strcmp(directive, "GLOBAL")) {
+        _analyzer_expect_identifier(analyzer);
+        ident_t *ident = lookup_tree_get_or_insert(&analyzer->lookup_tree, analyzer->token->literal);
+        if (ident->imported) analyzer_fatal_error(analyzer, "Identifier was already declared with .extern.");
+        if (ident->equ != NULL) analyzer_fatal_error(analyzer, "Constants cannot be exported with .global.");
+        ident->exported = true;
+
+    } else if (!strcmp(directive, "EXTERN")) {
+        _analyzer_expect_identifier(analyzer);
+        ident_t *ident = lookup_tree_get_or_insert(&analyzer->lookup_tree, analyzer->token->literal);
+        if (_analyzer_label_seen(analyzer, ident) || ident->exported || ident->equ != NULL)
+            analyzer_fatal_error(analyzer, "Identifier is defined in this file and cannot be declared with .extern.");
+        ident->imported = true;
+
+    } else {
+        analyzer_fatal_error(analyzer, "Unrecognized directive.");
     }
-    analyzer->stream_index++;
 }
 
 static void _analyzer_expect_register(Analyzer *analyzer) {
@@ -155,7 +796,10 @@ static uint16_t _analyzer_convert_dcd(Analyzer *analyzer) {
     case TokenHex:
     case TokenDec:
     case TokenChar:
-        return _convert_numeric_literal(analyzer, 0xFFFF);
+    case TokenIdentifier:
+    case TokenLParen:
+    case TokenMinus:
+        return _analyzer_immediate(analyzer, 0xFFFF, false);
     case TokenStr:
         analyzer->__str_in_prog = analyzer->token->literal;
         return _str_literal(analyzer);
@@ -166,28 +810,27 @@ static uint16_t _analyzer_convert_dcd(Analyzer *analyzer) {
 }
 
 static uint16_t _analyzer_convert_conditional(Analyzer *analyzer) {
-    uint16_t inst = 0;
+    isa_insn_t insn = {0};
     int length = strlen(analyzer->token->literal);
 
     switch (length) {
     case 1:
-        inst = inst | 0x0F;
-        inst = (inst << 4) | _condition_code("AL");
+        insn.opcode = OP_Bcc;
+        insn.fields[FieldCond] = _condition_code("AL");
         break;
     case 2:
-        inst = inst | 0x1F;
-        inst = (inst << 4) | _condition_code("AL");
+        insn.opcode = OP_BLcc;
+        insn.fields[FieldCond] = _condition_code("AL");
         break;
     case 3:
-        inst = inst | 0x0F;
-        inst = (inst << 4) | _condition_code(analyzer->token->literal + 1);
+        insn.opcode = OP_Bcc;
+        insn.fields[FieldCond] = _condition_code(analyzer->token->literal + 1);
         break;
     default:
-        inst = inst | 0x1F;
-        inst = (inst << 4) | _condition_code(analyzer->token->literal + 2);
+        insn.opcode = OP_BLcc;
+        insn.fields[FieldCond] = _condition_code(analyzer->token->literal + 2);
         break;
     }
-    inst = inst << 7;
 
     // Next token must be an immediate
     _analyzer_read_token(analyzer);
@@ -196,32 +839,30 @@ static uint16_t _analyzer_convert_conditional(Analyzer *analyzer) {
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        inst |= _convert_numeric_literal(analyzer, 0x7F);
-    case TokenIdentifier: {
-        ident_t *ident = lookup_tree_get(analyzer->lookup_tree, analyzer->token->literal);
-        if (ident == NULL) analyzer_fatal_error(analyzer, "Undefined identifier.");
-        inst = inst | ((ident->location - analyzer->position + 1) & 0x7F);
+    case TokenLParen:
+    case TokenMinus:
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
+        break;
+    case TokenIdentifier:
+        insn.fields[FieldImm] = _analyzer_reference(analyzer, RelocRelative7);
         break;
-    }
     default:
         analyzer_fatal_error(analyzer, "Expected numerical immediate.");
     }
 
-    return inst;
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_form1(Analyzer *analyzer, const unsigned short int opcodes[]) {
-    uint16_t inst = 0;
+static uint16_t _analyzer_convert_form1(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {0};
 
     _analyzer_expect_register(analyzer);
-    inst = inst | _convert_register(analyzer->token->literal);
-    inst = inst << 2;
+    insn.fields[FieldRd] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
     _analyzer_expect_register(analyzer);
-    inst = inst | _convert_register(analyzer->token->literal);
-    inst = inst << 7;
+    insn.fields[FieldRx] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
@@ -229,30 +870,31 @@ static uint16_t _analyzer_convert_form1(Analyzer *analyzer, const unsigned short
     _analyzer_read_token(analyzer);
     switch (analyzer->token->type) {
     case TokenRegister:
-        inst |= opcodes[0] << 11;
-        inst |= _convert_register(analyzer->token->literal) << 5;
+        insn.opcode = opcodes[0];
+        insn.fields[FieldRy] = _convert_register(analyzer->token->literal);
         break;
     case TokenHex:
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        inst |= (opcodes[1] << 11);
-        inst |= _convert_numeric_literal(analyzer, 0x7F);
+    case TokenIdentifier:
+    case TokenLParen:
+    case TokenMinus:
+        insn.opcode = opcodes[1];
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
         break;
     default:
         analyzer_fatal_error(analyzer, "Expected numerical immediate or register.");
     }
 
-    return inst;
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_form2(Analyzer *analyzer, const unsigned short int opcodes[]) {
-
-    uint16_t inst = 0;
+static uint16_t _analyzer_convert_form2(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {0};
 
     _analyzer_expect_register(analyzer);
-    inst = inst | _convert_register(analyzer->token->literal);
-    inst = inst << 9;
+    insn.fields[FieldRd] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
@@ -260,58 +902,63 @@ static uint16_t _analyzer_convert_form2(Analyzer *analyzer, const unsigned short
     _analyzer_read_token(analyzer);
     switch (analyzer->token->type) {
     case TokenRegister:
-        inst |= opcodes[0] << 11;
-        inst |= (_convert_register(analyzer->token->literal) << 7);
+        insn.opcode = opcodes[0];
+        insn.fields[FieldRx] = _convert_register(analyzer->token->literal);
         break;
     case TokenHex:
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        inst |= opcodes[1] << 11;
-        inst |= _convert_numeric_literal(analyzer, 0x7F);
+    case TokenIdentifier:
+    case TokenLParen:
+    case TokenMinus:
+        insn.opcode = opcodes[1];
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
         break;
     default:
         analyzer_fatal_error(analyzer, "Expected numerical immediate or register.");
     }
 
-    return inst;
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_form3(Analyzer *analyzer, const unsigned short int opcodes[]) {
-
-    uint16_t inst = 0;
+static uint16_t _analyzer_convert_form3(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {opcodes[0], {0}};
 
     _analyzer_expect_register(analyzer);
-    inst = inst | _convert_register(analyzer->token->literal);
-    inst = inst << 2;
+    insn.fields[FieldRd] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
-    // Next token must be open [
+    // LDR rd, =constant loads the constant from a literal pool
     _analyzer_read_token(analyzer);
+    if (analyzer->token->type == TokenEquals) {
+        if (opcodes[0] != OP_LDR_PC) analyzer_fatal_error(analyzer, "Only LDR can load a literal.");
+        insn.fields[FieldImm] = _analyzer_literal(analyzer);
+        return isa_encode(&insn);
+    }
+
+    // Next token must be open [
     if (analyzer->token->type != TokenLBrack) analyzer_fatal_error(analyzer, "Expected open bracket: '['.");
 
     // Next token can either be a register, identifier or immediate
     _analyzer_read_token(analyzer);
-    uint16_t immediate;
     bool imm = true;
     switch (analyzer->token->type) {
     case TokenHex:
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        immediate = _convert_numeric_literal(analyzer, 0x1FF);
+    case TokenLParen:
+    case TokenMinus:
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
         break;
-    case TokenIdentifier: { // (PC-relative)
-        ident_t *ident = lookup_tree_get(analyzer->lookup_tree, analyzer->token->literal);
-        if (ident == NULL) analyzer_fatal_error(analyzer, "Undefined identifier.");
-        immediate = (ident->location - analyzer->position + 1) & 0x1FF;
+    case TokenIdentifier: // (PC-relative)
+        insn.fields[FieldImm] = _analyzer_reference(analyzer, RelocRelative9);
         break;
-    }
     case TokenRegister:
         imm = false;
-        inst = inst | _convert_register(analyzer->token->literal);
-        inst = inst << 2;
+        insn.fields[FieldRx] = _convert_register(analyzer->token->literal);
         break;
     default:
         analyzer_fatal_error(analyzer, "Expected register, identifier or numerical immediate.");
@@ -319,14 +966,10 @@ static uint16_t _analyzer_convert_form3(Analyzer *analyzer, const unsigned short
 
     // Argument was an immediate
     if (imm) {
-        inst = inst << 7;                  // Move over register bits to make room for immediate
-        inst = inst | (opcodes[0] << 11);  // Add the opcode
-        inst = inst | (immediate & 0x1FF); // Add the immediate to the end
-
         // Check that instruction closes with ]
         _analyzer_read_token(analyzer);
         if (analyzer->token->type != TokenRBrack) analyzer_fatal_error(analyzer, "Expected closing bracket.");
-        return inst;
+        return isa_encode(&insn);
     }
 
     // By now, instruction is either [register, register] or [register, imm7]
@@ -334,26 +977,23 @@ static uint16_t _analyzer_convert_form3(Analyzer *analyzer, const unsigned short
 
     // Next token is either a register or an immediate/identifier
     _analyzer_read_token(analyzer);
-    imm = true;
     switch (analyzer->token->type) {
     case TokenHex:
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        inst = inst << 9;
-        immediate = _convert_numeric_literal(analyzer, 0x7F);
+    case TokenLParen:
+    case TokenMinus:
+        insn.opcode = opcodes[2];
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
         break;
-    case TokenIdentifier: {
-        inst = inst << 9;
-        ident_t *ident = lookup_tree_get(analyzer->lookup_tree, analyzer->token->literal);
-        if (ident == NULL) analyzer_fatal_error(analyzer, "Undefined identifier.");
-        immediate = ident->location & 0x7F;
+    case TokenIdentifier:
+        insn.opcode = opcodes[2];
+        insn.fields[FieldImm] = _analyzer_reference(analyzer, RelocAbsolute7);
         break;
-    }
     case TokenRegister:
-        imm = false;
-        inst = inst | _convert_register(analyzer->token->literal);
-        inst = inst << 5;
+        insn.opcode = opcodes[1];
+        insn.fields[FieldRy] = _convert_register(analyzer->token->literal);
         break;
     default:
         analyzer_fatal_error(analyzer, "Expected register, identifier or numerical immediate.");
@@ -363,62 +1003,56 @@ static uint16_t _analyzer_convert_form3(Analyzer *analyzer, const unsigned short
     _analyzer_read_token(analyzer);
     if (analyzer->token->type != TokenRBrack) analyzer_fatal_error(analyzer, "Expected closing bracket.");
 
-    if (imm) return inst | (opcodes[2] << 11);
-    return inst | (opcodes[1] << 11);
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_form4(Analyzer *analyzer, const unsigned short int opcodes[]) {
-    uint16_t inst = opcodes[0] << 2; // Only one opcode
+static uint16_t _analyzer_convert_form4(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {0};
 
-    if (analyzer->token->literal[0] == 'R') inst |= 0x1; // Type: rotate
-    if (analyzer->token->literal[2] == 'R') inst |= 0x2; // Direction: right
-    inst = inst << 2;
+    if (analyzer->token->literal[0] == 'R') insn.fields[FieldMode] |= 0x1; // Type: rotate
+    if (analyzer->token->literal[2] == 'R') insn.fields[FieldMode] |= 0x2; // Direction: right
 
     // Expect register
     _analyzer_expect_register(analyzer);
-    inst |= _convert_register(analyzer->token->literal);
-    inst = inst << 2;
+    insn.fields[FieldRd] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
     _analyzer_expect_register(analyzer);
-    inst |= _convert_register(analyzer->token->literal);
-    inst = inst << 2;
+    insn.fields[FieldRx] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
     // Expect register or immediate
     _analyzer_read_token(analyzer);
-    bool imm = true;
-    uint8_t immediate;
     switch (analyzer->token->type) {
 
     case TokenHex:
     case TokenBin:
     case TokenDec:
     case TokenChar:
-        inst = inst << 3;
-        immediate = _convert_numeric_literal(analyzer, 0xF);
+    case TokenIdentifier:
+    case TokenLParen:
+    case TokenMinus:
+        insn.opcode = opcodes[0];
+        insn.fields[FieldImm] = _analyzer_field_immediate(analyzer, insn.opcode);
         break;
     case TokenRegister:
-        imm = false;
-        inst |= _convert_register(analyzer->token->literal);
-        inst = inst << 3;
+        insn.opcode = opcodes[1];
+        insn.fields[FieldRy] = _convert_register(analyzer->token->literal);
         break;
     default:
         analyzer_fatal_error(analyzer, "Expected register, identifier or numerical immediate.");
     }
 
-    if (imm) inst |= immediate;
-    return inst;
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_form5(Analyzer *analyzer, const unsigned short int opcodes[]) {
-    uint16_t inst = opcodes[0] << 2;
+static uint16_t _analyzer_convert_form5(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {opcodes[0], {0}};
 
     _analyzer_expect_register(analyzer);
-    inst |= _convert_register(analyzer->token->literal);
-    inst = inst << 9;
+    insn.fields[FieldRd] = _convert_register(analyzer->token->literal);
 
     _analyzer_expect_comma(analyzer);
 
@@ -426,17 +1060,13 @@ static uint16_t _analyzer_convert_form5(Analyzer *analyzer, const unsigned short
     _analyzer_read_token(analyzer);
     if (analyzer->token->type != TokenIdentifier) analyzer_fatal_error(analyzer, "Expected identifer.");
 
-    ident_t *ident = lookup_tree_get(analyzer->lookup_tree, analyzer->token->literal);
-    if (ident == NULL) analyzer_fatal_error(analyzer, "Undefined identifier.");
-    inst |= (ident->location - analyzer->position + 1) & 0x1FF;
+    insn.fields[FieldImm] = _analyzer_reference(analyzer, RelocRelative9);
 
-    return inst;
+    return isa_encode(&insn);
 }
 
-static uint16_t _analyzer_convert_stack(Analyzer *analyzer, const unsigned short int opcodes[]) {
-
-    uint16_t inst = 0;
-    inst = (inst | opcodes[0]) << 11;
+static uint16_t _analyzer_convert_stack(Analyzer *analyzer, const isa_opcode_t opcodes[]) {
+    isa_insn_t insn = {opcodes[0], {0}};
 
     // Next token must be a {
     _analyzer_read_token(analyzer);
@@ -445,7 +1075,7 @@ static uint16_t _analyzer_convert_stack(Analyzer *analyzer, const unsigned short
     // Tokens can be special registers or registers
     _analyzer_read_token(analyzer);
     while (analyzer->token->type == TokenRegister || analyzer->token->type == TokenSpecialRegister) {
-        inst |= _get_bitfield(analyzer->token->literal);
+        insn.fields[FieldImm] |= _get_bitfield(analyzer->token->literal);
         _analyzer_read_token(analyzer);
 
         // Closing curly brace signifies end of argument
@@ -457,7 +1087,7 @@ static uint16_t _analyzer_convert_stack(Analyzer *analyzer, const unsigned short
 
     // Next token must be a }
     if (analyzer->token->type != TokenRCurl) analyzer_fatal_error(analyzer, "Expected ']'.");
-    return inst;
+    return isa_encode(&insn);
 }
 
 static uint16_t _analyzer_convert_statement(Analyzer *analyzer) {
@@ -472,7 +1102,10 @@ static uint16_t _analyzer_convert_statement(Analyzer *analyzer) {
         return _analyzer_convert_dcd(analyzer);
     }
 
-    // TODO implement EQU
+    if (operator->form == FormEquiv) {
+        analyzer_fatal_error(analyzer, "EQU must follow the name of the constant it defines.");
+    }
+
     switch (operator->form) {
     case Form1:
         return _analyzer_convert_form1(analyzer, operator->raw);
@@ -493,40 +1126,96 @@ static uint16_t _analyzer_convert_statement(Analyzer *analyzer) {
 }
 
 /* Analyzer */
-Analyzer *analyzer_construct(TokenList *stream, const char *file_path) {
+Analyzer *analyzer_construct(Lexer *lexer, ObjectWriter *out, Diagnostics *diagnostics, bool optimize) {
     Analyzer *analyzer = malloc(sizeof(Analyzer));
-    analyzer->file_path = file_path;
-    analyzer->stream = stream;
-    analyzer->lookup_tree = lookup_tree_construct(stream);
-    analyzer->stream_index = 0;
+    analyzer->file_path = diagnostics->file_path;
+    analyzer->diagnostics = diagnostics;
+    analyzer->lexer = lexer;
+    analyzer->lookahead = token_ring_construct();
+    analyzer->out = out;
+    analyzer->peephole = peephole_construct(optimize, _analyzer_commit, analyzer);
+    analyzer->relax = relax_construct(_analyzer_place, _analyzer_place_label, _analyzer_fixed_target, analyzer);
+    analyzer->literals = literal_pool_construct();
+    analyzer->assembled = 0;
+    analyzer->lookup_tree = NULL;
     analyzer->position = 0;
     analyzer->__str_in_prog = NULL;
-    _analyzer_read_token(analyzer); // Initialize with start token
+    analyzer->__lexer_done = false;
+    analyzer->__ref = NULL;
+    analyzer->__expr = NULL;
+    analyzer->__expr_mask = 0;
+    analyzer->__expr_signed = false;
+    analyzer->__partial = NULL;
+    analyzer->__partial_len = 0;
+    analyzer->__partial_cap = 0;
+    analyzer->__deferred = NULL;
+    analyzer->__deferred_tail = NULL;
+    analyzer->listing = NULL;
+    analyzer->__stmt_line = 0;
+    analyzer->__stmt_col = 0;
+    analyzer->token = token_construct("START", TokenStart, 0, 0); // Initialize with start token
+    _analyzer_fill(analyzer);
     return analyzer;
 }
 
 void analyzer_destruct(Analyzer *analyzer) {
-    token_list_destruct(analyzer->stream); // Will free analyzer->token too
+    token_destruct(analyzer->token);
+    token_ring_destruct(analyzer->lookahead);
+    peephole_destruct(analyzer->peephole);
+    relax_destruct(analyzer->relax);
+    expr_destruct(analyzer->__expr);
+    while (analyzer->__partial_len > 0)
+        expr_destruct(_analyzer_release(analyzer));
+    free(analyzer->__partial);
+    while (analyzer->__deferred != NULL) {
+        expr_fixup_t *next = analyzer->__deferred->next;
+        expr_destruct(analyzer->__deferred->expr);
+        free(analyzer->__deferred);
+        analyzer->__deferred = next;
+    }
     lookup_tree_destruct(analyzer->lookup_tree);
+    literal_pool_destruct(analyzer->literals);
     free(analyzer);
 }
 
-uint16_t analyzer_next_instruction(Analyzer *analyzer) {
+/* Assembles the next instruction in the stream and hands it to the output. */
+void analyzer_next_instruction(Analyzer *analyzer) {
 
     // Check if a string literal is currently being translated
     if (analyzer->__str_in_prog != NULL) {
-        return _str_literal(analyzer);
+        _analyzer_emit(analyzer, _str_literal(analyzer), false);
+        return;
     }
+
+    // A pool is placed before its first load could go out of range of it
+    if (_analyzer_pool_due(analyzer)) _analyzer_place_pool(analyzer, true);
     _analyzer_read_token(analyzer);
+    analyzer->__stmt_line = analyzer->token->line;
+    analyzer->__stmt_col = analyzer->token->col;
 
-    // Skip initial identifiers
+    // Directives do not produce instructions
+    if (analyzer->token->type == TokenDirective) {
+        _analyzer_convert_directive(analyzer);
+        return;
+    }
+
+    // Initial identifiers are labels for the instruction which follows, or the names of constants
     if (analyzer->token->type == TokenIdentifier) {
+        Token *next = token_ring_peek(analyzer->lookahead, 0);
+        if (next != NULL && next->type == TokenOperator && !strcmp(next->literal, "EQU")) {
+            _analyzer_define_constant(analyzer);
+            return;
+        }
+        _analyzer_define_label(analyzer);
         _analyzer_read_token(analyzer);
+        analyzer->__stmt_line = analyzer->token->line;
+        analyzer->__stmt_col = analyzer->token->col;
     }
 
     // There must be an operator at the start of each instruction
     if (analyzer->token->type != TokenOperator)
         analyzer_fatal_error(analyzer, "Expected operator, got different token.");
 
-    return _analyzer_convert_statement(analyzer);
+    bool code = strcmp(analyzer->token->literal, "DCD") != 0; // Data is never rewritten by the peephole optimizer
+    _analyzer_emit(analyzer, _analyzer_convert_statement(analyzer), code);
 }
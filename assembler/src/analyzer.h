@@ -1,7 +1,15 @@
 #ifndef _ANALYZER_H_
 #define _ANALYZER_H_
 
+#include "diagnostics.h"
+#include "expressions.h"
 #include "identifiers.h"
+#include "instructions.h"
+#include "lexer.h"
+#include "listing.h"
+#include "literals.h"
+#include "peephole.h"
+#include "relax.h"
 #include "tokens.h"
 #include <stdint.h>
 
@@ -13,19 +21,42 @@ typedef struct ASMRegister {
 
 /* Analyzer */
 typedef struct Analyzer {
-    TokenList *stream;
-    unsigned long stream_index;
+    Lexer *lexer;
+    TokenRing *lookahead;
+    ObjectWriter *out;
+    Peephole *peephole;      // Holds assembled instructions until they are handed to relax
+    Relax *relax;            // Holds instructions until every branch before them has its final length
+    LiteralPool *literals;   // Constants loaded with LDR rd, =constant which have not been placed yet
+    unsigned long assembled; // Instructions assembled so far, before any are removed or lengthened
     ident_node_t *lookup_tree;
-    unsigned long position;
+    unsigned long position; // Address of the next instruction to be placed in the output
     Token *token;
     char *__str_in_prog;
+    bool __lexer_done;
     const char *file_path;
+    Diagnostics *diagnostics; // Where errors are reported
+    ident_t *__ref;           // Identifier referenced by the instruction being assembled, or NULL
+    reloc_t __ref_kind;
+    unsigned long __ref_line;
+    unsigned long __ref_col;
+    expr_t *__expr;                  // Expression for the immediate of the instruction being assembled, or NULL
+    uint16_t __expr_mask;
+    bool __expr_signed;
+    expr_t **__partial;              // Expressions still being parsed, freed if a fatal error abandons them
+    unsigned __partial_len;
+    unsigned __partial_cap;
+    expr_fixup_t *__deferred;        // Immediates waiting on identifiers which are not defined yet, in address order
+    expr_fixup_t *__deferred_tail;
+    Listing *listing;                // Records every word placed in the output, or NULL
+    unsigned long __stmt_line;       // Start of the statement being assembled
+    unsigned long __stmt_col;
 } Analyzer;
 
-Analyzer *analyzer_construct(TokenList *stream, const char *file_path);
+Analyzer *analyzer_construct(Lexer *lexer, ObjectWriter *out, Diagnostics *diagnostics, bool optimize);
 void analyzer_destruct(Analyzer *analyzer);
 
-uint16_t analyzer_next_instruction(Analyzer *analyzer);
+void analyzer_next_instruction(Analyzer *analyzer);
 bool analyzer_finished(Analyzer *analyzer);
+void analyzer_check_references(Analyzer *analyzer);
 
 #endif // _ANALYZER_H_
@@ -0,0 +1,101 @@
+#include "cache.h"
+#include "../../common/isa.h"
+#include "instructions.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CACHE_COPY_CHUNK 65536
+
+/* 64 bit FNV-1a */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t _hash(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Hashes the instruction set the output is encoded by, so that a change to it misses the cache even where the version
+ * was not changed with it. Mnemonics are hashed by their text, since their addresses differ from run to run.
+ */
+static uint64_t _hash_isa(uint64_t hash) {
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT; op++) {
+        const char *mnemonic = ISA[op].mnemonic != NULL ? ISA[op].mnemonic : "";
+        hash = _hash(hash, mnemonic, strlen(mnemonic) + 1);
+        hash = _hash(hash, &ISA[op].layout, sizeof(ISA[op].layout));
+        hash = _hash(hash, &ISA[op].signed_imm, sizeof(ISA[op].signed_imm));
+    }
+    return _hash(hash, ISA_LAYOUTS, sizeof(ISA_LAYOUTS));
+}
+
+/* Returns {dir}/{key}, or {dir}/{key}.{id} for a temporary file. Must be freed by the caller. */
+static char *_cache_path(const char *dir, uint64_t key, const char *suffix, unsigned id) {
+    size_t len = strlen(dir) + CACHE_KEY_LENGTH + strlen(suffix) + 16;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%016" PRIx64 "%s", dir, key, suffix);
+    if (*suffix != '\0') snprintf(&path[strlen(path)], len - strlen(path), "%u", id);
+    return path;
+}
+
+static bool _copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    if (in == NULL) return false;
+    FILE *out = fopen(to, "wb");
+    if (out == NULL) {
+        fclose(in);
+        return false;
+    }
+
+    char *chunk = malloc(CACHE_COPY_CHUNK);
+    size_t read;
+    while ((read = fread(chunk, 1, CACHE_COPY_CHUNK, in)) > 0)
+        fwrite(chunk, 1, read, out);
+    free(chunk);
+
+    bool success = !ferror(in) && !ferror(out);
+    fclose(in);
+    success &= fclose(out) == 0;
+    return success;
+}
+
+/* Creates the cache directory if it does not exist yet. */
+bool cache_open(const char *dir) { return mkdir(dir, 0777) == 0 || errno == EEXIST; }
+
+/* Computes the cache key of a source, from the same copy of it which is assembled. */
+uint64_t cache_key(const char *source, size_t length, unsigned options) {
+    uint64_t hash = _hash(FNV_OFFSET, ASSEMBLER_VERSION, strlen(ASSEMBLER_VERSION) + 1);
+    hash = _hash_isa(hash);
+    hash = _hash(hash, &options, sizeof(options));
+    return _hash(hash, source, length);
+}
+
+/* Copies the cached output for the key to out_file. Returns false on a cache miss. */
+bool cache_fetch(const char *dir, uint64_t key, const char *out_file) {
+    char *path = _cache_path(dir, key, "", 0);
+    bool success = _copy_file(path, out_file);
+    free(path);
+    if (!success) remove(out_file);
+    return success;
+}
+
+/* Stores out_file in the cache under the key. The copy is made under a temporary name which is unique to the caller's
+ * id and then renamed, so files with the same contents can be stored from several threads at once.
+ */
+bool cache_store(const char *dir, uint64_t key, const char *out_file, unsigned id) {
+    char *path = _cache_path(dir, key, "", 0);
+    char *temp = _cache_path(dir, key, ".tmp", id);
+
+    bool success = _copy_file(out_file, temp) && rename(temp, path) == 0;
+    if (!success) remove(temp);
+    free(path);
+    free(temp);
+    return success;
+}
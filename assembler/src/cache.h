@@ -0,0 +1,24 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Object cache. Outputs are stored in a directory under a key made from a hash of the source text, the assembler
+ * version and the options which change the output. A source which has been assembled before is copied from the cache
+ * instead of being lexed and analyzed again.
+ */
+#define CACHE_KEY_LENGTH 16 // Hex digits
+
+/* Options which are part of the key */
+#define CACHE_RELOCATABLE 0x1
+#define CACHE_OPTIMIZE 0x2
+
+bool cache_open(const char *dir);
+uint64_t cache_key(const char *source, size_t length, unsigned options);
+
+bool cache_fetch(const char *dir, uint64_t key, const char *out_file);
+bool cache_store(const char *dir, uint64_t key, const char *out_file, unsigned id);
+
+#endif // _CACHE_H_
@@ -0,0 +1,132 @@
+#include "diagnostics.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+Diagnostics *diagnostics_construct(const char *file_path) {
+    Diagnostics *diagnostics = malloc(sizeof(Diagnostics));
+    diagnostics->file_path = file_path;
+    diagnostics->error_count = 0;
+    diagnostics->entries = NULL;
+    diagnostics->count = 0;
+    diagnostics->__entries_cap = 0;
+    diagnostics->__messages = NULL;
+    diagnostics->__len = 0;
+    diagnostics->__cap = 0;
+    return diagnostics;
+}
+
+void diagnostics_destruct(Diagnostics *diagnostics) {
+    for (unsigned i = 0; i < diagnostics->count; i++) {
+        free(diagnostics->entries[i].message);
+        free(diagnostics->entries[i].subject);
+    }
+    free(diagnostics->entries);
+    free(diagnostics->__messages);
+    free(diagnostics);
+}
+
+__attribute__((format(printf, 2, 0))) static void _diagnostics_append(Diagnostics *diagnostics, const char *format,
+                                                                     va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len < 0) return;
+
+    while (diagnostics->__len + len + 1 > diagnostics->__cap) {
+        diagnostics->__cap = diagnostics->__cap == 0 ? 256 : diagnostics->__cap * 2;
+        diagnostics->__messages = realloc(diagnostics->__messages, diagnostics->__cap);
+    }
+
+    vsnprintf(diagnostics->__messages + diagnostics->__len, len + 1, format, args);
+    diagnostics->__len += len;
+}
+
+__attribute__((format(printf, 2, 3))) static void _diagnostics_print(Diagnostics *diagnostics, const char *format,
+                                                                    ...) {
+    va_list args;
+    va_start(args, format);
+    _diagnostics_append(diagnostics, format, args);
+    va_end(args);
+}
+
+static char *_copy(const char *str) {
+    if (str == NULL) return NULL;
+    char *copy = malloc(strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
+}
+
+/* Adds a structured entry. The message is taken over by the entry, the subject is copied. */
+static void _diagnostics_record(Diagnostics *diagnostics, severity_t severity, unsigned long line, unsigned long col,
+                                char *message, const char *subject) {
+    if (diagnostics->count == diagnostics->__entries_cap) {
+        diagnostics->__entries_cap = diagnostics->__entries_cap == 0 ? 8 : diagnostics->__entries_cap * 2;
+        diagnostics->entries = realloc(diagnostics->entries, sizeof(diagnostic_t) * diagnostics->__entries_cap);
+    }
+    diagnostics->entries[diagnostics->count++] = (diagnostic_t){severity, line, col, message, _copy(subject)};
+    if (severity == SeverityError) diagnostics->error_count++;
+}
+
+/* Formats a message into a new string, without its trailing newline. */
+__attribute__((format(printf, 1, 0))) static char *_format(const char *format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len < 0) len = 0;
+
+    char *message = malloc(len + 1);
+    vsnprintf(message, len + 1, format, args);
+    if (len > 0 && message[len - 1] == '\n') message[len - 1] = '\0';
+    return message;
+}
+
+/* Records an error message which is not about a particular place in the source, such as a file which cannot be opened.
+ * The message is formatted immediately, so its arguments do not need to outlive the call.
+ */
+void diagnostics_error(Diagnostics *diagnostics, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    _diagnostics_append(diagnostics, format, args);
+    va_end(args);
+
+    va_start(args, format);
+    _diagnostics_record(diagnostics, SeverityError, 0, 0, _format(format, args), NULL);
+    va_end(args);
+}
+
+/* Records a message which is reported along with any errors, but does not fail the file. */
+void diagnostics_note(Diagnostics *diagnostics, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char *message = _format(format, args);
+    va_end(args);
+
+    _diagnostics_print(diagnostics, "%s: note: %s\n", diagnostics->file_path, message);
+    _diagnostics_record(diagnostics, SeverityNote, 0, 0, message, NULL);
+}
+
+/* Records an error about a place in the source. A line of zero means the error is about the subject as a whole, such as
+ * an identifier which is never defined.
+ */
+void diagnostics_error_at(Diagnostics *diagnostics, unsigned long line, unsigned long col, const char *message,
+                          const char *subject_kind, const char *subject) {
+    if (line == 0) {
+        _diagnostics_print(diagnostics, "%s: error: %s\n", diagnostics->file_path, message);
+    } else {
+        _diagnostics_print(diagnostics, "%s:%lu:%lu error: %s\n", diagnostics->file_path, line, col, message);
+    }
+    if (subject != NULL) _diagnostics_print(diagnostics, "\t %s: '%s'\n", subject_kind, subject);
+    _diagnostics_record(diagnostics, SeverityError, line, col, _copy(message), subject);
+}
+
+/* Abandons the file being assembled. Control returns to where diagnostics->abort was set. */
+void diagnostics_abort(Diagnostics *diagnostics) { longjmp(diagnostics->abort, 1); }
+
+bool diagnostics_failed(Diagnostics *diagnostics) { return diagnostics->error_count > 0; }
+
+void diagnostics_print(Diagnostics *diagnostics, FILE *stream) {
+    if (diagnostics->__len > 0) fwrite(diagnostics->__messages, 1, diagnostics->__len, stream);
+}
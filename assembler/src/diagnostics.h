@@ -0,0 +1,48 @@
+#ifndef _DIAGNOSTICS_H_
+#define _DIAGNOSTICS_H_
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum Severity {
+    SeverityError, // Fails the file
+    SeverityNote,  // Reported along with any errors
+} severity_t;
+
+/* One message, as reported to a caller of the library rather than printed */
+typedef struct Diagnostic {
+    severity_t severity;
+    unsigned long line; // Place in the source the message is about, or zero if it is not about one place
+    unsigned long col;
+    char *message; // Message without the file name, place or subject
+    char *subject; // Token, identifier or character the message is about, or NULL
+} diagnostic_t;
+
+/* Diagnostics reported while assembling one source file. Messages are buffered instead of printed so that files which
+ * are assembled in parallel can be reported in the order they were given.
+ */
+typedef struct Diagnostics {
+    const char *file_path;
+    unsigned error_count;
+    jmp_buf abort; // Where assembly of the file resumes after a fatal error
+    diagnostic_t *entries;
+    unsigned count;
+    unsigned __entries_cap;
+    char *__messages;
+    size_t __len;
+    size_t __cap;
+} Diagnostics;
+
+Diagnostics *diagnostics_construct(const char *file_path);
+void diagnostics_destruct(Diagnostics *diagnostics);
+
+void diagnostics_error(Diagnostics *diagnostics, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void diagnostics_note(Diagnostics *diagnostics, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void diagnostics_error_at(Diagnostics *diagnostics, unsigned long line, unsigned long col, const char *message,
+                          const char *subject_kind, const char *subject);
+void diagnostics_abort(Diagnostics *diagnostics) __attribute__((noreturn));
+bool diagnostics_failed(Diagnostics *diagnostics);
+void diagnostics_print(Diagnostics *diagnostics, FILE *stream);
+
+#endif // _DIAGNOSTICS_H_
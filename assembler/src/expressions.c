@@ -0,0 +1,173 @@
+/* Implements evaluation of constant expressions. */
+#include "expressions.h"
+#include <stdlib.h>
+
+/* Largest shift which is meaningful for a 16 bit word */
+#define EXPR_MAX_SHIFT 16
+
+expr_t *expr_construct(expr_kind_t kind, expr_t *left, expr_t *right, unsigned long line, unsigned long col) {
+    expr_t *expr = malloc(sizeof(expr_t));
+    expr->kind = kind;
+    expr->value = 0;
+    expr->ident = NULL;
+    expr->left = left;
+    expr->right = right;
+    expr->line = line;
+    expr->col = col;
+    return expr;
+}
+
+void expr_destruct(expr_t *expr) {
+    if (expr == NULL) return;
+    expr_destruct(expr->left);
+    expr_destruct(expr->right);
+    free(expr);
+}
+
+expr_fixup_t *expr_fixup_construct(unsigned long address, expr_t *expr, uint16_t mask, bool signed_imm) {
+    expr_fixup_t *fixup = malloc(sizeof(expr_fixup_t));
+    fixup->address = address;
+    fixup->expr = expr;
+    fixup->mask = mask;
+    fixup->signed_imm = signed_imm;
+    fixup->next = NULL;
+    return fixup;
+}
+
+/* A value during evaluation. In a relocatable object the linker may move a section, so a label's address is only known
+ * relative to its section. Such a value counts how many times the section's base address is added to it (weight), and
+ * only a weight of zero is a constant, as in the difference of two labels in the same section.
+ */
+typedef struct Term {
+    long value;
+    long weight;
+    unsigned section;
+} term_t;
+
+static eval_status_t _fail(eval_result_t *result, const expr_t *at, const char *err_msg) {
+    result->culprit = at;
+    result->err_msg = err_msg;
+    return EvalError;
+}
+
+static eval_status_t _evaluate(const expr_t *expr, bool relocatable, term_t *term, eval_result_t *result);
+
+static eval_status_t _evaluate_identifier(const expr_t *expr, bool relocatable, term_t *term, eval_result_t *result) {
+    ident_t *ident = expr->ident;
+
+    if (ident->equ != NULL) {
+        if (ident->__evaluating) return _fail(result, expr, "Constant is defined in terms of itself.");
+        ident->__evaluating = true;
+        eval_status_t status = _evaluate(ident->equ, relocatable, term, result);
+        ident->__evaluating = false;
+        return status;
+    }
+
+    if (ident->imported) return _fail(result, expr, "Identifier declared with .extern has no value until linked.");
+    if (!ident->defined) {
+        result->culprit = expr;
+        return EvalUndefined;
+    }
+
+    term->value = ident->location;
+    term->weight = relocatable ? 1 : 0;
+    term->section = ident->section;
+    return EvalResolved;
+}
+
+static eval_status_t _evaluate(const expr_t *expr, bool relocatable, term_t *term, eval_result_t *result) {
+    term->value = 0;
+    term->weight = 0;
+    term->section = 0;
+
+    switch (expr->kind) {
+    case ExprNumber:
+        term->value = expr->value;
+        return EvalResolved;
+    case ExprIdentifier:
+        return _evaluate_identifier(expr, relocatable, term, result);
+    default:
+        break;
+    }
+
+    term_t left, right = {0, 0, 0};
+    eval_status_t status = _evaluate(expr->left, relocatable, &left, result);
+    if (status != EvalResolved) return status;
+    if (expr->right != NULL) {
+        status = _evaluate(expr->right, relocatable, &right, result);
+        if (status != EvalResolved) return status;
+    }
+
+    // Labels can only be added and subtracted, and only within a section
+    bool linear = expr->kind == ExprNegate || expr->kind == ExprAdd || expr->kind == ExprSub;
+    if (!linear && (left.weight != 0 || right.weight != 0))
+        return _fail(result, expr, "Label addresses can only be added or subtracted in a relocatable object.");
+    if (left.weight != 0 && right.weight != 0 && left.section != right.section)
+        return _fail(result, expr, "Labels in different sections cannot be combined.");
+    term->section = left.weight != 0 ? left.section : right.section;
+
+    switch (expr->kind) {
+    case ExprNegate:
+        term->value = -left.value;
+        term->weight = -left.weight;
+        break;
+    case ExprAdd:
+        term->value = left.value + right.value;
+        term->weight = left.weight + right.weight;
+        break;
+    case ExprSub:
+        term->value = left.value - right.value;
+        term->weight = left.weight - right.weight;
+        break;
+    case ExprMul:
+        term->value = left.value * right.value;
+        break;
+    case ExprDiv:
+        if (right.value == 0) return _fail(result, expr, "Division by zero.");
+        term->value = left.value / right.value;
+        break;
+    case ExprShiftLeft:
+    case ExprShiftRight:
+        if (right.value < 0 || right.value > EXPR_MAX_SHIFT) return _fail(result, expr, "Shift amount out of range.");
+        if (expr->kind == ExprShiftLeft) {
+            term->value = (long)((unsigned long)left.value << right.value);
+        } else {
+            term->value = left.value >> right.value;
+        }
+        break;
+    case ExprAnd:
+        term->value = left.value & right.value;
+        break;
+    case ExprOr:
+        term->value = left.value | right.value;
+        break;
+    default:
+        break;
+    }
+    return EvalResolved;
+}
+
+/* Evaluates an expression to a constant. On failure, result says which part of the expression was undefined or in
+ * error.
+ */
+eval_status_t expr_evaluate(const expr_t *expr, bool relocatable, eval_result_t *result) {
+    term_t term;
+    result->culprit = NULL;
+    result->err_msg = NULL;
+
+    eval_status_t status = _evaluate(expr, relocatable, &term, result);
+    if (status != EvalResolved) return status;
+    if (term.weight != 0) return _fail(result, expr, "Value depends on where the linker places a section.");
+
+    result->value = term.value;
+    return EvalResolved;
+}
+
+/* Checks that a value fits the field given by mask without being cut down: as a signed offset if the field holds one,
+ * and otherwise as an unsigned value. A whole word may hold either.
+ */
+bool expr_fits(long value, uint16_t mask, bool signed_imm) {
+    if (mask == 0xFFFF) return -0x8000 <= value && value <= 0xFFFF;
+    if (signed_imm) return -(long)(mask / 2) - 1 <= value && value <= mask / 2;
+    return 0 <= value && value <= mask;
+}
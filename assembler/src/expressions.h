@@ -0,0 +1,66 @@
+#ifndef _EXPRESSIONS_H_
+#define _EXPRESSIONS_H_
+
+#include "identifiers.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Constant expressions, which are evaluated by the assembler and folded into immediates. Identifiers in an expression
+ * are EQU constants or labels. An expression which refers to an identifier that is not defined yet is kept until the
+ * end of the file and evaluated then.
+ */
+typedef enum ExprKind {
+    ExprNumber,
+    ExprIdentifier,
+    ExprNegate,
+    ExprAdd,
+    ExprSub,
+    ExprMul,
+    ExprDiv,
+    ExprShiftLeft,
+    ExprShiftRight,
+    ExprAnd,
+    ExprOr,
+} expr_kind_t;
+
+typedef struct expression {
+    expr_kind_t kind;
+    long value;     // ExprNumber
+    ident_t *ident; // ExprIdentifier
+    struct expression *left;
+    struct expression *right; // Binary operators only
+    unsigned long line;
+    unsigned long col;
+} expr_t;
+
+expr_t *expr_construct(expr_kind_t kind, expr_t *left, expr_t *right, unsigned long line, unsigned long col);
+void expr_destruct(expr_t *expr);
+
+/* An immediate which is filled in once its expression can be evaluated */
+typedef struct expr_fixup {
+    unsigned long address;
+    expr_t *expr;
+    uint16_t mask;   // Field of the instruction which holds the value
+    bool signed_imm; // Whether the field holds a signed offset
+    struct expr_fixup *next;
+} expr_fixup_t;
+
+expr_fixup_t *expr_fixup_construct(unsigned long address, expr_t *expr, uint16_t mask, bool signed_imm);
+
+/* Evaluation */
+typedef enum EvalStatus {
+    EvalResolved,
+    EvalUndefined, // Refers to an identifier which is not defined yet
+    EvalError,
+} eval_status_t;
+
+typedef struct EvalResult {
+    long value;
+    const expr_t *culprit; // Part of the expression which is undefined or in error
+    const char *err_msg;
+} eval_result_t;
+
+eval_status_t expr_evaluate(const expr_t *expr, bool relocatable, eval_result_t *result);
+bool expr_fits(long value, uint16_t mask, bool signed_imm) __attribute__((const));
+
+#endif // _EXPRESSIONS_H_
@@ -0,0 +1,156 @@
+/* Implements libgasm. Memory streams let the lexer and the object writer work on buffers without knowing it. */
+#define _GNU_SOURCE
+#include "gasm.h"
+#include "analyzer.h"
+#include "layout.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* Output held in memory. Unlike open_memstream, it can be read back and written over, which the object writer needs to
+ * patch words it has already flushed.
+ */
+typedef struct MemoryStream {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    size_t position;
+} memory_stream_t;
+
+static ssize_t _memory_read(void *cookie, char *buf, size_t size) {
+    memory_stream_t *mem = cookie;
+    if (mem->position >= mem->size) return 0;
+    if (size > mem->size - mem->position) size = mem->size - mem->position;
+    memcpy(buf, &mem->data[mem->position], size);
+    mem->position += size;
+    return size;
+}
+
+static ssize_t _memory_write(void *cookie, const char *buf, size_t size) {
+    memory_stream_t *mem = cookie;
+    if (mem->position + size > mem->capacity) {
+        size_t capacity = mem->capacity == 0 ? 1024 : mem->capacity;
+        while (mem->position + size > capacity)
+            capacity *= 2;
+        uint8_t *data = realloc(mem->data, capacity);
+        if (data == NULL) return -1;
+        mem->data = data;
+        mem->capacity = capacity;
+    }
+    if (mem->position > mem->size) memset(&mem->data[mem->size], 0, mem->position - mem->size);
+    memcpy(&mem->data[mem->position], buf, size);
+    mem->position += size;
+    if (mem->position > mem->size) mem->size = mem->position;
+    return size;
+}
+
+static int _memory_seek(void *cookie, off64_t *offset, int whence) {
+    memory_stream_t *mem = cookie;
+    off64_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (off64_t)mem->position : (off64_t)mem->size;
+    if (base + *offset < 0) return -1;
+    mem->position = base + *offset;
+    *offset = mem->position;
+    return 0;
+}
+
+/* The buffer outlives the stream, and is handed to the result once the writer has closed it. */
+static int _memory_close(void *cookie) {
+    (void)cookie;
+    return 0;
+}
+
+static const cookie_io_functions_t MEMORY_STREAM = {_memory_read, _memory_write, _memory_seek, _memory_close};
+
+/* Streams tokens from the lexer through the analyzer into the writer, and records each word in the listing if one is
+ * given. Any error abandons the source and resumes at the setjmp. The writer is left open, and whether there were errors
+ * is returned.
+ */
+bool gasm_translate(Lexer *lexer, ObjectWriter *writer, Diagnostics *diagnostics, bool optimize, Listing *listing) {
+    Analyzer *volatile analyzer = NULL;
+    if (setjmp(diagnostics->abort) == 0) {
+        analyzer = analyzer_construct(lexer, writer, diagnostics, optimize);
+        analyzer->listing = listing;
+        while (!analyzer_finished(analyzer))
+            analyzer_next_instruction(analyzer);
+        analyzer_check_references(analyzer);
+    }
+    if (analyzer != NULL) analyzer_destruct(analyzer);
+    return !diagnostics_failed(diagnostics);
+}
+
+/* Assembles source, or the source as laid out again if a layout is given. */
+static gasm_result_t *_assemble(const char *source, size_t length, const char *name, gasm_options_t options,
+                                const Layout *layout) {
+    gasm_result_t *result = calloc(1, sizeof(gasm_result_t));
+    result->diagnostics = diagnostics_construct(name);
+    if (layout != NULL) {
+        source = layout->source;
+        length = layout->length;
+    }
+
+    // The source is only ever read, although fmemopen does not take it as const
+    FILE *in = fmemopen((void *)(uintptr_t)source, length, "rb");
+    memory_stream_t mem = {NULL, 0, 0, 0};
+    FILE *out = fopencookie(&mem, "wb+", MEMORY_STREAM);
+    if (in == NULL || out == NULL) {
+        diagnostics_error(result->diagnostics, "Could not open memory streams for %s.\n", name);
+        if (in != NULL) fclose(in);
+        if (out != NULL) fclose(out);
+        return result;
+    }
+
+    Lexer *lexer = lexer_construct_stream(in, name, result->diagnostics);
+    if (layout != NULL) lexer_map_lines(lexer, layout->lines, layout->line_count);
+    ObjectWriter *writer = object_writer_construct_stream(out, options.relocatable);
+    if (options.listing) result->listing = listing_construct(name);
+    bool success = gasm_translate(lexer, writer, result->diagnostics, options.optimize, result->listing);
+    lexer_destruct(lexer);
+
+    if (!success) {
+        object_writer_discard(writer);
+        free(mem.data);
+        return result;
+    }
+    if (!object_writer_destruct(writer)) {
+        diagnostics_error(result->diagnostics, "Could not write the output of %s to memory.\n", name);
+        free(mem.data);
+        return result;
+    }
+    result->success = true;
+    result->output = mem.data;
+    result->output_size = mem.size;
+    return result;
+}
+
+/* Assembles length bytes of source. The name is only used in diagnostics, and to find the source in a profile. The
+ * result must be destroyed by the caller, whether or not assembly succeeded.
+ */
+gasm_result_t *gasm_assemble(const char *source, size_t length, const char *name, gasm_options_t options) {
+    Layout *layout = options.profile != NULL ? layout_construct(source, length, name, options.profile) : NULL;
+    if (layout != NULL && layout->moved == 0) {
+        layout_destruct(layout);
+        layout = NULL;
+    }
+
+    gasm_result_t *result = _assemble(source, length, name, options, layout);
+    if (layout != NULL && result->success) {
+        diagnostics_note(result->diagnostics, "Laid out by profile, moving %u block(s), %u of which never ran.",
+                         layout->moved, layout->cold);
+    } else if (layout != NULL) {
+        // Moving a block can take a PC-relative load or LEA out of range of its label, which source order does not
+        gasm_result_destruct(result);
+        result = _assemble(source, length, name, options, NULL);
+        if (result->success) diagnostics_note(result->diagnostics, "Not laid out by profile, since it would not fit.");
+    }
+    if (layout != NULL) layout_destruct(layout);
+    return result;
+}
+
+void gasm_result_destruct(gasm_result_t *result) {
+    diagnostics_destruct(result->diagnostics);
+    if (result->listing != NULL) listing_destruct(result->listing);
+    free(result->output);
+    free(result);
+}
@@ -0,0 +1,37 @@
+#ifndef _GASM_H_
+#define _GASM_H_
+
+#include "../../common/profile.h"
+#include "diagnostics.h"
+#include "instructions.h"
+#include "lexer.h"
+#include "listing.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* libgasm, the assembler as a library. Source held in memory is assembled into an object held in memory, so tools such
+ * as the test runner can assemble many programs without starting a process or touching the file system for each one.
+ * Errors never exit the process; they are returned as diagnostics, both structured and as the text gassemble prints.
+ */
+typedef struct GasmOptions {
+    bool relocatable;         // Assemble a relocatable object for glink instead of a flat image, like gassemble -c
+    bool optimize;            // Run the peephole optimizer, like gassemble -O
+    bool listing;             // Record a listing of the output, like gassemble --listing
+    const profile_t *profile; // Lay out code by how often it ran, like gassemble --profile, or NULL
+} gasm_options_t;
+
+typedef struct GasmResult {
+    bool success;
+    uint8_t *output;          // Flat image or relocatable object, exactly as gassemble writes it, or NULL on failure
+    size_t output_size;       // Bytes in the output
+    Diagnostics *diagnostics; // Errors and notes, in the order they were reported
+    Listing *listing;         // Every word of the output and where it came from, or NULL if not requested
+} gasm_result_t;
+
+gasm_result_t *gasm_assemble(const char *source, size_t length, const char *name, gasm_options_t options);
+void gasm_result_destruct(gasm_result_t *result);
+
+bool gasm_translate(Lexer *lexer, ObjectWriter *writer, Diagnostics *diagnostics, bool optimize, Listing *listing);
+
+#endif // _GASM_H_
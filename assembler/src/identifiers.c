@@ -1,18 +1,18 @@
 #include "identifiers.h"
+#include "expressions.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Progressing position */
-static unsigned int _str_literal_len(char *literal) {
-    unsigned int length = 0;
-    while (*literal != '\0') {
-        literal += *literal == '\\'; // Skip one char if escape found
-        literal++;
-        length++;
-    }
-    length += (length % 2 == 0) + 1; // Round up to nearest instruction length (2 bytes)
-    return length / 2;
+/* Fixups */
+fixup_t *fixup_construct(unsigned long address, reloc_t kind, unsigned long line, unsigned long col, fixup_t *next) {
+    fixup_t *fixup = malloc(sizeof(fixup_t));
+    fixup->address = address;
+    fixup->kind = kind;
+    fixup->line = line;
+    fixup->col = col;
+    fixup->next = next;
+    return fixup;
 }
 
 /* Identifiers */
@@ -20,11 +20,26 @@ ident_t *identifier_construct(char *name, unsigned long location) {
     ident_t *ident = malloc(sizeof(ident_t));
     ident->name = name;
     ident->location = location;
+    ident->defined = false;
+    ident->pending = NULL;
+    ident->section = 0;
+    ident->exported = false;
+    ident->imported = false;
+    ident->symbol = -1;
+    ident->equ = NULL;
+    ident->__evaluating = false;
     return ident;
 }
 
 void identifier_destruct(ident_t *ident) {
-    free(ident); // Freeing name value will be done by token list
+    while (ident->pending != NULL) {
+        fixup_t *next = ident->pending->next;
+        free(ident->pending);
+        ident->pending = next;
+    }
+    expr_destruct(ident->equ);
+    free(ident->name);
+    free(ident);
 }
 
 /* Identifier lookup */
@@ -36,63 +51,14 @@ static ident_node_t *_lookup_tree_construct(ident_t *ident) {
     return tree;
 }
 
-/* Returns true if successful, false if identifier was already in the tree. */
-static bool _lookup_tree_insert(ident_node_t **root, ident_t *ident) {
-
-    if (root == NULL) {
-        return false;
-    }
-
-    if (*root == NULL) {
-        *root = _lookup_tree_construct(ident);
-        return true;
-    } else {
-        int comp = strcmp((*root)->ident->name, ident->name);
-        if (comp > 0) {
-            return _lookup_tree_insert(&((*root)->right), ident);
-        } else if (comp < 0) {
-            return _lookup_tree_insert(&((*root)->left), ident);
-        } else {
-            return false; // identifier already in tree
-        }
-    }
-}
-
 void lookup_tree_destruct(ident_node_t *root) {
-    // Don't free tokens, they are the responsibility of the token list stream
     if (root == NULL) {
         return;
     }
     lookup_tree_destruct(root->left);
     lookup_tree_destruct(root->right);
-    root = NULL;
-}
-
-ident_node_t *lookup_tree_construct(TokenList *list) {
-    ident_node_t *root = NULL;
-    unsigned long current_pos = 0;
-    for (unsigned int i = 0; i < list->length; i++) {
-        Token *t = list->tokens[i];
-
-        switch (t->type) {
-        case TokenOperator:
-            current_pos++;
-            break;
-        case TokenStr:
-            current_pos += _str_literal_len(t->literal) - 1; // Subtract DCD operator offset, all strings follow DCD
-            break;
-        case TokenIdentifier: {
-            // Only record labels if they do not immediately follow an operator
-            if (i - 1 > 0 && list->tokens[i - 1]->type != TokenOperator) {
-                ident_t *identifier = identifier_construct(t->literal, current_pos);
-                _lookup_tree_insert(&root, identifier);
-            }
-        }
-        default:
-            continue;
-        }
-    }
-    return root;
+    identifier_destruct(root->ident);
+    free(root);
 }
 
 ident_t *lookup_tree_get(ident_node_t *root, char *ident) {
@@ -110,6 +76,38 @@ ident_t *lookup_tree_get(ident_node_t *root, char *ident) {
     }
 }
 
+/* Returns the identifier with the given name, inserting an undefined one (with its own copy of the name) if it is not
+ * in the tree yet. Forward references are recorded on the undefined identifier until its definition is reached.
+ */
+ident_t *lookup_tree_get_or_insert(ident_node_t **root, char *ident) {
+
+    while (*root != NULL) {
+        int comp = strcmp((*root)->ident->name, ident);
+        if (comp > 0) {
+            root = &((*root)->right);
+        } else if (comp < 0) {
+            root = &((*root)->left);
+        } else {
+            return (*root)->ident;
+        }
+    }
+
+    char *name = malloc(strlen(ident) + 1);
+    strcpy(name, ident);
+    *root = _lookup_tree_construct(identifier_construct(name, 0));
+    return (*root)->ident;
+}
+
+/* Calls fn on every identifier in the tree, in a deterministic order. */
+void lookup_tree_for_each(ident_node_t *root, void (*fn)(ident_t *, void *), void *ctx) {
+    if (root == NULL) {
+        return;
+    }
+    lookup_tree_for_each(root->left, fn, ctx);
+    fn(root->ident, ctx);
+    lookup_tree_for_each(root->right, fn, ctx);
+}
+
 // TODO remove this
 void in_order_print(ident_node_t *root) {
     if (root == NULL) {
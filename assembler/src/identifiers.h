@@ -1,13 +1,37 @@
 #ifndef _IDENTIFIERS_H_
 #define _IDENTIFIERS_H_
 
+#include "../../common/object.h"
 #include "tokens.h"
 #include <stdbool.h>
 
+/* A word in the output which must be patched once its identifier is defined. The kind of field which references the
+ * identifier is the same as the relocation type the linker would use for it.
+ */
+typedef struct fixup {
+    unsigned long address;
+    reloc_t kind;
+    unsigned long line;
+    unsigned long col;
+    struct fixup *next;
+} fixup_t;
+
+fixup_t *fixup_construct(unsigned long address, reloc_t kind, unsigned long line, unsigned long col, fixup_t *next);
+
 /* Identifiers */
+struct expression;
+
 typedef struct identifier {
     char *name;
     unsigned long location;
+    bool defined;
+    fixup_t *pending;       // References waiting on the definition
+    unsigned section;       // Section the identifier is defined in
+    bool exported;          // Declared with .global
+    bool imported;          // Declared with .extern
+    long symbol;            // Index in the object's symbol table, or -1 if it has none yet
+    struct expression *equ; // Value of a constant defined with EQU, or NULL for a label
+    bool __evaluating;      // Set while the constant's value is being evaluated, to detect cycles
 } ident_t;
 
 ident_t *identifier_construct(char *name, unsigned long location);
@@ -20,10 +44,11 @@ typedef struct identifier_node {
     struct identifier_node *right;
 } ident_node_t;
 
-ident_node_t *lookup_tree_construct(TokenList *list);
 void lookup_tree_destruct(ident_node_t *root);
 
 ident_t *lookup_tree_get(ident_node_t *root, char *ident);
+ident_t *lookup_tree_get_or_insert(ident_node_t **root, char *ident);
+void lookup_tree_for_each(ident_node_t *root, void (*fn)(ident_t *, void *), void *ctx);
 void in_order_print(ident_node_t *root);
 
 #endif // _IDENTIFIERS_H_
@@ -5,6 +5,13 @@
 
 const char *OBJ_FILE_SUFFIX = ".o";
 const char *DEFAULT_OUT_FILE = "a.o";
+const char *LISTING_FILE_SUFFIX = ".lst";
+const char *ADDRMAP_FILE_SUFFIX = ".map";
+const char *DEFAULT_SECTION = "text";
+
+// Part of every object cache key, so must change whenever the output for a source may change. The instruction set
+// tables are hashed into the key as well, but a change to how they are used is not.
+const char *ASSEMBLER_VERSION = "gassemble 0.7";
 
 /* File type verification */
 static int _is_obj_file(const char *file_path) {
@@ -33,17 +40,8 @@ void instruction_list_destruct(InstructionList *list) {
 
 void instruction_list_append(InstructionList *list, uint16_t instruction) {
     if (list->length == list->__capacity) {
-        list->__capacity *= 2;
-        uint16_t *new_arr = malloc(sizeof(uint16_t) * list->__capacity);
-
-        // Copy over tokens
-        for (unsigned int i = 0; i < list->length; i++) {
-            new_arr[i] = list->instructions[i];
-        }
-
-        // Replace old list
-        free(list->instructions);
-        list->instructions = new_arr;
+        list->__capacity = list->__capacity == 0 ? 1 : list->__capacity * 2;
+        list->instructions = realloc(list->instructions, sizeof(uint16_t) * list->__capacity);
     }
 
     list->instructions[list->length] = instruction;
@@ -62,24 +60,258 @@ uint16_t instruction_list_get(InstructionList *list, int index) {
     return list->instructions[index];
 }
 
-int write_all_instructions(InstructionList *list, const char *file_path) {
+/* Writes every instruction as a big-endian word, with a single write for the whole list. */
+int write_all_instructions(InstructionList *list, FILE *stream) {
+    return object_write_words(stream, list->instructions, list->length) && !ferror(stream);
+}
+
+/* Object writer */
+ObjectWriter *object_writer_construct(const char *file_path, bool relocatable) {
 
     if (!_is_obj_file(file_path)) {
-        return 0;
+        return NULL;
     }
 
-    FILE *fptr = fopen(file_path, "wb");
+    // Opened for update so that already flushed instructions can be patched
+    FILE *fptr = fopen(file_path, "wb+");
 
     if (fptr == NULL) {
-        return 0;
+        return NULL;
+    }
+
+    ObjectWriter *writer = object_writer_construct_stream(fptr, relocatable);
+    writer->file_path = file_path;
+    return writer;
+}
+
+/* Writes to a stream which is already open for update, such as one held in memory. The writer closes the stream. */
+ObjectWriter *object_writer_construct_stream(FILE *fptr, bool relocatable) {
+    ObjectWriter *writer = calloc(1, sizeof(ObjectWriter));
+    writer->stream = fptr;
+    writer->file_path = NULL;
+    writer->buffer = instruction_list_construct(OBJECT_WRITER_CHUNK);
+    writer->flushed = 0;
+    writer->relocatable = relocatable;
+    writer->overflowed = false;
+
+    // Space for the header is reserved now and filled in once the tables are complete
+    if (relocatable) {
+        object_write_header(fptr, 0, 0, 0, 0);
+    }
+    return writer;
+}
+
+static void _object_writer_flush(ObjectWriter *writer) {
+    write_all_instructions(writer->buffer, writer->stream);
+    writer->flushed += writer->buffer->length;
+    writer->buffer->length = 0;
+}
+
+/* Adds a name to the string table and returns its offset. */
+static uint32_t _object_writer_string(ObjectWriter *writer, const char *name) {
+    size_t len = strlen(name) + 1;
+    while (writer->__strings_len + len > writer->__strings_cap) {
+        writer->__strings_cap = writer->__strings_cap == 0 ? 256 : writer->__strings_cap * 2;
+        writer->__strings = realloc(writer->__strings, writer->__strings_cap);
+    }
+    uint32_t offset = writer->__strings_len;
+    memcpy(writer->__strings + offset, name, len);
+    writer->__strings_len += len;
+    return offset;
+}
+
+/* Fills in the length of the current section once it is complete. A length which does not fit the object format
+ * fails the output, the analyzer reports it before the output is finished.
+ */
+static void _object_writer_end_section(ObjectWriter *writer) {
+    if (writer->section_count == 0) return;
+
+    out_section_t *section = &writer->sections[writer->section_count - 1];
+    section->length = object_writer_position(writer) - section->start;
+    if (!writer->relocatable) return;
+    if (section->length > OBJECT_MAX_SECTION_LENGTH) {
+        writer->overflowed = true;
+        return;
+    }
+
+    fseek(writer->stream, section->offset - 2, SEEK_SET);
+    object_put16(writer->stream, section->length);
+    fseek(writer->stream, 0, SEEK_END);
+}
+
+/* Writes the symbol, relocation and string tables of a relocatable object, then the header which counts them. */
+static void _object_writer_write_tables(ObjectWriter *writer) {
+    for (unsigned i = 0; i < writer->symbol_count; i++) {
+        obj_symbol_t *sym = &writer->symbols[i];
+        object_write_symbol(writer->stream, _object_writer_string(writer, sym->name), sym->section, sym->value,
+                            sym->binding);
+    }
+    for (unsigned i = 0; i < writer->relocation_count; i++) {
+        obj_reloc_t *reloc = &writer->relocations[i];
+        object_write_relocation(writer->stream, reloc->section, reloc->offset, reloc->symbol, reloc->type);
+    }
+    fwrite(writer->__strings, 1, writer->__strings_len, writer->stream);
+
+    rewind(writer->stream);
+    object_write_header(writer->stream, writer->section_count, writer->symbol_count, writer->relocation_count,
+                        writer->__strings_len);
+}
+
+static void _object_writer_free(ObjectWriter *writer) {
+    instruction_list_destruct(writer->buffer);
+
+    for (unsigned i = 0; i < writer->section_count; i++)
+        free(writer->sections[i].name);
+    for (unsigned i = 0; i < writer->symbol_count; i++)
+        free(writer->symbols[i].name);
+    free(writer->sections);
+    free(writer->symbols);
+    free(writer->relocations);
+    free(writer->__strings);
+    free(writer);
+}
+
+/* Flushes any remaining instructions and closes the output. Returns 0 if the output could not be written. */
+int object_writer_destruct(ObjectWriter *writer) {
+    _object_writer_flush(writer);
+    _object_writer_end_section(writer);
+    if (writer->relocatable) {
+        _object_writer_write_tables(writer);
+    }
+
+    int success = !writer->overflowed && !ferror(writer->stream);
+    success &= fclose(writer->stream) == 0;
+    _object_writer_free(writer);
+    return success;
+}
+
+/* Closes and removes the output without finishing it, for when assembly fails part way through. */
+void object_writer_discard(ObjectWriter *writer) {
+    fclose(writer->stream);
+    if (writer->file_path != NULL) remove(writer->file_path);
+    _object_writer_free(writer);
+}
+
+/* Address of the next instruction to be appended. */
+unsigned long object_writer_position(ObjectWriter *writer) { return writer->flushed + writer->buffer->length; }
+
+/* Starts a new section at the current position. In a relocatable object every section gets its own header, so anything
+ * buffered for the previous section is flushed first.
+ */
+void object_writer_begin_section(ObjectWriter *writer, const char *name) {
+    _object_writer_flush(writer);
+    _object_writer_end_section(writer);
+
+    if (writer->section_count == writer->__section_capacity) {
+        writer->__section_capacity = writer->__section_capacity == 0 ? 4 : writer->__section_capacity * 2;
+        writer->sections = realloc(writer->sections, sizeof(out_section_t) * writer->__section_capacity);
+    }
+
+    out_section_t *section = &writer->sections[writer->section_count++];
+    section->name = malloc(strlen(name) + 1);
+    strcpy(section->name, name);
+    section->start = object_writer_position(writer);
+    section->length = 0;
+
+    if (writer->relocatable) {
+        object_put32(writer->stream, _object_writer_string(writer, name));
+        object_put16(writer->stream, 0); // Length is filled in when the section ends
+    }
+    section->offset = ftell(writer->stream);
+}
+
+/* Returns the most recent section with the given name, or NULL if there is none. */
+out_section_t *object_writer_find_section(ObjectWriter *writer, const char *name) {
+    for (unsigned i = writer->section_count; i > 0; i--) {
+        if (!strcmp(writer->sections[i - 1].name, name)) {
+            return &writer->sections[i - 1];
+        }
     }
+    return NULL;
+}
 
-    for (unsigned long i = 0; i < list->length; i++) {
-        uint8_t first_half = list->instructions[i] >> 8;
-        uint8_t second_half = list->instructions[i];
-        fwrite(&first_half, 1, 1, fptr);
-        fwrite(&second_half, 1, 1, fptr);
+/* Index of the section containing the given address. */
+static unsigned _object_writer_section_index(ObjectWriter *writer, unsigned long address) {
+    unsigned i = writer->section_count - 1;
+    while (i > 0 && writer->sections[i].start > address) {
+        i--;
     }
-    fclose(fptr);
-    return 1;
+    return i;
+}
+
+void object_writer_append(ObjectWriter *writer, uint16_t instruction) {
+    if (writer->section_count == 0) {
+        object_writer_begin_section(writer, DEFAULT_SECTION);
+    }
+    if (writer->buffer->length == writer->buffer->__capacity) {
+        _object_writer_flush(writer);
+    }
+    instruction_list_append(writer->buffer, instruction);
+}
+
+/* Replaces the bits selected by mask in the instruction at the given address. Instructions which are still buffered are
+ * patched in memory, otherwise the word is read back from the output and rewritten in place.
+ */
+void object_writer_patch(ObjectWriter *writer, unsigned long address, uint16_t mask, uint16_t bits) {
+
+    if (address >= writer->flushed) {
+        uint16_t *inst = &writer->buffer->instructions[address - writer->flushed];
+        *inst = (*inst & ~mask) | (bits & mask);
+        return;
+    }
+
+    out_section_t *section = &writer->sections[_object_writer_section_index(writer, address)];
+    long offset = section->offset + (address - section->start) * 2;
+
+    uint8_t bytes[2];
+    fseek(writer->stream, offset, SEEK_SET);
+    fread(bytes, 1, 2, writer->stream);
+    uint16_t inst = (bytes[0] << 8) | bytes[1];
+    inst = (inst & ~mask) | (bits & mask);
+    bytes[0] = inst >> 8;
+    bytes[1] = inst;
+
+    fseek(writer->stream, offset, SEEK_SET);
+    fwrite(bytes, 1, 2, writer->stream);
+    fseek(writer->stream, 0, SEEK_END); // Resume appending
+}
+
+/* Adds an undefined symbol to a relocatable object's symbol table and returns its index. */
+unsigned object_writer_add_symbol(ObjectWriter *writer, const char *name) {
+    if (writer->symbol_count == writer->__symbol_capacity) {
+        writer->__symbol_capacity = writer->__symbol_capacity == 0 ? 16 : writer->__symbol_capacity * 2;
+        writer->symbols = realloc(writer->symbols, sizeof(obj_symbol_t) * writer->__symbol_capacity);
+    }
+
+    obj_symbol_t *sym = &writer->symbols[writer->symbol_count];
+    sym->name = malloc(strlen(name) + 1);
+    strcpy(sym->name, name);
+    sym->section = OBJECT_NO_SECTION;
+    sym->value = 0;
+    sym->binding = BindImport;
+    return writer->symbol_count++;
+}
+
+/* Gives a symbol its final location. Imported symbols are left without a section. */
+void object_writer_define_symbol(ObjectWriter *writer, unsigned symbol, unsigned long address, binding_t binding) {
+    obj_symbol_t *sym = &writer->symbols[symbol];
+    sym->binding = binding;
+    if (binding == BindImport) return;
+
+    sym->section = _object_writer_section_index(writer, address);
+    sym->value = address - writer->sections[sym->section].start;
+}
+
+/* Records that the instruction at address must be completed by the linker with the location of symbol. */
+void object_writer_add_relocation(ObjectWriter *writer, unsigned long address, reloc_t type, unsigned symbol) {
+    if (writer->relocation_count == writer->__relocation_capacity) {
+        writer->__relocation_capacity = writer->__relocation_capacity == 0 ? 16 : writer->__relocation_capacity * 2;
+        writer->relocations = realloc(writer->relocations, sizeof(obj_reloc_t) * writer->__relocation_capacity);
+    }
+
+    obj_reloc_t *reloc = &writer->relocations[writer->relocation_count++];
+    reloc->section = _object_writer_section_index(writer, address);
+    reloc->offset = address - writer->sections[reloc->section].start;
+    reloc->symbol = symbol;
+    reloc->type = type;
 }
@@ -1,10 +1,17 @@
 #ifndef _INSTRUCTIONS_H_
 #define _INSTRUCTIONS_H_
 
+#include "../../common/object.h"
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 extern const char *OBJ_FILE_SUFFIX;
 extern const char *DEFAULT_OUT_FILE;
+extern const char *LISTING_FILE_SUFFIX;
+extern const char *ADDRMAP_FILE_SUFFIX;
+extern const char *DEFAULT_SECTION;
+extern const char *ASSEMBLER_VERSION;
 
 /* Instruction list */
 typedef struct InstructionList {
@@ -19,6 +26,56 @@ void instruction_list_destruct(InstructionList *list);
 void instruction_list_append(InstructionList *list, uint16_t instruction);
 uint16_t instruction_list_get(InstructionList *list, int index);
 
-int write_all_instructions(InstructionList *list, const char *file_path);
+int write_all_instructions(InstructionList *list, FILE *stream);
+
+/* Object writer (streams finalized instructions to the output in fixed-size chunks) */
+#define OBJECT_WRITER_CHUNK 4096
+
+/* A contiguous run of instructions in the output */
+typedef struct OutputSection {
+    char *name;
+    unsigned long start;  // Address of the first instruction
+    unsigned long length; // Number of instructions
+    long offset;          // File offset of the first instruction
+} out_section_t;
+
+typedef struct ObjectWriter {
+    FILE *stream;
+    const char *file_path;   // Output file, or NULL if the stream is not a file
+    InstructionList *buffer; // Instructions which have not been flushed to the stream yet
+    unsigned long flushed;   // Number of instructions already written to the stream
+    bool relocatable;        // Whether a relocatable object is written instead of a flat image
+    bool overflowed;         // Whether a section was too long for its length to be written
+
+    out_section_t *sections;
+    unsigned section_count;
+    unsigned __section_capacity;
+
+    // Relocatable objects only
+    obj_symbol_t *symbols;
+    unsigned symbol_count;
+    unsigned __symbol_capacity;
+    obj_reloc_t *relocations;
+    unsigned relocation_count;
+    unsigned __relocation_capacity;
+    char *__strings;
+    unsigned long __strings_len;
+    unsigned long __strings_cap;
+} ObjectWriter;
+
+ObjectWriter *object_writer_construct(const char *file_path, bool relocatable);
+ObjectWriter *object_writer_construct_stream(FILE *stream, bool relocatable);
+int object_writer_destruct(ObjectWriter *writer);
+void object_writer_discard(ObjectWriter *writer);
+
+unsigned long object_writer_position(ObjectWriter *writer);
+void object_writer_begin_section(ObjectWriter *writer, const char *name);
+out_section_t *object_writer_find_section(ObjectWriter *writer, const char *name);
+void object_writer_append(ObjectWriter *writer, uint16_t instruction);
+void object_writer_patch(ObjectWriter *writer, unsigned long address, uint16_t mask, uint16_t bits);
+
+unsigned object_writer_add_symbol(ObjectWriter *writer, const char *name);
+void object_writer_define_symbol(ObjectWriter *writer, unsigned symbol, unsigned long address, binding_t binding);
+void object_writer_add_relocation(ObjectWriter *writer, unsigned long address, reloc_t type, unsigned symbol);
 
 #endif // _INSTRUCTIONS_H_
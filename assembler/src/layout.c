@@ -0,0 +1,259 @@
+/* Implements profile-guided layout. The source is only lexed to find its blocks, which are moved as whole lines. */
+#include "layout.h"
+#include "diagnostics.h"
+#include "lexer.h"
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A run of whole lines which nothing falls through into, except the first of a section */
+typedef struct Block {
+    unsigned long start; // First line
+    unsigned long end;   // Line after the last
+    unsigned region;     // Section the block is in, counting from zero in source order
+    bool closed;         // Whether it ends in an unconditional branch or a POP into PC
+    const char *target;  // Label the closing branch goes to, or NULL
+    uint64_t heat;       // Executions of its most executed statement
+} block_t;
+
+/* What the source says about each line */
+typedef struct LineFacts {
+    bool barrier;   // Execution never goes on to the next line
+    bool section;   // A .section directive
+    bool code;      // An instruction
+    bool data;      // A DCD
+    char *label;    // Label defined on the line, or NULL
+    char *target;   // Label a B or BAL on the line goes to, or NULL
+    uint64_t count; // Times the line ran, from the profile
+} line_facts_t;
+
+typedef struct LabelBlock {
+    const char *label;
+    unsigned long block;
+} label_block_t;
+
+static int _compare_labels(const void *a, const void *b) {
+    return strcmp(((const label_block_t *)a)->label, ((const label_block_t *)b)->label);
+}
+
+static void _free_facts(line_facts_t *facts, unsigned long line_count) {
+    for (unsigned long i = 0; i < line_count; i++) {
+        free(facts[i].label);
+        free(facts[i].target);
+    }
+    free(facts);
+}
+
+static char *_copy(const char *text) {
+    char *copy = malloc(strlen(text) + 1);
+    strcpy(copy, text);
+    return copy;
+}
+
+/* Lexes the source to find labels, unconditional branches and sections. Returns false if it does not lex, in which case
+ * assembling it reports why.
+ */
+static bool _scan(const char *source, size_t length, const char *name, line_facts_t *facts) {
+    FILE *in = fmemopen((void *)(uintptr_t)source, length, "rb");
+    if (in == NULL) return false;
+    Diagnostics *diagnostics = diagnostics_construct(name);
+    Lexer *lexer = lexer_construct_stream(in, name, diagnostics);
+
+    bool lexed = false;
+    if (setjmp(diagnostics->abort) == 0) {
+        unsigned long line = 0;
+        char operator[8] = ""; // Operator of the line, if it has been read
+        bool awaiting_target = false;
+        Token *token;
+        for (token = lexer_next_token(lexer); token->type != TokenEOF; token = lexer_next_token(lexer)) {
+            bool first = token->line != line;
+            if (first) {
+                line = token->line;
+                operator[0] = '\0';
+                awaiting_target = false;
+            }
+            line_facts_t *fact = &facts[line - 1];
+
+            if (first && token->type == TokenIdentifier) {
+                fact->label = _copy(token->literal);
+            } else if (token->type == TokenDirective && !strcmp(token->literal, "SECTION")) {
+                fact->section = true;
+            } else if (token->type == TokenOperator && operator[0] == '\0') {
+                snprintf(operator, sizeof(operator), "%s", token->literal);
+                fact->data = !strcmp(operator, "DCD");
+                fact->code = !fact->data && strcmp(operator, "EQU");
+                awaiting_target = !strcmp(operator, "B") || !strcmp(operator, "BAL");
+                fact->barrier = awaiting_target;
+            } else if (awaiting_target && token->type == TokenIdentifier) {
+                fact->target = _copy(token->literal);
+                awaiting_target = false;
+            } else if (token->type == TokenSpecialRegister && !strcmp(token->literal, "PC") &&
+                       !strcmp(operator, "POP")) {
+                fact->barrier = true;
+            }
+            token_destruct(token);
+        }
+        token_destruct(token); // The end of the file
+        lexed = true;
+    }
+
+    lexer_destruct(lexer);
+    diagnostics_destruct(diagnostics);
+    return lexed;
+}
+
+/* Cuts the lines into blocks. Data which nothing falls into and which never ran is not run into the label after it
+ * either, so it ends a block there.
+ */
+static unsigned long _cut(const line_facts_t *facts, unsigned long line_count, block_t *blocks) {
+    unsigned long count = 0;
+    unsigned region = 0;
+    bool only_data = false; // Whether the block so far can only be data, since nothing falls into it and nothing ran
+    bool has_data = false;
+    blocks[0] = (block_t){1, line_count + 1, 0, false, NULL, 0};
+    for (unsigned long line = 1; line <= line_count; line++) {
+        const line_facts_t *fact = &facts[line - 1];
+        if (fact->section && line > blocks[count].start) {
+            blocks[count].end = line;
+            blocks[++count] = (block_t){line, line_count + 1, ++region, false, NULL, 0};
+            only_data = false;
+        } else if (fact->section && line > 1) {
+            blocks[count].region = ++region;
+            only_data = false;
+        } else if (fact->label != NULL && only_data && has_data) {
+            blocks[count].end = line;
+            blocks[count].closed = true;
+            blocks[++count] = (block_t){line, line_count + 1, region, false, NULL, 0};
+            has_data = false;
+        }
+
+        only_data &= !fact->code && fact->count == 0;
+        has_data |= fact->data;
+        if (fact->barrier) {
+            blocks[count].end = line + 1;
+            blocks[count].closed = true;
+            blocks[count].target = fact->target;
+            if (line < line_count) blocks[++count] = (block_t){line + 1, line_count + 1, region, false, NULL, 0};
+            only_data = true;
+            has_data = false;
+        }
+    }
+    return count + 1;
+}
+
+/* Orders the blocks of one region, from first to last, appending them to order. */
+static void _order_region(const block_t *blocks, unsigned long first, unsigned long last, const label_block_t *labels,
+                          unsigned long label_count, bool *placed, unsigned long *order, unsigned long *placed_count) {
+    // A last block which falls through into whatever follows it cannot move
+    unsigned long end = last > first && !blocks[last - 1].closed ? last - 1 : last;
+    order[(*placed_count)++] = first;
+    placed[first] = true;
+
+    for (unsigned long current = first;;) {
+        unsigned long next = last;
+        if (blocks[current].target != NULL) {
+            label_block_t key = {blocks[current].target, 0};
+            const label_block_t *found = bsearch(&key, labels, label_count, sizeof(label_block_t), _compare_labels);
+            if (found != NULL && found->block > first && found->block < end && !placed[found->block] &&
+                blocks[found->block].heat > 0)
+                next = found->block;
+        }
+        if (next == last) {
+            for (unsigned long i = first + 1; i < end; i++) {
+                if (!placed[i] && blocks[i].heat > 0 && (next == last || blocks[i].heat > blocks[next].heat)) next = i;
+            }
+        }
+        if (next == last) break;
+        order[(*placed_count)++] = next;
+        placed[next] = true;
+        current = next;
+    }
+
+    for (unsigned long i = first + 1; i < last; i++) {
+        if (placed[i]) continue;
+        order[(*placed_count)++] = i;
+        placed[i] = true;
+    }
+}
+
+/* Lays out source by a profile of its statements. The name is the file the profile knows the source by. Returns NULL if
+ * the source does not lex, otherwise the layout must be destroyed by the caller.
+ */
+Layout *layout_construct(const char *source, size_t length, const char *name, const profile_t *profile) {
+    unsigned long line_count = 0;
+    for (size_t i = 0; i < length; i++)
+        line_count += source[i] == '\n';
+    if (length > 0 && source[length - 1] != '\n') line_count++;
+    if (line_count == 0) return NULL;
+
+    size_t *starts = malloc(sizeof(size_t) * (line_count + 1));
+    starts[0] = 0;
+    for (size_t i = 0, line = 1; i < length; i++) {
+        if (source[i] == '\n' && line < line_count) starts[line++] = i + 1;
+    }
+    starts[line_count] = length;
+
+    line_facts_t *facts = calloc(line_count, sizeof(line_facts_t));
+    if (!_scan(source, length, name, facts)) {
+        _free_facts(facts, line_count);
+        free(starts);
+        return NULL;
+    }
+
+    for (unsigned long line = 1; line <= line_count; line++)
+        facts[line - 1].count = profile_count(profile, name, line);
+    block_t *blocks = malloc(sizeof(block_t) * line_count);
+    unsigned long block_count = _cut(facts, line_count, blocks);
+    unsigned long label_count = 0;
+    label_block_t *labels = malloc(sizeof(label_block_t) * line_count);
+    for (unsigned long b = 0; b < block_count; b++) {
+        for (unsigned long line = blocks[b].start; line < blocks[b].end; line++) {
+            if (facts[line - 1].count > blocks[b].heat) blocks[b].heat = facts[line - 1].count;
+            if (facts[line - 1].label != NULL) labels[label_count++] = (label_block_t){facts[line - 1].label, b};
+        }
+    }
+    qsort(labels, label_count, sizeof(label_block_t), _compare_labels);
+
+    bool *placed = calloc(block_count, sizeof(bool));
+    unsigned long *order = malloc(sizeof(unsigned long) * block_count);
+    unsigned long placed_count = 0;
+    for (unsigned long first = 0, last; first < block_count; first = last) {
+        for (last = first + 1; last < block_count && blocks[last].region == blocks[first].region; last++)
+            ;
+        _order_region(blocks, first, last, labels, label_count, placed, order, &placed_count);
+    }
+
+    Layout *layout = calloc(1, sizeof(Layout));
+    layout->source = malloc(length + 2);
+    layout->lines = malloc(sizeof(unsigned long) * line_count);
+    for (unsigned long i = 0; i < block_count; i++) {
+        const block_t *block = &blocks[order[i]];
+        if (order[i] != i) {
+            layout->moved++;
+            layout->cold += block->heat == 0;
+        }
+        for (unsigned long line = block->start; line < block->end; line++) {
+            size_t size = starts[line] - starts[line - 1];
+            memcpy(&layout->source[layout->length], &source[starts[line - 1]], size);
+            layout->length += size;
+            // Only the last line of the source may run out without a new line
+            if (layout->source[layout->length - 1] != '\n') layout->source[layout->length++] = '\n';
+            layout->lines[layout->line_count++] = line;
+        }
+    }
+
+    _free_facts(facts, line_count);
+    free(starts);
+    free(blocks);
+    free(labels);
+    free(placed);
+    free(order);
+    return layout;
+}
+
+void layout_destruct(Layout *layout) {
+    free(layout->source);
+    free(layout->lines);
+    free(layout);
+}
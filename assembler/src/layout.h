@@ -0,0 +1,30 @@
+#ifndef _LAYOUT_H_
+#define _LAYOUT_H_
+
+#include "../../common/profile.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Profile-guided layout. Source is cut into blocks which nothing falls through into: each block after the first in a
+ * section begins after an unconditional branch or a POP into PC. Such blocks can be put in any order without changing
+ * what the program does, since every way into them is by a label.
+ *
+ * The first block of each section stays first, and a last block which falls through into whatever follows it stays
+ * last. The others are laid out from the first by following each block's closing branch to the block it branches to,
+ * while that block has run, and otherwise taking the hottest block left. Blocks which never ran are moved after all of
+ * those which did, in source order. A hot path then falls through without its taken branches where -O can remove them,
+ * and hot branches are short enough for imm7.
+ */
+typedef struct Layout {
+    char *source;         // The source with its blocks in their new order
+    size_t length;        // Bytes in source
+    unsigned long *lines; // Indexed by line of the new source less one, the line it came from
+    unsigned long line_count;
+    unsigned moved; // Blocks which are not where they were
+    unsigned cold;  // Blocks which never ran, moved after those which did
+} Layout;
+
+Layout *layout_construct(const char *source, size_t length, const char *name, const profile_t *profile);
+void layout_destruct(Layout *layout);
+
+#endif // _LAYOUT_H_
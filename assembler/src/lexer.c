@@ -2,10 +2,13 @@
 #include "lexer.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+const char *FILE_SUFFIX = ".gasm";
+
 /* File type verification */
 static bool _is_gasm_file(const char *filename) {
 
@@ -93,14 +96,21 @@ static bool is_operator(char *ident) {
 
 bool lexer_eof(Lexer *lexer) { return lexer->character == EOF; }
 
+/* Line in the source as it was written, which differs from the line read in source which has been laid out again. */
+static unsigned long _lexer_line(const Lexer *lexer) {
+    if (lexer->__lines == NULL || lexer->line == 0 || lexer->line > lexer->__line_count) return lexer->line;
+    return lexer->__lines[lexer->line - 1];
+}
+
 static void lexer_fatal_error(Lexer *lexer, const char *err_msg) {
-    const char *format_string = "%s:%lu:%lu: error: %s\n\tcharacter: '%c'\n";
-    if (lexer->character > ' ' || lexer->character < '~') {
-        format_string = "%s:%lu:%lu: error: %s\n\tcharacter: 0x%x (ascii)\n";
+    char character[8];
+    if (lexer->character > ' ' && lexer->character < '~') {
+        snprintf(character, sizeof(character), "%c", lexer->character);
+    } else {
+        snprintf(character, sizeof(character), "0x%02x", (unsigned char)lexer->character);
     }
-    printf(format_string, lexer->file_path, lexer->line, lexer->col, err_msg, lexer->character);
-    fclose(lexer->stream);
-    exit(EXIT_FAILURE);
+    diagnostics_error_at(lexer->diagnostics, _lexer_line(lexer), lexer->col, err_msg, "Character", character);
+    diagnostics_abort(lexer->diagnostics);
 }
 
 /* Helper internals */
@@ -111,30 +121,41 @@ static char _lexer_peek(Lexer *lexer) {
 }
 
 static void _lexer_read_char(Lexer *lexer) {
+
+    // Record the character being stepped over if a slice is in progress
+    if (lexer->__recording) {
+        if (lexer->__slice_len == lexer->__slice_cap) {
+            lexer->__slice_cap *= 2;
+            lexer->__slice = realloc(lexer->__slice, lexer->__slice_cap);
+        }
+        lexer->__slice[lexer->__slice_len++] = lexer->character;
+    }
+
     lexer->character = fgetc(lexer->stream);
     lexer->col++;
 
     // Keeps track of lines and columns
     if (lexer->character == '\n') {
         lexer->line++;
-        lexer->col = 1;
+        lexer->col = 0;
     }
 }
 
-static char *_lexer_slice(Lexer *lexer, long start) {
-    size_t length = ftell(lexer->stream) - (start - 1);
-
-    // Store identifier
-    char *slice = malloc(length + 1);
-
-    fseek(lexer->stream, -length, SEEK_CUR); // Send file stream to start position of slice
-    fseek(lexer->stream, 0, SEEK_CUR);       // Reset stream (saw on StackOverflow lol)
+/* Starts recording characters into a slice, beginning with the current character. */
+static void _lexer_start_slice(Lexer *lexer) {
+    lexer->__slice_len = 0;
+    lexer->__recording = true;
+}
 
-    fgets(slice, length, lexer->stream);
-    fseek(lexer->stream, 1, SEEK_CUR);
-    fseek(lexer->stream, 0, SEEK_CUR);
+/* Stops recording and returns a copy of every character stepped over since the slice started. The stream is never
+ * seeked, so the lexer only ever reads forward through its input.
+ */
+static char *_lexer_slice(Lexer *lexer) {
+    lexer->__recording = false;
 
-    slice[length] = '\0'; // Add null terminator
+    char *slice = malloc(lexer->__slice_len + 1);
+    memcpy(slice, lexer->__slice, lexer->__slice_len);
+    slice[lexer->__slice_len] = '\0'; // Add null terminator
 
     return slice;
 }
@@ -158,11 +179,11 @@ static void _lexer_skip_comment(Lexer *lexer) {
 
 static char *_lexer_read_identifier(Lexer *lexer) {
 
-    long start = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
     while (is_letter(lexer->character) || lexer->character == '_' || is_num(lexer->character)) {
         _lexer_read_char(lexer);
     }
-    return _lexer_slice(lexer, start);
+    return _lexer_slice(lexer);
 }
 
 static char *_lexer_read_bin_literal(Lexer *lexer) {
@@ -172,11 +193,11 @@ static char *_lexer_read_bin_literal(Lexer *lexer) {
     }
     _lexer_read_char(lexer);
 
-    long start = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
     while (is_bin(lexer->character)) {
         _lexer_read_char(lexer);
     }
-    return _lexer_slice(lexer, start);
+    return _lexer_slice(lexer);
 }
 
 static char *_lexer_read_hex_literal(Lexer *lexer) {
@@ -186,25 +207,22 @@ static char *_lexer_read_hex_literal(Lexer *lexer) {
     }
     _lexer_read_char(lexer);
 
-    long start = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
     while (is_hex(lexer->character)) {
         _lexer_read_char(lexer);
     }
-    return _lexer_slice(lexer, start);
+    return _lexer_slice(lexer);
 }
 
 static char *_lexer_read_decimal_literal(Lexer *lexer) {
-    long start = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
     while (is_num(lexer->character)) {
         _lexer_read_char(lexer);
     }
-    return _lexer_slice(lexer, start);
+    return _lexer_slice(lexer);
 }
 
 static char *_lexer_read_numeric_literal(Lexer *lexer, token_t *type) {
-    // Initial read to determine literal type
-    _lexer_read_char(lexer);
-
     if (lexer->character == '0' && _lexer_peek(lexer) == 'b') {
         _lexer_read_char(lexer); // Skip over 'b'
         *type = TokenBin;
@@ -221,7 +239,7 @@ static char *_lexer_read_numeric_literal(Lexer *lexer, token_t *type) {
 
 static char *_lexer_read_string_literal(Lexer *lexer) {
     _lexer_read_char(lexer); // Skip first quote
-    long start_pos = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
     bool escape = false; // Allow \" as a valid character
     while ((lexer->character != '"' || escape) && lexer->character != '\n' && lexer->character != EOF) {
         escape = lexer->character == '\\' && !escape;
@@ -230,27 +248,27 @@ static char *_lexer_read_string_literal(Lexer *lexer) {
 
     if (lexer->character == '\n' || lexer->character == EOF) lexer_fatal_error(lexer, "Unterminated string literal");
 
-    char *value = _lexer_slice(lexer, start_pos);
+    char *value = _lexer_slice(lexer);
     _lexer_read_char(lexer); // Skip last quote
     return value;
 }
 
 static char *_lexer_read_char_literal(Lexer *lexer) {
     _lexer_read_char(lexer); // Read internal character
-    long start_pos = ftell(lexer->stream);
+    _lexer_start_slice(lexer);
 
     if (lexer->character == '\\') _lexer_read_char(lexer); // Escape detected, read another char
 
     _lexer_read_char(lexer); // Get final quote
     if (lexer->character != '\'') lexer_fatal_error(lexer, "Multi-character character literal.");
 
-    char *value = _lexer_slice(lexer, start_pos);
+    char *value = _lexer_slice(lexer);
     _lexer_read_char(lexer); // Skip last quote
     return value;
 }
 
 /* Lexer */
-Lexer *lexer_construct(const char *file_path) {
+Lexer *lexer_construct(const char *file_path, Diagnostics *diagnostics) {
 
     // Verify compatible file
     if (!_is_gasm_file(file_path)) {
@@ -263,17 +281,55 @@ Lexer *lexer_construct(const char *file_path) {
         return NULL;
     }
 
+    return lexer_construct_stream(fptr, file_path, diagnostics);
+}
+
+/* Reads source which is already in memory, named by the file it was read from. The source must outlive the lexer. */
+Lexer *lexer_construct_memory(const char *source, size_t length, const char *file_path, Diagnostics *diagnostics) {
+    if (!_is_gasm_file(file_path)) {
+        return NULL;
+    }
+
+    // The source is only ever read, although fmemopen does not take it as const
+    FILE *fptr = fmemopen((void *)(uintptr_t)source, length, "rb");
+    if (fptr == NULL) {
+        return NULL;
+    }
+
+    return lexer_construct_stream(fptr, file_path, diagnostics);
+}
+
+/* Reads from a stream which is already open, such as source held in memory. The name is used in errors, and the lexer
+ * closes the stream.
+ */
+Lexer *lexer_construct_stream(FILE *fptr, const char *file_path, Diagnostics *diagnostics) {
     Lexer *lexer = malloc(sizeof(Lexer));
     lexer->file_path = file_path;
+    lexer->diagnostics = diagnostics;
     lexer->stream = fptr;
     lexer->line = 1;
-    lexer->col = 1;
+    lexer->col = 0;
+    lexer->__slice_cap = 64;
+    lexer->__slice_len = 0;
+    lexer->__slice = malloc(lexer->__slice_cap);
+    lexer->__recording = false;
+    lexer->__lines = NULL;
+    lexer->__line_count = 0;
     _lexer_read_char(lexer);
     return lexer;
 }
 
+/* Reports tokens at the lines given for each line read, for source whose lines have been moved, such as by the profile
+ * layout. The lines must outlive the lexer.
+ */
+void lexer_map_lines(Lexer *lexer, const unsigned long *lines, unsigned long count) {
+    lexer->__lines = lines;
+    lexer->__line_count = count;
+}
+
 void lexer_destruct(Lexer *lexer) {
     fclose(lexer->stream);
+    free(lexer->__slice);
     free(lexer);
 }
 
@@ -285,33 +341,86 @@ Token *lexer_next_token(Lexer *lexer) {
         _lexer_skip_comment(lexer);
     }
 
+    // Tokens are placed where they start
+    unsigned long line = _lexer_line(lexer), col = lexer->col;
+
     switch (lexer->character) {
     case ',':
         _lexer_read_char(lexer);
-        return token_construct(",", TokenComma, lexer->line, lexer->col);
+        return token_construct(",", TokenComma, line, col);
     case '[':
         _lexer_read_char(lexer);
-        return token_construct("[", TokenLBrack, lexer->line, lexer->col);
+        return token_construct("[", TokenLBrack, line, col);
     case ']':
         _lexer_read_char(lexer);
-        return token_construct("]", TokenRBrack, lexer->line, lexer->col);
+        return token_construct("]", TokenRBrack, line, col);
     case '{':
         _lexer_read_char(lexer);
-        return token_construct("{", TokenLCurl, lexer->line, lexer->col);
+        return token_construct("{", TokenLCurl, line, col);
     case '}':
         _lexer_read_char(lexer);
-        return token_construct("}", TokenRCurl, lexer->line, lexer->col);
+        return token_construct("}", TokenRCurl, line, col);
+    case '(':
+        _lexer_read_char(lexer);
+        return token_construct("(", TokenLParen, line, col);
+    case ')':
+        _lexer_read_char(lexer);
+        return token_construct(")", TokenRParen, line, col);
+    case '+':
+        _lexer_read_char(lexer);
+        return token_construct("+", TokenPlus, line, col);
+    case '-':
+        _lexer_read_char(lexer);
+        return token_construct("-", TokenMinus, line, col);
+    case '*':
+        _lexer_read_char(lexer);
+        return token_construct("*", TokenStar, line, col);
+    case '/':
+        _lexer_read_char(lexer);
+        return token_construct("/", TokenSlash, line, col);
+    case '&':
+        _lexer_read_char(lexer);
+        return token_construct("&", TokenAmpersand, line, col);
+    case '|':
+        _lexer_read_char(lexer);
+        return token_construct("|", TokenPipe, line, col);
+    case '=':
+        _lexer_read_char(lexer);
+        return token_construct("=", TokenEquals, line, col);
+    case '<':
+    case '>': {
+        char direction = lexer->character;
+        _lexer_read_char(lexer);
+        if (lexer->character != direction) lexer_fatal_error(lexer, "Expected shift operator '<<' or '>>'.");
+        _lexer_read_char(lexer);
+        if (direction == '<') return token_construct("<<", TokenShiftLeft, line, col);
+        return token_construct(">>", TokenShiftRight, line, col);
+    }
     case -1:
-        return token_construct(NULL, TokenEOF, lexer->line, lexer->col);
+        return token_construct(NULL, TokenEOF, line, col);
     case '"':
-        return token_construct(_lexer_read_string_literal(lexer), TokenStr, lexer->line, lexer->col);
+        return token_construct(_lexer_read_string_literal(lexer), TokenStr, line, col);
     case '\'':
-        return token_construct(_lexer_read_char_literal(lexer), TokenChar, lexer->line, lexer->col);
-    case '#': {
+        return token_construct(_lexer_read_char_literal(lexer), TokenChar, line, col);
+    case '.': {
+        _lexer_read_char(lexer); // Skip '.'
+        if (!is_letter(lexer->character)) lexer_fatal_error(lexer, "Expected directive name after '.'.");
+        char *directive = _lexer_read_identifier(lexer);
+        string_to_uppercase(directive);
+        return token_construct(directive, TokenDirective, line, col);
+    }
+    case '#':
+        // Marks an immediate, which is a number or an expression made of the tokens which follow
+        _lexer_read_char(lexer);
+        if (!is_num(lexer->character)) return lexer_next_token(lexer);
+        break;
+    }
+
+    // Numbers inside expressions do not need a '#'
+    if (is_num(lexer->character)) {
         token_t num_type = TokenIllegal; // Illegal by default until set
         char *literal = _lexer_read_numeric_literal(lexer, &num_type);
-        return token_construct(literal, num_type, lexer->line, lexer->col);
-    }
+        return token_construct(literal, num_type, line, col);
     }
 
     if (is_letter(lexer->character) || lexer->character == '_') {
@@ -328,7 +437,7 @@ Token *lexer_next_token(Lexer *lexer) {
             ident_type = TokenSpecialRegister;
             string_to_uppercase(identifier);
         }
-        return token_construct(identifier, ident_type, lexer->line, lexer->col);
+        return token_construct(identifier, ident_type, line, col);
     }
 
     lexer_fatal_error(lexer, "Illegal token.");
@@ -1,11 +1,12 @@
 #ifndef _LEXER_H_
 #define _LEXER_H_
 
+#include "diagnostics.h"
 #include "tokens.h"
 #include <stdbool.h>
 #include <stdio.h>
 
-static const char *FILE_SUFFIX = ".gasm";
+extern const char *FILE_SUFFIX;
 
 /* Lexer */
 typedef struct Lexer {
@@ -14,10 +15,20 @@ typedef struct Lexer {
     unsigned long line;
     unsigned long col;
     const char *file_path;
+    Diagnostics *diagnostics;     // Where errors are reported
+    char *__slice;                // Characters of the literal currently being read
+    size_t __slice_len;           // Number of characters recorded into the slice
+    size_t __slice_cap;           // Capacity of the slice buffer
+    bool __recording;             // Whether characters are being recorded into the slice
+    const unsigned long *__lines; // Indexed by line read less one, the line it came from, or NULL if not moved
+    unsigned long __line_count;   // Number of lines in __lines
 } Lexer;
 
-Lexer *lexer_construct(const char *file_path);
+Lexer *lexer_construct(const char *file_path, Diagnostics *diagnostics);
+Lexer *lexer_construct_memory(const char *source, size_t length, const char *file_path, Diagnostics *diagnostics);
+Lexer *lexer_construct_stream(FILE *stream, const char *file_path, Diagnostics *diagnostics);
 void lexer_destruct(Lexer *lexer);
+void lexer_map_lines(Lexer *lexer, const unsigned long *lines, unsigned long count);
 
 bool lexer_eof(Lexer *lexer);
 Token *lexer_next_token(Lexer *lexer);
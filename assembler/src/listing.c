@@ -0,0 +1,106 @@
+/* Implements the listing. */
+#include "listing.h"
+#include "../../common/isa.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Writes the cycle count of a word, which is a range for a conditional branch, or '-' if it is unknown. The counts are
+ * those mcasm generates from the microcode into cycles.h.
+ */
+static void _cycles(const listing_entry_t *entry, char *buf, size_t size) {
+    unsigned taken = isa_cycles(entry->word, true), not_taken = isa_cycles(entry->word, false);
+
+    if (!entry->code || taken == 0) {
+        snprintf(buf, size, "-");
+    } else if (taken == not_taken) {
+        snprintf(buf, size, "%u", taken);
+    } else {
+        snprintf(buf, size, "%u-%u", not_taken, taken);
+    }
+}
+
+Listing *listing_construct(const char *source) {
+    Listing *listing = calloc(1, sizeof(Listing));
+    listing->source = source;
+    return listing;
+}
+
+void listing_destruct(Listing *listing) {
+    for (unsigned long i = 0; i < listing->length; i++) {
+        free(listing->entries[i].labels);
+        free(listing->entries[i].section);
+    }
+    free(listing->entries);
+    free(listing->__labels);
+    free(listing->__section);
+    free(listing);
+}
+
+/* Records a label defined before the next word. */
+void listing_label(Listing *listing, const char *name) {
+    size_t len = listing->__labels == NULL ? 0 : strlen(listing->__labels);
+    listing->__labels = realloc(listing->__labels, len + strlen(name) + 2);
+    if (len > 0) listing->__labels[len++] = ' ';
+    strcpy(&listing->__labels[len], name);
+}
+
+/* Records a section which starts at the next word. */
+void listing_section(Listing *listing, const char *name) {
+    free(listing->__section);
+    listing->__section = malloc(strlen(name) + 1);
+    strcpy(listing->__section, name);
+}
+
+/* Records the word placed at address. Every word of the output is recorded, in address order. */
+void listing_word(Listing *listing, unsigned long address, uint16_t word, bool code, unsigned long line,
+                  unsigned long col) {
+    if (address != listing->length) return;
+    if (listing->length == listing->__capacity) {
+        listing->__capacity = listing->__capacity == 0 ? 256 : listing->__capacity * 2;
+        listing->entries = realloc(listing->entries, sizeof(listing_entry_t) * listing->__capacity);
+    }
+    listing->entries[listing->length++] =
+        (listing_entry_t){word, code, line, col, listing->__labels, listing->__section};
+    listing->__labels = NULL;
+    listing->__section = NULL;
+}
+
+/* Mirrors a patch of the output, so that the listing shows words as they are written. */
+void listing_patch(Listing *listing, unsigned long address, uint16_t mask, uint16_t bits) {
+    if (address >= listing->length) return;
+    uint16_t *word = &listing->entries[address].word;
+    *word = (*word & ~mask) | (bits & mask);
+}
+
+/* Writes the listing as text, one word per line. Returns false if it could not be written. */
+bool listing_write(const Listing *listing, FILE *stream) {
+    fprintf(stream, "; Listing of %s\n", listing->source);
+    fprintf(stream, "; Cycles run from the fetch of an instruction to the next fetch, taken from its microcode path.\n");
+    fprintf(stream, ";\n; %-4s  %-4s  %-6s  %-24s  %s\n", "ADDR", "WORD", "CYCLES", "SOURCE", "LABELS");
+
+    for (unsigned long address = 0; address < listing->length; address++) {
+        const listing_entry_t *entry = &listing->entries[address];
+        if (entry->section != NULL) fprintf(stream, "\n; .section %s\n", entry->section);
+
+        char cycles[16], place[256];
+        _cycles(entry, cycles, sizeof(cycles));
+        snprintf(place, sizeof(place), "%s:%lu:%lu", listing->source, entry->line, entry->col);
+        if (entry->labels != NULL) {
+            fprintf(stream, "  %04lx  %04x  %-6s  %-24s  %s\n", address, entry->word, cycles, place, entry->labels);
+        } else {
+            fprintf(stream, "  %04lx  %04x  %-6s  %s\n", address, entry->word, cycles, place);
+        }
+    }
+    return !ferror(stream);
+}
+
+/* Builds an address map of the listing, for the emulator. */
+addrmap_t *listing_map(const Listing *listing) {
+    addrmap_t *map = addrmap_construct();
+    unsigned file = addrmap_add_file(map, listing->source);
+    for (unsigned long address = 0; address < listing->length && address <= 0xFFFF; address++) {
+        const listing_entry_t *entry = &listing->entries[address];
+        addrmap_add(map, address, file, entry->line, entry->col);
+    }
+    return map;
+}
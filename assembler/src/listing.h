@@ -0,0 +1,43 @@
+#ifndef _LISTING_H_
+#define _LISTING_H_
+
+#include "../../common/addrmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Listing of the output. Every word is recorded as it is given its address, along with the statement which assembled
+ * it, and kept up to date as references in it are patched. Once the source has been assembled the listing can be
+ * written as text, or as an address map for the emulator.
+ */
+typedef struct ListingEntry {
+    uint16_t word;
+    bool code;          // Whether the word is an instruction rather than data
+    unsigned long line; // Statement which assembled the word
+    unsigned long col;
+    char *labels;  // Labels defined at the word, separated by spaces, or NULL
+    char *section; // Section which starts at the word, or NULL
+} listing_entry_t;
+
+typedef struct Listing {
+    const char *source;        // Name of the source file
+    listing_entry_t *entries;  // Indexed by address
+    unsigned long length;
+    unsigned long __capacity;
+    char *__labels;  // Labels waiting for the next word
+    char *__section; // Section waiting for its first word
+} Listing;
+
+Listing *listing_construct(const char *source);
+void listing_destruct(Listing *listing);
+
+void listing_label(Listing *listing, const char *name);
+void listing_section(Listing *listing, const char *name);
+void listing_word(Listing *listing, unsigned long address, uint16_t word, bool code, unsigned long line,
+                  unsigned long col);
+void listing_patch(Listing *listing, unsigned long address, uint16_t mask, uint16_t bits);
+
+bool listing_write(const Listing *listing, FILE *stream);
+addrmap_t *listing_map(const Listing *listing);
+
+#endif // _LISTING_H_
@@ -0,0 +1,82 @@
+/* Implements literal pools. */
+#include "literals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+LiteralPool *literal_pool_construct(void) { return calloc(1, sizeof(LiteralPool)); }
+
+void literal_pool_destruct(LiteralPool *pool) {
+    for (unsigned i = 0; i < pool->length; i++) {
+        expr_destruct(pool->entries[i].expr);
+        identifier_destruct(pool->entries[i].label);
+    }
+    for (unsigned i = 0; i < pool->__retired_count; i++)
+        identifier_destruct(pool->__retired[i]);
+    free(pool->entries);
+    free(pool->__retired);
+    free(pool);
+}
+
+/* Adds an entry whose label is named after the literal, which is how it appears in errors. */
+static literal_t *_literal_pool_add(LiteralPool *pool, literal_kind_t kind, const char *name, unsigned long assembled) {
+    if (pool->length == pool->__capacity) {
+        pool->__capacity = pool->__capacity == 0 ? 16 : pool->__capacity * 2;
+        pool->entries = realloc(pool->entries, sizeof(literal_t) * pool->__capacity);
+    }
+    if (pool->length == 0) pool->first = assembled;
+
+    literal_t *literal = &pool->entries[pool->length++];
+    literal->kind = kind;
+    literal->value = 0;
+    literal->ref = NULL;
+    literal->expr = NULL;
+
+    char *label = malloc(strlen(name) + 2);
+    sprintf(label, "=%s", name);
+    literal->label = identifier_construct(label, 0);
+    return literal;
+}
+
+ident_t *literal_pool_value(LiteralPool *pool, uint16_t value, unsigned long assembled) {
+    for (unsigned i = 0; i < pool->length; i++) {
+        if (pool->entries[i].kind == LiteralValue && pool->entries[i].value == value) return pool->entries[i].label;
+    }
+
+    char name[8];
+    sprintf(name, "0x%04X", value);
+    literal_t *literal = _literal_pool_add(pool, LiteralValue, name, assembled);
+    literal->value = value;
+    return literal->label;
+}
+
+ident_t *literal_pool_address(LiteralPool *pool, ident_t *ref, unsigned long assembled) {
+    for (unsigned i = 0; i < pool->length; i++) {
+        if (pool->entries[i].kind == LiteralAddress && pool->entries[i].ref == ref) return pool->entries[i].label;
+    }
+
+    literal_t *literal = _literal_pool_add(pool, LiteralAddress, ref->name, assembled);
+    literal->ref = ref;
+    return literal->label;
+}
+
+/* Expressions which cannot be evaluated yet always get their own word, since their values cannot be compared. */
+ident_t *literal_pool_expression(LiteralPool *pool, expr_t *expr, unsigned long assembled) {
+    literal_t *literal = _literal_pool_add(pool, LiteralExpression, "expression", assembled);
+    literal->expr = expr;
+    return literal->label;
+}
+
+/* Empties the pool once its words have been handed to the output. Their labels are kept until the pool is destroyed,
+ * since they are only given addresses once every instruction before them has one.
+ */
+void literal_pool_clear(LiteralPool *pool) {
+    for (unsigned i = 0; i < pool->length; i++) {
+        if (pool->__retired_count == pool->__retired_capacity) {
+            pool->__retired_capacity = pool->__retired_capacity == 0 ? 16 : pool->__retired_capacity * 2;
+            pool->__retired = realloc(pool->__retired, sizeof(ident_t *) * pool->__retired_capacity);
+        }
+        pool->__retired[pool->__retired_count++] = pool->entries[i].label;
+    }
+    pool->length = 0;
+}
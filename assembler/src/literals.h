@@ -0,0 +1,48 @@
+#ifndef _LITERALS_H_
+#define _LITERALS_H_
+
+#include "expressions.h"
+#include "identifiers.h"
+#include <stdint.h>
+
+/* Literal pools. Most 16 bit constants do not fit in an immediate field, so LDR rd, =constant loads the constant with a
+ * PC-relative LDR from a word in the next pool after it. Each word is given an anonymous label, which the loads refer to
+ * like any other label. Equal constants share one word in a pool.
+ */
+#define LITERAL_POOL_MAX 62    // Entries in a pool, so that a branch around it is always in range
+#define LITERAL_POOL_REACH 224 // Instructions from the first load to the end of its pool before the pool is placed,
+                               // leaving room for branches in between to be lengthened
+
+typedef enum LiteralKind {
+    LiteralValue,      // Constant which is known already
+    LiteralAddress,    // Address of a label, which may be left for the linker
+    LiteralExpression, // Expression which refers to an identifier that is not defined yet
+} literal_kind_t;
+
+typedef struct Literal {
+    literal_kind_t kind;
+    uint16_t value; // LiteralValue
+    ident_t *ref;   // LiteralAddress
+    expr_t *expr;   // LiteralExpression, owned by the pool until the word is placed
+    ident_t *label; // Label of the word, which loads refer to
+} literal_t;
+
+typedef struct LiteralPool {
+    literal_t *entries;
+    unsigned length;
+    unsigned __capacity;
+    unsigned long first; // Number of instructions assembled before the first load from the pool
+    ident_t **__retired; // Labels of placed words, which may still be waiting in the output for an address
+    unsigned __retired_count;
+    unsigned __retired_capacity;
+} LiteralPool;
+
+LiteralPool *literal_pool_construct(void);
+void literal_pool_destruct(LiteralPool *pool);
+
+ident_t *literal_pool_value(LiteralPool *pool, uint16_t value, unsigned long assembled);
+ident_t *literal_pool_address(LiteralPool *pool, ident_t *ref, unsigned long assembled);
+ident_t *literal_pool_expression(LiteralPool *pool, expr_t *expr, unsigned long assembled);
+void literal_pool_clear(LiteralPool *pool);
+
+#endif // _LITERALS_H_
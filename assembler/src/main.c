@@ -1,54 +1,419 @@
 /* An assembler for the gol-16 assembly language (g-asm) */
-#include "analyzer.h"
+#include "../../common/profile.h"
+#include "cache.h"
+#include "diagnostics.h"
+#include "gasm.h"
 #include "instructions.h"
 #include "lexer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 
-int main(int argc, char *argv[]) {
+/* How often sources are checked for changes in watch mode */
+static const struct timespec WATCH_INTERVAL = {0, 250000000};
 
-    // Grab file name from arguments
-    if (argc > 3) {
-        printf("Too many arguments.");
-        return EXIT_FAILURE;
-    } else if (argc == 1) {
-        printf("Too few arguments.");
-        return EXIT_FAILURE;
+static void usage(void) {
+    puts("USAGE: gassemble [-c] [-O] [-j JOBS] [--cache DIR] [--watch] [--listing] [--profile FILE] INPUT.gasm... "
+         "[OUTPUT.o]");
+}
+
+/* One source file to assemble. Jobs share nothing but their read-only options, so they can run on any thread. */
+typedef struct AssemblyJob {
+    const char *in_file;
+    char *out_file;
+    bool relocatable;
+    bool optimize;
+    bool listing;             // Whether a listing, and an address map for a flat image, are written beside the output
+    const profile_t *profile; // Profile written by gemu which code is laid out by, or NULL
+    const char *cache_dir;    // Object cache, or NULL if outputs are not cached
+    bool hash_source;         // Whether the key of the source is computed, for the cache or for watch mode
+    unsigned id;
+    Diagnostics *diagnostics;
+    bool success;
+    bool keyed;   // Whether key holds the cache key of the source as it was last assembled
+    uint64_t key;
+} asm_job_t;
+
+/* Jobs are handed out to the worker threads in input order */
+typedef struct JobQueue {
+    asm_job_t *jobs;
+    unsigned count;
+    atomic_uint next;
+} job_queue_t;
+
+/* Derives the output of a source file from its name, so that a.gasm is assembled into a.o */
+static char *_default_out_file(const char *in_file) {
+    size_t len = strlen(in_file);
+    size_t suffix_len = strlen(FILE_SUFFIX);
+    if (len >= suffix_len && !strcmp(&in_file[len - suffix_len], FILE_SUFFIX)) len -= suffix_len;
+
+    char *out_file = malloc(len + strlen(OBJ_FILE_SUFFIX) + 1);
+    memcpy(out_file, in_file, len);
+    strcpy(&out_file[len], OBJ_FILE_SUFFIX);
+    return out_file;
+}
+
+/* Derives the name of a file written beside the output, so that a.o has the listing a.lst */
+static char *_sibling_file(const char *out_file, const char *suffix) {
+    size_t len = strlen(out_file);
+    size_t suffix_len = strlen(OBJ_FILE_SUFFIX);
+    if (len >= suffix_len && !strcmp(&out_file[len - suffix_len], OBJ_FILE_SUFFIX)) len -= suffix_len;
+
+    char *file = malloc(len + strlen(suffix) + 1);
+    memcpy(file, out_file, len);
+    strcpy(&file[len], suffix);
+    return file;
+}
+
+/* Writes the listing of a job, and the address map of a flat image for the emulator. */
+static void _write_listing(asm_job_t *job, Listing *listing) {
+    char *listing_file = _sibling_file(job->out_file, LISTING_FILE_SUFFIX);
+    FILE *fptr = fopen(listing_file, "w");
+    bool written = fptr != NULL && listing_write(listing, fptr);
+    if (fptr != NULL) written &= fclose(fptr) == 0;
+    if (!written) diagnostics_error(job->diagnostics, "Could not write to file %s.\n", listing_file);
+    free(listing_file);
+
+    // Addresses in a relocatable object are only final once it is linked
+    if (job->relocatable) return;
+    char *map_file = _sibling_file(job->out_file, ADDRMAP_FILE_SUFFIX);
+    addrmap_t *map = listing_map(listing);
+    if (!addrmap_write(map, map_file)) diagnostics_error(job->diagnostics, "Could not write to file %s.\n", map_file);
+    addrmap_destruct(map);
+    free(map_file);
+}
+
+static bool _is_out_file(const char *arg) {
+    size_t len = strlen(arg);
+    size_t suffix_len = strlen(OBJ_FILE_SUFFIX);
+    return len >= suffix_len && !strcmp(&arg[len - suffix_len], OBJ_FILE_SUFFIX);
+}
+
+static unsigned _cache_options(asm_job_t *job) {
+    return (job->relocatable ? CACHE_RELOCATABLE : 0) | (job->optimize ? CACHE_OPTIMIZE : 0);
+}
+
+/* Reads a whole source file into memory. Returns NULL if it could not be read, otherwise it must be freed. */
+static char *_read_source(const char *in_file, size_t *length) {
+    FILE *fptr = fopen(in_file, "rb");
+    if (fptr == NULL) return NULL;
+    fseek(fptr, 0, SEEK_END);
+    long size = ftell(fptr);
+    rewind(fptr);
+    char *source = malloc(size > 0 ? size : 1);
+    *length = fread(source, 1, size > 0 ? size : 0, fptr);
+
+    bool failed = ferror(fptr);
+    fclose(fptr);
+    if (failed) {
+        free(source);
+        return NULL;
+    }
+    return source;
+}
+
+/* Assembles a source file laid out by its profile. The whole source is read into memory, since it is written again in
+ * a new order before it is assembled.
+ */
+static void _assemble_profiled(asm_job_t *job) {
+    size_t length;
+    char *source = _read_source(job->in_file, &length);
+    if (source == NULL) {
+        diagnostics_error(job->diagnostics, "Could not read from %s: ensure file is of type '%s'.\n", job->in_file,
+                          FILE_SUFFIX);
+        return;
     }
 
-    const char *in_file = argv[1];
-    const char *out_file;
-    if (argc == 3) {
-        out_file = argv[2];
-    } else {
-        out_file = DEFAULT_OUT_FILE;
+    gasm_options_t options = {job->relocatable, job->optimize, job->listing, job->profile};
+    gasm_result_t *result = gasm_assemble(source, length, job->in_file, options);
+    free(source);
+
+    // The result's diagnostics become the job's
+    Diagnostics *diagnostics = job->diagnostics;
+    job->diagnostics = result->diagnostics;
+    result->diagnostics = diagnostics;
+
+    if (result->success) {
+        FILE *out = fopen(job->out_file, "wb");
+        bool written = out != NULL && fwrite(result->output, 1, result->output_size, out) == result->output_size;
+        if (out != NULL) written &= fclose(out) == 0;
+        if (!written) diagnostics_error(job->diagnostics, "Could not write to file %s.\n", job->out_file);
+        if (written && result->listing != NULL) _write_listing(job, result->listing);
+    }
+    job->success = !diagnostics_failed(job->diagnostics);
+    gasm_result_destruct(result);
+}
+
+/* Assembles a single source file. Errors are recorded in the job's diagnostics, and the output is removed if there were
+ * any. A source which is already in the object cache is copied from it instead.
+ */
+static void _assemble(asm_job_t *job) {
+    // The layout depends on the profile as well as the source, so it is not cached
+    if (job->profile != NULL) {
+        _assemble_profiled(job);
+        return;
+    }
+    Diagnostics *diagnostics = job->diagnostics;
+
+    // A keyed source is read once and lexed from memory, so the key is always that of the source which was assembled,
+    // even if the file is saved again part way through
+    size_t length = 0;
+    char *source = job->hash_source ? _read_source(job->in_file, &length) : NULL;
+    job->keyed = source != NULL;
+    if (job->keyed) job->key = cache_key(source, length, _cache_options(job));
+    // A listing is only made by assembling the source
+    if (job->keyed && job->cache_dir != NULL && !job->listing && cache_fetch(job->cache_dir, job->key, job->out_file)) {
+        free(source);
+        job->success = true;
+        return;
     }
 
     // Create lexer
-    Lexer *lexer = lexer_construct(in_file);
+    Lexer *lexer = source != NULL ? lexer_construct_memory(source, length, job->in_file, diagnostics)
+                                  : lexer_construct(job->in_file, diagnostics);
 
     if (lexer == NULL) {
-        printf("Could not read from %s: ensure file is of type '%s'.", in_file, FILE_SUFFIX);
+        diagnostics_error(diagnostics, "Could not read from %s: ensure file is of type '%s'.\n", job->in_file,
+                          FILE_SUFFIX);
+        free(source);
+        return;
     }
 
-    // Parse some tokens
-    TokenList *list = token_list_construct(1);
-    token_list_append(list, token_construct("START", TokenStart, 0, 0));
+    // Create output, instructions are written to it as they are assembled
+    ObjectWriter *writer = object_writer_construct(job->out_file, job->relocatable);
 
-    while (!lexer_eof(lexer) && token_list_get(list, -1)->type != TokenIllegal)
-        token_list_append(list, lexer_next_token(lexer));
+    if (writer == NULL) {
+        diagnostics_error(diagnostics, "Could not write to file %s. Ensure that file is of type '%s'.\n", job->out_file,
+                          OBJ_FILE_SUFFIX);
+        lexer_destruct(lexer);
+        free(source);
+        return;
+    }
+
+    Listing *listing = job->listing ? listing_construct(job->in_file) : NULL;
+    gasm_translate(lexer, writer, diagnostics, job->optimize, listing);
     lexer_destruct(lexer);
+    free(source);
 
-    // Create analyzer
-    Analyzer *analyzer = analyzer_construct(list, in_file);
-    InstructionList *instructions = instruction_list_construct(1);
-    while (!analyzer_finished(analyzer))
-        instruction_list_append(instructions, analyzer_next_instruction(analyzer));
-    analyzer_destruct(analyzer);
-
-    // Write instructions to output
-    bool success = write_all_instructions(instructions, out_file);
-    if (!success) printf("Could not write to file %s. Ensure that file is of type '%s'.\n", out_file, OBJ_FILE_SUFFIX);
-    instruction_list_destruct(instructions);
-    return EXIT_SUCCESS;
+    if (diagnostics_failed(diagnostics)) {
+        object_writer_discard(writer);
+    } else if (!object_writer_destruct(writer)) {
+        diagnostics_error(diagnostics, "Could not write to file %s.\n", job->out_file);
+    } else if (listing != NULL) {
+        _write_listing(job, listing);
+    }
+    if (listing != NULL) listing_destruct(listing);
+    job->success = !diagnostics_failed(diagnostics);
+
+    // A cache which cannot be written to only loses the speed up
+    if (job->success && job->keyed && job->cache_dir != NULL)
+        cache_store(job->cache_dir, job->key, job->out_file, job->id);
+}
+
+static void *_worker(void *arg) {
+    job_queue_t *queue = arg;
+    for (unsigned i = atomic_fetch_add(&queue->next, 1); i < queue->count; i = atomic_fetch_add(&queue->next, 1))
+        _assemble(&queue->jobs[i]);
+    return NULL;
+}
+
+/* Assembles every job on up to thread_count threads, including the calling thread. */
+static void _assemble_all(asm_job_t *jobs, unsigned count, unsigned thread_count) {
+    job_queue_t queue = {jobs, count, 0};
+    if (thread_count > count) thread_count = count;
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * thread_count);
+    unsigned started = 0;
+    for (; started + 1 < thread_count; started++) {
+        if (pthread_create(&threads[started], NULL, _worker, &queue) != 0) break; // Carry on with fewer threads
+    }
+    _worker(&queue);
+
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+/* Reassembles each file whose contents change, until the assembler is interrupted. Files are only checked when their
+ * modification time or size changes, and saving a file without changing it does not reassemble it.
+ */
+static void _watch(asm_job_t *jobs, unsigned count) {
+    struct stat *seen = calloc(count, sizeof(struct stat));
+    for (unsigned i = 0; i < count; i++)
+        stat(jobs[i].in_file, &seen[i]);
+    printf("Watching %u file(s) for changes.\n", count);
+    fflush(stdout);
+
+    for (;;) {
+        nanosleep(&WATCH_INTERVAL, NULL);
+        for (unsigned i = 0; i < count; i++) {
+            asm_job_t *job = &jobs[i];
+            struct stat now;
+            if (stat(job->in_file, &now) != 0) continue; // May be part way through being saved
+            if (now.st_size == seen[i].st_size && now.st_mtim.tv_sec == seen[i].st_mtim.tv_sec &&
+                now.st_mtim.tv_nsec == seen[i].st_mtim.tv_nsec)
+                continue;
+            seen[i] = now;
+
+            // The source is read again when it is assembled, and keyed by that copy
+            size_t length;
+            char *source = job->success && job->keyed ? _read_source(job->in_file, &length) : NULL;
+            bool unchanged = source != NULL && cache_key(source, length, _cache_options(job)) == job->key;
+            free(source);
+            if (unchanged) continue;
+
+            diagnostics_destruct(job->diagnostics);
+            job->diagnostics = diagnostics_construct(job->in_file);
+            _assemble(job);
+            diagnostics_print(job->diagnostics, stdout);
+            if (job->success) printf("%s: assembled into %s\n", job->in_file, job->out_file);
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    // Grab options and file names from arguments
+    bool relocatable = false;
+    bool optimize = false;
+    unsigned long thread_count = 1;
+    const char *cache_dir = NULL;
+    bool watch = false;
+    bool listing = false;
+    const char *profile_file = NULL;
+    const char *out_file = NULL;
+    const char **in_files = malloc(sizeof(char *) * argc);
+    unsigned in_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-c")) {
+            relocatable = true; // Write a relocatable object for glink instead of a flat image
+        } else if (!strcmp(argv[i], "-O")) {
+            optimize = true; // Run the peephole optimizer
+        } else if (!strncmp(argv[i], "-j", 2)) {
+            const char *jobs = argv[i][2] != '\0' ? &argv[i][2] : i + 1 < argc ? argv[++i] : "";
+            char *end;
+            thread_count = strtoul(jobs, &end, 10);
+            if (*jobs == '\0' || *end != '\0' || thread_count == 0) {
+                printf("Expected a positive number of jobs after -j.\n");
+                usage();
+                free(in_files);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--cache")) {
+            if (++i == argc) {
+                printf("Expected a directory after --cache.\n");
+                usage();
+                free(in_files);
+                return EXIT_FAILURE;
+            }
+            cache_dir = argv[i];
+        } else if (!strcmp(argv[i], "--watch")) {
+            watch = true;
+        } else if (!strcmp(argv[i], "--profile")) {
+            if (++i == argc) {
+                printf("Expected a profile written by gemu after --profile.\n");
+                usage();
+                free(in_files);
+                return EXIT_FAILURE;
+            }
+            profile_file = argv[i]; // Lay out code by how often it ran
+        } else if (!strcmp(argv[i], "--listing")) {
+            listing = true; // Write a listing, and an address map for the emulator, beside each output
+        } else if (_is_out_file(argv[i]) && in_count > 0 && out_file == NULL && i == argc - 1) {
+            out_file = argv[i];
+        } else {
+            in_files[in_count++] = argv[i];
+        }
+    }
+
+    if (in_count == 0) {
+        printf("Too few arguments.\n");
+        usage();
+        free(in_files);
+        return EXIT_FAILURE;
+    }
+
+    // An output name can only be given for a single input, otherwise every input names its own output
+    if (out_file != NULL && in_count > 1) {
+        printf("Cannot name a single output for %u input files.\n", in_count);
+        usage();
+        free(in_files);
+        return EXIT_FAILURE;
+    }
+
+    profile_t *profile = NULL;
+    if (profile_file != NULL && (profile = profile_read(profile_file)) == NULL) {
+        printf("Could not read profile %s.\n", profile_file);
+        free(in_files);
+        return EXIT_FAILURE;
+    }
+
+    asm_job_t *jobs = malloc(sizeof(asm_job_t) * in_count);
+    for (unsigned i = 0; i < in_count; i++) {
+        jobs[i].in_file = in_files[i];
+        jobs[i].out_file = _default_out_file(in_files[i]);
+        jobs[i].relocatable = relocatable;
+        jobs[i].optimize = optimize;
+        jobs[i].listing = listing;
+        jobs[i].profile = profile;
+        jobs[i].cache_dir = cache_dir;
+        jobs[i].hash_source = cache_dir != NULL || watch;
+        jobs[i].id = i;
+        jobs[i].keyed = false;
+        jobs[i].diagnostics = diagnostics_construct(in_files[i]);
+        jobs[i].success = false;
+    }
+    if (out_file != NULL) {
+        free(jobs[0].out_file);
+        jobs[0].out_file = malloc(strlen(out_file) + 1);
+        strcpy(jobs[0].out_file, out_file);
+    } else if (in_count == 1) {
+        free(jobs[0].out_file);
+        jobs[0].out_file = malloc(strlen(DEFAULT_OUT_FILE) + 1);
+        strcpy(jobs[0].out_file, DEFAULT_OUT_FILE);
+    }
+
+    // Two jobs writing the same output would race with each other
+    bool duplicate = false;
+    for (unsigned i = 0; i < in_count && !duplicate; i++) {
+        for (unsigned j = i + 1; j < in_count && !duplicate; j++) {
+            if (!strcmp(jobs[i].out_file, jobs[j].out_file)) {
+                printf("Inputs %s and %s would both be assembled into %s.\n", jobs[i].in_file, jobs[j].in_file,
+                       jobs[i].out_file);
+                duplicate = true;
+            }
+        }
+    }
+
+    if (cache_dir != NULL && !cache_open(cache_dir)) {
+        printf("Could not create cache directory %s, assembling without it.\n", cache_dir);
+        for (unsigned i = 0; i < in_count; i++)
+            jobs[i].cache_dir = NULL;
+    }
+
+    if (!duplicate) _assemble_all(jobs, in_count, thread_count);
+
+    // Diagnostics are reported in input order, however the jobs were scheduled
+    int status = duplicate ? EXIT_FAILURE : EXIT_SUCCESS;
+    for (unsigned i = 0; i < in_count; i++) {
+        diagnostics_print(jobs[i].diagnostics, stdout);
+        if (!jobs[i].success) status = EXIT_FAILURE;
+    }
+    if (watch && !duplicate) _watch(jobs, in_count);
+
+    for (unsigned i = 0; i < in_count; i++) {
+        diagnostics_destruct(jobs[i].diagnostics);
+        free(jobs[i].out_file);
+    }
+    free(jobs);
+    free(in_files);
+    if (profile != NULL) profile_destruct(profile);
+    return status;
 }
@@ -0,0 +1,277 @@
+/* Implements the peephole optimizer and its rule table. */
+#include "peephole.h"
+#include "../../common/isa.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Instruction fields */
+static unsigned _rd(uint16_t word) { return (word >> 9) & 0x3; }
+static unsigned _rx(uint16_t word) { return (word >> 7) & 0x3; }
+static unsigned _ry(uint16_t word) { return (word >> 5) & 0x3; }
+static unsigned _imm7(uint16_t word) { return word & 0x7F; }
+static unsigned _imm9(uint16_t word) { return word & 0x1FF; }
+
+/* An instruction whose fields are all known */
+static bool _plain(const peep_insn_t *insn) { return insn->code && insn->ref == NULL && insn->expr == NULL; }
+
+/* Finds the register written by an ALU operation (Form 1 or Form 4), which are the instructions that set the flags from
+ * their result.
+ */
+static bool _alu_destination(uint16_t word, unsigned *rd) {
+    isa_opcode_t op = isa_opcode(word);
+    bool alu = (OP_ADD <= op && op <= OP_OR) || (OP_ADD_IMM <= op && op <= OP_OR_IMM) || op == OP_SHIFT_IMM ||
+               op == OP_SHIFT;
+    if (alu) *rd = isa_decode(word).fields[FieldRd];
+    return alu;
+}
+
+static bool _sets_flags(uint16_t word) {
+    unsigned rd;
+    return _alu_destination(word, &rd) || isa_opcode(word) == OP_CMP || isa_opcode(word) == OP_CMP_IMM;
+}
+
+/* Checks that the flags are overwritten before anything could read them, starting from the instruction at from. Any
+ * branch, data, or the end of the window means the flags may be read.
+ */
+static bool _flags_dead(const peep_insn_t *insns, unsigned from, unsigned available) {
+    for (unsigned i = from; i < available; i++) {
+        uint16_t word = insns[i].word;
+        if (!insns[i].code) return false;
+
+        switch (isa_opcode(word)) {
+        case OP_Bcc:
+        case OP_BLcc:
+            return false;
+        case OP_PUSH:
+            if (word & ISA_STACK_FR) return false;
+            break;
+        case OP_POP:
+            if (word & ISA_STACK_PC) return false;
+            if (word & ISA_STACK_FR) return true;
+            break;
+        default:
+            if (_sets_flags(word)) return true;
+        }
+    }
+    return false;
+}
+
+/* Rules */
+
+/* MOV rX, #0; ADD rX, rX, rY -> MOV rX, rY (also for ADD rX, rY, rX and ADD rX, rX, #imm) */
+static bool _match_mov_zero_add(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    (void)next_label;
+    uint16_t mov = insns[0].word, add = insns[1].word;
+    if (!_plain(&insns[0]) || !_plain(&insns[1])) return false;
+    if (isa_opcode(mov) != OP_MOV_IMM || _imm9(mov) != 0 || _rd(add) != _rd(mov)) return false;
+
+    bool reg = isa_opcode(add) == OP_ADD && (_rx(add) == _rd(mov) || _ry(add) == _rd(mov));
+    bool imm = isa_opcode(add) == OP_ADD_IMM && _rx(add) == _rd(mov);
+    return (reg || imm) && _flags_dead(insns, 2, available); // MOV does not set the flags
+}
+
+static unsigned _rewrite_mov_zero_add(peep_insn_t *insns) {
+    uint16_t add = insns[1].word;
+    unsigned rd = _rd(add);
+    if (isa_opcode(add) == OP_ADD_IMM) {
+        insns[0].word = isa_encode(&(isa_insn_t){OP_MOV_IMM, {[FieldRd] = rd, [FieldImm] = _imm7(add)}});
+    } else {
+        unsigned other = _rx(add) == rd ? _ry(add) : _rx(add);
+        insns[0].word = isa_encode(&(isa_insn_t){OP_MOV, {[FieldRd] = rd, [FieldRx] = other}});
+    }
+    return 1;
+}
+
+/* Checks that nothing reads the carry or overflow flags before they are overwritten, starting from the instruction at
+ * from. A branch on EQ, NE, MI or PL tests only the zero and negative flags, so the search goes on past it, and its
+ * target is taken not to test the carry or overflow flags before setting them. Any other reader, data, or the end of
+ * the window means they may be read.
+ */
+static bool _carry_overflow_dead(const peep_insn_t *insns, unsigned from, unsigned available) {
+    for (unsigned i = from; i < available; i++) {
+        uint16_t word = insns[i].word;
+        if (!insns[i].code) return false;
+
+        switch (isa_opcode(word)) {
+        case OP_Bcc:
+        case OP_BLcc:
+            switch (isa_decode(word).fields[FieldCond]) {
+            case ISA_CONDITION_EQ:
+            case ISA_CONDITION_NE:
+            case ISA_CONDITION_MI:
+            case ISA_CONDITION_PL:
+                break;
+            default:
+                return false;
+            }
+            break;
+        case OP_PUSH:
+            if (word & ISA_STACK_FR) return false;
+            break;
+        case OP_POP:
+            if (word & ISA_STACK_PC) return false;
+            if (word & ISA_STACK_FR) return true;
+            break;
+        default:
+            if (_sets_flags(word)) return true;
+        }
+    }
+    return false;
+}
+
+/* ALU rd, ...; CMP rd, #0 -> ALU rd, ...
+ * The ALU sets the zero and negative flags from its result, which is what comparing the result with zero gives. It
+ * does not set the carry and overflow flags the same way: ADD and SUB set them from their own operation and the other
+ * operations clear them, where CMP rd, #0 sets the carry and clears the overflow flag. The CMP is only dropped when
+ * nothing reads those two flags.
+ */
+static bool _match_cmp_after_alu(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    (void)next_label;
+    uint16_t alu = insns[0].word, cmp = insns[1].word;
+    unsigned rd;
+    if (!_plain(&insns[0]) || !_plain(&insns[1]) || !_alu_destination(alu, &rd)) return false;
+    if (isa_opcode(cmp) != OP_CMP_IMM || _rd(cmp) != rd || _imm9(cmp) != 0) return false;
+    return _carry_overflow_dead(insns, 2, available);
+}
+
+static unsigned _rewrite_drop_second(peep_insn_t *insns) {
+    (void)insns;
+    return 1;
+}
+
+/* MUL rd, rx, #2^k -> LSL rd, rx, #k */
+static bool _match_mul_pow2(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    (void)available;
+    (void)next_label;
+    unsigned imm = _imm7(insns[0].word);
+    return _plain(&insns[0]) && isa_opcode(insns[0].word) == OP_MUL_IMM && imm > 1 && (imm & (imm - 1)) == 0;
+}
+
+static unsigned _rewrite_mul_pow2(peep_insn_t *insns) {
+    uint16_t mul = insns[0].word;
+    unsigned shift = 0;
+    while ((1u << shift) != _imm7(mul))
+        shift++;
+    isa_insn_t lsl = {OP_SHIFT_IMM, {[FieldRd] = _rd(mul), [FieldRx] = _rx(mul), [FieldImm] = shift}};
+    insns[0].word = isa_encode(&lsl);
+    return 1;
+}
+
+/* Bcc to the label which immediately follows it. BLcc is kept since it also sets the link register. */
+static bool _match_branch_next(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    return available == 1 && next_label != NULL && insns[0].code && isa_opcode(insns[0].word) == OP_Bcc &&
+           insns[0].ref == next_label;
+}
+
+static unsigned _rewrite_drop(peep_insn_t *insns) {
+    (void)insns;
+    return 0;
+}
+
+/* MOV rX, rX */
+static bool _match_mov_self(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    (void)available;
+    (void)next_label;
+    return _plain(&insns[0]) && isa_opcode(insns[0].word) == OP_MOV && _rd(insns[0].word) == _rx(insns[0].word);
+}
+
+/* ADD/SUB/OR rX, rX, #0 and MUL/DIV rX, rX, #1, when the flags they set are never read */
+static bool _match_identity(const peep_insn_t *insns, unsigned available, const ident_t *next_label) {
+    (void)next_label;
+    uint16_t word = insns[0].word;
+    if (!_plain(&insns[0]) || _rd(word) != _rx(word)) return false;
+
+    switch (isa_opcode(word)) {
+    case OP_ADD_IMM:
+    case OP_SUB_IMM:
+    case OP_OR_IMM:
+        if (_imm7(word) != 0) return false;
+        break;
+    case OP_MUL_IMM:
+    case OP_DIV_IMM:
+        if (_imm7(word) != 1) return false;
+        break;
+    default:
+        return false;
+    }
+    return _flags_dead(insns, 1, available);
+}
+
+const peephole_rule_t PEEPHOLE_RULES[] = {
+    {"mov-zero-add", 2, _match_mov_zero_add, _rewrite_mov_zero_add},
+    {"cmp-after-alu", 2, _match_cmp_after_alu, _rewrite_drop_second},
+    {"mul-pow2", 1, _match_mul_pow2, _rewrite_mul_pow2},
+    {"branch-next", 1, _match_branch_next, _rewrite_drop},
+    {"mov-self", 1, _match_mov_self, _rewrite_drop},
+    {"identity", 1, _match_identity, _rewrite_drop},
+};
+const unsigned NUM_PEEPHOLE_RULES = sizeof(PEEPHOLE_RULES) / sizeof(peephole_rule_t);
+
+/* Peephole */
+Peephole *peephole_construct(bool enabled, peephole_commit_t commit, void *ctx) {
+    Peephole *peephole = malloc(sizeof(Peephole));
+    peephole->length = 0;
+    peephole->enabled = enabled;
+    peephole->removed = 0;
+    peephole->rewritten = 0;
+    peephole->commit = commit;
+    peephole->ctx = ctx;
+    return peephole;
+}
+
+void peephole_destruct(Peephole *peephole) {
+    for (unsigned i = 0; i < peephole->length; i++)
+        expr_destruct(peephole->window[i].expr);
+    free(peephole);
+}
+
+/* Applies rules at the start of the window until none of them match. */
+static void _peephole_optimize(Peephole *peephole, const ident_t *next_label) {
+    bool changed = true;
+    while (changed && peephole->length > 0) {
+        changed = false;
+        for (unsigned r = 0; r < NUM_PEEPHOLE_RULES && !changed; r++) {
+            const peephole_rule_t *rule = &PEEPHOLE_RULES[r];
+            if (rule->length > peephole->length) continue;
+            if (!rule->match(peephole->window, peephole->length, next_label)) continue;
+
+            unsigned remaining = rule->rewrite(peephole->window);
+            memmove(&peephole->window[remaining], &peephole->window[rule->length],
+                    sizeof(peep_insn_t) * (peephole->length - rule->length));
+            peephole->length -= rule->length - remaining;
+            peephole->removed += rule->length - remaining;
+            peephole->rewritten += remaining > 0;
+            changed = true;
+        }
+    }
+}
+
+static void _peephole_commit_first(Peephole *peephole) {
+    peephole->commit(&peephole->window[0], peephole->ctx);
+    peephole->length--;
+    memmove(&peephole->window[0], &peephole->window[1], sizeof(peep_insn_t) * peephole->length);
+}
+
+/* Adds an assembled instruction to the window. Once the window is full, its first instruction is committed. */
+void peephole_push(Peephole *peephole, peep_insn_t insn) {
+    if (!peephole->enabled) {
+        peephole->commit(&insn, peephole->ctx);
+        return;
+    }
+
+    peephole->window[peephole->length++] = insn;
+    if (peephole->length < PEEPHOLE_WINDOW) return;
+
+    _peephole_optimize(peephole, NULL);
+    if (peephole->length == PEEPHOLE_WINDOW) _peephole_commit_first(peephole);
+}
+
+/* Commits every instruction in the window. Must be called before anything which needs the address of the next
+ * instruction, such as a label (given as next_label) or the start of a section.
+ */
+void peephole_flush(Peephole *peephole, const ident_t *next_label) {
+    while (peephole->length > 0) {
+        _peephole_optimize(peephole, next_label);
+        if (peephole->length > 0) _peephole_commit_first(peephole);
+    }
+}
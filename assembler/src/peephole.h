@@ -0,0 +1,63 @@
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+#include "../../common/object.h"
+#include "expressions.h"
+#include "identifiers.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Peephole optimizer. Assembled instructions are held in a small window before they are given an address, so that
+ * sequences matched by the rule table can be rewritten or removed. Nothing which could be the target of a branch is ever
+ * held in the window: it is flushed before every label, so a rewrite never spans a label.
+ */
+#define PEEPHOLE_WINDOW 8
+
+/* An instruction which has been assembled but not given an address yet */
+typedef struct PeepholeInstruction {
+    uint16_t word;
+    bool code;     // Whether the word is an instruction rather than data from DCD
+    ident_t *ref;  // Identifier referenced by a field of the word, or NULL. Resolved once the address is known.
+    reloc_t kind;  // Type of the referencing field
+    unsigned long line;
+    unsigned long col;
+    expr_t *expr;           // Expression for the immediate field, or NULL. Evaluated at the end of the file.
+    uint16_t expr_mask;     // Immediate field which holds the value of expr
+    bool expr_signed;       // Whether that field holds a signed offset
+    unsigned long src_line; // Statement which assembled the word, for the listing
+    unsigned long src_col;
+} peep_insn_t;
+
+/* Receives each instruction once it leaves the window, in order */
+typedef void (*peephole_commit_t)(peep_insn_t *insn, void *ctx);
+
+typedef struct Peephole {
+    peep_insn_t window[PEEPHOLE_WINDOW];
+    unsigned length;
+    bool enabled; // Whether rules are applied, otherwise instructions are committed as soon as they are pushed
+    unsigned long removed;
+    unsigned long rewritten;
+    peephole_commit_t commit;
+    void *ctx;
+} Peephole;
+
+/* A rule matches instructions at the start of the window. It is also given the rest of the window, to check that a
+ * change in flags cannot be observed, and the label which follows the window if it is being flushed before one.
+ */
+typedef struct PeepholeRule {
+    const char *name;
+    unsigned length; // Instructions matched
+    bool (*match)(const peep_insn_t *insns, unsigned available, const ident_t *next_label);
+    unsigned (*rewrite)(peep_insn_t *insns); // Rewrites the matched instructions in place and returns how many remain
+} peephole_rule_t;
+
+extern const peephole_rule_t PEEPHOLE_RULES[];
+extern const unsigned NUM_PEEPHOLE_RULES;
+
+Peephole *peephole_construct(bool enabled, peephole_commit_t commit, void *ctx);
+void peephole_destruct(Peephole *peephole);
+
+void peephole_push(Peephole *peephole, peep_insn_t insn);
+void peephole_flush(Peephole *peephole, const ident_t *next_label);
+
+#endif // _PEEPHOLE_H_
@@ -0,0 +1,289 @@
+/* Implements branch relaxation. */
+#include "relax.h"
+#include "../../common/isa.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Condition which holds exactly when the one at the same index does not */
+static const uint8_t INVERSE_CONDITION[] = {0x1, 0x0, 0x4, 0x5, 0x2, 0x3, 0x7, 0x6, 0x9, 0x8, 0xB, 0xA, 0xD, 0xC};
+
+static unsigned _condition(uint16_t word) { return isa_decode(word).fields[FieldCond]; }
+/* Encodes an instruction of the long forms, which only use R0. The condition is given for a branch. */
+static uint16_t _encode(isa_opcode_t opcode, unsigned condition, unsigned imm) {
+    isa_insn_t insn = {opcode, {[FieldCond] = condition, [FieldImm] = imm}};
+    return isa_encode(&insn);
+}
+
+static bool _link(const relax_item_t *item) { return isa_opcode(item->insn.word) == OP_BLcc; }
+
+/* The long forms of a branch are:
+ *
+ *        B!cc skip         ; Only for a conditional branch
+ *        PUSH {R0}
+ *        LEA R0, target    ; LDR R0, [literal] for the far form
+ *        PUSH {R0}
+ *        LEA R0, skip      ; Only for BLcc, the return address
+ *        PUSH {R0}         ; Only for BLcc
+ *        POP {R0, PC}      ; POP {R0, PC, LR} for BLcc, which pops LR, then PC, then R0
+ *        DCD target        ; Only for the far form, the literal
+ *   skip ...
+ *
+ * R0 and the flags are left as they were, but the two words below SP, or three for BLcc, are overwritten.
+ */
+static unsigned _relax_body(const relax_item_t *item) {
+    return (item->form == RelaxNear ? 4 : 5) + (_link(item) ? 2 : 0);
+}
+
+static unsigned _relax_skip(const relax_item_t *item) { return _condition(item->insn.word) != ISA_CONDITION_ALWAYS; }
+
+/* Number of words the item takes in the output */
+static unsigned _relax_size(const relax_item_t *item) {
+    if (item->label != NULL) return 0;
+    if (!item->branch || item->form == RelaxShort) return 1;
+    return _relax_skip(item) + _relax_body(item);
+}
+
+/* Shortest form which reaches target from a branch at address. The LEA of the near form follows the skip and a PUSH. */
+static relax_form_t _relax_form_for(const relax_item_t *item, unsigned long address, unsigned long target) {
+    if (reloc_in_range(RelocRelative7, target, address)) return RelaxShort;
+    if (reloc_in_range(RelocRelative9, target, address + _relax_skip(item) + 1)) return RelaxNear;
+    return RelaxFar;
+}
+
+/* Gives every item the address it has with the current forms, and returns the address which follows the buffer. */
+static unsigned long _relax_layout(Relax *relax) {
+    unsigned long address = relax->base;
+    for (unsigned i = 0; i < relax->length; i++) {
+        relax->items[i].address = address;
+        address += _relax_size(&relax->items[i]);
+    }
+    return address;
+}
+
+/* Grows branches until every one of them reaches its target. A target which is not defined yet is at least as far away
+ * as the end of the buffer.
+ */
+static void _relax_grow(Relax *relax) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        unsigned long end = _relax_layout(relax);
+
+        for (unsigned i = 0; i < relax->length; i++) {
+            relax_item_t *item = &relax->items[i];
+            if (!item->branch || item->form == RelaxFar) continue;
+
+            unsigned long target = item->target == RELAX_UNKNOWN  ? end
+                                   : item->target == RELAX_PLACED ? item->insn.ref->location
+                                                                  : relax->items[item->target].address;
+            relax_form_t form = _relax_form_for(item, item->address, target);
+            if (form > item->form) {
+                item->form = form;
+                changed = true;
+            }
+        }
+    }
+}
+
+/* Number of items at the start of the buffer whose addresses and forms can no longer change. A branch whose target is
+ * unknown may still grow, and so may any branch across it.
+ */
+static unsigned _relax_settled(const Relax *relax) {
+    unsigned settled = relax->length;
+    for (unsigned i = 0; i < relax->length; i++) {
+        const relax_item_t *item = &relax->items[i];
+        if (item->branch && item->target == RELAX_UNKNOWN && item->form != RelaxFar) {
+            settled = i;
+            break;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (unsigned i = 0; i < settled && !changed; i++) {
+            const relax_item_t *item = &relax->items[i];
+            if (item->branch && item->form != RelaxFar && item->target > (long)settled) {
+                settled = i;
+                changed = true;
+            }
+        }
+    }
+    return settled;
+}
+
+static peep_insn_t _relax_word(const relax_item_t *item, uint16_t word) {
+    peep_insn_t insn = item->insn;
+    insn.word = word;
+    insn.ref = NULL;
+    return insn;
+}
+
+/* Places the long form of a branch. The target is referenced from the LEA or the literal instead of the branch. */
+static void _relax_place_long(Relax *relax, const relax_item_t *item) {
+    unsigned body = _relax_body(item);
+    peep_insn_t words[8];
+    unsigned n = 0;
+
+    if (_relax_skip(item)) {
+        unsigned inverse = INVERSE_CONDITION[_condition(item->insn.word)];
+        words[n++] = _relax_word(item, _encode(OP_Bcc, inverse, body + 1));
+    }
+    words[n++] = _relax_word(item, _encode(OP_PUSH, 0, ISA_STACK_R0));
+
+    if (item->form == RelaxNear) {
+        words[n] = _relax_word(item, _encode(OP_LEA, 0, 0));
+        words[n].ref = item->insn.ref;
+        words[n++].kind = RelocRelative9;
+    } else {
+        words[n++] = _relax_word(item, _encode(OP_LDR_PC, 0, body - 2));
+    }
+    words[n++] = _relax_word(item, _encode(OP_PUSH, 0, ISA_STACK_R0));
+
+    if (_link(item)) {
+        words[n++] = _relax_word(item, _encode(OP_LEA, 0, body - 3));
+        words[n++] = _relax_word(item, _encode(OP_PUSH, 0, ISA_STACK_R0));
+        words[n++] = _relax_word(item, _encode(OP_POP, 0, ISA_STACK_R0 | ISA_STACK_PC | ISA_STACK_LR));
+    } else {
+        words[n++] = _relax_word(item, _encode(OP_POP, 0, ISA_STACK_R0 | ISA_STACK_PC));
+    }
+
+    if (item->form == RelaxFar) {
+        words[n] = _relax_word(item, 0);
+        words[n].code = false;
+        words[n].ref = item->insn.ref;
+        words[n++].kind = RelocAbsolute16;
+    }
+
+    for (unsigned i = 0; i < n; i++)
+        relax->place(&words[i], relax->ctx);
+    relax->lengthened++;
+    relax->added += n - 1;
+}
+
+static void _relax_place(Relax *relax, relax_item_t *item) {
+    if (item->label != NULL) {
+        relax->define(item->label, relax->ctx);
+    } else if (item->branch && item->form != RelaxShort) {
+        _relax_place_long(relax, item);
+    } else {
+        relax->place(&item->insn, relax->ctx);
+    }
+    relax->base += _relax_size(item);
+}
+
+/* Places the first count items and removes them from the buffer. */
+static void _relax_release(Relax *relax, unsigned count) {
+    if (count == 0) return;
+    for (unsigned i = 0; i < count; i++)
+        _relax_place(relax, &relax->items[i]);
+
+    relax->length -= count;
+    memmove(relax->items, &relax->items[count], sizeof(relax_item_t) * relax->length);
+    for (unsigned i = 0; i < relax->length; i++) {
+        relax_item_t *item = &relax->items[i];
+        if (item->target >= (long)count) {
+            item->target -= count;
+        } else if (item->target >= 0) {
+            item->target = RELAX_PLACED;
+        }
+    }
+}
+
+static void _relax_update(Relax *relax) {
+    _relax_grow(relax);
+    _relax_release(relax, _relax_settled(relax));
+}
+
+static void _relax_append(Relax *relax, relax_item_t item) {
+    if (relax->length == relax->__capacity) {
+        relax->__capacity = relax->__capacity == 0 ? 64 : relax->__capacity * 2;
+        relax->items = realloc(relax->items, sizeof(relax_item_t) * relax->__capacity);
+    }
+    relax->items[relax->length++] = item;
+}
+
+static long _relax_find(const Relax *relax, const ident_t *label) {
+    if (label->defined) return RELAX_PLACED;
+    for (unsigned i = 0; i < relax->length; i++) {
+        if (relax->items[i].label == label) return i;
+    }
+    return RELAX_UNKNOWN;
+}
+
+/* Relax */
+Relax *relax_construct(relax_place_t place, relax_define_t define, relax_fixed_t fixed, void *ctx) {
+    Relax *relax = malloc(sizeof(Relax));
+    relax->items = NULL;
+    relax->length = 0;
+    relax->__capacity = 0;
+    relax->base = 0;
+    relax->lengthened = 0;
+    relax->added = 0;
+    relax->place = place;
+    relax->define = define;
+    relax->fixed = fixed;
+    relax->ctx = ctx;
+    return relax;
+}
+
+void relax_destruct(Relax *relax) {
+    for (unsigned i = 0; i < relax->length; i++)
+        expr_destruct(relax->items[i].insn.expr);
+    free(relax->items);
+    free(relax);
+}
+
+/* Adds an instruction which has left the peephole window. It is placed straight away unless a branch before it may
+ * still grow, or it is itself a branch to a label which is not defined yet.
+ */
+void relax_push(Relax *relax, peep_insn_t insn) {
+    relax_item_t item = {insn, NULL, false, RelaxShort, RELAX_UNKNOWN, relax->base};
+    item.branch = insn.code && insn.ref != NULL && insn.kind == RelocRelative7 && !relax->fixed(insn.ref, relax->ctx);
+    if (item.branch) item.target = _relax_find(relax, insn.ref);
+
+    if (relax->length == 0 && (!item.branch || item.target == RELAX_PLACED)) {
+        if (item.branch) item.form = _relax_form_for(&item, relax->base, insn.ref->location);
+        _relax_place(relax, &item);
+        return;
+    }
+    _relax_append(relax, item);
+    _relax_update(relax);
+}
+
+/* Defines a label at the end of the buffer, which resolves every branch waiting on it. */
+void relax_label(Relax *relax, ident_t *label) {
+    if (relax->length == 0) {
+        relax->define(label, relax->ctx);
+        return;
+    }
+
+    relax_item_t item = {.label = label, .form = RelaxShort, .target = RELAX_UNKNOWN};
+    _relax_append(relax, item);
+    for (unsigned i = 0; i + 1 < relax->length; i++) {
+        relax_item_t *branch = &relax->items[i];
+        if (branch->branch && branch->target == RELAX_UNKNOWN && branch->insn.ref == label)
+            branch->target = relax->length - 1;
+    }
+    _relax_update(relax);
+}
+
+/* Whether the label has been reached but is still waiting in the buffer for an address */
+bool relax_pending(const Relax *relax, const ident_t *label) {
+    for (unsigned i = 0; i < relax->length; i++) {
+        if (relax->items[i].label == label) return true;
+    }
+    return false;
+}
+
+/* Places everything in the buffer. A branch whose target is still unknown is left short, for the linker to resolve or
+ * for an error to be reported.
+ */
+void relax_flush(Relax *relax) {
+    for (unsigned i = 0; i < relax->length; i++) {
+        relax_item_t *item = &relax->items[i];
+        if (item->branch && item->target == RELAX_UNKNOWN) item->branch = false;
+    }
+    _relax_grow(relax);
+    _relax_release(relax, relax->length);
+}
@@ -0,0 +1,66 @@
+#ifndef _RELAX_H_
+#define _RELAX_H_
+
+#include "identifiers.h"
+#include "peephole.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Branch relaxation. Bcc and BLcc only reach 64 words either side of themselves, so a branch to a label which is further
+ * away is replaced with a longer sequence which loads the target into PC through the stack. Every branch is given the
+ * shortest form which reaches its target.
+ *
+ * A backward branch is sized as soon as it is assembled. A forward branch is held in a buffer, along with everything
+ * after it, until its target is defined or it is already too far from the end of the buffer to be short. Lengthening a
+ * branch moves everything after it, which can take other branches out of range, so forms are recomputed until none of
+ * them change. Forms only ever grow, so this always finishes.
+ */
+typedef enum RelaxForm {
+    RelaxShort, // Bcc/BLcc label
+    RelaxNear,  // Target loaded with LEA, within 256 words of it
+    RelaxFar,   // Target loaded from a literal word which follows the sequence
+} relax_form_t;
+
+/* Target of a branch which is not a label in the buffer */
+#define RELAX_PLACED -1  // Defined before the buffer, so its address is final
+#define RELAX_UNKNOWN -2 // Not defined yet
+
+/* An instruction or label which has not been given an address yet */
+typedef struct RelaxItem {
+    peep_insn_t insn;
+    ident_t *label; // Label defined at this point, instead of an instruction, or NULL
+    bool branch;    // Whether insn is a branch to a label which may be lengthened
+    relax_form_t form;
+    long target;           // Index of the branch's target label in the buffer, RELAX_PLACED or RELAX_UNKNOWN
+    unsigned long address; // Address the item will have if no branch before it grows
+} relax_item_t;
+
+/* Receives each instruction of the output once its address is final, in order */
+typedef void (*relax_place_t)(peep_insn_t *insn, void *ctx);
+/* Receives each label once its address is final */
+typedef void (*relax_define_t)(ident_t *label, void *ctx);
+/* Whether the distance to a branch target cannot be known by the assembler, so the branch is left short */
+typedef bool (*relax_fixed_t)(const ident_t *target, void *ctx);
+
+typedef struct Relax {
+    relax_item_t *items;
+    unsigned length;
+    unsigned __capacity;
+    unsigned long base;       // Address of the first item in the buffer
+    unsigned long lengthened; // Branches given a long form
+    unsigned long added;      // Words added by long forms
+    relax_place_t place;
+    relax_define_t define;
+    relax_fixed_t fixed;
+    void *ctx;
+} Relax;
+
+Relax *relax_construct(relax_place_t place, relax_define_t define, relax_fixed_t fixed, void *ctx);
+void relax_destruct(Relax *relax);
+
+void relax_push(Relax *relax, peep_insn_t insn);
+void relax_label(Relax *relax, ident_t *label);
+bool relax_pending(const Relax *relax, const ident_t *label);
+void relax_flush(Relax *relax);
+
+#endif // _RELAX_H_
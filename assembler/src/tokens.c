@@ -4,24 +4,24 @@
 #include <string.h>
 
 /* Condition code and operator lists */
-const operator_t OPERATORS[] = {{"ADD", {0x01, 0x11}, Form1},
-                                {"SUB", {0x02, 0x12}, Form1},
-                                {"MUL", {0x03, 0x13}, Form1},
-                                {"DIV", {0x04, 0x14}, Form1},
-                                {"AND", {0x05, 0x15}, Form1},
-                                {"OR", {0x06, 0x16}, Form1},
-                                {"NOT", {0x07, 0x17}, Form2},
-                                {"CMP", {0x0A, 0x1A}, Form2},
-                                {"MOV", {0x09, 0x19}, Form2},
-                                {"LDR", {0x0C, 0x0E, 0x1E}, Form3},
-                                {"STR", {0x1C, 0x0D, 0x1D}, Form3},
-                                {"LSR", {0x08}, Form4},
-                                {"LSL", {0x08}, Form4},
-                                {"ROR", {0x08}, Form4},
-                                {"ROL", {0x08}, Form4},
-                                {"LEA", {0x1B}, Form5},
-                                {"PUSH", {0x00}, FormStack},
-                                {"POP", {0x10}, FormStack},
+const operator_t OPERATORS[] = {{"ADD", {OP_ADD, OP_ADD_IMM}, Form1},
+                                {"SUB", {OP_SUB, OP_SUB_IMM}, Form1},
+                                {"MUL", {OP_MUL, OP_MUL_IMM}, Form1},
+                                {"DIV", {OP_DIV, OP_DIV_IMM}, Form1},
+                                {"AND", {OP_AND, OP_AND_IMM}, Form1},
+                                {"OR", {OP_OR, OP_OR_IMM}, Form1},
+                                {"NOT", {OP_NOT, OP_NOT_IMM}, Form2},
+                                {"CMP", {OP_CMP, OP_CMP_IMM}, Form2},
+                                {"MOV", {OP_MOV, OP_MOV_IMM}, Form2},
+                                {"LDR", {OP_LDR_PC, OP_LDR, OP_LDR_OFF}, Form3},
+                                {"STR", {OP_STR_PC, OP_STR, OP_STR_OFF}, Form3},
+                                {"LSR", {OP_SHIFT_IMM, OP_SHIFT}, Form4},
+                                {"LSL", {OP_SHIFT_IMM, OP_SHIFT}, Form4},
+                                {"ROR", {OP_SHIFT_IMM, OP_SHIFT}, Form4},
+                                {"ROL", {OP_SHIFT_IMM, OP_SHIFT}, Form4},
+                                {"LEA", {OP_LEA}, Form5},
+                                {"PUSH", {OP_PUSH}, FormStack},
+                                {"POP", {OP_POP}, FormStack},
                                 {"DCD", {0}, FormEquiv},
                                 {"EQU", {0}, FormEquiv}};
 const unsigned NUM_OPERATORS = sizeof(OPERATORS) / sizeof(operator_t);
@@ -31,77 +31,83 @@ const char *CONDITION_CODES[] = {
 const unsigned NUM_CONDITION_CODES = sizeof(CONDITION_CODES) / sizeof(char *);
 
 /* Tokens */
-Token *token_construct(char *literal, token_t type, unsigned long line, unsigned long col) {
+Token *token_construct(const char *literal, token_t type, unsigned long line, unsigned long col) {
     Token *token = malloc(sizeof(Token));
-    token->literal = literal;
+    token->constant = literal;
     token->type = type;
     token->line = line;
     token->col = col;
     return token;
 }
 
+/* Punctuation and EOF tokens point at string constants rather than owning their literal. */
 void token_destruct(Token *token) {
-    if (token->literal != NULL) {
+    switch (token->type) {
+    case TokenLBrack:
+    case TokenRBrack:
+    case TokenLCurl:
+    case TokenRCurl:
+    case TokenComma:
+    case TokenLParen:
+    case TokenRParen:
+    case TokenPlus:
+    case TokenMinus:
+    case TokenStar:
+    case TokenSlash:
+    case TokenShiftLeft:
+    case TokenShiftRight:
+    case TokenAmpersand:
+    case TokenPipe:
+    case TokenEquals:
+    case TokenStart:
+    case TokenEOF:
+        break;
+    default:
         free(token->literal);
     }
     free(token);
 }
 
-/* Token list */
-TokenList *token_list_construct(unsigned long length) {
-    TokenList *list = malloc(sizeof(TokenList));
-    list->length = 0;
-    list->__capacity = length;
-
-    if (length == 0) {
-        list->tokens = NULL;
-    } else {
-        list->tokens = malloc(sizeof(Token *) * list->__capacity);
-    }
-
-    return list;
+/* Token ring */
+TokenRing *token_ring_construct(void) {
+    TokenRing *ring = malloc(sizeof(TokenRing));
+    ring->head = 0;
+    ring->length = 0;
+    return ring;
 }
 
-void token_list_destruct(TokenList *list) {
-    for (unsigned int i = 0; i < list->length; i++) {
-        free(list->tokens[i]);
+void token_ring_destruct(TokenRing *ring) {
+    while (ring->length > 0) {
+        token_destruct(token_ring_pop(ring));
     }
-    free(list);
+    free(ring);
 }
 
-void token_list_append(TokenList *list, Token *token) {
-    if (list->length == list->__capacity) {
-        list->__capacity = 2 * list->__capacity;
-        Token **new_arr = malloc(sizeof(Token *) * list->__capacity);
-
-        // Copy over tokens
-        for (unsigned int i = 0; i < list->length; i++) {
-            new_arr[i] = list->tokens[i];
-        }
+bool token_ring_full(TokenRing *ring) { return ring->length == TOKEN_RING_CAPACITY; }
 
-        // Replace old list
-        free(list->tokens);
-        list->tokens = new_arr;
-    }
-
-    list->tokens[list->length] = token;
-    list->length++;
+/* The caller must check that the ring is not full before pushing. */
+void token_ring_push(TokenRing *ring, Token *token) {
+    ring->tokens[(ring->head + ring->length) % TOKEN_RING_CAPACITY] = token;
+    ring->length++;
 }
 
-/* This function supports negative numbers for the index parameter to support indexing from the rear (-1 is the last
- * element in the list).
- */
-Token *token_list_get(TokenList *list, int index) {
-
-    // Support for negative indexing
-    if (index < 0) {
-        index = list->length + index;
+/* Removes the oldest token from the ring and hands ownership of it to the caller. */
+Token *token_ring_pop(TokenRing *ring) {
+    if (ring->length == 0) {
+        return NULL;
     }
+    Token *token = ring->tokens[ring->head];
+    ring->head = (ring->head + 1) % TOKEN_RING_CAPACITY;
+    ring->length--;
+    return token;
+}
 
-    if (!((unsigned int)index < list->length) || index < 0) {
+/* Looks ahead without consuming: an offset of 0 is the next token to be popped. */
+Token *token_ring_peek(TokenRing *ring, unsigned offset) {
+    if (offset >= ring->length) {
         return NULL;
     }
-    return list->tokens[index];
+    return ring->tokens[(ring->head + offset) % TOKEN_RING_CAPACITY];
 }
 
 /* Utility functions */
@@ -1,12 +1,13 @@
 #ifndef _TOKENS_H_
 #define _TOKENS_H_
+#include "../../common/isa.h"
 #include <stdbool.h>
 
 typedef enum OperatorForm { Form1, Form2, Form3, Form4, Form5, FormStack, FormEquiv } form_t;
 
 typedef struct Operator {
     const char *name;
-    unsigned short int raw[3];
+    isa_opcode_t raw[3]; // Opcodes of the operator's forms, in the order its converter chooses between them
     form_t form;
 } operator_t;
 
@@ -27,39 +28,60 @@ typedef enum token_type {
     TokenDec,
     TokenChar,
     TokenStr,
+    TokenDirective,
     TokenLBrack,
     TokenRBrack,
     TokenLCurl,
     TokenRCurl,
     TokenComma,
+    TokenLParen,
+    TokenRParen,
+    TokenPlus,
+    TokenMinus,
+    TokenStar,
+    TokenSlash,
+    TokenShiftLeft,
+    TokenShiftRight,
+    TokenAmpersand,
+    TokenPipe,
+    TokenEquals,
     TokenStart,
     TokenEOF,
     TokenIllegal,
 } token_t;
 
-/* Token */
+/* Token. Punctuation, START and EOF tokens are given a string constant, which they read through literal but never
+ * free, so it is held as a constant.
+ */
 typedef struct Token {
-    char *literal;
+    union {
+        char *literal;
+        const char *constant;
+    };
     token_t type;
     unsigned long line;
     unsigned long col;
 } Token;
 
-Token *token_construct(char *literal, token_t type, unsigned long line, unsigned long col);
+Token *token_construct(const char *literal, token_t type, unsigned long line, unsigned long col);
 void token_destruct(Token *token);
 
-/* Token list */
-typedef struct TokenList {
-    Token **tokens;
-    unsigned long length;
-    unsigned long __capacity;
-} TokenList;
+/* Token ring (fixed-size lookahead between the lexer and the analyzer) */
+#define TOKEN_RING_CAPACITY 4
 
-TokenList *token_list_construct(unsigned long length);
-void token_list_destruct(TokenList *list);
+typedef struct TokenRing {
+    Token *tokens[TOKEN_RING_CAPACITY];
+    unsigned head;
+    unsigned length;
+} TokenRing;
 
-void token_list_append(TokenList *list, Token *token);
-Token *token_list_get(TokenList *list, int index);
+TokenRing *token_ring_construct(void);
+void token_ring_destruct(TokenRing *ring);
+
+bool token_ring_full(TokenRing *ring);
+void token_ring_push(TokenRing *ring, Token *token);
+Token *token_ring_pop(TokenRing *ring);
+Token *token_ring_peek(TokenRing *ring, unsigned offset);
 
 /* Utility functions */
 void string_to_uppercase(char *string);
@@ -1,4 +1,5 @@
-/* Define test cases for the gol-16 assembler */
+/* Define test cases for the gol-16 assembler. Each case is assembled in-process through libgasm. */
+#include "../src/gasm.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -16,9 +17,26 @@
 typedef struct TestCase {
     const char name[15];
     const bool expect_fail;
+    const gasm_options_t options; // Options given to the assembler
+    const bool profiled;          // Whether code is laid out by the profile in {name}.prof
 } testcase_t;
 
-const testcase_t TEST_CASES[] = {{"char", false}, {"string", false}, {"comment", false}, {"illegaltoken", true}};
+const testcase_t TEST_CASES[] = {{"char", false},
+                                 {"string", false},
+                                 {"comment", false},
+                                 {"sections", false},
+                                 {"reloc_main", false, {.relocatable = true}},
+                                 {"reloc_lib", false, {.relocatable = true}},
+                                 {"reloc_missing", true, {.relocatable = true}},
+                                 {"peephole", false, {.optimize = true}},
+                                 {"equ", false},
+                                 {"equ_range", true},
+                                 {"literal_range", true},
+                                 {"relax", false},
+                                 {"literal", false},
+                                 {"listing", false, {.listing = true}},
+                                 {"layout", false, {.optimize = true}, true},
+                                 {"illegaltoken", true}};
 #define array_len(a) sizeof(a) / sizeof(*a)
 
 /* Test execution results */
@@ -32,35 +50,30 @@ typedef struct TestResult {
 } testres_t;
 
 void test_result_display(testres_t res);
-testres_t run_test(const char *test_name, bool expect_fail, const char *test_dir, const char *exe_path);
+testres_t run_test(const testcase_t *test, const char *test_dir);
 
 /* Utilities */
 char *join_path(const char *fname, const char *dir);
 void full_path(char **path, const char *test_name, const char *dir, const char *suffix, unsigned len);
-void test_files(const char *test_name, const char *dir, char **src_path, char **asm_path, char **hnd_path);
-char *assemble_cmd(const char *src_path, char const *asm_path, char const *exe_path);
+void test_files(const char *test_name, const char *dir, char **src_path, char **hnd_path);
+char *read_file(const char *path, size_t *size);
+bool listing_matches(const gasm_result_t *result, const char *test_name, const char *dir);
 
 /* Main */
 int main(int argc, char *argv[]) {
 
-    // Takes two arguments
-    if (argc != 3) {
-        puts("USAGE: gasmt [TEST_CASE_DIR] [ASSEMBLER_PATH]");
+    // Takes one argument
+    if (argc != 2) {
+        puts("USAGE: gasmt [TEST_CASE_DIR]");
         return EXIT_FAILURE;
     }
 
     char *test_case_dir = argv[1];
-    char *assembler_path = argv[2];
-
-    if (access(assembler_path, X_OK | F_OK) != 0) {
-        printf("gol-16 assembler at %s does not exist or is not executable.", assembler_path);
-        return EXIT_FAILURE;
-    }
 
     unsigned pass_count = 0;
     for (unsigned i = 0; i < array_len(TEST_CASES); i++) {
         testcase_t test = TEST_CASES[i];
-        testres_t result = run_test(test.name, test.expect_fail, test_case_dir, assembler_path);
+        testres_t result = run_test(&test, test_case_dir);
         pass_count += result.success;
         test_result_display(result);
     }
@@ -116,70 +129,139 @@ void full_path(char **path, const char *test_name, const char *dir, const char *
     free(fname);
 }
 
-/* Stores the full path to the three required test case files in their respective pointers. All three paths must be
- * freed by the caller.
+/* Stores the full path to the two required test case files in their respective pointers. Both paths must be freed by
+ * the caller.
  * src_path: .gasm source file
- * asm_path: Assembler-assembled object file
  * hnd_path: Hand assembled file
  */
-void test_files(const char *test_name, const char *dir, char **src_path, char **asm_path, char **hnd_path) {
+void test_files(const char *test_name, const char *dir, char **src_path, char **hnd_path) {
     unsigned name_len = strlen(test_name);
     unsigned srclen = sizeof(char) * name_len + 6; // + .gasm \0
-    unsigned asmlen = sizeof(char) * name_len + 3; // + .o \0
     unsigned hndlen = sizeof(char) * name_len + 5; // + _h.o \0
 
     full_path(src_path, test_name, dir, ".gasm", srclen);
-    full_path(asm_path, test_name, dir, ".o", asmlen);
     full_path(hnd_path, test_name, dir, "_h.o", hndlen);
 }
 
-/* Returns the assembler command required to build the test object file from source. Returned command must be freed by
- * the caller.
+/* Reads a whole file into memory. Returns NULL if it cannot be read, otherwise the contents must be freed by the
+ * caller.
  */
-char *assemble_cmd(const char *src_path, char const *asm_path, char const *exe_path) {
-    // +3 for 2 spaces between arguments and a null terminator
-    unsigned long len = sizeof(char) * (strlen(exe_path) + strlen(asm_path) + strlen(src_path) + 3);
-    char *cmd = malloc(len);
-
-    strcpy(cmd, exe_path);
-    strcat(cmd, " ");
-    strcat(cmd, src_path);
-    strcat(cmd, " ");
-    strcat(cmd, asm_path);
-    return cmd;
+char *read_file(const char *path, size_t *size) {
+    FILE *fptr = fopen(path, "rb");
+    if (fptr == NULL) return NULL;
+
+    fseek(fptr, 0, SEEK_END);
+    long len = ftell(fptr);
+    rewind(fptr);
+    char *contents = malloc(len > 0 ? len : 1);
+    *size = fread(contents, 1, len, fptr);
+    fclose(fptr);
+    return contents;
 }
 
-/* Runs a test case (assembles source file and compares its contents with the hand assembled copy) and returns the
- * results. Handles failures where required TC files DNE or system/assembler return failure.
- * exe_path: The path to the assembler executable
+/* Compares the listing of a test case with the hand written listing in {dir}/{test_name}_h.lst. */
+bool listing_matches(const gasm_result_t *result, const char *test_name, const char *dir) {
+    char *lst_path;
+    full_path(&lst_path, test_name, dir, "_h.lst", strlen(test_name) + 7); // + _h.lst \0
+    size_t expected_size;
+    char *expected = read_file(lst_path, &expected_size);
+    free(lst_path);
+    if (expected == NULL) return false;
+
+    char *actual;
+    size_t actual_size;
+    FILE *stream = open_memstream(&actual, &actual_size);
+    listing_write(result->listing, stream);
+    fclose(stream);
+
+    bool same = actual_size == expected_size && !memcmp(actual, expected, actual_size);
+    free(actual);
+    free(expected);
+    return same;
+}
+
+/* Runs a test case (assembles source file and compares its output with the hand assembled copy) and returns the
+ * results. Handles failures where required TC files DNE or the assembler reports errors, which are printed.
  */
-testres_t run_test(const char *test_name, bool expect_fail, const char *test_dir, const char *exe_path) {
+testres_t run_test(const testcase_t *test, const char *test_dir) {
+    const char *test_name = test->name;
+    bool expect_fail = test->expect_fail;
 
     char *hnd_path;
     char *src_path;
-    char *asm_path;
-    test_files(test_name, test_dir, &src_path, &asm_path, &hnd_path);
+    test_files(test_name, test_dir, &src_path, &hnd_path);
 
     // Check that necessary source file exists with read permission
-    if (access(src_path, F_OK | R_OK) != 0) return test_result_construct_cf("Source file DNE.", test_name);
+    size_t src_size;
+    char *src = read_file(src_path, &src_size);
+    if (src == NULL) {
+        free(src_path);
+        free(hnd_path);
+        return test_result_construct_cf("Source file DNE.", test_name);
+    }
 
-    // Check that assembler/system did not return failure
-    if (system(assemble_cmd(src_path, asm_path, exe_path)) != 0)
-        return test_result_construct(expect_fail, 0, 0, 0, "Assembler execution failed.", test_name);
+    // Check that the assembler did not report failure. A failure must come with a reason. The source is named without
+    // its directory, so that listings do not depend on where the tests are run from.
+    const char *src_name = strrchr(src_path, '/') != NULL ? strrchr(src_path, '/') + 1 : src_path;
+    gasm_options_t options = test->options;
+    profile_t *profile = NULL;
+    if (test->profiled) {
+        char *prof_path;
+        full_path(&prof_path, test_name, test_dir, ".prof", strlen(test_name) + 6); // + .prof \0
+        profile = profile_read(prof_path);
+        free(prof_path);
+        if (profile == NULL) {
+            free(src);
+            free(src_path);
+            free(hnd_path);
+            return test_result_construct_cf("Profile DNE.", test_name);
+        }
+        options.profile = profile;
+    }
+    gasm_result_t *result = gasm_assemble(src, src_size, src_name, options);
+    free(src);
+    if (profile != NULL) profile_destruct(profile);
+    if (!result->success) {
+        if (!expect_fail) diagnostics_print(result->diagnostics, stdout);
+        bool explained = result->diagnostics->count > 0;
+        gasm_result_destruct(result);
+        free(src_path);
+        free(hnd_path);
+        return test_result_construct(expect_fail && explained, 0, 0, 0, "Assembler execution failed.", test_name);
+    }
 
     // For byte comparison, the hand assembled file must work.
-    if (access(hnd_path, F_OK | R_OK) != 0) return test_result_construct_cf("Hand assembled file DNE.", test_name);
+    size_t hnd_size;
+    uint8_t *hnd = (uint8_t *)read_file(hnd_path, &hnd_size);
+    if (hnd == NULL) {
+        gasm_result_destruct(result);
+        free(src_path);
+        free(hnd_path);
+        return test_result_construct_cf("Hand assembled file DNE.", test_name);
+    }
 
-    FILE *hptr = fopen(hnd_path, "rb");
-    FILE *aptr = fopen(asm_path, "rb");
+    // Find the first byte which differs, or where one output ends before the other
+    size_t pos = 0;
+    while (pos < hnd_size && pos < result->output_size && result->output[pos] == hnd[pos])
+        pos++;
+    bool same = pos == hnd_size && pos == result->output_size;
+    bool in_both = pos < hnd_size && pos < result->output_size;
+    uint8_t a = pos < result->output_size ? result->output[pos] : 0;
+    uint8_t h = pos < hnd_size ? hnd[pos] : 0;
+    const char *err_msg = same ? (expect_fail ? "Assembler did not fail." : "Success!")
+                          : in_both ? "Byte mismatch."
+                                    : "Length mismatch.";
 
-    uint8_t a, h;
-    while (!feof(hptr) && !feof(aptr)) {
-        fread(&h, 1, 1, hptr);
-        fread(&a, 1, 1, aptr);
-        if (a != h) return test_result_construct(expect_fail, ftell(hptr), a, h, "Byte mismatch.", test_name);
+    // A listing is compared with its own hand written copy
+    if (same && test->options.listing && !listing_matches(result, test_name, test_dir)) {
+        same = false;
+        err_msg = "Listing mismatch.";
     }
-    fclose(hptr);
-    fclose(aptr);
-    return test_result_construct(true, 0, 0, 0, "Success!", test_name);
+    testres_t res = test_result_construct(same && !expect_fail, pos, a, h, err_msg, test_name);
+
+    free(hnd);
+    free(src_path);
+    free(hnd_path);
+    gasm_result_destruct(result);
+    return res;
 }
@@ -0,0 +1,159 @@
+/* Implements reading and writing of the gol-16 address map format. */
+#include "addrmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+addrmap_t *addrmap_construct(void) { return calloc(1, sizeof(addrmap_t)); }
+
+void addrmap_destruct(addrmap_t *map) {
+    for (unsigned i = 0; i < map->file_count; i++)
+        free(map->files[i]);
+    free(map->files);
+    free(map->entries);
+    free(map);
+}
+
+/* Adds a source file and returns its index. */
+unsigned addrmap_add_file(addrmap_t *map, const char *name) {
+    map->files = realloc(map->files, sizeof(char *) * (map->file_count + 1));
+    map->files[map->file_count] = malloc(strlen(name) + 1);
+    strcpy(map->files[map->file_count], name);
+    return map->file_count++;
+}
+
+/* Records the source of the word at address. Addresses must be added in increasing order. A word from the same place as
+ * the word before it extends that entry instead of adding one.
+ */
+void addrmap_add(addrmap_t *map, uint16_t address, uint16_t file, uint32_t line, uint16_t col) {
+    if (map->count > 0) {
+        const addrmap_entry_t *last = &map->entries[map->count - 1];
+        if (last->file == file && last->line == line && last->col == col) return;
+    }
+    if (map->count == map->__capacity) {
+        map->__capacity = map->__capacity == 0 ? 64 : map->__capacity * 2;
+        map->entries = realloc(map->entries, sizeof(addrmap_entry_t) * map->__capacity);
+    }
+    map->entries[map->count++] = (addrmap_entry_t){address, file, line, col};
+}
+
+/* Returns the entry which covers address, or NULL if it comes before the first entry. */
+const addrmap_entry_t *addrmap_lookup(const addrmap_t *map, uint16_t address) {
+    unsigned long low = 0, high = map->count;
+    while (low < high) {
+        unsigned long mid = low + (high - low) / 2;
+        if (map->entries[mid].address <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low == 0 ? NULL : &map->entries[low - 1];
+}
+
+/* Writing */
+static void _put(FILE *stream, uint32_t value, unsigned bytes) {
+    uint8_t buf[4];
+    for (unsigned i = 0; i < bytes; i++)
+        buf[i] = value >> (8 * (bytes - i - 1));
+    fwrite(buf, 1, bytes, stream);
+}
+
+/* Writes the map to a file. Returns false if it could not be written. */
+bool addrmap_write(const addrmap_t *map, const char *file_path) {
+    FILE *fptr = fopen(file_path, "wb");
+    if (fptr == NULL) return false;
+
+    uint32_t strings_len = 0;
+    for (unsigned i = 0; i < map->file_count; i++)
+        strings_len += strlen(map->files[i]) + 1;
+
+    fwrite(ADDRMAP_MAGIC, 1, 4, fptr);
+    _put(fptr, ADDRMAP_VERSION, 2);
+    _put(fptr, map->file_count, 2);
+    _put(fptr, map->count, 4);
+    _put(fptr, strings_len, 4);
+
+    uint32_t offset = 0;
+    for (unsigned i = 0; i < map->file_count; i++) {
+        _put(fptr, offset, 4);
+        offset += strlen(map->files[i]) + 1;
+    }
+    for (unsigned long i = 0; i < map->count; i++) {
+        const addrmap_entry_t *entry = &map->entries[i];
+        _put(fptr, entry->address, 2);
+        _put(fptr, entry->file, 2);
+        _put(fptr, entry->line, 4);
+        _put(fptr, entry->col, 2);
+    }
+    for (unsigned i = 0; i < map->file_count; i++)
+        fwrite(map->files[i], 1, strlen(map->files[i]) + 1, fptr);
+
+    bool success = !ferror(fptr);
+    success &= fclose(fptr) == 0;
+    return success;
+}
+
+/* Reading */
+static uint32_t _get(const uint8_t *data, unsigned long *pos, unsigned bytes) {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bytes; i++)
+        value = (value << 8) | data[(*pos)++];
+    return value;
+}
+
+/* Reads an address map into memory. Returns NULL if the file could not be read or is not a valid map. */
+addrmap_t *addrmap_read(const char *file_path) {
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return NULL;
+
+    fseek(fptr, 0, SEEK_END);
+    long length = ftell(fptr);
+    rewind(fptr);
+    uint8_t *data = malloc(length > 0 ? length : 1);
+    bool valid = length >= ADDRMAP_HEADER_SIZE && fread(data, 1, length, fptr) == (size_t)length;
+    fclose(fptr);
+    valid = valid && !memcmp(data, ADDRMAP_MAGIC, 4);
+    if (!valid) {
+        free(data);
+        return NULL;
+    }
+
+    unsigned long pos = 4;
+    uint16_t version = _get(data, &pos, 2);
+    unsigned file_count = _get(data, &pos, 2);
+    unsigned long count = _get(data, &pos, 4);
+    unsigned long strings_len = _get(data, &pos, 4);
+    unsigned long tables = 4UL * file_count + ADDRMAP_ENTRY_SIZE * count;
+    if (version != ADDRMAP_VERSION || ADDRMAP_HEADER_SIZE + tables + strings_len != (unsigned long)length ||
+        (strings_len > 0 && data[length - 1] != '\0')) {
+        free(data);
+        return NULL;
+    }
+
+    addrmap_t *map = addrmap_construct();
+    const char *strings = (const char *)data + length - strings_len;
+    for (unsigned i = 0; i < file_count && valid; i++) {
+        uint32_t offset = _get(data, &pos, 4);
+        valid = offset < strings_len;
+        if (valid) addrmap_add_file(map, strings + offset);
+    }
+
+    map->entries = malloc(sizeof(addrmap_entry_t) * (count > 0 ? count : 1));
+    map->__capacity = count;
+    for (unsigned long i = 0; i < count && valid; i++) {
+        addrmap_entry_t *entry = &map->entries[map->count++];
+        entry->address = _get(data, &pos, 2);
+        entry->file = _get(data, &pos, 2);
+        entry->line = _get(data, &pos, 4);
+        entry->col = _get(data, &pos, 2);
+        valid = entry->file < file_count && (i == 0 || entry->address > map->entries[i - 1].address);
+    }
+    free(data);
+
+    if (!valid) {
+        addrmap_destruct(map);
+        return NULL;
+    }
+    return map;
+}
@@ -0,0 +1,47 @@
+/* Defines the gol-16 address map format, written by the assembler (gassemble --listing) and read by the emulator to
+ * tie addresses in a flat image back to the source which assembled them.
+ *
+ * All fields are big-endian. Consecutive words assembled from the same statement share one entry, so an address belongs
+ * to the last entry at or before it. The file is laid out as:
+ *
+ *   header  magic "G16M", u16 version, u16 file count, u32 entry count, u32 string table size
+ *   files   u32 name (string table offset)
+ *   entries u16 address, u16 file, u32 line, u16 column, in increasing address order
+ *   strings null terminated names
+ */
+#ifndef _ADDRMAP_H_
+#define _ADDRMAP_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ADDRMAP_MAGIC "G16M"
+#define ADDRMAP_VERSION 1
+#define ADDRMAP_HEADER_SIZE 16
+#define ADDRMAP_ENTRY_SIZE 10
+
+typedef struct AddrMapEntry {
+    uint16_t address; // First address of the run
+    uint16_t file;    // Index into the map's files
+    uint32_t line;
+    uint16_t col;
+} addrmap_entry_t;
+
+typedef struct AddrMap {
+    char **files;
+    unsigned file_count;
+    addrmap_entry_t *entries;
+    unsigned long count;
+    unsigned long __capacity;
+} addrmap_t;
+
+addrmap_t *addrmap_construct(void);
+void addrmap_destruct(addrmap_t *map);
+
+unsigned addrmap_add_file(addrmap_t *map, const char *name);
+void addrmap_add(addrmap_t *map, uint16_t address, uint16_t file, uint32_t line, uint16_t col);
+const addrmap_entry_t *addrmap_lookup(const addrmap_t *map, uint16_t address);
+
+bool addrmap_write(const addrmap_t *map, const char *file_path);
+addrmap_t *addrmap_read(const char *file_path);
+
+#endif // _ADDRMAP_H_
@@ -0,0 +1,42 @@
+/* Cycles of each opcode, generated by mcasm --timing from microcode.gmc. Do not edit; generate them again with
+ * make cycles in schematic once the microcode changes.
+ */
+#ifndef _CYCLES_H_
+#define _CYCLES_H_
+
+/* X(opcode, cycles taken, cycles not taken) */
+#define ISA_CYCLES(X) \
+    X(0x00, 0, 0) \
+    X(0x01, 7, 7) \
+    X(0x02, 7, 7) \
+    X(0x03, 7, 7) \
+    X(0x04, 7, 7) \
+    X(0x05, 7, 7) \
+    X(0x06, 7, 7) \
+    X(0x07, 6, 6) \
+    X(0x08, 7, 7) \
+    X(0x09, 6, 6) \
+    X(0x0A, 6, 6) \
+    X(0x0B, 0, 0) \
+    X(0x0C, 8, 8) \
+    X(0x0D, 9, 9) \
+    X(0x0E, 9, 9) \
+    X(0x0F, 7, 5) \
+    X(0x10, 0, 0) \
+    X(0x11, 7, 7) \
+    X(0x12, 7, 7) \
+    X(0x13, 7, 7) \
+    X(0x14, 7, 7) \
+    X(0x15, 7, 7) \
+    X(0x16, 7, 7) \
+    X(0x17, 6, 6) \
+    X(0x18, 7, 7) \
+    X(0x19, 5, 5) \
+    X(0x1A, 6, 6) \
+    X(0x1B, 6, 6) \
+    X(0x1C, 8, 8) \
+    X(0x1D, 9, 9) \
+    X(0x1E, 9, 9) \
+    X(0x1F, 8, 5)
+
+#endif // _CYCLES_H_
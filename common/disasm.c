@@ -0,0 +1,197 @@
+/* Implements the disassembler. */
+#include "disasm.h"
+#include <stdlib.h>
+#include <string.h>
+
+static disasm_word_t DECODE[0x10000];
+static bool decode_built = false;
+
+static disasm_word_t _classify(uint16_t word) {
+    disasm_word_t entry = {0, 0};
+    isa_insn_t insn = isa_decode(word);
+    const isa_opcode_info_t *info = &ISA[insn.opcode];
+
+    // Words with bits outside their fields, or fields with no meaning, were not assembled
+    if (info->mnemonic == NULL || isa_encode(&insn) != word) return entry;
+    if (info->layout == LayoutStack && insn.fields[FieldImm] == 0) return entry;
+    if (info->layout == LayoutBranch && ISA_CONDITIONS[insn.fields[FieldCond]] == NULL) return entry;
+
+    entry.flags = DISASM_VALID | DISASM_CONTINUES;
+    if (info->layout == LayoutBranch) {
+        entry.flags |= DISASM_BRANCH;
+        entry.offset = isa_immediate(&insn);
+        if (insn.opcode == OP_Bcc && insn.fields[FieldCond] == ISA_CONDITION_ALWAYS) entry.flags &= ~DISASM_CONTINUES;
+    } else if (insn.opcode == OP_LDR_PC || insn.opcode == OP_STR_PC || insn.opcode == OP_LEA) {
+        entry.flags |= DISASM_REFERENCE;
+        entry.offset = isa_immediate(&insn);
+    } else if (insn.opcode == OP_POP && (insn.fields[FieldImm] & ISA_STACK_PC)) {
+        entry.flags &= ~DISASM_CONTINUES;
+    }
+    return entry;
+}
+
+/* Returns the decode table, indexed by word. It is built on first use, which is not thread safe. */
+const disasm_word_t *disasm_table(void) {
+    if (!decode_built) {
+        for (uint32_t word = 0; word <= 0xFFFF; word++)
+            DECODE[word] = _classify(word);
+        decode_built = true;
+    }
+    return DECODE;
+}
+
+disasm_t *disasm_construct(const uint16_t *words, unsigned long length) {
+    disasm_t *disasm = calloc(1, sizeof(disasm_t));
+    disasm->words = words;
+    disasm->length = length;
+    disasm->kinds = calloc(length + 1, sizeof(disasm_kind_t));
+    disasm->labels = calloc(length + 1, sizeof(char *));
+    disasm->operands = calloc(length + 1, sizeof(char *));
+    disasm->__targets = calloc(length + 1, sizeof(bool));
+    return disasm;
+}
+
+void disasm_destruct(disasm_t *disasm) {
+    for (unsigned long i = 0; i < disasm->length; i++) {
+        free(disasm->labels[i]);
+        free(disasm->operands[i]);
+    }
+    free(disasm->kinds);
+    free(disasm->labels);
+    free(disasm->operands);
+    free(disasm->__work);
+    free(disasm->__targets);
+    free(disasm);
+}
+
+static char *_copy(const char *name) {
+    char *copy = malloc(strlen(name) + 1);
+    strcpy(copy, name);
+    return copy;
+}
+
+/* Names an address. An address keeps the first name it is given. */
+void disasm_label(disasm_t *disasm, unsigned long address, const char *name) {
+    if (address >= disasm->length || disasm->labels[address] != NULL) return;
+    disasm->labels[address] = _copy(name);
+}
+
+/* Names the symbol which fills in the field of the word at address, from a relocation. Its field holds nothing. */
+void disasm_operand(disasm_t *disasm, unsigned long address, const char *name) {
+    if (address >= disasm->length) return;
+    free(disasm->operands[address]);
+    disasm->operands[address] = _copy(name);
+}
+
+static void _push(disasm_t *disasm, unsigned long address) {
+    if (disasm->__work_length == disasm->__work_capacity) {
+        disasm->__work_capacity = disasm->__work_capacity == 0 ? 64 : disasm->__work_capacity * 2;
+        disasm->__work = realloc(disasm->__work, sizeof(unsigned long) * disasm->__work_capacity);
+    }
+    disasm->__work[disasm->__work_length++] = address;
+}
+
+/* Adds an address where execution may begin, with an optional name. */
+void disasm_entry(disasm_t *disasm, unsigned long address, const char *name) {
+    if (address >= disasm->length) return;
+    if (name != NULL) disasm_label(disasm, address, name);
+    _push(disasm, address);
+}
+
+/* Marks a target of a word, if it is inside the image. */
+static bool _target(disasm_t *disasm, unsigned long address, int16_t offset) {
+    long target = (long)address + offset;
+    if (target < 0 || (unsigned long)target >= disasm->length) return false;
+    disasm->__targets[target] = true;
+    return true;
+}
+
+/* Follows control flow from every entry point. Every word reached is code, and the words it branches to or refers to are
+ * labelled, L_ for code and D_ for data. Flow stops at a word which is not an instruction, an unconditional branch, or a
+ * POP into PC.
+ */
+void disasm_analyze(disasm_t *disasm) {
+    const disasm_word_t *table = disasm_table();
+
+    while (disasm->__work_length > 0) {
+        unsigned long address = disasm->__work[--disasm->__work_length];
+
+        for (; address < disasm->length && disasm->kinds[address] != DisasmCode; address++) {
+            disasm_word_t entry = table[disasm->words[address]];
+            if (!(entry.flags & DISASM_VALID)) break;
+            disasm->kinds[address] = DisasmCode;
+
+            // A field filled in by the linker holds no offset yet
+            if (disasm->operands[address] == NULL) {
+                if ((entry.flags & DISASM_BRANCH) && _target(disasm, address, entry.offset)) {
+                    _push(disasm, address + entry.offset);
+                }
+                if (entry.flags & DISASM_REFERENCE) _target(disasm, address, entry.offset);
+            }
+            if (!(entry.flags & DISASM_CONTINUES)) break;
+        }
+    }
+
+    // Targets without a name are named after what they turned out to hold
+    for (unsigned long address = 0; address < disasm->length; address++) {
+        if (!disasm->__targets[address] || disasm->labels[address] != NULL) continue;
+        char name[24];
+        snprintf(name, sizeof(name), "%s_%04lx", disasm->kinds[address] == DisasmCode ? "L" : "D", address);
+        disasm->labels[address] = _copy(name);
+    }
+}
+
+/* Returns the label of an address, or NULL. */
+const char *disasm_label_at(const disasm_t *disasm, unsigned long address) {
+    return address < disasm->length ? disasm->labels[address] : NULL;
+}
+
+/* Writes the word at address as a G-ASM statement, like snprintf. Targets inside the image are written as labels. */
+size_t disasm_format(const disasm_t *disasm, unsigned long address, char *buf, size_t size) {
+    uint16_t word = disasm->words[address];
+    const char *operand = disasm->operands[address];
+
+    if (disasm->kinds[address] != DisasmCode) {
+        if (operand != NULL) return snprintf(buf, size, "DCD %s", operand);
+        return snprintf(buf, size, "DCD 0x%04x", word);
+    }
+
+    disasm_word_t entry = disasm_table()[word];
+    isa_insn_t insn = isa_decode(word);
+    const isa_opcode_info_t *info = &ISA[insn.opcode];
+    if (operand == NULL && (entry.flags & (DISASM_BRANCH | DISASM_REFERENCE))) {
+        long target = (long)address + entry.offset;
+        if (target >= 0) operand = disasm_label_at(disasm, target);
+    }
+    if (operand == NULL) return isa_format(word, buf, size);
+
+    switch (insn.opcode) {
+    case OP_Bcc:
+    case OP_BLcc:
+        return snprintf(buf, size, "%s%s %s", info->mnemonic, ISA_CONDITIONS[insn.fields[FieldCond]], operand);
+    case OP_LDR_PC:
+    case OP_STR_PC:
+        return snprintf(buf, size, "%s R%u, [%s]", info->mnemonic, insn.fields[FieldRd], operand);
+    case OP_LDR_OFF:
+    case OP_STR_OFF:
+        return snprintf(buf, size, "%s R%u, [R%u, %s]", info->mnemonic, insn.fields[FieldRd], insn.fields[FieldRx],
+                        operand);
+    case OP_LEA:
+        return snprintf(buf, size, "LEA R%u, %s", insn.fields[FieldRd], operand);
+    default:
+        return isa_format(word, buf, size);
+    }
+}
+
+/* Writes the whole image as G-ASM which assembles back into it: each label on a line of its own, then the statement,
+ * with its address and word in a comment.
+ */
+bool disasm_write(const disasm_t *disasm, FILE *stream) {
+    char text[64];
+    for (unsigned long address = 0; address < disasm->length; address++) {
+        if (disasm->labels[address] != NULL) fprintf(stream, "%s\n", disasm->labels[address]);
+        disasm_format(disasm, address, text, sizeof(text));
+        fprintf(stream, "    %-28s ; %04lx  %04x\n", text, address, disasm->words[address]);
+    }
+    return !ferror(stream);
+}
@@ -0,0 +1,57 @@
+/* Disassembles gol-16 images, for the disassembler (gdis) and the emulator (gemu).
+ *
+ * Every 16 bit word is decoded once, into a table of 64K entries, so classifying a word is a single lookup. Code is
+ * found by following control flow from the entry points; a word which is never reached is data and is written as DCD.
+ * Branch targets and words loaded PC-relative are given labels, so that the output can be assembled again.
+ */
+#ifndef _DISASM_H_
+#define _DISASM_H_
+#include "isa.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Decode table flags */
+#define DISASM_VALID 0x01     // An instruction which assembles back into the same word
+#define DISASM_CONTINUES 0x02 // Execution may go on to the next word
+#define DISASM_BRANCH 0x04    // May branch to the word at the offset
+#define DISASM_REFERENCE 0x08 // Refers to the word at the offset (LDR/STR [imm9] and LEA)
+
+typedef struct DisasmWord {
+    uint8_t flags;
+    int16_t offset; // From the word itself, for a branch or reference
+} disasm_word_t;
+
+const disasm_word_t *disasm_table(void);
+
+/* What each address turned out to hold */
+typedef enum DisasmKind {
+    DisasmUnknown, // Not reached, so data
+    DisasmCode,
+} disasm_kind_t;
+
+typedef struct Disasm {
+    const uint16_t *words;
+    unsigned long length;
+    disasm_kind_t *kinds;  // Indexed by word
+    char **labels;         // Indexed by word, NULL if the word has no label
+    char **operands;       // Indexed by word, symbol which fills the word's field in a relocatable object, or NULL
+    unsigned long *__work; // Entry points waiting to be followed
+    unsigned long __work_length;
+    unsigned long __work_capacity;
+    bool *__targets; // Indexed by word, whether anything branches to or refers to it
+} disasm_t;
+
+disasm_t *disasm_construct(const uint16_t *words, unsigned long length);
+void disasm_destruct(disasm_t *disasm);
+
+void disasm_entry(disasm_t *disasm, unsigned long address, const char *name);
+void disasm_label(disasm_t *disasm, unsigned long address, const char *name);
+void disasm_operand(disasm_t *disasm, unsigned long address, const char *name);
+void disasm_analyze(disasm_t *disasm);
+
+const char *disasm_label_at(const disasm_t *disasm, unsigned long address);
+size_t disasm_format(const disasm_t *disasm, unsigned long address, char *buf, size_t size);
+bool disasm_write(const disasm_t *disasm, FILE *stream);
+
+#endif // _DISASM_H_
@@ -0,0 +1,133 @@
+/* Implements the gol-16 instruction set tables, encoding and decoding. */
+#include "isa.h"
+#include "cycles.h"
+#include <stdio.h>
+
+const isa_opcode_info_t ISA[ISA_OPCODE_COUNT] = {
+#define ISA_INFO(code, name, mnemonic, layout, sign) [code] = {mnemonic, layout, sign},
+    ISA_OPCODES(ISA_INFO)
+#undef ISA_INFO
+};
+
+/* Generated by mcasm from the microcode, so that every tool counts the cycles the control unit takes */
+const isa_cycles_t ISA_TIMING[ISA_OPCODE_COUNT] = {
+#define ISA_CYCLE(code, taken, not_taken) [code] = {taken, not_taken},
+    ISA_CYCLES(ISA_CYCLE)
+#undef ISA_CYCLE
+};
+
+/* Indexed by layout, then field: {shift, width} */
+const isa_field_pos_t ISA_LAYOUTS[ISA_LAYOUT_COUNT][ISA_FIELD_COUNT] = {
+    [LayoutStack] = {[FieldImm] = {0, 8}},
+    [LayoutRRR] = {[FieldRd] = {9, 2}, [FieldRx] = {7, 2}, [FieldRy] = {5, 2}},
+    [LayoutRRI7] = {[FieldRd] = {9, 2}, [FieldRx] = {7, 2}, [FieldImm] = {0, 7}},
+    [LayoutRR] = {[FieldRd] = {9, 2}, [FieldRx] = {7, 2}},
+    [LayoutRI9] = {[FieldRd] = {9, 2}, [FieldImm] = {0, 9}},
+    [LayoutShiftImm] = {[FieldMode] = {9, 2}, [FieldRd] = {7, 2}, [FieldRx] = {5, 2}, [FieldImm] = {0, 4}},
+    [LayoutShiftReg] = {[FieldMode] = {9, 2}, [FieldRd] = {7, 2}, [FieldRx] = {5, 2}, [FieldRy] = {3, 2}},
+    [LayoutBranch] = {[FieldCond] = {7, 4}, [FieldImm] = {0, 7}},
+};
+
+const char *const ISA_CONDITIONS[16] = {"EQ", "NE", "HS", "HI", "LO", "LS", "MI", "PL",
+                                        "VS", "VC", "GE", "LT", "GT", "LE", "",   NULL};
+
+/* Indexed by the mode field of a shift */
+const char *const ISA_SHIFTS[4] = {"LSL", "ROL", "LSR", "ROR"};
+
+/* Indexed by bit, from the highest */
+const char *const ISA_STACK_REGISTERS[8] = {"R0", "R1", "R2", "R3", "PC", "SP", "LR", "FR"};
+
+/* Returns the mask of a field of an opcode, in place in the word. */
+uint16_t isa_field_mask(isa_opcode_t opcode, isa_field_t field) {
+    isa_field_pos_t pos = ISA_LAYOUTS[ISA[opcode].layout][field];
+    return ((1u << pos.width) - 1) << pos.shift;
+}
+
+/* Encodes an instruction. Each field is cut down to its width. */
+uint16_t isa_encode(const isa_insn_t *insn) {
+    const isa_field_pos_t *layout = ISA_LAYOUTS[ISA[insn->opcode].layout];
+    uint16_t word = insn->opcode << ISA_OPCODE_SHIFT;
+    for (unsigned field = 0; field < ISA_FIELD_COUNT; field++) {
+        word |= (insn->fields[field] & ((1u << layout[field].width) - 1)) << layout[field].shift;
+    }
+    return word;
+}
+
+/* Decodes a word into its opcode and fields. Fields the opcode does not have are zero. */
+isa_insn_t isa_decode(uint16_t word) {
+    isa_insn_t insn = {isa_opcode(word), {0}};
+    const isa_field_pos_t *layout = ISA_LAYOUTS[ISA[insn.opcode].layout];
+    for (unsigned field = 0; field < ISA_FIELD_COUNT; field++) {
+        insn.fields[field] = (word >> layout[field].shift) & ((1u << layout[field].width) - 1);
+    }
+    return insn;
+}
+
+/* Returns the immediate of a decoded instruction, sign extended if the opcode takes a signed offset. */
+int16_t isa_immediate(const isa_insn_t *insn) {
+    unsigned width = ISA_LAYOUTS[ISA[insn->opcode].layout][FieldImm].width;
+    uint16_t imm = insn->fields[FieldImm];
+    if (ISA[insn->opcode].signed_imm && width > 0 && (imm >> (width - 1)) & 1) return (int16_t)(imm - (1u << width));
+    return (int16_t)imm;
+}
+
+/* Returns the cycles an instruction takes, from its fetch to the next fetch. A branch on AL is always taken. */
+unsigned isa_cycles(uint16_t word, bool taken) {
+    isa_opcode_t opcode = isa_opcode(word);
+    if (taken || ISA[opcode].layout != LayoutBranch) return ISA_TIMING[opcode].taken;
+    if (((word >> ISA_LAYOUTS[LayoutBranch][FieldCond].shift) & 0xF) == ISA_CONDITION_ALWAYS)
+        return ISA_TIMING[opcode].taken;
+    return ISA_TIMING[opcode].not_taken;
+}
+
+static size_t _format_stack(const char *mnemonic, uint16_t list, char *buf, size_t size) {
+    size_t n = snprintf(buf, size, "%s {", mnemonic);
+    const char *separator = "";
+    for (unsigned bit = 0; bit < 8; bit++) {
+        if (!(list & (0x80 >> bit))) continue;
+        n += snprintf(buf + (n < size ? n : size), n < size ? size - n : 0, "%s%s", separator,
+                      ISA_STACK_REGISTERS[bit]);
+        separator = ", ";
+    }
+    return n + snprintf(buf + (n < size ? n : size), n < size ? size - n : 0, "}");
+}
+
+/* Writes an instruction as G-ASM, like snprintf. Offsets are written as numbers, since labels are not known here. A word
+ * which is not an instruction is written as DCD.
+ */
+size_t isa_format(uint16_t word, char *buf, size_t size) {
+    isa_insn_t insn = isa_decode(word);
+    const isa_opcode_info_t *info = &ISA[insn.opcode];
+    const uint16_t *f = insn.fields;
+    int imm = isa_immediate(&insn);
+    bool memory = insn.opcode == OP_LDR || insn.opcode == OP_STR || insn.opcode == OP_LDR_OFF ||
+                  insn.opcode == OP_STR_OFF || insn.opcode == OP_LDR_PC || insn.opcode == OP_STR_PC;
+
+    switch (info->layout) {
+    case LayoutStack:
+        return _format_stack(info->mnemonic, f[FieldImm], buf, size);
+    case LayoutRRR:
+        if (memory) {
+            return snprintf(buf, size, "%s R%u, [R%u, R%u]", info->mnemonic, f[FieldRd], f[FieldRx], f[FieldRy]);
+        }
+        return snprintf(buf, size, "%s R%u, R%u, R%u", info->mnemonic, f[FieldRd], f[FieldRx], f[FieldRy]);
+    case LayoutRRI7:
+        if (memory) return snprintf(buf, size, "%s R%u, [R%u, #%d]", info->mnemonic, f[FieldRd], f[FieldRx], imm);
+        return snprintf(buf, size, "%s R%u, R%u, #%d", info->mnemonic, f[FieldRd], f[FieldRx], imm);
+    case LayoutRR:
+        return snprintf(buf, size, "%s R%u, R%u", info->mnemonic, f[FieldRd], f[FieldRx]);
+    case LayoutRI9:
+        if (memory) return snprintf(buf, size, "%s R%u, [#%d]", info->mnemonic, f[FieldRd], imm);
+        return snprintf(buf, size, "%s R%u, #%d", info->mnemonic, f[FieldRd], imm);
+    case LayoutShiftImm:
+        return snprintf(buf, size, "%s R%u, R%u, #%d", ISA_SHIFTS[f[FieldMode]], f[FieldRd], f[FieldRx], imm);
+    case LayoutShiftReg:
+        return snprintf(buf, size, "%s R%u, R%u, R%u", ISA_SHIFTS[f[FieldMode]], f[FieldRd], f[FieldRx], f[FieldRy]);
+    case LayoutBranch:
+        if (ISA_CONDITIONS[f[FieldCond]] == NULL) break;
+        return snprintf(buf, size, "%s%s #%d", info->mnemonic, ISA_CONDITIONS[f[FieldCond]], imm);
+    default:
+        break;
+    }
+    return snprintf(buf, size, "DCD 0x%04x", word);
+}
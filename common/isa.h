@@ -0,0 +1,149 @@
+/* Describes the gol-16 instruction set, shared by the assembler (gassemble), the emulator (gemu) and the disassembler.
+ *
+ * Every instruction is a 5 bit opcode in the top bits of the word, followed by fields laid out by its layout. Each
+ * opcode is listed once, in ISA_OPCODES, and everything else is generated from that list: the opcode names, the layout
+ * table, encoding and decoding. A field missing from a layout is zero.
+ *
+ *   LayoutStack     ooooo 000 llllllll      register list, one bit for each of R0-R3, PC, SP, LR and FR
+ *   LayoutRRR       ooooo dd xx yy 00000
+ *   LayoutRRI7      ooooo dd xx iiiiiii
+ *   LayoutRR        ooooo dd xx 0000000
+ *   LayoutRI9       ooooo dd iiiiiiiii
+ *   LayoutShiftImm  ooooo mm dd xx 0 iiii   mode: bit 1 shifts right, bit 0 rotates
+ *   LayoutShiftReg  ooooo mm dd xx yy 000
+ *   LayoutBranch    ooooo cccc iiiiiii      condition code
+ *
+ * Cycles run from the fetch of an instruction to the next fetch, along its state path in schematic/microcode.gmc. Every
+ * instruction takes 4 cycles to fetch and decode (fetch, f1, f2, decode). A branch whose condition fails leaves after
+ * checking it, so it takes fewer cycles when not taken. Opcodes without a path in the microcode yet take zero. They are
+ * counted by mcasm --timing into cycles.h, which everything that counts cycles reads through ISA_TIMING.
+ */
+#ifndef _ISA_H_
+#define _ISA_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* X(opcode, name, mnemonic, layout, signed immediate) */
+#define ISA_OPCODES(X)                                                                                                 \
+    X(0x00, PUSH, "PUSH", LayoutStack, false)                                                                          \
+    X(0x01, ADD, "ADD", LayoutRRR, false)                                                                              \
+    X(0x02, SUB, "SUB", LayoutRRR, false)                                                                              \
+    X(0x03, MUL, "MUL", LayoutRRR, false)                                                                              \
+    X(0x04, DIV, "DIV", LayoutRRR, false)                                                                              \
+    X(0x05, AND, "AND", LayoutRRR, false)                                                                              \
+    X(0x06, OR, "OR", LayoutRRR, false)                                                                                \
+    X(0x07, NOT, "NOT", LayoutRR, false)                                                                               \
+    X(0x08, SHIFT_IMM, "LSL", LayoutShiftImm, false)                                                                   \
+    X(0x09, MOV, "MOV", LayoutRR, false)                                                                               \
+    X(0x0A, CMP, "CMP", LayoutRR, false)                                                                               \
+    X(0x0B, RESERVED, NULL, LayoutNone, false)                                                                         \
+    X(0x0C, LDR_PC, "LDR", LayoutRI9, true)                                                                            \
+    X(0x0D, STR, "STR", LayoutRRR, false)                                                                              \
+    X(0x0E, LDR, "LDR", LayoutRRR, false)                                                                              \
+    X(0x0F, Bcc, "B", LayoutBranch, true)                                                                              \
+    X(0x10, POP, "POP", LayoutStack, false)                                                                            \
+    X(0x11, ADD_IMM, "ADD", LayoutRRI7, false)                                                                         \
+    X(0x12, SUB_IMM, "SUB", LayoutRRI7, false)                                                                         \
+    X(0x13, MUL_IMM, "MUL", LayoutRRI7, false)                                                                         \
+    X(0x14, DIV_IMM, "DIV", LayoutRRI7, false)                                                                         \
+    X(0x15, AND_IMM, "AND", LayoutRRI7, false)                                                                         \
+    X(0x16, OR_IMM, "OR", LayoutRRI7, false)                                                                           \
+    X(0x17, NOT_IMM, "NOT", LayoutRI9, false)                                                                          \
+    X(0x18, SHIFT, "LSL", LayoutShiftReg, false)                                                                       \
+    X(0x19, MOV_IMM, "MOV", LayoutRI9, false)                                                                          \
+    X(0x1A, CMP_IMM, "CMP", LayoutRI9, false)                                                                          \
+    X(0x1B, LEA, "LEA", LayoutRI9, true)                                                                               \
+    X(0x1C, STR_PC, "STR", LayoutRI9, true)                                                                            \
+    X(0x1D, STR_OFF, "STR", LayoutRRI7, true)                                                                          \
+    X(0x1E, LDR_OFF, "LDR", LayoutRRI7, true)                                                                          \
+    X(0x1F, BLcc, "BL", LayoutBranch, true)
+
+#define ISA_OPCODE_COUNT 32
+#define ISA_OPCODE_SHIFT 11
+
+/* Opcodes, named OP_ followed by the name in ISA_OPCODES */
+typedef enum Opcode {
+#define ISA_ENUM(code, name, mnemonic, layout, sign) OP_##name = code,
+    ISA_OPCODES(ISA_ENUM)
+#undef ISA_ENUM
+} isa_opcode_t;
+
+typedef enum IsaLayout {
+    LayoutNone,
+    LayoutStack,
+    LayoutRRR,
+    LayoutRRI7,
+    LayoutRR,
+    LayoutRI9,
+    LayoutShiftImm,
+    LayoutShiftReg,
+    LayoutBranch,
+    ISA_LAYOUT_COUNT,
+} isa_layout_t;
+
+/* Fields of an instruction after its opcode */
+typedef enum IsaField {
+    FieldRd,   // Destination, or the register stored by STR
+    FieldRx,   // First source
+    FieldRy,   // Second source
+    FieldImm,  // Immediate, offset or register list, always in the lowest bits
+    FieldMode, // Shift direction and type
+    FieldCond, // Branch condition code
+    ISA_FIELD_COUNT,
+} isa_field_t;
+
+typedef struct IsaFieldPos {
+    uint8_t shift;
+    uint8_t width; // Zero if the layout does not have the field
+} isa_field_pos_t;
+
+typedef struct IsaOpcodeInfo {
+    const char *mnemonic; // NULL for an unused opcode
+    isa_layout_t layout;
+    bool signed_imm; // Whether the immediate is a signed offset rather than an unsigned value
+} isa_opcode_info_t;
+
+/* Cycles of an opcode, as counted from the microcode in cycles.h */
+typedef struct IsaCycles {
+    uint8_t taken; // When a branch is taken, and for every other instruction
+    uint8_t not_taken;
+} isa_cycles_t;
+
+extern const isa_opcode_info_t ISA[ISA_OPCODE_COUNT];
+extern const isa_field_pos_t ISA_LAYOUTS[ISA_LAYOUT_COUNT][ISA_FIELD_COUNT];
+extern const isa_cycles_t ISA_TIMING[ISA_OPCODE_COUNT];
+extern const char *const ISA_CONDITIONS[16];
+extern const char *const ISA_SHIFTS[4];
+extern const char *const ISA_STACK_REGISTERS[8];
+
+/* Stack register list bits */
+#define ISA_STACK_R0 0x80
+#define ISA_STACK_PC 0x08
+#define ISA_STACK_SP 0x04
+#define ISA_STACK_LR 0x02
+#define ISA_STACK_FR 0x01
+
+/* Condition codes, as in ISA_CONDITIONS */
+#define ISA_CONDITION_EQ 0x0
+#define ISA_CONDITION_NE 0x1
+#define ISA_CONDITION_MI 0x6
+#define ISA_CONDITION_PL 0x7
+#define ISA_CONDITION_ALWAYS 0xE
+
+/* A decoded instruction */
+typedef struct IsaInstruction {
+    isa_opcode_t opcode;
+    uint16_t fields[ISA_FIELD_COUNT];
+} isa_insn_t;
+
+static inline isa_opcode_t isa_opcode(uint16_t word) { return (isa_opcode_t)(word >> ISA_OPCODE_SHIFT); }
+
+uint16_t isa_field_mask(isa_opcode_t opcode, isa_field_t field) __attribute__((const));
+uint16_t isa_encode(const isa_insn_t *insn);
+isa_insn_t isa_decode(uint16_t word) __attribute__((const));
+int16_t isa_immediate(const isa_insn_t *insn);
+unsigned isa_cycles(uint16_t word, bool taken) __attribute__((const));
+size_t isa_format(uint16_t word, char *buf, size_t size);
+
+#endif // _ISA_H_
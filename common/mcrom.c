@@ -0,0 +1,76 @@
+/* Implements reading and writing of the gol-16 microcode ROM container. */
+#include "mcrom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void _put_big_endian(uint8_t *bytes, uint64_t value, unsigned count) {
+    for (unsigned i = 0; i < count; i++)
+        bytes[i] = (uint8_t)(value >> ((count - i - 1) * 8));
+}
+
+static uint64_t _get_big_endian(const uint8_t *bytes, unsigned count) {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < count; i++)
+        value = value << 8 | bytes[i];
+    return value;
+}
+
+/* Writes a container, assembled in one buffer and written at once. Returns false if it could not be written. */
+bool mcrom_write(const uint64_t *words, uint32_t count, unsigned address_bits, const char *file_path) {
+    size_t size = MCROM_HEADER_BYTES + (size_t)count * sizeof(uint64_t);
+    uint8_t *buffer = calloc(size, 1);
+    memcpy(buffer, MCROM_MAGIC, 4);
+    _put_big_endian(&buffer[4], MCROM_VERSION, 2);
+    buffer[6] = (uint8_t)address_bits;
+    buffer[7] = sizeof(uint64_t);
+    _put_big_endian(&buffer[8], count, 4);
+    for (uint32_t i = 0; i < count; i++)
+        _put_big_endian(&buffer[MCROM_HEADER_BYTES + i * sizeof(uint64_t)], words[i], sizeof(uint64_t));
+
+    FILE *fptr = fopen(file_path, "wb");
+    bool success = fptr != NULL && fwrite(buffer, 1, size, fptr) == size;
+    if (fptr != NULL) success &= fclose(fptr) == 0;
+    free(buffer);
+    return success;
+}
+
+/* Reads a container into a table of words. Returns NULL if it could not be read, or is not a container of a version
+ * this reader knows, otherwise the ROM must be destroyed by the caller.
+ */
+mcrom_t *mcrom_read(const char *file_path) {
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return NULL;
+
+    uint8_t header[MCROM_HEADER_BYTES];
+    bool valid = fread(header, 1, sizeof(header), fptr) == sizeof(header) && !memcmp(header, MCROM_MAGIC, 4) &&
+                 _get_big_endian(&header[4], 2) == MCROM_VERSION && header[6] >= 8 && header[6] <= 12 &&
+                 header[7] == sizeof(uint64_t);
+    uint32_t count = valid ? (uint32_t)_get_big_endian(&header[8], 4) : 0;
+    valid &= count <= 1u << header[6];
+
+    // Rounded up to a whole number of alignments, as aligned_alloc needs
+    size_t size = (size_t)count * sizeof(uint64_t);
+    size_t aligned = (size + MCROM_ALIGNMENT) / MCROM_ALIGNMENT * MCROM_ALIGNMENT;
+    uint8_t *bytes = valid ? malloc(size + 1) : NULL;
+    valid &= bytes != NULL && fread(bytes, 1, size + 1, fptr) == size;
+    fclose(fptr);
+    if (!valid) {
+        free(bytes);
+        return NULL;
+    }
+
+    mcrom_t *rom = malloc(sizeof(mcrom_t));
+    rom->address_bits = header[6];
+    rom->count = count;
+    rom->words = aligned_alloc(MCROM_ALIGNMENT, aligned);
+    for (uint32_t i = 0; i < count; i++)
+        rom->words[i] = _get_big_endian(&bytes[i * sizeof(uint64_t)], sizeof(uint64_t));
+    free(bytes);
+    return rom;
+}
+
+void mcrom_destruct(mcrom_t *rom) {
+    free(rom->words);
+    free(rom);
+}
@@ -0,0 +1,38 @@
+/* Defines the gol-16 microcode ROM container, written by the microcode assembler (mcasm) and loaded by the emulator
+ * (gemu).
+ *
+ * A container is a header followed by a word for each state, all big-endian:
+ *
+ *   magic           4 bytes, "GMCR"
+ *   version         2 bytes, MCROM_VERSION
+ *   address bits    1 byte, the width of the next state address in the lowest bits of each word, from 8 to 12
+ *   word bytes      1 byte, 8
+ *   states          4 bytes
+ *   reserved        4 bytes, zero
+ *   words           8 bytes each, its signals above the address of its next state
+ *
+ * A reader refuses a version it does not know, so the layout of the words can change with the version.
+ */
+#ifndef _MCROM_H_
+#define _MCROM_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MCROM_MAGIC "GMCR"
+#define MCROM_VERSION 1
+#define MCROM_HEADER_BYTES 16
+
+/* Alignment of the words once loaded, a cache line */
+#define MCROM_ALIGNMENT 64
+
+typedef struct McRom {
+    unsigned address_bits;
+    uint32_t count;
+    uint64_t *words; // Indexed by state, aligned to MCROM_ALIGNMENT
+} mcrom_t;
+
+bool mcrom_write(const uint64_t *words, uint32_t count, unsigned address_bits, const char *file_path);
+mcrom_t *mcrom_read(const char *file_path);
+void mcrom_destruct(mcrom_t *rom);
+
+#endif // _MCROM_H_
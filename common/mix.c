@@ -0,0 +1,48 @@
+/* Implements reading and writing of the gol-16 instruction mix format. */
+#include "mix.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Writes the opcodes which were executed to a file. Returns false if it could not be written. */
+bool mix_write(const mix_t *mix, const char *file_path) {
+    FILE *fptr = fopen(file_path, "w");
+    if (fptr == NULL) return false;
+
+    fprintf(fptr, "; gol-16 instruction mix\n");
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT; op++) {
+        if (mix->executed[op] > 0)
+            fprintf(fptr, "$%02x %" PRIu64 " %" PRIu64 "\n", op, mix->executed[op], mix->not_taken[op]);
+    }
+
+    bool success = !ferror(fptr);
+    success &= fclose(fptr) == 0;
+    return success;
+}
+
+/* Reads a mix, starting from zero counts. Returns false if the file could not be read or a line is not an opcode and
+ * its counts.
+ */
+bool mix_read(mix_t *mix, const char *file_path) {
+    FILE *fptr = fopen(file_path, "r");
+    if (fptr == NULL) return false;
+
+    memset(mix, 0, sizeof(mix_t));
+    char text[256];
+    bool valid = true;
+    while (valid && fgets(text, sizeof(text), fptr) != NULL) {
+        text[strcspn(text, "\r\n")] = '\0';
+        if (text[0] == ';' || text[0] == '\0') continue;
+
+        unsigned op;
+        uint64_t executed, not_taken;
+        char extra;
+        valid = sscanf(text, "$%x %" SCNu64 " %" SCNu64 " %c", &op, &executed, &not_taken, &extra) == 3 &&
+                op < ISA_OPCODE_COUNT && not_taken <= executed;
+        if (!valid) break;
+        mix->executed[op] += executed;
+        mix->not_taken[op] += not_taken;
+    }
+    fclose(fptr);
+    return valid;
+}
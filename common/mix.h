@@ -0,0 +1,27 @@
+/* Defines the gol-16 instruction mix format, written by the emulator (gemu --mix) and read by the microcode assembler
+ * (mcasm --mix) to weigh the cycles of each opcode by how often a program runs it.
+ *
+ * A mix counts how many times each opcode was executed, and for a branch how many of those times its condition failed.
+ * It is text, one opcode to a line, in the same register as the execution profile. Lines beginning with ';' are
+ * comments:
+ *
+ *   ; gol-16 instruction mix
+ *   $<opcode> <executed> <not taken>
+ *
+ * Counts for the same opcode are added together, so several runs can be concatenated into one mix.
+ */
+#ifndef _MIX_H_
+#define _MIX_H_
+#include "isa.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Mix {
+    uint64_t executed[ISA_OPCODE_COUNT];  // Indexed by opcode
+    uint64_t not_taken[ISA_OPCODE_COUNT]; // Indexed by opcode, executions of a branch whose condition failed
+} mix_t;
+
+bool mix_write(const mix_t *mix, const char *file_path);
+bool mix_read(mix_t *mix, const char *file_path);
+
+#endif // _MIX_H_
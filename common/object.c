@@ -0,0 +1,261 @@
+/* Implements reading and writing of the gol-16 relocatable object format. */
+#include "object.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Relocations */
+uint16_t reloc_mask(reloc_t type) {
+    switch (type) {
+    case RelocRelative9:
+        return 0x1FF;
+    case RelocAbsolute16:
+        return 0xFFFF;
+    default:
+        return 0x7F;
+    }
+}
+
+/* Returns the field value which makes the instruction at place refer to target. */
+uint16_t reloc_value(reloc_t type, unsigned long target, unsigned long place) {
+    switch (type) {
+    case RelocAbsolute7:
+    case RelocAbsolute16:
+        return target & reloc_mask(type);
+    default:
+        return (target - place) & reloc_mask(type);
+    }
+}
+
+/* Checks that the field value for target can be represented without truncation. */
+bool reloc_in_range(reloc_t type, unsigned long target, unsigned long place) {
+    long offset = (long)target - (long)place;
+    switch (type) {
+    case RelocRelative7:
+        return -64 <= offset && offset <= 63;
+    case RelocRelative9:
+        return -256 <= offset && offset <= 255;
+    case RelocAbsolute7:
+        return target <= 0x7F;
+    case RelocAbsolute16:
+        return target <= 0xFFFF;
+    }
+    return false;
+}
+
+/* Word order */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define OBJECT_HOST_BIG_ENDIAN 1
+#else
+#define OBJECT_HOST_BIG_ENDIAN 0
+#endif
+
+/* Converts words between host order and big-endian in place. The loop has no dependencies between words, so the
+ * compiler vectorizes it into byte shuffles over whole registers.
+ */
+void object_swap_words(uint16_t *words, unsigned long count) {
+    if (OBJECT_HOST_BIG_ENDIAN) return;
+    for (unsigned long i = 0; i < count; i++)
+        words[i] = (uint16_t)(words[i] << 8 | words[i] >> 8);
+}
+
+/* Writing */
+
+/* Writes words as big-endian with a single fwrite. The words are swapped in place and swapped back afterwards rather
+ * than copied, so they are unchanged when this returns.
+ */
+bool object_write_words(FILE *stream, uint16_t *words, unsigned long count) {
+    if (count == 0) return !ferror(stream);
+    object_swap_words(words, count);
+    bool success = fwrite(words, sizeof(uint16_t), count, stream) == count;
+    object_swap_words(words, count);
+    return success;
+}
+
+void object_put16(FILE *stream, uint16_t value) {
+    uint8_t bytes[2] = {value >> 8, value};
+    fwrite(bytes, 1, sizeof(bytes), stream);
+}
+
+void object_put32(FILE *stream, uint32_t value) {
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+    fwrite(bytes, 1, sizeof(bytes), stream);
+}
+
+void object_write_header(FILE *stream, unsigned sections, unsigned symbols, unsigned relocations,
+                         unsigned long strings) {
+    fwrite(OBJECT_MAGIC, 1, 4, stream);
+    object_put16(stream, OBJECT_VERSION);
+    object_put16(stream, sections);
+    object_put16(stream, symbols);
+    object_put16(stream, relocations);
+    object_put32(stream, strings);
+}
+
+void object_write_symbol(FILE *stream, uint32_t name, uint16_t section, uint16_t value, binding_t binding) {
+    object_put32(stream, name);
+    object_put16(stream, section);
+    object_put16(stream, value);
+    uint8_t bytes[2] = {binding, 0};
+    fwrite(bytes, 1, sizeof(bytes), stream);
+}
+
+void object_write_relocation(FILE *stream, uint16_t section, uint16_t offset, uint16_t symbol, reloc_t type) {
+    object_put16(stream, section);
+    object_put16(stream, offset);
+    object_put16(stream, symbol);
+    uint8_t bytes[2] = {type, 0};
+    fwrite(bytes, 1, sizeof(bytes), stream);
+}
+
+/* Reading */
+typedef struct Cursor {
+    const uint8_t *data;
+    unsigned long length;
+    unsigned long pos;
+    bool overrun;
+} cursor_t;
+
+static uint32_t _get(cursor_t *cur, unsigned bytes) {
+    if (cur->pos + bytes > cur->length) {
+        cur->overrun = true;
+        return 0;
+    }
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bytes; i++)
+        value = (value << 8) | cur->data[cur->pos++];
+    return value;
+}
+
+static char *_string(const uint8_t *strings, unsigned long length, uint32_t offset) {
+    if (offset >= length) return NULL;
+    size_t len = strnlen((const char *)strings + offset, length - offset);
+    if (offset + len == length) return NULL; // Unterminated
+    char *name = malloc(len + 1);
+    memcpy(name, strings + offset, len + 1);
+    return name;
+}
+
+static uint8_t *_read_file(const char *file_path, unsigned long *length) {
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return NULL;
+
+    fseek(fptr, 0, SEEK_END);
+    *length = ftell(fptr);
+    rewind(fptr);
+
+    uint8_t *data = malloc(*length + 1);
+    if (fread(data, 1, *length, fptr) != *length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fptr);
+    return data;
+}
+
+/* Reads a relocatable object into memory. Returns NULL if the file could not be read or is not a valid object. */
+object_t *object_read(const char *file_path) {
+
+    unsigned long length;
+    uint8_t *data = _read_file(file_path, &length);
+    if (data == NULL) return NULL;
+
+    if (length < OBJECT_HEADER_SIZE || memcmp(data, OBJECT_MAGIC, 4)) {
+        free(data);
+        return NULL;
+    }
+
+    cursor_t cur = {data, length, 4, false};
+    uint16_t version = _get(&cur, 2);
+    object_t *obj = calloc(1, sizeof(object_t));
+    obj->file_path = file_path;
+    obj->section_count = _get(&cur, 2);
+    obj->symbol_count = _get(&cur, 2);
+    obj->relocation_count = _get(&cur, 2);
+    uint32_t strings_len = _get(&cur, 4);
+
+    if (version != OBJECT_VERSION || strings_len > length) {
+        free(data);
+        free(obj);
+        return NULL;
+    }
+    const uint8_t *strings = data + length - strings_len;
+    bool valid = true;
+
+    // Sections
+    uint32_t *section_names = calloc(obj->section_count + 1, sizeof(uint32_t));
+    obj->sections = calloc(obj->section_count + 1, sizeof(obj_section_t));
+    for (unsigned i = 0; i < obj->section_count && !cur.overrun; i++) {
+        section_names[i] = _get(&cur, 4);
+        obj->sections[i].length = _get(&cur, 2);
+        obj->sections[i].words = malloc(sizeof(uint16_t) * (obj->sections[i].length + 1));
+        unsigned long bytes = sizeof(uint16_t) * obj->sections[i].length;
+        if (cur.pos + bytes > cur.length) {
+            cur.overrun = true;
+            break;
+        }
+        memcpy(obj->sections[i].words, cur.data + cur.pos, bytes);
+        object_swap_words(obj->sections[i].words, obj->sections[i].length);
+        cur.pos += bytes;
+    }
+
+    // Symbols
+    uint32_t *symbol_names = calloc(obj->symbol_count + 1, sizeof(uint32_t));
+    obj->symbols = calloc(obj->symbol_count + 1, sizeof(obj_symbol_t));
+    for (unsigned i = 0; i < obj->symbol_count && !cur.overrun; i++) {
+        symbol_names[i] = _get(&cur, 4);
+        obj->symbols[i].section = _get(&cur, 2);
+        obj->symbols[i].value = _get(&cur, 2);
+        obj->symbols[i].binding = _get(&cur, 1);
+        _get(&cur, 1); // Reserved
+        valid &= obj->symbols[i].binding <= BindImport;
+        valid &= obj->symbols[i].section < obj->section_count || obj->symbols[i].binding == BindImport;
+    }
+
+    // Relocations
+    obj->relocations = calloc(obj->relocation_count + 1, sizeof(obj_reloc_t));
+    for (unsigned i = 0; i < obj->relocation_count && !cur.overrun; i++) {
+        obj_reloc_t *reloc = &obj->relocations[i];
+        reloc->section = _get(&cur, 2);
+        reloc->offset = _get(&cur, 2);
+        reloc->symbol = _get(&cur, 2);
+        reloc->type = _get(&cur, 1);
+        _get(&cur, 1); // Reserved
+        valid &= reloc->section < obj->section_count && reloc->symbol < obj->symbol_count;
+        valid &= reloc->type <= RelocAbsolute16;
+        valid &= valid && reloc->offset < obj->sections[reloc->section].length;
+    }
+
+    // Names are resolved last, since the string table is at the end of the file
+    valid &= !cur.overrun && cur.pos + strings_len == length;
+    for (unsigned i = 0; valid && i < obj->section_count; i++) {
+        obj->sections[i].name = _string(strings, strings_len, section_names[i]);
+        valid &= obj->sections[i].name != NULL;
+    }
+    for (unsigned i = 0; valid && i < obj->symbol_count; i++) {
+        obj->symbols[i].name = _string(strings, strings_len, symbol_names[i]);
+        valid &= obj->symbols[i].name != NULL;
+    }
+
+    free(section_names);
+    free(symbol_names);
+    free(data);
+
+    if (!valid) {
+        object_destruct(obj);
+        return NULL;
+    }
+    return obj;
+}
+
+void object_destruct(object_t *obj) {
+    for (unsigned i = 0; i < obj->section_count; i++) {
+        free(obj->sections[i].name);
+        free(obj->sections[i].words);
+    }
+    for (unsigned i = 0; i < obj->symbol_count; i++)
+        free(obj->symbols[i].name);
+    free(obj->sections);
+    free(obj->symbols);
+    free(obj->relocations);
+    free(obj);
+}
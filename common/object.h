@@ -0,0 +1,93 @@
+/* Defines the gol-16 relocatable object format, shared by the assembler (gasm -c) and the linker (glink).
+ *
+ * All fields are big-endian, like the gol-16 itself. The file is laid out as:
+ *
+ *   header      magic "G16R", u16 version, u16 section count, u16 symbol count, u16 relocation count,
+ *               u32 string table size
+ *   sections    u32 name (string table offset), u16 length in words (so at most 65535), then the words themselves
+ *   symbols     u32 name, u16 section (OBJECT_NO_SECTION if imported), u16 value (offset into section),
+ *               u8 binding, u8 reserved
+ *   relocations u16 section, u16 offset (word within section), u16 symbol index, u8 type, u8 reserved
+ *   strings     null terminated names
+ */
+#ifndef _OBJECT_H_
+#define _OBJECT_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OBJECT_MAGIC "G16R"
+#define OBJECT_VERSION 1
+#define OBJECT_HEADER_SIZE 16
+#define OBJECT_SECTION_HEADER_SIZE 6
+#define OBJECT_SYMBOL_SIZE 10
+#define OBJECT_RELOCATION_SIZE 8
+#define OBJECT_NO_SECTION 0xFFFF
+#define OBJECT_MAX_SECTION_LENGTH 0xFFFF // Section lengths are stored in 16 bits
+
+/* Symbol bindings */
+typedef enum binding {
+    BindLocal,  // Defined in this object, only visible to its own relocations
+    BindGlobal, // Defined in this object and exported to other objects
+    BindImport, // Defined by another object
+} binding_t;
+
+/* Relocation types (fields which hold the address of a symbol) */
+typedef enum reloc_type {
+    RelocRelative7, // PC-relative, signed 7 bit field (Bcc/BLcc)
+    RelocRelative9, // PC-relative, signed 9 bit field (LDR/STR [imm9], LEA)
+    RelocAbsolute7,  // Absolute address, unsigned 7 bit field ([r, imm7])
+    RelocAbsolute16, // Absolute address, whole word (literal loaded by a long branch)
+} reloc_t;
+
+uint16_t reloc_mask(reloc_t type) __attribute__((const));
+uint16_t reloc_value(reloc_t type, unsigned long target, unsigned long place) __attribute__((const));
+bool reloc_in_range(reloc_t type, unsigned long target, unsigned long place) __attribute__((const));
+
+/* Object contents */
+typedef struct ObjSection {
+    char *name;
+    uint16_t length;
+    uint16_t *words;
+} obj_section_t;
+
+typedef struct ObjSymbol {
+    char *name;
+    uint16_t section;
+    uint16_t value;
+    binding_t binding;
+} obj_symbol_t;
+
+typedef struct ObjRelocation {
+    uint16_t section;
+    uint16_t offset;
+    uint16_t symbol;
+    reloc_t type;
+} obj_reloc_t;
+
+typedef struct Object {
+    const char *file_path;
+    unsigned section_count;
+    obj_section_t *sections;
+    unsigned symbol_count;
+    obj_symbol_t *symbols;
+    unsigned relocation_count;
+    obj_reloc_t *relocations;
+} object_t;
+
+object_t *object_read(const char *file_path);
+void object_destruct(object_t *obj);
+
+/* Word order. Words are held in host order in memory and converted in bulk when they are read or written. */
+void object_swap_words(uint16_t *words, unsigned long count);
+
+/* Writing */
+bool object_write_words(FILE *stream, uint16_t *words, unsigned long count);
+void object_put16(FILE *stream, uint16_t value);
+void object_put32(FILE *stream, uint32_t value);
+void object_write_header(FILE *stream, unsigned sections, unsigned symbols, unsigned relocations,
+                         unsigned long strings);
+void object_write_symbol(FILE *stream, uint32_t name, uint16_t section, uint16_t value, binding_t binding);
+void object_write_relocation(FILE *stream, uint16_t section, uint16_t offset, uint16_t symbol, reloc_t type);
+
+#endif // _OBJECT_H_
@@ -0,0 +1,133 @@
+/* Implements reading and writing of the gol-16 execution profile format. */
+#include "profile.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+profile_t *profile_construct(void) { return calloc(1, sizeof(profile_t)); }
+
+void profile_destruct(profile_t *profile) {
+    for (unsigned i = 0; i < profile->file_count; i++)
+        free(profile->files[i]);
+    free(profile->files);
+    free(profile->entries);
+    free(profile);
+}
+
+static const char *_basename(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash != NULL ? slash + 1 : path;
+}
+
+/* Returns the index of a file, or file_count if the profile has none by that name. A file which is not found by its
+ * whole path is looked for by its name alone, since the profile may have been made from another directory.
+ */
+static unsigned _find_file(const profile_t *profile, const char *file) {
+    for (unsigned i = 0; i < profile->file_count; i++) {
+        if (!strcmp(profile->files[i], file)) return i;
+    }
+    for (unsigned i = 0; i < profile->file_count; i++) {
+        if (!strcmp(_basename(profile->files[i]), _basename(file))) return i;
+    }
+    return profile->file_count;
+}
+
+/* Entries are kept in order of file and line. Returns where the entry is, or where it would go. */
+static unsigned long _search(const profile_t *profile, unsigned file, uint32_t line) {
+    unsigned long low = 0, high = profile->count;
+    while (low < high) {
+        unsigned long mid = low + (high - low) / 2;
+        const profile_entry_t *entry = &profile->entries[mid];
+        if (entry->file < file || (entry->file == file && entry->line < line)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* Adds count executions of a statement. */
+void profile_add(profile_t *profile, const char *file, uint32_t line, uint64_t count) {
+    unsigned index = 0;
+    while (index < profile->file_count && strcmp(profile->files[index], file))
+        index++;
+    if (index == profile->file_count) {
+        profile->files = realloc(profile->files, sizeof(char *) * (profile->file_count + 1));
+        profile->files[profile->file_count] = malloc(strlen(file) + 1);
+        strcpy(profile->files[profile->file_count++], file);
+    }
+
+    unsigned long at = _search(profile, index, line);
+    if (at < profile->count && profile->entries[at].file == index && profile->entries[at].line == line) {
+        profile->entries[at].count += count;
+        return;
+    }
+    if (profile->count == profile->__capacity) {
+        profile->__capacity = profile->__capacity == 0 ? 64 : profile->__capacity * 2;
+        profile->entries = realloc(profile->entries, sizeof(profile_entry_t) * profile->__capacity);
+    }
+    memmove(&profile->entries[at + 1], &profile->entries[at], sizeof(profile_entry_t) * (profile->count - at));
+    profile->entries[at] = (profile_entry_t){index, line, count};
+    profile->count++;
+}
+
+/* Returns how many times a statement was executed, which is zero for a statement the profile does not mention. */
+uint64_t profile_count(const profile_t *profile, const char *file, uint32_t line) {
+    unsigned index = _find_file(profile, file);
+    if (index == profile->file_count) return 0;
+    unsigned long at = _search(profile, index, line);
+    if (at < profile->count && profile->entries[at].file == index && profile->entries[at].line == line)
+        return profile->entries[at].count;
+    return 0;
+}
+
+/* Writes the profile to a file. Returns false if it could not be written. */
+bool profile_write(const profile_t *profile, const char *file_path) {
+    FILE *fptr = fopen(file_path, "w");
+    if (fptr == NULL) return false;
+
+    fprintf(fptr, "; gol-16 execution profile\n");
+    for (unsigned long i = 0; i < profile->count; i++) {
+        const profile_entry_t *entry = &profile->entries[i];
+        fprintf(fptr, "%" PRIu64 " %s:%" PRIu32 "\n", entry->count, profile->files[entry->file], entry->line);
+    }
+
+    bool success = !ferror(fptr);
+    success &= fclose(fptr) == 0;
+    return success;
+}
+
+/* Reads a profile into memory. Returns NULL if the file could not be read or a line is not a count and a statement. */
+profile_t *profile_read(const char *file_path) {
+    FILE *fptr = fopen(file_path, "r");
+    if (fptr == NULL) return NULL;
+
+    profile_t *profile = profile_construct();
+    char text[1024];
+    bool valid = true;
+    while (valid && fgets(text, sizeof(text), fptr) != NULL) {
+        text[strcspn(text, "\r\n")] = '\0';
+        if (text[0] == ';' || text[0] == '\0') continue;
+
+        char *end;
+        uint64_t count = strtoull(text, &end, 10);
+        char *file = end + strspn(end, " \t");
+        char *colon = strrchr(file, ':');
+        valid = end != text && file != end && colon != NULL && colon != file;
+        if (!valid) break;
+
+        *colon = '\0';
+        unsigned long line = strtoul(colon + 1, &end, 10);
+        valid = *end == '\0' && end != colon + 1;
+        if (valid) profile_add(profile, file, line, count);
+    }
+    fclose(fptr);
+
+    if (!valid) {
+        profile_destruct(profile);
+        return NULL;
+    }
+    return profile;
+}
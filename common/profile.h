@@ -0,0 +1,40 @@
+/* Defines the gol-16 execution profile format, written by the emulator (gemu --profile) and read by the assembler
+ * (gassemble --profile) to lay out code by how often it runs.
+ *
+ * A profile counts how many times each statement of the source was executed. It is text, one statement to a line, so
+ * that profiles can be read, compared and merged by hand. Lines beginning with ';' are comments:
+ *
+ *   ; gol-16 execution profile
+ *   <count> <file>:<line>
+ *
+ * Counts for the same statement are added together, so several runs can be concatenated into one profile.
+ */
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct ProfileEntry {
+    unsigned file; // Index into the profile's files
+    uint32_t line;
+    uint64_t count;
+} profile_entry_t;
+
+typedef struct Profile {
+    char **files;
+    unsigned file_count;
+    profile_entry_t *entries;
+    unsigned long count;
+    unsigned long __capacity;
+} profile_t;
+
+profile_t *profile_construct(void);
+void profile_destruct(profile_t *profile);
+
+void profile_add(profile_t *profile, const char *file, uint32_t line, uint64_t count);
+uint64_t profile_count(const profile_t *profile, const char *file, uint32_t line);
+
+bool profile_write(const profile_t *profile, const char *file_path);
+profile_t *profile_read(const char *file_path);
+
+#endif // _PROFILE_H_
@@ -0,0 +1,8 @@
+/* Implements the table of control signal names. */
+#include "signals.h"
+
+const char *const SIGNAL_NAMES[SIGNAL_COUNT] = {
+#define SIGNAL_NAME(name, text) [SIGNAL_##name] = text,
+    SIGNALS(SIGNAL_NAME)
+#undef SIGNAL_NAME
+};
@@ -0,0 +1,62 @@
+/* Lists the control signals of the gol-16 microcode, shared by the microcode assembler (mcasm) and the emulator (gemu).
+ *
+ * A microcode word holds the address of its next state in its lowest bits, followed by a bit for each signal in the
+ * order of SIGNALS, from the lowest. A signal is only ever added at the end, so that words keep their meaning.
+ */
+#ifndef _SIGNALS_H_
+#define _SIGNALS_H_
+
+/* X(name, text) */
+#define SIGNALS(X)                                                                                                     \
+    X(T1OE, "t1oe")       /* ALU input A is t1, rather than zero */                                                    \
+    X(T1CE, "t1ce")       /* t1 latches the bus */                                                                     \
+    X(T2OE, "t2oe")       /* t2 drives the bus */                                                                      \
+    X(T2CE, "t2ce")       /* t2 latches the ALU result */                                                              \
+    X(RD, "rd")           /* Selects the register in the rd field of ir */                                             \
+    X(RX, "rx")           /* Selects the register in the rx field of ir */                                             \
+    X(RY, "ry")           /* Selects the register in the ry field of ir */                                             \
+    X(CCOE, "ccoe")       /* The condition code field of ir goes to the condition checker */                           \
+    X(REGW, "regw")       /* The selected register latches the bus */                                                  \
+    X(REGR, "regr")       /* The selected register drives the bus */                                                   \
+    X(PCOE, "pcoe")       /* Selects PC */                                                                             \
+    X(SPOE, "spoe")       /* Selects SP */                                                                             \
+    X(LROE, "lroe")       /* Selects LR */                                                                             \
+    X(FROE, "froe")       /* The flags go to the condition checker */                                                  \
+    X(FRCE, "frce")       /* The flags latch those of the ALU */                                                       \
+    X(UI4, "ui4")         /* The low 4 bits of ir drive the bus */                                                     \
+    X(UI7, "ui7")         /* The low 7 bits of ir drive the bus */                                                     \
+    X(UI9, "ui9")         /* The low 9 bits of ir drive the bus */                                                     \
+    X(SI7, "si7")         /* The low 7 bits of ir drive the bus, sign extended */                                      \
+    X(SI9, "si9")         /* The low 9 bits of ir drive the bus, sign extended */                                      \
+    X(AADD, "aadd")       /* The ALU adds */                                                                           \
+    X(ASUB, "asub")       /* The ALU subtracts */                                                                      \
+    X(ANOP, "anop")       /* The ALU does nothing */                                                                   \
+    X(AOP, "aop")         /* The ALU performs the operation in the low 4 bits of the opcode */                         \
+    X(COE, "coe")         /* A constant 1 drives the bus */                                                            \
+    X(IRCE, "irce")       /* ir latches the bus */                                                                     \
+    X(CTEST, "ctest")     /* Goes back to fetch once this state is done, unless the condition holds */                 \
+    X(MARCE, "marce")     /* mar latches the bus */                                                                    \
+    X(MAROE, "maroe")     /* mar addresses memory */                                                                   \
+    X(MDRCE, "mdrce")     /* mdr latches memory, or the bus with mdrput */                                             \
+    X(MDROE, "mdroe")     /* mdr drives the bus, with mdrget, or memory */                                             \
+    X(MDRPUT, "mdrput")   /* mdr is loaded from the bus rather than memory */                                          \
+    X(MDRGET, "mdrget")   /* mdr drives the bus rather than memory */                                                  \
+    X(IBREAD, "ibread")   /* Memory is read */                                                                         \
+    X(IBWRITE, "ibwrite") /* Memory is written from mdr */                                                             \
+    X(PCF, "pcf")         /* mar and t1 latch PC beside the bus, starting the next fetch */                            \
+    X(SRD, "srd")         /* Selects the register in the rd field of a shift, bits 7-8 of ir */                        \
+    X(SRX, "srx")         /* Selects the register in the rx field of a shift, bits 5-6 of ir */                        \
+    X(SRY, "sry")         /* Selects the register in the ry field of a shift, bits 3-4 of ir */                        \
+    X(ASHIFT, "ashift")   /* The ALU shifts or rotates as the mode field of ir says */
+
+/* Signals, named SIGNAL_ followed by the name in SIGNALS */
+typedef enum Signal {
+#define SIGNAL_ENUM(name, text) SIGNAL_##name,
+    SIGNALS(SIGNAL_ENUM)
+#undef SIGNAL_ENUM
+    SIGNAL_COUNT
+} signal_t;
+
+extern const char *const SIGNAL_NAMES[SIGNAL_COUNT];
+
+#endif // _SIGNALS_H_
@@ -0,0 +1,504 @@
+/* Implements static timing analysis of gol-16 flat images. */
+#include "timing.h"
+#include "disasm.h"
+#include <stdlib.h>
+
+/* Node standing for leaving the function */
+#define TIMING_END 0x10000u
+
+/* Lengthened branches, which push the target and pop it into PC */
+#define PUSH_R0 0x0080u
+#define POP_R0_PC ((OP_POP << ISA_OPCODE_SHIFT) | ISA_STACK_R0 | ISA_STACK_PC)
+#define POP_R0_PC_LR ((OP_POP << ISA_OPCODE_SHIFT) | ISA_STACK_R0 | ISA_STACK_PC | ISA_STACK_LR)
+
+enum { FunctionNew, FunctionInProgress, FunctionDone };
+
+void timing_cycles_isa(timing_cycles_t *cycles) {
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT; op++) {
+        cycles->taken[op] = ISA_TIMING[op].taken;
+        cycles->not_taken[op] = ISA_TIMING[op].not_taken;
+    }
+}
+
+/**
+ * Creates an analysis of a flat image, whose execution begins at address 0.
+ * @param words The words of the image, which must outlive the analysis.
+ * @param length The number of words.
+ * @param cycles The cycles of each opcode.
+ */
+timing_t *timing_construct(const uint16_t *words, unsigned long length, const timing_cycles_t *cycles) {
+    timing_t *timing = calloc(1, sizeof(timing_t));
+    timing->words = words;
+    timing->length = length;
+    timing->cycles = *cycles;
+    timing->loop_min = calloc(length, sizeof(unsigned));
+    timing->loop_max = calloc(length, sizeof(unsigned));
+    return timing;
+}
+
+void timing_destruct(timing_t *timing) {
+    free(timing->loop_min);
+    free(timing->loop_max);
+    free(timing->functions);
+    free(timing);
+}
+
+/* Bounds a loop by the least and most times its header runs each time the loop is entered. */
+void timing_bound(timing_t *timing, uint16_t header, unsigned min, unsigned max) {
+    if (header >= timing->length) return;
+    timing->loop_min[header] = min > 0 ? min : 1;
+    timing->loop_max[header] = max > min ? max : min;
+}
+
+/* An edge of a function's control flow graph, costing the cycles from the fetch of one node to that of the other */
+typedef struct Edge {
+    uint32_t to; // Address, or TIMING_END
+    uint64_t wcet;
+    uint64_t bcet;
+} edge_t;
+
+typedef struct Node {
+    edge_t *edges;
+    unsigned count;
+    bool member;   // Part of the function
+    bool absorbed; // Part of a loop which has been collapsed into its header
+} node_t;
+
+/* The control flow graph of one function */
+typedef struct Graph {
+    node_t *nodes;     // Indexed by address
+    uint32_t *members; // Addresses of the function, in the order they were found
+    unsigned long member_count;
+    unsigned long *place; // Indexed by address, scratch for the place of a node in the region being worked on
+} graph_t;
+
+static bool _fail(timing_t *timing, unsigned function, const char *problem, uint32_t at) {
+    timing->functions[function].problem = problem;
+    timing->functions[function].problem_at = (uint16_t)at;
+    return false;
+}
+
+/* Adds an edge, or widens the one already going to the same node. */
+static void _add_edge(node_t *node, uint32_t to, uint64_t wcet, uint64_t bcet) {
+    for (unsigned i = 0; i < node->count; i++) {
+        if (node->edges[i].to != to) continue;
+        if (wcet > node->edges[i].wcet) node->edges[i].wcet = wcet;
+        if (bcet < node->edges[i].bcet) node->edges[i].bcet = bcet;
+        return;
+    }
+    node->edges = realloc(node->edges, sizeof(edge_t) * (node->count + 1));
+    node->edges[node->count++] = (edge_t){to, wcet, bcet};
+}
+
+/* Returns the function with an entry point, adding it if it is new. */
+static unsigned _function(timing_t *timing, uint16_t entry) {
+    for (unsigned i = 0; i < timing->function_count; i++) {
+        if (timing->functions[i].entry == entry) return i;
+    }
+    timing->functions = realloc(timing->functions, sizeof(timing_function_t) * (timing->function_count + 1));
+    timing->functions[timing->function_count] = (timing_function_t){entry, 0, 0, NULL, 0, FunctionNew};
+    return timing->function_count++;
+}
+
+static bool _analyze_function(timing_t *timing, unsigned function);
+
+/* Finds the address loaded into R0 by a LEA or an LDR of a literal, as lengthened branches do. */
+static bool _loaded_address(const timing_t *timing, uint32_t at, uint32_t *address) {
+    uint16_t word = timing->words[at];
+    if (!(disasm_table()[word].flags & DISASM_VALID)) return false;
+    isa_insn_t insn = isa_decode(word);
+    if (insn.fields[FieldRd] != 0) return false;
+    uint16_t target = (uint16_t)(at + isa_immediate(&insn));
+    if (insn.opcode == OP_LEA) {
+        *address = target;
+        return true;
+    }
+    if (insn.opcode == OP_LDR_PC && target < timing->length) {
+        *address = timing->words[target];
+        return true;
+    }
+    return false;
+}
+
+/* Adds the cost of calling a function to an edge. Returns false if the function could not be bounded. */
+static bool _call(timing_t *timing, unsigned caller, uint32_t at, uint32_t callee, uint64_t *wcet, uint64_t *bcet) {
+    if (callee >= timing->length) return _fail(timing, caller, "calls outside the image", at);
+    unsigned function = _function(timing, (uint16_t)callee);
+    if (timing->functions[function].__state == FunctionInProgress) return _fail(timing, caller, "recursive call", at);
+    if (!_analyze_function(timing, function)) return _fail(timing, caller, "calls a function with no bound", at);
+    *wcet += timing->functions[function].wcet;
+    *bcet += timing->functions[function].bcet;
+    return true;
+}
+
+/* Adds the edges out of the instruction at an address. Returns false if they cannot be followed. */
+static bool _follow(timing_t *timing, unsigned function, node_t *node, uint32_t at) {
+    uint16_t word = timing->words[at];
+    if (!(disasm_table()[word].flags & DISASM_VALID)) {
+        _add_edge(node, TIMING_END, 0, 0); // Not executed, so it takes no cycles
+        return true;
+    }
+
+    isa_insn_t insn = isa_decode(word);
+    unsigned taken = timing->cycles.taken[insn.opcode], not_taken = timing->cycles.not_taken[insn.opcode];
+    uint32_t target = (uint16_t)(at + isa_immediate(&insn));
+    bool always = insn.fields[FieldCond] == ISA_CONDITION_ALWAYS;
+    uint32_t callee, ret;
+
+    switch (insn.opcode) {
+    case OP_Bcc:
+        if (always && target == at) {
+            _add_edge(node, TIMING_END, taken, taken); // Stops the processor
+        } else {
+            _add_edge(node, target, taken, taken);
+            if (!always) _add_edge(node, at + 1, not_taken, not_taken);
+        }
+        return true;
+    case OP_BLcc: {
+        uint64_t wcet = taken, bcet = taken;
+        if (!_call(timing, function, at, target, &wcet, &bcet)) return false;
+        if (!always) {
+            if (not_taken > wcet) wcet = not_taken;
+            if (not_taken < bcet) bcet = not_taken;
+        }
+        _add_edge(node, at + 1, wcet, bcet);
+        return true;
+    }
+    case OP_POP:
+        if (!(insn.fields[FieldImm] & ISA_STACK_PC)) break;
+        // PUSH {R0}; LEA R0, target; PUSH {R0}; POP {R0, PC}
+        if (word == POP_R0_PC && at >= 3 && timing->words[at - 1] == PUSH_R0 && timing->words[at - 3] == PUSH_R0 &&
+            _loaded_address(timing, at - 2, &target)) {
+            _add_edge(node, target, taken, taken);
+            return true;
+        }
+        // PUSH {R0}; LEA R0, callee; PUSH {R0}; LEA R0, return; PUSH {R0}; POP {R0, PC, LR}
+        if (word == POP_R0_PC_LR && at >= 5 && timing->words[at - 1] == PUSH_R0 &&
+            timing->words[at - 3] == PUSH_R0 && timing->words[at - 5] == PUSH_R0 &&
+            _loaded_address(timing, at - 2, &ret) && _loaded_address(timing, at - 4, &callee)) {
+            uint64_t wcet = taken, bcet = taken;
+            if (!_call(timing, function, at, callee, &wcet, &bcet)) return false;
+            _add_edge(node, ret, wcet, bcet);
+            return true;
+        }
+        _add_edge(node, TIMING_END, taken, taken); // A return
+        return true;
+    default:
+        break;
+    }
+    _add_edge(node, at + 1, taken, taken);
+    return true;
+}
+
+/* Finds the instructions of a function and the edges between them. */
+static bool _build(timing_t *timing, unsigned function, graph_t *graph) {
+    uint32_t entry = timing->functions[function].entry;
+    graph->members[graph->member_count++] = entry;
+    graph->nodes[entry].member = true;
+    for (unsigned long i = 0; i < graph->member_count; i++) {
+        uint32_t at = graph->members[i];
+        node_t *node = &graph->nodes[at];
+        if (!_follow(timing, function, node, at)) return false;
+        for (unsigned e = 0; e < node->count; e++) {
+            uint32_t to = node->edges[e].to;
+            if (to == TIMING_END || graph->nodes[to].member) continue;
+            if (to >= timing->length) return _fail(timing, function, "runs outside the image", at);
+            graph->nodes[to].member = true;
+            graph->members[graph->member_count++] = to;
+        }
+    }
+    return true;
+}
+
+/* A loop found by its back edges, with the addresses in its body */
+typedef struct Loop {
+    uint32_t header;
+    uint32_t *body; // Including the header
+    unsigned long size;
+} loop_t;
+
+static int _compare_loops(const void *a, const void *b) {
+    unsigned long x = ((const loop_t *)a)->size, y = ((const loop_t *)b)->size;
+    return (x > y) - (x < y);
+}
+
+/* Finds the loops of a function by depth first search from its entry: an edge back to a node still being searched is a
+ * back edge, and its header's body is everything which reaches the edge without passing through the header. Returns
+ * the number of loops, or -1 if a body can be entered other than through its header.
+ */
+static long _find_loops(timing_t *timing, unsigned function, const graph_t *graph, loop_t **loops) {
+    unsigned long length = timing->length;
+    uint8_t *colour = calloc(length, sizeof(uint8_t)); // Unvisited, being searched, or done
+    unsigned *next_edge = calloc(length, sizeof(unsigned));
+    uint32_t *stack = malloc(sizeof(uint32_t) * graph->member_count);
+    uint32_t *latches = malloc(sizeof(uint32_t) * graph->member_count * 2); // Pairs of latch and header
+    unsigned long latch_count = 0, depth = 0;
+
+    stack[depth++] = timing->functions[function].entry;
+    colour[stack[0]] = 1;
+    while (depth > 0) {
+        uint32_t at = stack[depth - 1];
+        const node_t *node = &graph->nodes[at];
+        if (next_edge[at] == node->count) {
+            colour[at] = 2;
+            depth--;
+            continue;
+        }
+        uint32_t to = node->edges[next_edge[at]++].to;
+        if (to == TIMING_END) continue;
+        if (colour[to] == 1) {
+            latches[latch_count * 2] = at;
+            latches[latch_count++ * 2 + 1] = to;
+        } else if (colour[to] == 0) {
+            colour[to] = 1;
+            stack[depth++] = to;
+        }
+    }
+
+    // Predecessors, as a list of edges sorted by the node they go to
+    unsigned long *first = calloc(length + 1, sizeof(unsigned long));
+    for (unsigned long i = 0; i < graph->member_count; i++) {
+        const node_t *node = &graph->nodes[graph->members[i]];
+        for (unsigned e = 0; e < node->count; e++) {
+            if (node->edges[e].to != TIMING_END) first[node->edges[e].to + 1]++;
+        }
+    }
+    for (unsigned long i = 0; i < length; i++)
+        first[i + 1] += first[i];
+    uint32_t *preds = malloc(sizeof(uint32_t) * (first[length] + 1));
+    unsigned long *filled = calloc(length, sizeof(unsigned long));
+    for (unsigned long i = 0; i < graph->member_count; i++) {
+        const node_t *node = &graph->nodes[graph->members[i]];
+        for (unsigned e = 0; e < node->count; e++) {
+            uint32_t to = node->edges[e].to;
+            if (to != TIMING_END) preds[first[to] + filled[to]++] = graph->members[i];
+        }
+    }
+
+    long loop_count = 0;
+    uint32_t *in_body = calloc(length, sizeof(uint32_t)); // Header + 1 of the last body found to hold the node
+    for (unsigned long l = 0; l < latch_count && loop_count >= 0; l++) {
+        uint32_t header = latches[l * 2 + 1];
+        if (in_body[header] == header + 1) continue; // Found already, through another back edge
+
+        loop_t loop = {header, malloc(sizeof(uint32_t) * graph->member_count), 0};
+        loop.body[loop.size++] = header;
+        in_body[header] = header + 1;
+        for (unsigned long k = l; k < latch_count; k++) {
+            uint32_t latch = latches[k * 2];
+            if (latches[k * 2 + 1] != header || in_body[latch] == header + 1) continue;
+            in_body[latch] = header + 1;
+            loop.body[loop.size++] = latch;
+        }
+        for (unsigned long i = 1; i < loop.size; i++) {
+            uint32_t at = loop.body[i];
+            for (unsigned long p = first[at]; p < first[at + 1]; p++) {
+                if (in_body[preds[p]] == header + 1) continue;
+                in_body[preds[p]] = header + 1;
+                loop.body[loop.size++] = preds[p];
+            }
+        }
+
+        // Only the header may be reached from outside
+        for (unsigned long i = 1; i < loop.size && loop_count >= 0; i++) {
+            uint32_t at = loop.body[i];
+            if (at == timing->functions[function].entry) loop_count = -1;
+            for (unsigned long p = first[at]; p < first[at + 1] && loop_count >= 0; p++) {
+                if (in_body[preds[p]] != header + 1) loop_count = -1;
+            }
+            if (loop_count < 0) _fail(timing, function, "loop entered other than through its header", at);
+        }
+        if (loop_count < 0) {
+            free(loop.body);
+            break;
+        }
+        *loops = realloc(*loops, sizeof(loop_t) * (loop_count + 1));
+        (*loops)[loop_count++] = loop;
+    }
+
+    free(colour);
+    free(next_edge);
+    free(stack);
+    free(latches);
+    free(first);
+    free(preds);
+    free(filled);
+    free(in_body);
+    return loop_count;
+}
+
+/* Works out the longest and shortest paths from a source to every node of a region, which has no cycles once edges
+ * back to the source are left out. Edges leaving the region are not followed. Returns false if the region has a cycle.
+ */
+static bool _paths(const graph_t *graph, const uint32_t *region, unsigned long size, const uint32_t *in_region,
+                   uint32_t mark, uint64_t *wcet, uint64_t *bcet) {
+    unsigned *incoming = calloc(size, sizeof(unsigned));
+    unsigned long *ready = malloc(sizeof(unsigned long) * size);
+    unsigned long ready_count = 0, done = 0;
+
+    for (unsigned long i = 0; i < size; i++) {
+        graph->place[region[i]] = i;
+        wcet[i] = 0;
+        bcet[i] = UINT64_MAX;
+    }
+    for (unsigned long i = 0; i < size; i++) {
+        const node_t *node = &graph->nodes[region[i]];
+        for (unsigned e = 0; e < node->count; e++) {
+            uint32_t to = node->edges[e].to;
+            if (to != TIMING_END && to != region[0] && in_region[to] == mark) incoming[graph->place[to]]++;
+        }
+    }
+    bcet[0] = 0;
+    ready[ready_count++] = 0;
+
+    // Each node is taken once every path into it has been
+    while (ready_count > 0) {
+        unsigned long place = ready[--ready_count];
+        done++;
+        const node_t *node = &graph->nodes[region[place]];
+        for (unsigned e = 0; e < node->count; e++) {
+            uint32_t to = node->edges[e].to;
+            if (to == TIMING_END || to == region[0] || in_region[to] != mark) continue;
+            unsigned long k = graph->place[to];
+            if (wcet[place] + node->edges[e].wcet > wcet[k]) wcet[k] = wcet[place] + node->edges[e].wcet;
+            if (bcet[place] + node->edges[e].bcet < bcet[k]) bcet[k] = bcet[place] + node->edges[e].bcet;
+            if (--incoming[k] == 0) ready[ready_count++] = k;
+        }
+    }
+
+    free(incoming);
+    free(ready);
+    return done == size;
+}
+
+/* Collapses a loop into its header, whose edges become the ways out of the loop. Returns false if it has no bound. */
+static bool _collapse(timing_t *timing, unsigned function, graph_t *graph, const loop_t *loop, uint32_t *in_region,
+                      uint32_t mark) {
+    uint32_t header = loop->header;
+    if (timing->loop_min[header] == 0) return _fail(timing, function, "loop with no bound", header);
+
+    // Inner loops have already been collapsed into their headers
+    uint32_t *region = malloc(sizeof(uint32_t) * loop->size);
+    unsigned long size = 0;
+    region[size++] = header;
+    for (unsigned long i = 1; i < loop->size; i++) {
+        if (!graph->nodes[loop->body[i]].absorbed) region[size++] = loop->body[i];
+    }
+    for (unsigned long i = 0; i < size; i++)
+        in_region[region[i]] = mark;
+
+    uint64_t *wcet = malloc(sizeof(uint64_t) * size), *bcet = malloc(sizeof(uint64_t) * size);
+    if (!_paths(graph, region, size, in_region, mark, wcet, bcet)) {
+        free(region);
+        free(wcet);
+        free(bcet);
+        return _fail(timing, function, "loop which is not reducible", header);
+    }
+
+    uint64_t back_wcet = 0, back_bcet = UINT64_MAX;
+    node_t exits = {NULL, 0, false, false};
+    for (unsigned long i = 0; i < size; i++) {
+        const node_t *node = &graph->nodes[region[i]];
+        for (unsigned e = 0; e < node->count; e++) {
+            const edge_t *edge = &node->edges[e];
+            if (edge->to == header) {
+                if (wcet[i] + edge->wcet > back_wcet) back_wcet = wcet[i] + edge->wcet;
+                if (bcet[i] + edge->bcet < back_bcet) back_bcet = bcet[i] + edge->bcet;
+            } else if (edge->to == TIMING_END || in_region[edge->to] != mark) {
+                _add_edge(&exits, edge->to, wcet[i] + edge->wcet, bcet[i] + edge->bcet);
+            }
+        }
+    }
+    free(region);
+    free(wcet);
+    free(bcet);
+    if (exits.count == 0) return _fail(timing, function, "loop which never exits", header);
+
+    // Every other iteration goes back to the header, and the last leaves
+    for (unsigned e = 0; e < exits.count; e++) {
+        exits.edges[e].wcet += (uint64_t)(timing->loop_max[header] - 1) * back_wcet;
+        exits.edges[e].bcet += (uint64_t)(timing->loop_min[header] - 1) * back_bcet;
+    }
+    for (unsigned long i = 1; i < loop->size; i++)
+        graph->nodes[loop->body[i]].absorbed = true;
+    free(graph->nodes[header].edges);
+    graph->nodes[header].edges = exits.edges;
+    graph->nodes[header].count = exits.count;
+    return true;
+}
+
+/* Works out the times of a function, analyzing the functions it calls first. */
+static bool _analyze_function(timing_t *timing, unsigned function) {
+    if (timing->functions[function].__state == FunctionDone) return timing->functions[function].problem == NULL;
+    timing->functions[function].__state = FunctionInProgress;
+
+    graph_t graph = {calloc(timing->length, sizeof(node_t)), malloc(sizeof(uint32_t) * timing->length), 0,
+                     malloc(sizeof(unsigned long) * timing->length)};
+    loop_t *loops = NULL;
+    long loop_count = 0;
+    bool bounded = _build(timing, function, &graph);
+    if (bounded) loop_count = _find_loops(timing, function, &graph, &loops);
+    bounded &= loop_count >= 0;
+    qsort(loops, loop_count > 0 ? loop_count : 0, sizeof(loop_t), _compare_loops);
+
+    uint32_t *in_region = calloc(timing->length, sizeof(uint32_t));
+    for (long l = 0; bounded && l < loop_count; l++)
+        bounded = _collapse(timing, function, &graph, &loops[l], in_region, (uint32_t)l + 1);
+
+    if (bounded) {
+        uint32_t *region = malloc(sizeof(uint32_t) * graph.member_count);
+        unsigned long size = 0;
+        uint32_t mark = (uint32_t)loop_count + 1;
+        for (unsigned long i = 0; i < graph.member_count; i++) {
+            if (graph.nodes[graph.members[i]].absorbed) continue;
+            region[size++] = graph.members[i];
+            in_region[graph.members[i]] = mark;
+        }
+        uint64_t *wcet = malloc(sizeof(uint64_t) * size), *bcet = malloc(sizeof(uint64_t) * size);
+        bounded = _paths(&graph, region, size, in_region, mark, wcet, bcet);
+        if (!bounded) _fail(timing, function, "control flow which is not reducible", region[0]);
+
+        timing_function_t *result = &timing->functions[function];
+        result->wcet = 0;
+        result->bcet = UINT64_MAX;
+        for (unsigned long i = 0; bounded && i < size; i++) {
+            const node_t *node = &graph.nodes[region[i]];
+            for (unsigned e = 0; e < node->count; e++) {
+                if (node->edges[e].to != TIMING_END) continue;
+                if (wcet[i] + node->edges[e].wcet > result->wcet) result->wcet = wcet[i] + node->edges[e].wcet;
+                if (bcet[i] + node->edges[e].bcet < result->bcet) result->bcet = bcet[i] + node->edges[e].bcet;
+            }
+        }
+        if (bounded && result->bcet == UINT64_MAX) bounded = _fail(timing, function, "never returns", region[0]);
+        free(region);
+        free(wcet);
+        free(bcet);
+    }
+
+    for (unsigned long i = 0; i < graph.member_count; i++)
+        free(graph.nodes[graph.members[i]].edges);
+    for (long l = 0; l < loop_count; l++)
+        free(loops[l].body);
+    free(loops);
+    free(graph.nodes);
+    free(graph.members);
+    free(graph.place);
+    free(in_region);
+    timing->functions[function].__state = FunctionDone;
+    return bounded;
+}
+
+static int _compare_functions(const void *a, const void *b) {
+    return (int)((const timing_function_t *)a)->entry - (int)((const timing_function_t *)b)->entry;
+}
+
+/* Finds the functions reached from address 0 and works out their times. A function which cannot be bounded is given
+ * the problem, and so is every function which calls it.
+ */
+void timing_analyze(timing_t *timing) {
+    if (timing->length == 0) return;
+    _analyze_function(timing, _function(timing, 0));
+    for (unsigned i = 0; i < timing->function_count; i++)
+        _analyze_function(timing, i);
+    qsort(timing->functions, timing->function_count, sizeof(timing_function_t), _compare_functions);
+}
@@ -0,0 +1,56 @@
+/* Static timing analysis of gol-16 flat images, for the timing analyzer (gtime).
+ *
+ * The cycles of each instruction run from its fetch to the next fetch, along its path through the microcode. They are
+ * taken from the shared instruction set table, which mcasm generates from the microcode. A branch has one cost when taken
+ * and another when not.
+ *
+ * A function is the code reached from an entry point, address 0 or the target of a BL, without following its calls.
+ * Its control flow graph has one node for each instruction. Every loop needs a bound: the least and most times its
+ * header runs each time the loop is entered. Loops are collapsed from the innermost out into single nodes, whose edges
+ * out of the loop cost (bound - 1) iterations plus the path from the header to that exit, until the function is a DAG
+ * whose longest and shortest paths from the entry to a return are its worst and best case execution times. A call
+ * costs the BL and the times of the function it calls.
+ *
+ * A return is a POP into PC, a branch to itself (which stops the processor) or a word which is not an instruction.
+ * Branches lengthened by the assembler through the stack are recognised as the branches and calls they stand for.
+ */
+#ifndef _TIMING_H_
+#define _TIMING_H_
+#include "isa.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Cycles of each opcode, from its fetch to the next fetch */
+typedef struct TimingCycles {
+    unsigned taken[ISA_OPCODE_COUNT];     // For a taken branch, and for every other instruction
+    unsigned not_taken[ISA_OPCODE_COUNT]; // For a branch which is not taken
+} timing_cycles_t;
+
+void timing_cycles_isa(timing_cycles_t *cycles);
+
+typedef struct TimingFunction {
+    uint16_t entry;
+    uint64_t bcet;         // Best case cycles, from the fetch of its entry to the fetch after it returns
+    uint64_t wcet;         // Worst case cycles
+    const char *problem;   // Why it could not be bounded, or NULL
+    uint16_t problem_at;   // Address the problem is about
+    unsigned __state;      // Not analyzed yet, in progress, or done
+} timing_function_t;
+
+typedef struct Timing {
+    const uint16_t *words;
+    unsigned long length;
+    timing_cycles_t cycles;
+    unsigned *loop_min; // Indexed by address, least runs of a loop header there, or zero if it has no bound
+    unsigned *loop_max; // Indexed by address, most runs of a loop header there
+    timing_function_t *functions; // In order of entry
+    unsigned function_count;
+} timing_t;
+
+timing_t *timing_construct(const uint16_t *words, unsigned long length, const timing_cycles_t *cycles);
+void timing_destruct(timing_t *timing);
+
+void timing_bound(timing_t *timing, uint16_t header, unsigned min, unsigned max);
+void timing_analyze(timing_t *timing);
+
+#endif // _TIMING_H_
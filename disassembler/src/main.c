@@ -0,0 +1,128 @@
+/* A disassembler for gol-16 images and relocatable objects (gdis) */
+#include "../../common/disasm.h"
+#include "../../common/object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) { puts("USAGE: gdis INPUT.o [OUTPUT.gasm]"); }
+
+/* Reads a flat image of big-endian words. */
+static uint16_t *_read_image(const char *file_path, unsigned long *length) {
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return NULL;
+
+    fseek(fptr, 0, SEEK_END);
+    long bytes = ftell(fptr);
+    rewind(fptr);
+    *length = bytes > 0 ? bytes / 2 : 0;
+    uint16_t *words = malloc(sizeof(uint16_t) * (*length + 1));
+    if (fread(words, sizeof(uint16_t), *length, fptr) != *length) {
+        free(words);
+        words = NULL;
+    } else {
+        object_swap_words(words, *length);
+    }
+    fclose(fptr);
+    return words;
+}
+
+static bool _is_object(const char *file_path) {
+    char magic[4] = {0};
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return false;
+    bool object = fread(magic, 1, 4, fptr) == 4 && !memcmp(magic, OBJECT_MAGIC, 4);
+    fclose(fptr);
+    return object;
+}
+
+/* Execution of a flat image begins at address 0. */
+static bool _disassemble_image(const char *file_path, FILE *out) {
+    unsigned long length;
+    uint16_t *words = _read_image(file_path, &length);
+    if (words == NULL) {
+        fprintf(stderr, "Could not read %s.\n", file_path);
+        return false;
+    }
+
+    disasm_t *disasm = disasm_construct(words, length);
+    disasm_entry(disasm, 0, NULL);
+    disasm_analyze(disasm);
+    fprintf(out, "; Disassembly of %s\n\n", file_path);
+    bool success = disasm_write(disasm, out);
+
+    disasm_destruct(disasm);
+    free(words);
+    return success;
+}
+
+/* Symbols of a relocatable object keep their names. Execution may begin at the start of its first section, at any label
+ * in that section, or at any exported label; words which cannot be reached from those are data.
+ */
+static bool _disassemble_object(object_t *obj, FILE *out) {
+    bool success = true;
+    fprintf(out, "; Disassembly of %s\n", obj->file_path);
+    for (unsigned i = 0; i < obj->symbol_count; i++) {
+        if (obj->symbols[i].binding == BindGlobal) fprintf(out, "    .global %s\n", obj->symbols[i].name);
+        if (obj->symbols[i].binding == BindImport) fprintf(out, "    .extern %s\n", obj->symbols[i].name);
+    }
+
+    for (unsigned s = 0; s < obj->section_count; s++) {
+        obj_section_t *section = &obj->sections[s];
+        disasm_t *disasm = disasm_construct(section->words, section->length);
+
+        for (unsigned i = 0; i < obj->symbol_count; i++) {
+            const obj_symbol_t *symbol = &obj->symbols[i];
+            if (symbol->section != s) continue;
+            if (symbol->binding == BindGlobal || s == 0) {
+                disasm_entry(disasm, symbol->value, symbol->name);
+            } else {
+                disasm_label(disasm, symbol->value, symbol->name);
+            }
+        }
+        for (unsigned i = 0; i < obj->relocation_count; i++) {
+            const obj_reloc_t *reloc = &obj->relocations[i];
+            if (reloc->section == s) disasm_operand(disasm, reloc->offset, obj->symbols[reloc->symbol].name);
+        }
+        if (s == 0) disasm_entry(disasm, 0, NULL);
+        disasm_analyze(disasm);
+
+        fprintf(out, "\n.section %s\n", section->name);
+        success &= disasm_write(disasm, out);
+        disasm_destruct(disasm);
+    }
+    return success;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            fprintf(stderr, "Could not write to file %s.\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool success;
+    if (_is_object(argv[1])) {
+        object_t *obj = object_read(argv[1]);
+        success = obj != NULL;
+        if (obj == NULL) {
+            fprintf(stderr, "Could not read %s: the relocatable object is not valid.\n", argv[1]);
+        } else {
+            success = _disassemble_object(obj, out);
+            object_destruct(obj);
+        }
+    } else {
+        success = _disassemble_image(argv[1], out);
+    }
+
+    if (out != stdout) success &= fclose(out) == 0;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
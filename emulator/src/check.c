@@ -0,0 +1,147 @@
+#include "check.h"
+#include "../../common/disasm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Values each register holds in turn: zero, one, the edges of the signed range and a shift amount above 15. */
+static const word_t VALUES[] = {0x0000, 0x0001, 0x0013, 0x7FFF, 0x8000, 0xFFFF};
+#define VALUE_COUNT (sizeof(VALUES) / sizeof(VALUES[0]))
+
+/** Addresses an instruction is executed at, so that addresses relative to PC wrap around memory too. */
+static const word_t PCS[] = {0x0100, 0xFFF0};
+
+/** Cases for each instruction word: the values turned through the registers, with every combination of the flags. */
+#define FLAG_COMBINATIONS 16
+#define CASES (VALUE_COUNT * FLAG_COMBINATIONS)
+
+static const char *REGISTER_NAMES[REG_LR + 1] = {"R0", "R1", "R2", "R3", "PC", "SP", "LR"};
+static const char *STATUS_NAMES[] = {"goes on", "halts", "stops"};
+
+/** Puts the processor in the state of a case, with the instruction word at PC, to be fetched from the start. */
+static void _set_up(Cpu *cpu, word_t word, unsigned c) {
+    unsigned turn = c / FLAG_COMBINATIONS;
+    for (unsigned i = 0; i <= REG_LR; i++)
+        cpu->registers[i] = VALUES[(turn + i) % VALUE_COUNT];
+    cpu->registers[REG_PC] = PCS[turn % 2];
+    cpu->memory[cpu->registers[REG_PC]] = word;
+    cpu->flags = c % FLAG_COMBINATIONS;
+    cpu->state = 0;
+}
+
+/**
+ * Describes how the state the microcode left differs from the state the instruction set left.
+ * @return Whether it differs.
+ */
+static bool _differs(const Cpu *isa, CpuStatus expected, const Cpu *rom, CpuStatus status, char *text, size_t size) {
+    for (unsigned i = 0; i <= REG_LR; i++) {
+        if (rom->registers[i] == isa->registers[i]) continue;
+        snprintf(text, size, "%s is %04x, not %04x", REGISTER_NAMES[i], rom->registers[i], isa->registers[i]);
+        return true;
+    }
+    if (rom->flags != isa->flags) {
+        snprintf(text, size, "FR is %x, not %x", rom->flags, isa->flags);
+        return true;
+    }
+    if (status != expected) {
+        snprintf(text, size, "it %s, where the instruction set %s", STATUS_NAMES[status], STATUS_NAMES[expected]);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Checks each instruction word of an opcode, over every case.
+ * @param example Where the first difference is described, with the case it was found in.
+ * @return The number of instruction words which differ.
+ */
+static unsigned _check_opcode(Cpu *isa, Cpu *rom, const mcrom_t *microcode, const state_t decode[ISA_OPCODE_COUNT],
+                              isa_opcode_t opcode, unsigned *words, char *example, size_t size) {
+    unsigned differ = 0;
+    for (unsigned operands = 0; operands < 1u << ISA_OPCODE_SHIFT; operands++) {
+        word_t word = (word_t)(opcode << ISA_OPCODE_SHIFT | operands);
+        if (!(disasm_table()[word].flags & DISASM_VALID)) continue;
+        (*words)++;
+
+        char text[96] = "";
+        unsigned c = 0;
+        for (; c < CASES; c++) {
+            _set_up(isa, word, c);
+            _set_up(rom, word, c);
+            CpuStatus expected = cpu_step(isa);
+            CpuStatus status = cpu_step_rom(rom, microcode, decode);
+            if (_differs(isa, expected, rom, status, text, sizeof(text))) break;
+        }
+
+        // Both start with the same memory, and go on with it once a word has been checked
+        if (c == CASES && memcmp(isa->memory, rom->memory, sizeof(isa->memory))) {
+            unsigned at = 0;
+            while (isa->memory[at] == rom->memory[at])
+                at++;
+            snprintf(text, sizeof(text), "memory at %04x is %04x, not %04x", at, rom->memory[at], isa->memory[at]);
+            c = 0;
+        }
+        if (text[0] == '\0') continue;
+        memcpy(rom->memory, isa->memory, sizeof(isa->memory));
+
+        if (differ++ == 0) {
+            char insn[64];
+            isa_format(word, insn, sizeof(insn));
+            word_t *r = rom->registers;
+            _set_up(rom, word, c);
+            snprintf(example, size, "%s with R0-R3 %04x %04x %04x %04x, SP %04x, LR %04x, PC %04x and FR %x: %s", insn,
+                     r[REG_R0], r[REG_R1], r[REG_R2], r[REG_R3], r[REG_SP], r[REG_LR], r[REG_PC], rom->flags, text);
+        }
+    }
+    return differ;
+}
+
+/**
+ * Checks every opcode, and reports what each does.
+ * @param microcode The microcode ROM, as loaded by mcrom_read.
+ * @param decode The state each opcode begins at, as loaded by load_decode_rom.
+ * @param report Where each opcode and the first difference found in it are written, or NULL.
+ * @return The number of opcodes which differ from the instruction set.
+ */
+unsigned check_microcode(const mcrom_t *microcode, const state_t decode[ISA_OPCODE_COUNT], FILE *report) {
+    // Memory holds a different value at each address, so that a load from the wrong one is seen
+    word_t *pattern = malloc(sizeof(word_t) * CPU_MEMORY_WORDS);
+    for (unsigned i = 0; i < CPU_MEMORY_WORDS; i++)
+        pattern[i] = (word_t)(i * 0x9E37 + 0x2B);
+    Cpu *isa = cpu_construct(pattern, CPU_MEMORY_WORDS);
+    Cpu *rom = cpu_construct(pattern, CPU_MEMORY_WORDS);
+    free(pattern);
+
+    unsigned differ = 0, checked = 0;
+    unsigned long cases = 0;
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT; op++) {
+        if (ISA[op].mnemonic == NULL) continue;
+        if (decode[op] == 0) {
+            if (report != NULL)
+                fprintf(report, "  $%02x %-4s  has no path through the microcode, so is not checked\n", op,
+                        ISA[op].mnemonic);
+            continue;
+        }
+
+        unsigned words = 0;
+        char example[256];
+        unsigned wrong =
+            _check_opcode(isa, rom, microcode, decode, (isa_opcode_t)op, &words, example, sizeof(example));
+        checked++;
+        cases += (unsigned long)words * CASES;
+        differ += wrong > 0;
+        if (report == NULL) continue;
+        if (wrong == 0) {
+            fprintf(report, "  $%02x %-4s  agrees for all %u instruction words\n", op, ISA[op].mnemonic, words);
+        } else {
+            fprintf(report, "  $%02x %-4s  differs for %u of %u instruction words, such as\n          %s\n", op,
+                    ISA[op].mnemonic, wrong, words, example);
+        }
+    }
+    if (report != NULL)
+        fprintf(report, "Checked %u opcodes in %lu cases against the instruction set: %u differ.\n", checked, cases,
+                differ);
+
+    cpu_destruct(isa);
+    cpu_destruct(rom);
+    return differ;
+}
@@ -0,0 +1,16 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include "cpu.h"
+#include <stdio.h>
+
+/**
+ * Checks that the microcode does what the instruction set says, so that it can be optimized with confidence. Every
+ * instruction word of every opcode with a path through the microcode is executed by cpu_step_rom and by cpu_step, from
+ * the same state, over classes of operands: each register holds each of a set of edge values in turn, with every
+ * combination of the flags. The registers, flags and memory they leave must be the same. Cycles are not compared,
+ * since making paths shorter is the point of optimizing the microcode.
+ */
+unsigned check_microcode(const mcrom_t *microcode, const state_t decode[ISA_OPCODE_COUNT], FILE *report);
+
+#endif // _CHECK_H_
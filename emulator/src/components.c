@@ -1,6 +1,8 @@
 #include "components.h"
 #include <stdio.h>
 
+const ALUOperation ALU_SHIFTS[4] = {ALU_LSL, ALU_ROL, ALU_LSR, ALU_ROR};
+
 /**
  * Reads the word at the given address from the program (like main memory). WARNING: This function assumes that the
  * address is valid.
@@ -10,12 +12,7 @@
  */
 word_t fetch_word(FILE *program, word_t addr) {
 
-    long pos = ftell(program);
-    if (pos > addr * 2) {
-        fseek(program, pos - addr * 2, SEEK_CUR);
-    } else {
-        fseek(program, addr * 2 - pos, SEEK_CUR);
-    }
+    fseek(program, addr * 2, SEEK_SET);
 
     word_t word;
     fread(&word, sizeof(word), 1, program);
@@ -23,18 +20,36 @@ word_t fetch_word(FILE *program, word_t addr) {
 }
 
 /**
- * Reads the signals at the given address (state) of the decode ROM.
- * @param decode_rom The file stream for the decode ROM/microcode.
+ * Reads the signals at the given address (state) of the microcode, which is loaded once into a table.
+ * @param microcode The microcode ROM, as loaded by mcrom_read.
  * @param addr The address of the signals to read.
- * @return The signals stored at the given address.
+ * @return The signals stored at the given address, with the next state address in their lowest bits, or none if no
+ * state is there.
  */
-signals_t fetch_signals(FILE *decode_rom, uint8_t addr) {
+signals_t fetch_signals(const mcrom_t *microcode, state_t addr) {
+    return addr < microcode->count ? microcode->words[addr] : 0;
+}
 
-    fseek(decode_rom, addr * 2, SEEK_SET);
+/**
+ * Loads the decode ROM, which holds the state each opcode begins at, packed big-endian from opcode 0. Its entries are
+ * as wide as the state addresses mcasm was built with, so the ROM is four bytes for each bit of them.
+ * @param decode_rom The file stream for the decode ROM.
+ * @param decode Where the state of each opcode is loaded.
+ * @return The bits of a state address, or zero if the file is not a decode ROM.
+ */
+unsigned load_decode_rom(FILE *decode_rom, state_t decode[ISA_OPCODE_COUNT]) {
+    uint8_t rom[ISA_OPCODE_COUNT * STATE_ADDRESS_BITS_MAX / 8 + 1];
+    rewind(decode_rom);
+    size_t size = fread(rom, 1, sizeof(rom), decode_rom);
+    unsigned bits = size * 8 / ISA_OPCODE_COUNT;
+    if (size % (ISA_OPCODE_COUNT / 8) != 0 || bits < STATE_ADDRESS_BITS_MIN || bits > STATE_ADDRESS_BITS_MAX) return 0;
 
-    signals_t signals;
-    fread(&signals, sizeof(signals), 1, decode_rom);
-    return signals; // Don't care that this is little-endian, because signals are bit values
+    for (unsigned op = 0, bit = 0; op < ISA_OPCODE_COUNT; op++) {
+        decode[op] = 0;
+        for (unsigned b = 0; b < bits; b++, bit++)
+            decode[op] = (state_t)(decode[op] << 1 | ((rom[bit / 8] >> (7 - bit % 8)) & 1));
+    }
+    return bits;
 }
 
 static word_t rotr(word_t a, word_t n) { return (a >> n) | (a << (sizeof(word_t) * 8 - n)); }
@@ -81,17 +96,18 @@ word_t alu(ALUOperation op, word_t a, word_t b, uint8_t *flags) {
         else
             result = a / b;
         break;
+    // Shifts and rotates only use the low 4 bits of b, so that they are defined for any operand the microcode passes
     case ALU_LSL:
-        result = a << b;
+        result = a << (b & 0xF);
         break;
     case ALU_LSR:
-        result = a >> b;
+        result = a >> (b & 0xF);
         break;
     case ALU_ROL:
-        result = rotl(a, b);
+        result = rotl(a, b & 0xF);
         break;
     case ALU_ROR:
-        result = rotr(a, b);
+        result = rotr(a, b & 0xF);
         break;
     case ALU_NOOP:
         break;
@@ -1,6 +1,8 @@
 #ifndef _COMPONENTS_H_
 #define _COMPONENTS_H_
 
+#include "../../common/isa.h"
+#include "../../common/mcrom.h"
 #include <stdint.h>
 #include <stdio.h>
 
@@ -41,6 +43,9 @@ typedef enum {
     ALU_ROR = 0xC,  /**< Logical rotate right */
 } ALUOperation;
 
+/** The ALU operation of each mode of a shift, indexed by the mode field. */
+extern const ALUOperation ALU_SHIFTS[4];
+
 /** Lists all of the possible condition codes for the gol-16 processor. */
 typedef enum {
     COND_EQ = 0x0, /**< Equal */
@@ -60,56 +65,23 @@ typedef enum {
     COND_AL = 0xE, /**< Always */
 } ConditionCode;
 
-typedef enum {
-    OP_PUSH = 0x00, /**< PUSH {r, ...} | Push passed registers onto the stack and decrement stack pointer. */
-    OP_ADD = 0x01,  /**< ADD rd, rx, ry | Adds rx to ry and stores the result into rd. */
-    OP_SUB = 0x02,  /**< SUB rd, rx, ry | Subtracts rx from ry and stores the result into rd. */
-    OP_MUL = 0x03,  /**< MUL rd, rx, ry | Multiplies rx by ry and stores the result into rd. */
-    OP_DIV = 0x04,  /**< DIV rd, rx, ry | Divides rx by ry and stores the result into rd. */
-    OP_AND = 0x05,  /**< AND rd, rx, ry | Bitwise AND rx with ry and stores the result into rd. */
-    OP_OR = 0x06,   /**< OR rd, rx, ry | Bitwise OR rx with ry and stores the result into rd. */
-    OP_NOT = 0x07,  /**< NOT rd, r | Stores bitwise NOT(r) into rd (generates flags). */
-    /** LSd/ROd rd, r, imm4 | Logical shift/rotate left/right r by imm4 bits and stores the result into rd. */
-    OP_LSd_ROd_IMM = 0x08,
-    OP_MOV = 0x09,       /**< MOV rd, r | Copies the value in r to rd. */
-    OP_CMP = 0x0A,       /**< CMP rx, ry | Subtract ry from rx to generate flags. */
-    OP_RESERVED = 0x0B,  /**< Reserved for future use. */
-    OP_LDR_PCREL = 0x0C, /**< LDR rd, [imm9] | Load address imm9 + PC into rd. */
-    /** STR rs, [rx, ry] | Add contents of rx and ry and store contents of rs in the resulting address in memory. */
-    OP_STR = 0x0D,
-    /** LDR rd, [rx, ry] | Add contents of rx and ry and load contents of the resulting address in memory into rd. */
-    OP_LDR = 0x0E,
-    OP_Bcc = 0x0F,     /**< Bcc imm7 | Branch to address PC + sign-ext(imm7) if cc is true based on flags. */
-    OP_POP = 0x10,     /**< POP {r, ...} | Pop passed registers from the stack and increment stack pointer. */
-    OP_ADD_IMM = 0x11, /**< ADD rd, r, imm7 | Add r and zero-ext(imm7) and store the result into rd. */
-    OP_SUB_IMM = 0x12, /**< SUB rd, r, imm7 | Subtract zero-ext(imm7) from r and store the result into rd. */
-    OP_MUL_IMM = 0x13, /**< MUL rd, r, imm7 | Multiply r by zero-ext(imm7) and store the result into rd. */
-    OP_DIV_IMM = 0x14, /**< DIV rd, r, imm7 | Divide r by zero-ext(imm7) and store the result into rd. */
-    OP_AND_IMM = 0x15, /**< AND rd, r, imm7 | Bitwise AND r with zero-ext(imm7) and store the result into rd. */
-    OP_OR_IMM = 0x16,  /**< OR rd, r, imm7 | Bitwise OR r with zero-ext(imm7) and store the result into rd. */
-    OP_NOT_IMM = 0x17, /**< NOT r, imm9 | Stores bitwise NOT zero-ext(imm7) into rd. */
-    /** LSd/ROd rd, rx, ry | Logical shift/rotate left/right rx by contents of ry # of bits and store result in rd. */
-    OP_LSd_ROd = 0x18,
-    OP_MOV_IMM = 0x19, /**< MOV rd, imm9 | Copy the value of zero-ext(imm9) into rd. */
-    OP_CMP_IMM = 0x1A, /**< CMP r, imm9 | Subtract zero-ext(imm9) from r to generate flags. */
-    OP_LEA = 0x1B,     /**< LEA rd, imm9 | Add PC and sign-ext(imm9) and store the result in rd. */
-    /** STR rs, [imm9] | Add PC and sign-ext(imm9) and store contents of rs into resulting address in memory. */
-    OP_STR_PCREL = 0x1C,
-    /** STR rs, [r, imm7] | Add contents of r to sign-ext(imm7), store contents of rs in resulting memory address. */
-    OP_STR_OFFR = 0x1D,
-    /** LDR rd, [r, imm7] | Add contents of r to sign-ext(imm7), load contents of resulting memory address in rd. */
-    OP_LDR_OFFR = 0x1E,
-    /** BLcc imm7 | Branch to address PC + sign-ext(imm7) if cc is true based on flags, and store PC in LR. */
-    OP_BLcc = 0x1F,
-} Opcodes;
+/** Opcodes and instruction layouts are described once for every tool, in the shared instruction set table. */
+typedef isa_opcode_t Opcodes;
 
 /** Defines a single memory word. */
 typedef uint16_t word_t;
 /** Defines a set of internal signals. */
 typedef uint64_t signals_t;
+/** Defines the address of a microcode state. */
+typedef uint16_t state_t;
+
+/** Fewest and most bits of a state address, which mcasm is built with. */
+#define STATE_ADDRESS_BITS_MIN 8
+#define STATE_ADDRESS_BITS_MAX 12
 
 word_t fetch_word(FILE *program, word_t addr);
-signals_t fetch_signals(FILE *decode_rom, uint8_t addr);
+signals_t fetch_signals(const mcrom_t *microcode, state_t addr);
+unsigned load_decode_rom(FILE *decode_rom, state_t decode[ISA_OPCODE_COUNT]);
 word_t alu(ALUOperation op, word_t a, word_t b, uint8_t *flags);
 
 #endif // _COMPONENTS_H_
@@ -0,0 +1,355 @@
+#include "cpu.h"
+#include "../../common/disasm.h"
+#include "../../common/signals.h"
+#include "handlers.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Creates a processor with the program loaded at address 0. Registers, flags and the rest of memory start at zero, so
+ * the stack grows down from the top of memory.
+ * @param program The words of a flat image.
+ * @param length The number of words in the program.
+ * @return The processor, to be destroyed with cpu_destruct.
+ */
+Cpu *cpu_construct(const word_t *program, unsigned long length) {
+    Cpu *cpu = calloc(1, sizeof(Cpu));
+    if (length > CPU_MEMORY_WORDS) length = CPU_MEMORY_WORDS;
+    memcpy(cpu->memory, program, sizeof(word_t) * length);
+    return cpu;
+}
+
+void cpu_destruct(Cpu *cpu) { free(cpu); }
+
+/**
+ * Checks a condition code against the flags.
+ * @param cond The condition code of a branch.
+ * @param flags The flag register.
+ * @return Whether the branch is taken.
+ */
+bool condition_holds(ConditionCode cond, uint8_t flags) {
+    bool c = flags & FLAG_CARRY, v = flags & FLAG_OVERFLOW, z = flags & FLAG_ZERO, n = flags & FLAG_NEGATIVE;
+    switch (cond) {
+    case COND_EQ:
+        return z;
+    case COND_NE:
+        return !z;
+    case COND_HS:
+        return c;
+    case COND_HI:
+        return c && !z;
+    case COND_LO:
+        return !c;
+    case COND_LS:
+        return !c || z;
+    case COND_MI:
+        return n;
+    case COND_PL:
+        return !n;
+    case COND_VS:
+        return v;
+    case COND_VC:
+        return !v;
+    case COND_GE:
+        return n == v;
+    case COND_LT:
+        return n != v;
+    case COND_GT:
+        return !z && n == v;
+    case COND_LE:
+        return z || n != v;
+    case COND_AL:
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Performs an ALU operation which writes the flag register. The ALU does not produce carry and signed overflow yet, so
+ * they are worked out here for addition and subtraction, which the unsigned and signed conditions need. Carry is set
+ * by a subtraction which does not borrow.
+ * @param cpu The processor, whose flags are written.
+ * @param op The ALU operation to perform.
+ * @param a The operand a for the calculation.
+ * @param b The operand b for the calculation.
+ * @return The result.
+ */
+word_t cpu_alu(Cpu *cpu, ALUOperation op, word_t a, word_t b) {
+    word_t result = alu(op, a, b, &cpu->flags);
+    cpu->flags &= ~(FLAG_CARRY | FLAG_OVERFLOW);
+    if (op == ALU_ADD) {
+        if ((uint32_t)a + b > 0xFFFF) cpu->flags |= FLAG_CARRY;
+        if (~(a ^ b) & (a ^ result) & 0x8000) cpu->flags |= FLAG_OVERFLOW;
+    } else if (op == ALU_SUB) {
+        if (a >= b) cpu->flags |= FLAG_CARRY;
+        if ((a ^ b) & (a ^ result) & 0x8000) cpu->flags |= FLAG_OVERFLOW;
+    }
+    return result;
+}
+
+static word_t *_stack_register(Cpu *cpu, unsigned bit) {
+    switch (0x80 >> bit) {
+    case ISA_STACK_PC:
+        return &cpu->registers[REG_PC];
+    case ISA_STACK_SP:
+        return &cpu->registers[REG_SP];
+    case ISA_STACK_LR:
+        return &cpu->registers[REG_LR];
+    default:
+        return &cpu->registers[bit]; // R0 to R3
+    }
+}
+
+/**
+ * Pushes registers in the order the spec gives, R0 to R3, PC, SP, LR and then FR, or pops them in the reverse order.
+ * The stack is full descending. PC is pushed as the address of the next instruction.
+ */
+static void _stack(Cpu *cpu, uint8_t list, bool push) {
+    word_t *sp = &cpu->registers[REG_SP];
+    for (unsigned i = 0; i < 8; i++) {
+        unsigned bit = push ? i : 7 - i;
+        if (!(list & (0x80 >> bit))) continue;
+
+        word_t fr = cpu->flags;
+        word_t *reg = (0x80 >> bit) == ISA_STACK_FR ? &fr : _stack_register(cpu, bit);
+        if (push) {
+            cpu->memory[--*sp] = *reg;
+        } else {
+            word_t value = cpu->memory[*sp]; // May be popped into SP itself
+            (*sp)++;
+            *reg = value;
+        }
+        cpu->flags = fr & 0xF;
+    }
+}
+
+/**
+ * Executes the instruction at PC.
+ * @param cpu The processor.
+ * @return CPU_RUNNING if the next instruction can be executed, otherwise why the processor stopped. An illegal word is
+ * not executed, and takes no cycles.
+ */
+CpuStatus cpu_step(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t pc = r[REG_PC];
+    word_t word = cpu->memory[pc];
+    if (!(disasm_table()[word].flags & DISASM_VALID)) return CPU_ILLEGAL;
+
+    isa_insn_t insn = isa_decode(word);
+    const uint16_t *f = insn.fields;
+    word_t imm = (word_t)isa_immediate(&insn);
+    bool taken = true;
+
+    // The next instruction follows, unless this one writes PC
+    r[REG_PC] = pc + 1;
+
+    switch (insn.opcode) {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_AND:
+    case OP_OR:
+        r[f[FieldRd]] = cpu_alu(cpu, (ALUOperation)insn.opcode, r[f[FieldRx]], r[f[FieldRy]]);
+        break;
+    case OP_ADD_IMM:
+    case OP_SUB_IMM:
+    case OP_MUL_IMM:
+    case OP_DIV_IMM:
+    case OP_AND_IMM:
+    case OP_OR_IMM:
+        r[f[FieldRd]] = cpu_alu(cpu, (ALUOperation)(insn.opcode - OP_ADD_IMM + ALU_ADD), r[f[FieldRx]], imm);
+        break;
+    case OP_SHIFT_IMM:
+        r[f[FieldRd]] = cpu_alu(cpu, ALU_SHIFTS[f[FieldMode]], r[f[FieldRx]], imm);
+        break;
+    case OP_SHIFT:
+        r[f[FieldRd]] = cpu_alu(cpu, ALU_SHIFTS[f[FieldMode]], r[f[FieldRx]], r[f[FieldRy]] & 0xF);
+        break;
+    // MOV and NOT do not write the flag register in the microcode
+    case OP_NOT:
+        r[f[FieldRd]] = ~r[f[FieldRx]];
+        break;
+    case OP_NOT_IMM:
+        r[f[FieldRd]] = ~imm;
+        break;
+    case OP_MOV:
+        r[f[FieldRd]] = r[f[FieldRx]];
+        break;
+    case OP_MOV_IMM:
+        r[f[FieldRd]] = imm;
+        break;
+    case OP_CMP:
+        cpu_alu(cpu, ALU_SUB, r[f[FieldRd]], r[f[FieldRx]]);
+        break;
+    case OP_CMP_IMM:
+        cpu_alu(cpu, ALU_SUB, r[f[FieldRd]], imm);
+        break;
+    case OP_LDR_PC:
+        r[f[FieldRd]] = cpu->memory[(word_t)(pc + imm)];
+        break;
+    case OP_LDR:
+        r[f[FieldRd]] = cpu->memory[(word_t)(r[f[FieldRx]] + r[f[FieldRy]])];
+        break;
+    case OP_LDR_OFF:
+        r[f[FieldRd]] = cpu->memory[(word_t)(r[f[FieldRx]] + imm)];
+        break;
+    case OP_STR_PC:
+        cpu->memory[(word_t)(pc + imm)] = r[f[FieldRd]];
+        break;
+    case OP_STR:
+        cpu->memory[(word_t)(r[f[FieldRx]] + r[f[FieldRy]])] = r[f[FieldRd]];
+        break;
+    case OP_STR_OFF:
+        cpu->memory[(word_t)(r[f[FieldRx]] + imm)] = r[f[FieldRd]];
+        break;
+    case OP_LEA:
+        r[f[FieldRd]] = pc + imm;
+        break;
+    case OP_Bcc:
+    case OP_BLcc:
+        taken = condition_holds((ConditionCode)f[FieldCond], cpu->flags);
+        if (!taken) break;
+        if (insn.opcode == OP_BLcc) r[REG_LR] = pc + 1;
+        r[REG_PC] = pc + imm;
+        break;
+    case OP_PUSH:
+        _stack(cpu, f[FieldImm], true);
+        break;
+    case OP_POP:
+        _stack(cpu, f[FieldImm], false);
+        break;
+    case OP_RESERVED:
+        return CPU_ILLEGAL;
+    }
+
+    cpu->instructions++;
+    cpu->cycles += isa_cycles(word, taken);
+    return r[REG_PC] == pc ? CPU_HALTED : CPU_RUNNING;
+}
+
+/**
+ * Executes the instruction at PC with the handler generated from its path through the microcode, which works out what
+ * each state on the path does instead of what the instruction set says. An opcode without a path, such as PUSH and
+ * POP, is executed by cpu_step.
+ * @param cpu The processor.
+ * @return CPU_RUNNING if the next instruction can be executed, otherwise why the processor stopped.
+ */
+CpuStatus cpu_step_microcode(Cpu *cpu) {
+    word_t pc = cpu->registers[REG_PC];
+    word_t word = cpu->memory[pc];
+    if (!(disasm_table()[word].flags & DISASM_VALID)) return CPU_ILLEGAL;
+    Handler handler = HANDLERS[isa_opcode(word)];
+    if (handler == NULL) return cpu_step(cpu);
+
+    handler(cpu);
+    cpu->instructions++;
+    return cpu->registers[REG_PC] == pc ? CPU_HALTED : CPU_RUNNING;
+}
+
+/**
+ * Finds whether a state is on the path which fetches and decodes an instruction, from fetch up to the first state whose
+ * next state address is zero.
+ */
+static bool _fetches(const mcrom_t *microcode, state_t state) {
+    state_t at = 0;
+    for (uint32_t i = 0; i < microcode->count; i++) {
+        if (at == state) return true;
+        at = fetch_signals(microcode, at) & ((1u << microcode->address_bits) - 1);
+        if (at == 0) return false;
+    }
+    return false;
+}
+
+/**
+ * Executes the instruction at PC by running the microcode ROM a state at a time, as the control unit does. Each state
+ * drives the bus, works the ALU and latches the registers its signals say, all from the values they held when the state
+ * began. The first state after fetch whose next state address is zero decodes the instruction, going on to the state
+ * the decode ROM gives its opcode. The instruction is done once it goes on to a state which fetches: fetch itself, or
+ * a later one if its last state prefetched, in which case the temporary registers and the state are kept in the
+ * processor for the next instruction, which takes the cycles from there. An opcode which the decode ROM sends back to
+ * fetch, such as PUSH and POP, has no path, and is executed by cpu_step.
+ * @param cpu The processor.
+ * @param microcode The microcode ROM, as loaded by mcrom_read.
+ * @param decode The state each opcode begins at, as loaded by load_decode_rom.
+ * @return CPU_RUNNING if the next instruction can be executed, otherwise why the processor stopped. A path which does
+ * not come back to fetch stops the processor as CPU_ILLEGAL.
+ */
+CpuStatus cpu_step_rom(Cpu *cpu, const mcrom_t *microcode, const state_t decode[ISA_OPCODE_COUNT]) {
+    word_t *r = cpu->registers;
+    word_t pc = r[REG_PC];
+    word_t word = cpu->memory[pc];
+    if (!(disasm_table()[word].flags & DISASM_VALID)) return CPU_ILLEGAL;
+    if (decode[isa_opcode(word)] == 0) {
+        cpu->state = 0;
+        return cpu_step(cpu);
+    }
+
+    word_t t1 = cpu->t1, t2 = cpu->t2, mar = cpu->mar, mdr = cpu->mdr, ir = cpu->ir;
+    bool decoded = false;
+    state_t state = cpu->state;
+    for (unsigned cycles = 1; cycles <= 2 * microcode->count; cycles++) {
+        signals_t signals = fetch_signals(microcode, state);
+#define ON(signal) (signals >> (SIGNAL_##signal + microcode->address_bits) & 1)
+
+        // The register selected, read or written through the bus
+        word_t *reg = ON(RD)     ? &r[(ir >> 9) & 3]
+                      : ON(RX)   ? &r[(ir >> 7) & 3]
+                      : ON(RY)   ? &r[(ir >> 5) & 3]
+                      : ON(SRD)  ? &r[(ir >> 7) & 3]
+                      : ON(SRX)  ? &r[(ir >> 5) & 3]
+                      : ON(SRY)  ? &r[(ir >> 3) & 3]
+                      : ON(PCOE) ? &r[REG_PC]
+                      : ON(SPOE) ? &r[REG_SP]
+                      : ON(LROE) ? &r[REG_LR]
+                                 : NULL;
+        word_t bus = ON(T2OE)                  ? t2
+                     : ON(COE)                 ? 1
+                     : ON(UI4)                 ? ir & 0xF
+                     : ON(UI7)                 ? ir & 0x7F
+                     : ON(UI9)                 ? ir & 0x1FF
+                     : ON(SI7)                 ? (word_t)(((ir & 0x7F) ^ 0x40) - 0x40)
+                     : ON(SI9)                 ? (word_t)(((ir & 0x1FF) ^ 0x100) - 0x100)
+                     : ON(REGR) && reg != NULL ? *reg
+                     : ON(MDROE) && ON(MDRGET) ? mdr
+                                               : 0;
+
+        // The condition is tested on the flags before the ALU writes them
+        bool fails = ON(CTEST) && !condition_holds((ConditionCode)((ir >> 7) & 0xF), cpu->flags);
+        ALUOperation op = ON(AADD)     ? ALU_ADD
+                          : ON(ASUB)   ? ALU_SUB
+                          : ON(AOP)    ? (ALUOperation)(isa_opcode(ir) & 0xF)
+                          : ON(ASHIFT) ? ALU_SHIFTS[(ir >> 9) & 3]
+                                       : ALU_NOOP;
+        word_t a = ON(T1OE) ? t1 : 0;
+        uint8_t alu_flags;
+        word_t result = ON(FRCE) ? cpu_alu(cpu, op, a, bus) : alu(op, a, bus, &alu_flags);
+
+        word_t read = cpu->memory[mar], prefetch = r[REG_PC];
+        if (ON(IBWRITE)) cpu->memory[mar] = mdr;
+        if (ON(REGW) && reg != NULL) *reg = bus;
+        if (ON(MDRCE)) mdr = ON(IBREAD) ? read : bus;
+        if (ON(T1CE)) t1 = bus;
+        if (ON(T2CE)) t2 = result;
+        if (ON(MARCE)) mar = bus;
+        if (ON(IRCE)) ir = bus;
+        if (ON(PCF)) t1 = mar = prefetch;
+#undef ON
+
+        // A failed condition goes back to fetch, and the first state to go back to fetch before decoding decodes
+        state_t next = fails ? 0 : signals & ((1u << microcode->address_bits) - 1);
+        if (!decoded && !fails && next == 0) {
+            next = decode[isa_opcode(ir)];
+            decoded = true;
+        }
+        if (decoded && _fetches(microcode, next)) {
+            cpu->t1 = t1, cpu->t2 = t2, cpu->mar = mar, cpu->mdr = mdr, cpu->ir = ir;
+            cpu->state = next;
+            cpu->instructions++;
+            cpu->cycles += cycles;
+            return r[REG_PC] == pc ? CPU_HALTED : CPU_RUNNING;
+        }
+        state = next;
+    }
+    return CPU_ILLEGAL;
+}
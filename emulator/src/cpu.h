@@ -0,0 +1,43 @@
+#ifndef _CPU_H_
+#define _CPU_H_
+
+#include "components.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Number of words in the gol-16 address space. */
+#define CPU_MEMORY_WORDS 0x10000
+
+/** Enumerates why the processor stopped, or that it can go on. */
+typedef enum {
+    CPU_RUNNING = 0x0, /**< The instruction was executed and the next one can be */
+    CPU_HALTED = 0x1,  /**< The instruction branched to itself, which would loop forever */
+    CPU_ILLEGAL = 0x2, /**< The word at PC is not an instruction, such as the DCD which ends a program */
+} CpuStatus;
+
+/**
+ * The architectural state of the gol-16, executed an instruction at a time. Instructions behave as their path through
+ * the microcode does, and take the cycles given by the shared instruction set table, but the microcode itself is not
+ * interpreted by cpu_step. cpu_step_microcode runs the handlers generated from it instead, state by state, and
+ * cpu_step_rom runs the microcode ROM itself.
+ */
+typedef struct {
+    word_t memory[CPU_MEMORY_WORDS]; /**< Main memory, holding the program from address 0 */
+    word_t registers[REG_LR + 1];    /**< Indexed by Register */
+    uint8_t flags;                   /**< Flag register, using the FLAG_ masks */
+    uint64_t instructions;           /**< Instructions executed so far */
+    uint64_t cycles;                 /**< Cycles taken so far, from the first fetch */
+    word_t t1, t2, mar, mdr, ir;     /**< Temporary registers, kept by cpu_step_rom for an instruction it prefetched */
+    state_t state;                   /**< State cpu_step_rom goes on from, past fetch once an instruction prefetches */
+} Cpu;
+
+Cpu *cpu_construct(const word_t *program, unsigned long length);
+void cpu_destruct(Cpu *cpu);
+
+bool condition_holds(ConditionCode cond, uint8_t flags) __attribute__((const));
+word_t cpu_alu(Cpu *cpu, ALUOperation op, word_t a, word_t b);
+CpuStatus cpu_step(Cpu *cpu);
+CpuStatus cpu_step_microcode(Cpu *cpu);
+CpuStatus cpu_step_rom(Cpu *cpu, const mcrom_t *microcode, const state_t decode[ISA_OPCODE_COUNT]);
+
+#endif // _CPU_H_
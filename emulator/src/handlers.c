@@ -0,0 +1,744 @@
+/* Handlers for each opcode, generated by mcasm --handlers from ../schematic/microcode.gmc. Do not edit; generate them
+ * again with make handlers once the microcode changes.
+ */
+#include "handlers.h"
+
+/* $01 ADD: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_01(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_ADD, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $02 SUB: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_02(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_SUB, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $03 MUL: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_03(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_MUL, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $04 DIV: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_04(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_DIV, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $05 AND: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_05(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_AND, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $06 OR: fetch, f1, f2, decode, form1r, ex1, t2_to_rd (7 cycles) */
+static void _handle_06(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1r
+    t1 = r[(ir >> 7) & 3];
+    // ex1
+    t2 = cpu_alu(cpu, ALU_OR, t1, r[(ir >> 5) & 3]);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $07 NOT: fetch, f1, f2, decode, movnotreg, t2_to_rd (6 cycles) */
+static void _handle_07(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // movnotreg
+    t2 = alu(ALU_NOT, 0, r[(ir >> 7) & 3], &alu_flags);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 6;
+}
+
+/* $08 LSL: fetch, f1, f2, decode, shifti, shifti1, shift_rd (7 cycles) */
+static void _handle_08(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // shifti
+    t1 = r[(ir >> 5) & 3];
+    // shifti1
+    t2 = cpu_alu(cpu, ALU_SHIFTS[(ir >> 9) & 3], t1, (word_t)(ir & 0xF));
+    // shift_rd
+    r[(ir >> 7) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $09 MOV: fetch, f1, f2, decode, movnotreg, t2_to_rd (6 cycles) */
+static void _handle_09(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // movnotreg
+    t2 = alu(ALU_RB, 0, r[(ir >> 7) & 3], &alu_flags);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 6;
+}
+
+/* $0a CMP: fetch, f1, f2, decode, cmpr, ex7 (6 cycles) */
+static void _handle_0a(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // cmpr
+    t1 = r[(ir >> 9) & 3];
+    // ex7
+    cpu_alu(cpu, ALU_SUB, t1, r[(ir >> 7) & 3]);
+    cpu->cycles += 6;
+}
+
+/* $0c LDR: fetch, f1, f2, decode, ldria, ldaddr_and_read_to_rd, read_to_rd, ex10 (8 cycles) */
+static void _handle_0c(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // ldria
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x1FF) ^ 0x100) - 0x100), &alu_flags);
+    // ldaddr_and_read_to_rd
+    mar = t2;
+    // read_to_rd
+    mdr = cpu->memory[mar];
+    // ex10
+    r[(ir >> 9) & 3] = mdr;
+    cpu->cycles += 8;
+}
+
+/* $0d STR: fetch, f1, f2, decode, stror, ex15, store_rd_at_addr, ex13, ex14 (9 cycles) */
+static void _handle_0d(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // stror
+    t1 = r[(ir >> 7) & 3];
+    // ex15
+    t2 = alu(ALU_ADD, t1, r[(ir >> 5) & 3], &alu_flags);
+    // store_rd_at_addr
+    mar = t2;
+    // ex13
+    mdr = r[(ir >> 9) & 3];
+    // ex14
+    cpu->memory[mar] = mdr;
+    cpu->cycles += 9;
+}
+
+/* $0e LDR: fetch, f1, f2, decode, ldror, ex11, ldaddr_and_read_to_rd, read_to_rd, ex10 (9 cycles) */
+static void _handle_0e(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // ldror
+    t1 = r[(ir >> 7) & 3];
+    // ex11
+    t2 = alu(ALU_ADD, t1, r[(ir >> 5) & 3], &alu_flags);
+    // ldaddr_and_read_to_rd
+    mar = t2;
+    // read_to_rd
+    mdr = cpu->memory[mar];
+    // ex10
+    r[(ir >> 9) & 3] = mdr;
+    cpu->cycles += 9;
+}
+
+/* $0f B: fetch, f1, f2, decode, check_cc, branch, replace_pc (7 cycles) */
+static void _handle_0f(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // check_cc
+    if (!condition_holds((ConditionCode)((ir >> 7) & 0xF), cpu->flags)) {
+        cpu->cycles += 5;
+        return;
+    }
+    // branch
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x7F) ^ 0x40) - 0x40), &alu_flags);
+    // replace_pc
+    r[REG_PC] = t2;
+    cpu->cycles += 7;
+}
+
+/* $11 ADD: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_11(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_ADD, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $12 SUB: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_12(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_SUB, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $13 MUL: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_13(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_MUL, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $14 DIV: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_14(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_DIV, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $15 AND: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_15(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_AND, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $16 OR: fetch, f1, f2, decode, form1i, ex2, t2_to_rd (7 cycles) */
+static void _handle_16(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // form1i
+    t1 = r[(ir >> 7) & 3];
+    // ex2
+    t2 = cpu_alu(cpu, ALU_OR, t1, (word_t)(ir & 0x7F));
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $17 NOT: fetch, f1, f2, decode, noti, t2_to_rd (6 cycles) */
+static void _handle_17(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // noti
+    t2 = alu(ALU_NOT, 0, (word_t)(ir & 0x1FF), &alu_flags);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 6;
+}
+
+/* $18 LSL: fetch, f1, f2, decode, shiftr, shiftr1, shift_rd (7 cycles) */
+static void _handle_18(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // shiftr
+    t1 = r[(ir >> 5) & 3];
+    // shiftr1
+    t2 = cpu_alu(cpu, ALU_SHIFTS[(ir >> 9) & 3], t1, r[(ir >> 3) & 3]);
+    // shift_rd
+    r[(ir >> 7) & 3] = t2;
+    cpu->cycles += 7;
+}
+
+/* $19 MOV: fetch, f1, f2, decode, movi (5 cycles) */
+static void _handle_19(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // movi
+    r[(ir >> 9) & 3] = (word_t)(ir & 0x1FF);
+    cpu->cycles += 5;
+}
+
+/* $1a CMP: fetch, f1, f2, decode, cmpi, ex9 (6 cycles) */
+static void _handle_1a(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // cmpi
+    t1 = r[(ir >> 9) & 3];
+    // ex9
+    cpu_alu(cpu, ALU_SUB, t1, (word_t)(ir & 0x1FF));
+    cpu->cycles += 6;
+}
+
+/* $1b LEA: fetch, f1, f2, decode, lea, t2_to_rd (6 cycles) */
+static void _handle_1b(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // lea
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x1FF) ^ 0x100) - 0x100), &alu_flags);
+    // t2_to_rd
+    r[(ir >> 9) & 3] = t2;
+    cpu->cycles += 6;
+}
+
+/* $1c STR: fetch, f1, f2, decode, stria, store_rd_at_addr, ex13, ex14 (8 cycles) */
+static void _handle_1c(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // stria
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x1FF) ^ 0x100) - 0x100), &alu_flags);
+    // store_rd_at_addr
+    mar = t2;
+    // ex13
+    mdr = r[(ir >> 9) & 3];
+    // ex14
+    cpu->memory[mar] = mdr;
+    cpu->cycles += 8;
+}
+
+/* $1d STR: fetch, f1, f2, decode, stroi, ex16, store_rd_at_addr, ex13, ex14 (9 cycles) */
+static void _handle_1d(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // stroi
+    t1 = r[(ir >> 7) & 3];
+    // ex16
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x7F) ^ 0x40) - 0x40), &alu_flags);
+    // store_rd_at_addr
+    mar = t2;
+    // ex13
+    mdr = r[(ir >> 9) & 3];
+    // ex14
+    cpu->memory[mar] = mdr;
+    cpu->cycles += 9;
+}
+
+/* $1e LDR: fetch, f1, f2, decode, ldroi, ex12, ldaddr_and_read_to_rd, read_to_rd, ex10 (9 cycles) */
+static void _handle_1e(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // ldroi
+    t1 = r[(ir >> 7) & 3];
+    // ex12
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x7F) ^ 0x40) - 0x40), &alu_flags);
+    // ldaddr_and_read_to_rd
+    mar = t2;
+    // read_to_rd
+    mdr = cpu->memory[mar];
+    // ex10
+    r[(ir >> 9) & 3] = mdr;
+    cpu->cycles += 9;
+}
+
+/* $1f BL: fetch, f1, f2, decode, check_cc_bl, link, branch, replace_pc (8 cycles) */
+static void _handle_1f(Cpu *cpu) {
+    word_t *r = cpu->registers;
+    word_t t1, t2, mar, mdr, ir;
+    uint8_t alu_flags;
+    // fetch
+    t1 = r[REG_PC];
+    mar = r[REG_PC];
+    // f1
+    t2 = alu(ALU_ADD, t1, 1, &alu_flags);
+    mdr = cpu->memory[mar];
+    // f2
+    ir = mdr;
+    // decode
+    r[REG_PC] = t2;
+    // check_cc_bl
+    if (!condition_holds((ConditionCode)((ir >> 7) & 0xF), cpu->flags)) {
+        cpu->cycles += 5;
+        return;
+    }
+    // link
+    r[REG_LR] = t2;
+    // branch
+    t2 = alu(ALU_ADD, t1, (word_t)(((ir & 0x7F) ^ 0x40) - 0x40), &alu_flags);
+    // replace_pc
+    r[REG_PC] = t2;
+    cpu->cycles += 8;
+}
+
+const Handler HANDLERS[ISA_OPCODE_COUNT] = {
+    [0x01] = _handle_01,
+    [0x02] = _handle_02,
+    [0x03] = _handle_03,
+    [0x04] = _handle_04,
+    [0x05] = _handle_05,
+    [0x06] = _handle_06,
+    [0x07] = _handle_07,
+    [0x08] = _handle_08,
+    [0x09] = _handle_09,
+    [0x0a] = _handle_0a,
+    [0x0c] = _handle_0c,
+    [0x0d] = _handle_0d,
+    [0x0e] = _handle_0e,
+    [0x0f] = _handle_0f,
+    [0x11] = _handle_11,
+    [0x12] = _handle_12,
+    [0x13] = _handle_13,
+    [0x14] = _handle_14,
+    [0x15] = _handle_15,
+    [0x16] = _handle_16,
+    [0x17] = _handle_17,
+    [0x18] = _handle_18,
+    [0x19] = _handle_19,
+    [0x1a] = _handle_1a,
+    [0x1b] = _handle_1b,
+    [0x1c] = _handle_1c,
+    [0x1d] = _handle_1d,
+    [0x1e] = _handle_1e,
+    [0x1f] = _handle_1f,
+};
@@ -0,0 +1,15 @@
+#ifndef _HANDLERS_H_
+#define _HANDLERS_H_
+
+#include "cpu.h"
+
+/**
+ * Executes the instruction at PC along its path through the microcode, from its fetch to the next fetch, and adds the
+ * cycles of that path. Handlers are generated from the microcode by mcasm --handlers into handlers.c.
+ */
+typedef void (*Handler)(Cpu *cpu);
+
+/** Indexed by opcode, the handler of each opcode, or NULL for an opcode without a path through the microcode. */
+extern const Handler HANDLERS[ISA_OPCODE_COUNT];
+
+#endif // _HANDLERS_H_
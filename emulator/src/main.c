@@ -1,49 +1,278 @@
+#include "../../common/addrmap.h"
+#include "../../common/disasm.h"
+#include "../../common/mix.h"
+#include "../../common/profile.h"
+#include "check.h"
 #include "components.h"
+#include "cpu.h"
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/** A program which has not stopped after this many instructions is assumed never to. */
+#define MAX_INSTRUCTIONS 100000000
 
 static uint16_t pc = 0;
 
+/** The ROMs which _step_rom runs, loaded once. */
+static const mcrom_t *rom_microcode = NULL;
+static state_t rom_decode[ISA_OPCODE_COUNT];
+
+static CpuStatus _step_rom(Cpu *cpu) { return cpu_step_rom(cpu, rom_microcode, rom_decode); }
+
+/**
+ * Runs the program until it stops, and writes how many times each statement and each opcode was executed.
+ * @param step Executes one instruction: cpu_step, cpu_step_microcode to run the handlers generated from the
+ * microcode, or _step_rom to run the microcode ROM itself.
+ * @param memory The program.
+ * @param length The number of words in the program.
+ * @param map The address map of the program, which names the statement of each address, if a profile is written.
+ * @param profile_file Where the profile is written, or NULL.
+ * @param mix_file Where the instruction mix is written, or NULL.
+ * @return Whether the files could be written.
+ */
+static bool run(CpuStatus (*step)(Cpu *), const word_t *memory, unsigned long length, const addrmap_t *map,
+                const char *profile_file, const char *mix_file) {
+    Cpu *cpu = cpu_construct(memory, length);
+    uint64_t *counts = calloc(CPU_MEMORY_WORDS, sizeof(uint64_t));
+    mix_t mix = {{0}, {0}};
+
+    CpuStatus status = CPU_RUNNING;
+    while (status == CPU_RUNNING && cpu->instructions < MAX_INSTRUCTIONS) {
+        word_t at = cpu->registers[REG_PC];
+        isa_insn_t insn = isa_decode(cpu->memory[at]);
+        // The flags before the branch decide whether it is taken
+        bool taken = ISA[insn.opcode].layout != LayoutBranch ||
+                     condition_holds((ConditionCode)insn.fields[FieldCond], cpu->flags);
+        status = step(cpu);
+        if (status == CPU_ILLEGAL) continue;
+        counts[at]++;
+        mix.executed[insn.opcode]++;
+        mix.not_taken[insn.opcode] += !taken;
+    }
+    const char *reason = status == CPU_HALTED    ? "branched to itself"
+                         : status == CPU_ILLEGAL ? "reached a word which is not an instruction"
+                                                 : "had not stopped";
+    printf("Ran %" PRIu64 " instructions in %" PRIu64 " cycles, and %s at %04x.\n", cpu->instructions, cpu->cycles,
+           reason, cpu->registers[REG_PC]);
+    if (cpu->instructions > 0)
+        printf("Averaged %.3f cycles per instruction.\n", (double)cpu->cycles / (double)cpu->instructions);
+
+    bool written = true;
+    if (mix_file != NULL && !mix_write(&mix, mix_file)) {
+        fprintf(stderr, "Could not write instruction mix '%s'.\n", mix_file);
+        written = false;
+    }
+
+    // A statement is executed each time its first word is, however many words it was assembled into
+    if (profile_file != NULL) {
+        profile_t *profile = profile_construct();
+        for (unsigned long i = 0; i < map->count; i++) {
+            const addrmap_entry_t *entry = &map->entries[i];
+            uint64_t count = counts[entry->address];
+            if (count > 0) profile_add(profile, map->files[entry->file], entry->line, count);
+        }
+        if (!profile_write(profile, profile_file)) {
+            fprintf(stderr, "Could not write profile '%s'.\n", profile_file);
+            written = false;
+        }
+        profile_destruct(profile);
+    }
+    free(counts);
+    cpu_destruct(cpu);
+    return written;
+}
+
+static void usage(void) {
+    fprintf(stderr, "USAGE: gemu [--handlers | --rom] [--profile FILE] [--mix FILE] [--decode FILE] MICROCODE PROGRAM "
+                    "[PROGRAM.map]\n");
+    fprintf(stderr, "       gemu --check --decode FILE MICROCODE\n");
+}
+
+/**
+ * Checks the microcode against the instruction set, and reports each opcode.
+ * @return Whether every opcode with a path through the microcode does what the instruction set says.
+ */
+static bool check(const char *microcode_file, const char *decode_file) {
+    mcrom_t *microcode = mcrom_read(microcode_file);
+    if (microcode == NULL) {
+        fprintf(stderr, "Could not load microcode '%s', which must be a ROM container written by mcasm.\n",
+                microcode_file);
+        return false;
+    }
+    FILE *decode_rom = fopen(decode_file, "rb");
+    state_t decode[ISA_OPCODE_COUNT];
+    unsigned bits = decode_rom != NULL ? load_decode_rom(decode_rom, decode) : 0;
+    if (decode_rom != NULL) fclose(decode_rom);
+    if (bits != microcode->address_bits) {
+        fprintf(stderr, "Could not read decode ROM '%s' with the %u bit state addresses of the microcode.\n",
+                decode_file, microcode->address_bits);
+        mcrom_destruct(microcode);
+        return false;
+    }
+
+    printf("Checking the microcode against the instruction set:\n");
+    unsigned differ = check_microcode(microcode, decode, stdout);
+    mcrom_destruct(microcode);
+    return differ == 0;
+}
+
 int main(int argc, char **argv) {
 
+    // Options come before the files
+    const char *profile_file = NULL, *mix_file = NULL, *decode_file = NULL;
+    bool handlers = false, rom = false, checking = false;
+    int arg = 1;
+    for (; arg + 1 < argc; arg++) {
+        if (!strcmp(argv[arg], "--handlers")) {
+            handlers = true;
+        } else if (!strcmp(argv[arg], "--rom")) {
+            rom = true;
+        } else if (!strcmp(argv[arg], "--check")) {
+            checking = true;
+        } else if (!strcmp(argv[arg], "--profile")) {
+            profile_file = argv[++arg];
+        } else if (!strcmp(argv[arg], "--mix")) {
+            mix_file = argv[++arg];
+        } else if (!strcmp(argv[arg], "--decode")) {
+            decode_file = argv[++arg];
+        } else {
+            break;
+        }
+    }
+
+    // Check the microcode, which needs no program
+    int files = argc - arg;
+    if (checking) {
+        if (files != 1 || decode_file == NULL) {
+            fprintf(stderr, "Checking the microcode needs its decode ROM, and no program.\n");
+            usage();
+            return EXIT_FAILURE;
+        }
+        return check(argv[arg], decode_file) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Get program to run
-    if (argc != 3) {
+    if (files != 2 && files != 3) {
         fprintf(stderr, "You must provide microcode for the processor and an input program file.\n");
+        usage();
         return EXIT_FAILURE;
     }
+    if (rom && decode_file == NULL) {
+        fprintf(stderr, "Running the microcode ROM needs its decode ROM.\n");
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (profile_file != NULL && files != 3) {
+        fprintf(stderr, "A profile needs the address map of the program, to name the statement at each address.\n");
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // Address map written by gassemble --listing, which ties addresses back to the source
+    addrmap_t *map = NULL;
+    if (files == 3) {
+        map = addrmap_read(argv[arg + 2]);
+        if (map == NULL) {
+            fprintf(stderr, "Could not read address map '%s'.\n", argv[arg + 2]);
+            return EXIT_FAILURE;
+        }
+    }
 
-    // Open microcode
-    FILE *microcode = fopen(argv[1], "rb");
+    // Load microcode, once, into a table of its words
+    mcrom_t *microcode = mcrom_read(argv[arg]);
     if (microcode == NULL) {
-        fprintf(stderr, "Could not open microcode file '%s'\n", argv[1]);
+        fprintf(stderr, "Could not load microcode '%s', which must be a ROM container written by mcasm.\n", argv[arg]);
         return EXIT_FAILURE;
     }
 
     // Open program
-    FILE *program = fopen(argv[2], "rb");
+    FILE *program = fopen(argv[arg + 1], "rb");
     if (program == NULL) {
-        fprintf(stderr, "Could not open program file '%s'.\n", argv[2]);
+        fprintf(stderr, "Could not open program file '%s'.\n", argv[arg + 1]);
         return EXIT_FAILURE;
     }
 
-    // Display program
-    while (!feof(program) && !ferror(program)) {
-        uint16_t word = fetch_word(program, pc);
-        printf("%04x\n", word);
-        pc++;
+    // Load program
+    fseek(program, 0, SEEK_END);
+    unsigned long length = ftell(program) / sizeof(word_t);
+    word_t *memory = malloc(sizeof(word_t) * (length + 1));
+    for (unsigned long i = 0; i < length; i++)
+        memory[i] = fetch_word(program, i);
+
+    if (rom) {
+        FILE *decode_rom = fopen(decode_file, "rb");
+        unsigned bits = decode_rom != NULL ? load_decode_rom(decode_rom, rom_decode) : 0;
+        if (decode_rom != NULL) fclose(decode_rom);
+        if (bits != microcode->address_bits) {
+            fprintf(stderr, "Could not read decode ROM '%s' with the %u bit state addresses of the microcode.\n",
+                    decode_file, microcode->address_bits);
+            return EXIT_FAILURE;
+        }
+        rom_microcode = microcode;
+    }
+
+    if (handlers || rom || profile_file != NULL || mix_file != NULL) {
+        CpuStatus (*step)(Cpu *) = rom ? _step_rom : handlers ? cpu_step_microcode : cpu_step;
+        bool written = run(step, memory, length, map, profile_file, mix_file);
+        mcrom_destruct(microcode);
+        fclose(program);
+        free(memory);
+        if (map != NULL) addrmap_destruct(map);
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Display program, disassembled from its entry point at address 0
+    disasm_t *disasm = disasm_construct(memory, length);
+    disasm_entry(disasm, 0, NULL);
+    disasm_analyze(disasm);
+    for (pc = 0; pc < length; pc++) {
+        char text[64];
+        disasm_format(disasm, pc, text, sizeof(text));
+        const char *label = disasm_label_at(disasm, pc);
+        if (label != NULL) printf("%s\n", label);
+
+        const addrmap_entry_t *source = map != NULL ? addrmap_lookup(map, pc) : NULL;
+        if (source != NULL) {
+            printf("  %04x  %04x  %-24s  %s:%u:%u\n", pc, memory[pc], text, map->files[source->file], source->line,
+                   source->col);
+        } else {
+            printf("  %04x  %04x  %s\n", pc, memory[pc], text);
+        }
+    }
+    disasm_destruct(disasm);
+
+    // Display the state each opcode begins at
+    if (decode_file != NULL) {
+        FILE *decode_rom = fopen(decode_file, "rb");
+        state_t decode[ISA_OPCODE_COUNT];
+        unsigned bits = decode_rom != NULL ? load_decode_rom(decode_rom, decode) : 0;
+        if (decode_rom != NULL) fclose(decode_rom);
+        if (bits == 0) {
+            fprintf(stderr, "Could not read decode ROM '%s'.\n", decode_file);
+        } else {
+            printf("Decode ROM, with %u bit state addresses:\n", bits);
+            for (unsigned op = 0; op < ISA_OPCODE_COUNT; op++) {
+                if (ISA[op].mnemonic != NULL) printf("  %02x  %-4s  %03x\n", op, ISA[op].mnemonic, decode[op]);
+            }
+        }
     }
 
-    uint8_t addr = 0;
-    while (!feof(microcode) && !ferror(microcode)) {
-        uint64_t signals = fetch_signals(microcode, addr);
-        printf("%016llx\n", signals);
-        addr++;
+    // Display the microcode, whose words hold the next state address in their lowest bits
+    printf("Microcode, with %u bit state addresses:\n", microcode->address_bits);
+    for (state_t addr = 0; addr < microcode->count; addr++) {
+        signals_t signals = fetch_signals(microcode, addr);
+        signals_t next = signals & ((1u << microcode->address_bits) - 1);
+        printf("  %03x  %016" PRIx64 "  %03" PRIx64 "\n", addr, signals, next);
     }
 
     // Close stream when done
-    fclose(microcode);
+    mcrom_destruct(microcode);
     fclose(program);
+    free(memory);
+    if (map != NULL) addrmap_destruct(map);
 
     return EXIT_SUCCESS;
 }
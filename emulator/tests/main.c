@@ -1,7 +1,15 @@
+#include "../../common/addrmap.h"
+#include "../../common/disasm.h"
+#include "../../common/mix.h"
+#include "../../common/signals.h"
+#include "../src/check.h"
 #include "../src/components.h"
+#include "../src/cpu.h"
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 static void test_alu_add(void) {
     // TODO revisit when carry and overflow are added
@@ -186,6 +194,367 @@ static void test_alu_ror(void) {
     assert(flags == 0);
 }
 
+static void test_load_decode_rom(void) {
+    // Twelve bit entries, packed big-endian, so each pair of opcodes takes three bytes
+    FILE *rom = tmpfile();
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT; op += 2) {
+        unsigned first = 0x100 + op, second = 0xA00 + op + 1;
+        fputc(first >> 4, rom);
+        fputc((first & 0xF) << 4 | second >> 8, rom);
+        fputc(second & 0xFF, rom);
+    }
+    state_t decode[ISA_OPCODE_COUNT];
+    assert(load_decode_rom(rom, decode) == 12);
+    assert(decode[0] == 0x100 && decode[1] == 0xA01 && decode[30] == 0x11E && decode[31] == 0xA1F);
+
+    // Entries one byte each, and a size no width gives
+    rewind(rom);
+    assert(ftruncate(fileno(rom), ISA_OPCODE_COUNT) == 0);
+    assert(load_decode_rom(rom, decode) == 8 && decode[0] == 0x10 && decode[1] == 0x0A);
+    fputc(0, rom);
+    assert(load_decode_rom(rom, decode) == 0);
+    fclose(rom);
+}
+
+static void test_addrmap_lookup(void) {
+    addrmap_t *map = addrmap_construct();
+    unsigned file = addrmap_add_file(map, "program.gasm");
+    addrmap_add(map, 0, file, 3, 1);
+    addrmap_add(map, 1, file, 4, 5);
+    addrmap_add(map, 2, file, 4, 5); // Same statement, so it extends the entry before it
+    addrmap_add(map, 3, file, 7, 5);
+    assert(map->count == 3);
+
+    assert(addrmap_lookup(map, 0)->line == 3);
+    assert(addrmap_lookup(map, 2)->line == 4);
+    assert(addrmap_lookup(map, 2)->col == 5);
+    assert(addrmap_lookup(map, 3)->line == 7);
+    assert(addrmap_lookup(map, 0xFFFF)->line == 7);
+    addrmap_destruct(map);
+
+    map = addrmap_construct();
+    assert(addrmap_lookup(map, 0) == NULL);
+    addrmap_destruct(map);
+}
+
+static void test_addrmap_round_trip(void) {
+    const char *path = "test_addrmap.map";
+    addrmap_t *map = addrmap_construct();
+    addrmap_add_file(map, "a.gasm");
+    addrmap_add(map, 0, 0, 1, 1);
+    addrmap_add(map, 0x10, 0, 70000, 12);
+    assert(addrmap_write(map, path));
+    addrmap_destruct(map);
+
+    map = addrmap_read(path);
+    remove(path);
+    assert(map != NULL);
+    assert(map->file_count == 1 && !strcmp(map->files[0], "a.gasm"));
+    assert(map->count == 2);
+    assert(addrmap_lookup(map, 0x0F)->line == 1);
+    assert(addrmap_lookup(map, 0x10)->line == 70000);
+    assert(addrmap_lookup(map, 0x10)->col == 12);
+    addrmap_destruct(map);
+
+    assert(addrmap_read("does_not_exist.map") == NULL);
+}
+
+static void test_mix_round_trip(void) {
+    const char *path = "test_mix.mix";
+    mix_t mix = {{0}, {0}};
+    mix.executed[OP_ADD] = 3;
+    mix.executed[OP_Bcc] = 10;
+    mix.not_taken[OP_Bcc] = 4;
+    assert(mix_write(&mix, path));
+
+    mix_t read;
+    assert(mix_read(&read, path));
+    remove(path);
+    assert(!memcmp(&read, &mix, sizeof(mix_t)));
+
+    FILE *fptr = fopen(path, "w");
+    fputs("$0f 1 2\n", fptr); // More branches not taken than executed
+    fclose(fptr);
+    assert(!mix_read(&read, path));
+    remove(path);
+    assert(!mix_read(&read, "does_not_exist.mix"));
+}
+
+static void test_mcrom_round_trip(void) {
+    const char *path = "test_mcrom.o";
+    const uint64_t words[] = {0x8000000000000001, 0x0123456789abcd00, 0};
+    assert(mcrom_write(words, 3, 12, path));
+
+    mcrom_t *rom = mcrom_read(path);
+    assert(rom != NULL && rom->address_bits == 12 && rom->count == 3);
+    assert(!memcmp(rom->words, words, sizeof(words)));
+    assert((uintptr_t)rom->words % MCROM_ALIGNMENT == 0);
+    assert(fetch_signals(rom, 1) == words[1] && fetch_signals(rom, 3) == 0);
+    mcrom_destruct(rom);
+
+    FILE *fptr = fopen(path, "r+b");
+    fseek(fptr, 5, SEEK_SET);
+    fputc(MCROM_VERSION + 1, fptr); // A version this reader does not know
+    fclose(fptr);
+    assert(mcrom_read(path) == NULL);
+
+    fptr = fopen(path, "wb");
+    fputs("GMCR", fptr); // Cut short in the header
+    fclose(fptr);
+    assert(mcrom_read(path) == NULL);
+    remove(path);
+    assert(mcrom_read("does_not_exist.o") == NULL);
+}
+
+static void test_isa_decode(void) {
+    isa_insn_t insn = isa_decode(0x6b60); // STR R1, [R2, R3]
+    assert(insn.opcode == OP_STR);
+    assert(insn.fields[FieldRd] == 1 && insn.fields[FieldRx] == 2 && insn.fields[FieldRy] == 3);
+
+    insn = isa_decode(0x78fe); // BNE #-2
+    assert(insn.opcode == OP_Bcc && insn.fields[FieldCond] == COND_NE);
+    assert(isa_immediate(&insn) == -2);
+
+    insn = isa_decode(0x45a5); // LSR R3, R1, #5
+    assert(insn.opcode == OP_SHIFT_IMM && insn.fields[FieldMode] == 0x2);
+    assert(insn.fields[FieldRd] == 3 && insn.fields[FieldRx] == 1 && isa_immediate(&insn) == 5);
+}
+
+static void test_isa_round_trip(void) {
+    // Every word of every opcode decodes into fields which encode back into the same word, apart from unused bits
+    for (uint32_t word = 0; word <= 0xFFFF; word++) {
+        isa_insn_t insn = isa_decode(word);
+        uint16_t used = 0xF800;
+        for (unsigned field = 0; field < ISA_FIELD_COUNT; field++)
+            used |= isa_field_mask(insn.opcode, field);
+        assert(isa_encode(&insn) == (word & used));
+    }
+}
+
+static void test_isa_format(void) {
+    char text[32];
+    isa_format(0xeb04, text, sizeof(text));
+    assert(!strcmp(text, "STR R1, [R2, #4]"));
+    isa_format(0xff7a, text, sizeof(text));
+    assert(!strcmp(text, "BL #-6"));
+    isa_format(0x0088, text, sizeof(text));
+    assert(!strcmp(text, "PUSH {R0, PC}"));
+    isa_format(0x5800, text, sizeof(text));
+    assert(!strcmp(text, "DCD 0x5800"));
+    assert(isa_cycles(0x78fe, false) == 5 && isa_cycles(0x78fe, true) == 7);
+    assert(isa_cycles(0x7f7e, false) == 7); // B on AL is always taken
+}
+
+static void test_disasm_table(void) {
+    const disasm_word_t *table = disasm_table();
+    assert(table[0x7f07].flags & DISASM_BRANCH && !(table[0x7f07].flags & DISASM_CONTINUES)); // B #7
+    assert(table[0x78fe].flags & DISASM_CONTINUES && table[0x78fe].offset == -2);            // BNE #-2
+    assert(table[0x61ff].flags & DISASM_REFERENCE && table[0x61ff].offset == -1);            // LDR R0, [#-1]
+    assert(!(table[0x8088].flags & DISASM_CONTINUES));                                      // POP {R0, PC}
+    assert(!(table[0x5800].flags & DISASM_VALID));                                          // Reserved opcode
+    assert(!(table[0x0801].flags & DISASM_VALID));                                          // ADD with unused bits set
+}
+
+static void test_disasm_image(void) {
+    const uint16_t words[] = {
+        0x7f02, // B L_0002
+        0x1234, // D_0001, never reached
+        0x61ff, // LDR R0, [D_0001]
+        0x8088, // POP {R0, PC}
+        0xca01, // MOV R1, #1, never reached so data
+    };
+    disasm_t *disasm = disasm_construct(words, 5);
+    disasm_entry(disasm, 0, "start");
+    disasm_analyze(disasm);
+
+    assert(disasm->kinds[0] == DisasmCode && disasm->kinds[1] == DisasmUnknown);
+    assert(disasm->kinds[3] == DisasmCode && disasm->kinds[4] == DisasmUnknown);
+    assert(!strcmp(disasm_label_at(disasm, 0), "start"));
+    assert(!strcmp(disasm_label_at(disasm, 1), "D_0001"));
+    assert(!strcmp(disasm_label_at(disasm, 2), "L_0002"));
+    assert(disasm_label_at(disasm, 3) == NULL);
+
+    char text[64];
+    disasm_format(disasm, 0, text, sizeof(text));
+    assert(!strcmp(text, "B L_0002"));
+    disasm_format(disasm, 2, text, sizeof(text));
+    assert(!strcmp(text, "LDR R0, [D_0001]"));
+    disasm_format(disasm, 4, text, sizeof(text));
+    assert(!strcmp(text, "DCD 0xca01"));
+    disasm_destruct(disasm);
+}
+
+static void test_condition_holds(void) {
+    assert(condition_holds(COND_EQ, FLAG_ZERO) && !condition_holds(COND_NE, FLAG_ZERO));
+    assert(condition_holds(COND_HS, FLAG_CARRY) && condition_holds(COND_LO, 0));
+    assert(condition_holds(COND_HI, FLAG_CARRY) && !condition_holds(COND_HI, FLAG_CARRY | FLAG_ZERO));
+    assert(condition_holds(COND_LT, FLAG_NEGATIVE) && condition_holds(COND_GE, FLAG_NEGATIVE | FLAG_OVERFLOW));
+    assert(condition_holds(COND_LE, FLAG_ZERO) && !condition_holds(COND_GT, FLAG_ZERO));
+    assert(condition_holds(COND_AL, 0));
+}
+
+/* Sums five numbers into memory, which runs 31 instructions in 208 cycles */
+static const word_t SUM_PROGRAM[] = {
+    0x7f07,                                 // B Main
+    0x0000, 0x0001, 0x0002, 0x0003, 0x000a, // nums
+    0x0000,                                 // sum
+    0xd9fa,                                 // Main LEA R0, nums
+    0xca01,                                 // MOV R1, #1
+    0xce00,                                 // MOV R3, #0
+    0xd205,                                 // Loop CMP R1, #5
+    0x7905,                                 // BHS Done
+    0x7420,                                 // LDR R2, [R0, R1]
+    0x0fc0,                                 // ADD R3, R3, R2
+    0x8a81,                                 // ADD R1, R1, #1
+    0x7f7b,                                 // B Loop
+    0xe7f6,                                 // Done STR R3, [sum]
+    0xffff,                                 // Not an instruction
+};
+
+static void test_cpu_sum(void) {
+    Cpu *cpu = cpu_construct(SUM_PROGRAM, sizeof(SUM_PROGRAM) / sizeof(word_t));
+    CpuStatus status;
+    while ((status = cpu_step(cpu)) == CPU_RUNNING)
+        ;
+    assert(status == CPU_ILLEGAL && cpu->registers[REG_PC] == 0x11);
+    assert(cpu->memory[6] == 16 && cpu->registers[REG_R1] == 5);
+    assert(cpu->flags & FLAG_CARRY);
+    assert(cpu->instructions == 31 && cpu->cycles == 208);
+    cpu_destruct(cpu);
+}
+
+static void test_cpu_stack(void) {
+    // A branch lengthened by the assembler, through the stack
+    const word_t program[] = {
+        0xc807, // MOV R0, #7
+        0x0080, // PUSH {R0}
+        0xd803, // LEA R0, #3
+        0x0080, // PUSH {R0}
+        0x8088, // POP {R0, PC}
+        0x7f00, // B #0
+    };
+    Cpu *cpu = cpu_construct(program, sizeof(program) / sizeof(word_t));
+    CpuStatus status;
+    while ((status = cpu_step(cpu)) == CPU_RUNNING)
+        ;
+    assert(status == CPU_HALTED && cpu->registers[REG_PC] == 5);
+    assert(cpu->registers[REG_R0] == 7 && cpu->registers[REG_SP] == 0);
+    assert(cpu->memory[0xFFFF] == 7 && cpu->memory[0xFFFE] == 5);
+    cpu_destruct(cpu);
+}
+
+static void test_cpu_relaxed(void) {
+    // A BEQ and a BL which gassemble lengthened to reach labels over 64 words away. The routine returns through LR, and
+    // R0 and the flags are kept, while the words below SP are used: two for the BEQ and three for the BL.
+    word_t program[0xB2] = {
+        [0x00] = 0xc807, // start MOV R0, #7
+        [0x01] = 0xd007, // CMP R0, #7
+        [0x02] = 0x7885, // BEQ far, as BNE #5
+        [0x03] = 0x0080, //   PUSH {R0}
+        [0x04] = 0xd854, //   LEA R0, far
+        [0x05] = 0x0080, //   PUSH {R0}
+        [0x06] = 0x8088, //   POP {R0, PC}
+        [0x07] = 0x7f79, // B start
+        [0x58] = 0x0080, // far BL routine, as PUSH {R0}
+        [0x59] = 0xd856, //   LEA R0, routine
+        [0x5a] = 0x0080, //   PUSH {R0}
+        [0x5b] = 0xd803, //   LEA R0, done
+        [0x5c] = 0x0080, //   PUSH {R0}
+        [0x5d] = 0x808a, //   POP {R0, PC, LR}
+        [0x5e] = 0x7f00, // done B done
+        [0xaf] = 0x4a00, // routine MOV R1, R0
+        [0xb0] = 0x0002, // PUSH {LR}
+        [0xb1] = 0x8008, // POP {PC}
+    };
+    Cpu *cpu = cpu_construct(program, sizeof(program) / sizeof(word_t));
+    CpuStatus status;
+    while ((status = cpu_step(cpu)) == CPU_RUNNING)
+        ;
+    assert(status == CPU_HALTED && cpu->registers[REG_PC] == 0x5e);
+    assert(cpu->registers[REG_R0] == 7 && cpu->registers[REG_R1] == 7 && cpu->registers[REG_LR] == 0x5e);
+    assert(cpu->registers[REG_SP] == 0 && (cpu->flags & FLAG_ZERO));
+    assert(cpu->memory[0xFFFE] == 0xaf && cpu->memory[0xFFFD] == 0x5e);
+    cpu_destruct(cpu);
+}
+
+static void test_cpu_microcode(void) {
+    // The handlers generated from the microcode take the same cycles, and agree with the instruction set
+    Cpu *isa = cpu_construct(SUM_PROGRAM, sizeof(SUM_PROGRAM) / sizeof(word_t));
+    Cpu *microcode = cpu_construct(SUM_PROGRAM, sizeof(SUM_PROGRAM) / sizeof(word_t));
+    CpuStatus status;
+    while ((status = cpu_step(isa)) == CPU_RUNNING)
+        assert(cpu_step_microcode(microcode) == CPU_RUNNING);
+    assert(cpu_step_microcode(microcode) == status);
+    assert(!memcmp(isa->registers, microcode->registers, sizeof(isa->registers)));
+    assert(!memcmp(isa->memory, microcode->memory, sizeof(isa->memory)));
+    assert(isa->flags == microcode->flags);
+    assert(microcode->instructions == 31 && microcode->cycles == 208);
+    cpu_destruct(isa);
+    cpu_destruct(microcode);
+
+    // BL links the address after it, and a failed condition leaves early
+    const word_t program[] = {
+        0xf882, // BLNE #2
+        0x7f00, // B #0
+        0x7f00, // B #0
+    };
+    Cpu *cpu = cpu_construct(program, sizeof(program) / sizeof(word_t));
+    cpu->flags = FLAG_ZERO;
+    assert(cpu_step_microcode(cpu) == CPU_RUNNING && cpu->registers[REG_PC] == 1 && cpu->cycles == 5);
+    cpu->flags = 0;
+    cpu->registers[REG_PC] = 0;
+    assert(cpu_step_microcode(cpu) == CPU_RUNNING && cpu->registers[REG_PC] == 2 && cpu->registers[REG_LR] == 1);
+    assert(cpu_step_microcode(cpu) == CPU_HALTED && cpu->cycles == 5 + 8 + 7);
+    cpu_destruct(cpu);
+}
+
+/** A signal's bit in a microcode word with 8 bit state addresses */
+#define S(signal) ((signals_t)1 << (SIGNAL_##signal + 8))
+
+static void test_cpu_rom(void) {
+    // Fetch and decode, and the path of register ALU operations
+    uint64_t words[] = {
+        S(PCOE) | S(REGR) | S(MARCE) | S(T1CE) | S(ANOP) | 1,
+        S(MAROE) | S(IBREAD) | S(MDRCE) | S(T1OE) | S(COE) | S(AADD) | S(T2CE) | 2,
+        S(IRCE) | S(MDROE) | S(MDRGET) | S(ANOP) | 3,
+        S(PCOE) | S(REGW) | S(T2OE),
+        S(RX) | S(REGR) | S(T1CE) | S(ANOP) | 5,
+        S(RY) | S(REGR) | S(T1OE) | S(AOP) | S(T2CE) | S(FRCE) | 6,
+        S(RD) | S(REGW) | S(T2OE) | S(ANOP),
+    };
+    mcrom_t microcode = {8, sizeof(words) / sizeof(words[0]), words};
+    state_t decode[ISA_OPCODE_COUNT] = {[OP_ADD] = 4, [OP_SUB] = 4};
+
+    const word_t program[] = {
+        0x0b60, // ADD R1, R2, R3
+        0x1360, // SUB R1, R2, R3
+    };
+    Cpu *cpu = cpu_construct(program, sizeof(program) / sizeof(word_t));
+    cpu->registers[REG_R2] = 5;
+    cpu->registers[REG_R3] = 3;
+    assert(cpu_step_rom(cpu, &microcode, decode) == CPU_RUNNING && cpu->registers[REG_R1] == 8 && cpu->cycles == 7);
+    assert(cpu_step_rom(cpu, &microcode, decode) == CPU_RUNNING && cpu->registers[REG_R1] == 2);
+    assert(cpu->registers[REG_PC] == 2 && cpu->instructions == 2 && cpu->cycles == 14);
+    cpu_destruct(cpu);
+
+    // Opcodes without a path are left out, and a path which adds whatever the opcode is differs for SUB
+    assert(check_microcode(&microcode, decode, NULL) == 0);
+    words[5] = (words[5] & ~S(AOP)) | S(AADD);
+    assert(check_microcode(&microcode, decode, NULL) == 1);
+    words[5] = (words[5] & ~S(AADD)) | S(AOP);
+
+    // The last state prefetches, so the next instruction goes on from f1 and takes a cycle less
+    words[6] |= S(PCF) | 1;
+    assert(check_microcode(&microcode, decode, NULL) == 0);
+    cpu = cpu_construct(program, sizeof(program) / sizeof(word_t));
+    cpu->registers[REG_R2] = 5;
+    cpu->registers[REG_R3] = 3;
+    assert(cpu_step_rom(cpu, &microcode, decode) == CPU_RUNNING && cpu->cycles == 7);
+    assert(cpu->state == 1 && cpu->mar == 1 && cpu->t1 == 1);
+    assert(cpu_step_rom(cpu, &microcode, decode) == CPU_RUNNING && cpu->registers[REG_R1] == 2 && cpu->cycles == 13);
+    cpu_destruct(cpu);
+}
+
 int main(void) {
 
     puts("Running tests...");
@@ -205,5 +574,33 @@ int main(void) {
     test_alu_ror();
     test_alu_noop();
 
+    /* MICROCODE TESTS */
+    test_load_decode_rom();
+    test_mcrom_round_trip();
+
+    /* ADDRESS MAP TESTS */
+    test_addrmap_lookup();
+    test_addrmap_round_trip();
+
+    /* INSTRUCTION MIX TESTS */
+    test_mix_round_trip();
+
+    /* INSTRUCTION SET TESTS */
+    test_isa_decode();
+    test_isa_round_trip();
+    test_isa_format();
+
+    /* DISASSEMBLER TESTS */
+    test_disasm_table();
+    test_disasm_image();
+
+    /* PROCESSOR TESTS */
+    test_condition_holds();
+    test_cpu_sum();
+    test_cpu_stack();
+    test_cpu_relaxed();
+    test_cpu_microcode();
+    test_cpu_rom();
+
     return 0;
 }
@@ -0,0 +1,189 @@
+/* Implements the linker which combines gol-16 relocatable objects into a flat memory image. */
+#include "linker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *OBJ_FILE_SUFFIX = ".o";
+
+static void link_error(const char *file_path, const char *err_msg, const char *name) {
+    fprintf(stderr, "%s: error: %s\n\tSymbol: '%s'\n", file_path, err_msg, name);
+}
+
+/* File type verification */
+static bool _is_obj_file(const char *file_path) {
+    size_t len = strlen(file_path);
+    const char *cur = &file_path[len]; // End of string
+
+    // Continue backwards until suffix start or string start
+    while (*cur != '.' && cur != file_path) {
+        cur--;
+    }
+    return !strcmp(cur, OBJ_FILE_SUFFIX);
+}
+
+Linker *linker_construct(object_t **objects, unsigned object_count) {
+    Linker *linker = malloc(sizeof(Linker));
+    linker->objects = objects;
+    linker->object_count = object_count;
+    linker->bases = malloc(sizeof(unsigned long *) * object_count);
+    for (unsigned i = 0; i < object_count; i++)
+        linker->bases[i] = calloc(objects[i]->section_count + 1, sizeof(unsigned long));
+    linker->exports = NULL;
+    linker->export_count = 0;
+    linker->image = NULL;
+    linker->length = 0;
+    return linker;
+}
+
+void linker_destruct(Linker *linker) {
+    for (unsigned i = 0; i < linker->object_count; i++)
+        free(linker->bases[i]);
+    free(linker->bases);
+    free(linker->exports);
+    free(linker->image);
+    free(linker);
+}
+
+/* Sections with the same name are gathered together, in the order their names first appear on the command line. Within
+ * a name, sections keep the order of their objects.
+ */
+static bool _linker_layout(Linker *linker) {
+    unsigned long address = 0;
+
+    for (unsigned o = 0; o < linker->object_count; o++) {
+        for (unsigned s = 0; s < linker->objects[o]->section_count; s++) {
+            const char *name = linker->objects[o]->sections[s].name;
+
+            // Skip names which were already placed by an earlier section
+            bool placed = false;
+            for (unsigned po = 0; po <= o && !placed; po++) {
+                unsigned limit = po == o ? s : linker->objects[po]->section_count;
+                for (unsigned ps = 0; ps < limit && !placed; ps++)
+                    placed = !strcmp(linker->objects[po]->sections[ps].name, name);
+            }
+            if (placed) continue;
+
+            // Place every section with this name
+            for (unsigned lo = o; lo < linker->object_count; lo++) {
+                for (unsigned ls = lo == o ? s : 0; ls < linker->objects[lo]->section_count; ls++) {
+                    if (strcmp(linker->objects[lo]->sections[ls].name, name)) continue;
+                    linker->bases[lo][ls] = address;
+                    address += linker->objects[lo]->sections[ls].length;
+                }
+            }
+        }
+    }
+
+    if (address > IMAGE_MAX_LENGTH) {
+        fprintf(stderr, "error: linked image of %lu words exceeds the %d word address space.\n", address,
+                IMAGE_MAX_LENGTH);
+        return false;
+    }
+
+    linker->length = address;
+    linker->image = malloc(sizeof(uint16_t) * (address + 1));
+    for (unsigned o = 0; o < linker->object_count; o++) {
+        for (unsigned s = 0; s < linker->objects[o]->section_count; s++) {
+            obj_section_t *section = &linker->objects[o]->sections[s];
+            memcpy(&linker->image[linker->bases[o][s]], section->words, sizeof(uint16_t) * section->length);
+        }
+    }
+    return true;
+}
+
+static int _symbol_cmp(const void *a, const void *b) {
+    return strcmp(((const link_symbol_t *)a)->name, ((const link_symbol_t *)b)->name);
+}
+
+/* Collects every exported symbol at its final address, sorted by name for lookup. */
+static bool _linker_collect_exports(Linker *linker) {
+    unsigned count = 0;
+    for (unsigned o = 0; o < linker->object_count; o++)
+        for (unsigned i = 0; i < linker->objects[o]->symbol_count; i++)
+            count += linker->objects[o]->symbols[i].binding == BindGlobal;
+
+    linker->exports = malloc(sizeof(link_symbol_t) * (count + 1));
+    for (unsigned o = 0; o < linker->object_count; o++) {
+        object_t *obj = linker->objects[o];
+        for (unsigned i = 0; i < obj->symbol_count; i++) {
+            obj_symbol_t *sym = &obj->symbols[i];
+            if (sym->binding != BindGlobal) continue;
+            link_symbol_t *export = &linker->exports[linker->export_count++];
+            export->name = sym->name;
+            export->address = linker->bases[o][sym->section] + sym->value;
+            export->owner = obj;
+        }
+    }
+    qsort(linker->exports, linker->export_count, sizeof(link_symbol_t), _symbol_cmp);
+
+    for (unsigned i = 1; i < linker->export_count; i++) {
+        if (!strcmp(linker->exports[i - 1].name, linker->exports[i].name)) {
+            link_error(linker->exports[i].owner->file_path, "Symbol is also exported by", linker->exports[i].name);
+            fprintf(stderr, "\tFirst definition: %s\n", linker->exports[i - 1].owner->file_path);
+            return false;
+        }
+    }
+    return true;
+}
+
+static link_symbol_t *_linker_find_export(Linker *linker, const char *name) {
+    link_symbol_t key = {name, 0, NULL};
+    return bsearch(&key, linker->exports, linker->export_count, sizeof(link_symbol_t), _symbol_cmp);
+}
+
+/* Fills in every field which the assembler left for the linker. */
+static bool _linker_relocate(Linker *linker) {
+    bool success = true;
+
+    for (unsigned o = 0; o < linker->object_count; o++) {
+        object_t *obj = linker->objects[o];
+        for (unsigned r = 0; r < obj->relocation_count; r++) {
+            obj_reloc_t *reloc = &obj->relocations[r];
+            obj_symbol_t *sym = &obj->symbols[reloc->symbol];
+
+            unsigned long target;
+            if (sym->binding == BindImport) {
+                link_symbol_t *export = _linker_find_export(linker, sym->name);
+                if (export == NULL) {
+                    link_error(obj->file_path, "Undefined symbol.", sym->name);
+                    success = false;
+                    continue;
+                }
+                target = export->address;
+            } else {
+                target = linker->bases[o][sym->section] + sym->value;
+            }
+
+            unsigned long place = linker->bases[o][reloc->section] + reloc->offset;
+            if (!reloc_in_range(reloc->type, target, place)) {
+                link_error(obj->file_path, "Relocated field is out of range.", sym->name);
+                success = false;
+                continue;
+            }
+
+            uint16_t mask = reloc_mask(reloc->type);
+            linker->image[place] = (linker->image[place] & ~mask) | reloc_value(reloc->type, target, place);
+        }
+    }
+    return success;
+}
+
+/* Lays out all sections, resolves symbols and applies relocations. Errors are reported as they are found. */
+bool linker_link(Linker *linker) {
+    if (!_linker_layout(linker)) return false;
+    if (!_linker_collect_exports(linker)) return false;
+    return _linker_relocate(linker);
+}
+
+/* Writes the linked image as raw big-endian words, the same format as a flat image from the assembler. */
+bool linker_write_image(Linker *linker, const char *file_path) {
+    if (!_is_obj_file(file_path)) return false;
+
+    FILE *fptr = fopen(file_path, "wb");
+    if (fptr == NULL) return false;
+
+    bool success = object_write_words(fptr, linker->image, linker->length);
+    success &= fclose(fptr) == 0;
+    return success;
+}
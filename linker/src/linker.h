@@ -0,0 +1,34 @@
+/* Defines the linker which combines gol-16 relocatable objects into a flat memory image. */
+#ifndef _LINKER_H_
+#define _LINKER_H_
+#include "../../common/object.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Memory is addressed by word, so an image can hold at most 64K words */
+#define IMAGE_MAX_LENGTH 0x10000
+
+/* Exported symbol, at its final address */
+typedef struct LinkSymbol {
+    const char *name;
+    unsigned long address;
+    const object_t *owner;
+} link_symbol_t;
+
+typedef struct Linker {
+    object_t **objects;
+    unsigned object_count;
+    unsigned long **bases; // Final address of every section, per object
+    link_symbol_t *exports;
+    unsigned export_count;
+    uint16_t *image;
+    unsigned long length;
+} Linker;
+
+Linker *linker_construct(object_t **objects, unsigned object_count);
+void linker_destruct(Linker *linker);
+
+bool linker_link(Linker *linker);
+bool linker_write_image(Linker *linker, const char *file_path);
+
+#endif // _LINKER_H_
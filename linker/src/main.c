@@ -0,0 +1,65 @@
+/* A linker for gol-16 relocatable objects (glink) */
+#include "../../common/object.h"
+#include "linker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *DEFAULT_OUT_FILE = "a.o";
+
+static void usage(void) { puts("USAGE: glink [-o OUTPUT.o] INPUT.o..."); }
+
+int main(int argc, char *argv[]) {
+
+    const char *out_file = DEFAULT_OUT_FILE;
+    object_t **objects = malloc(sizeof(object_t *) * argc);
+    unsigned object_count = 0;
+    int status = EXIT_FAILURE;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o")) {
+            if (++i == argc) {
+                usage();
+                goto cleanup;
+            }
+            out_file = argv[i];
+            continue;
+        }
+
+        objects[object_count] = object_read(argv[i]);
+        if (objects[object_count] == NULL) {
+            fprintf(stderr, "Could not read %s: ensure it is a relocatable object from 'gassemble -c'.\n", argv[i]);
+            goto cleanup;
+        }
+        object_count++;
+    }
+
+    if (object_count == 0) {
+        usage();
+        goto cleanup;
+    }
+
+    // Never overwrite an input with the image
+    for (unsigned i = 0; i < object_count; i++) {
+        if (!strcmp(objects[i]->file_path, out_file)) {
+            fprintf(stderr, "Output file %s is also an input.\n", out_file);
+            goto cleanup;
+        }
+    }
+
+    Linker *linker = linker_construct(objects, object_count);
+    if (linker_link(linker)) {
+        if (linker_write_image(linker, out_file)) {
+            status = EXIT_SUCCESS;
+        } else {
+            fprintf(stderr, "Could not write to file %s. Ensure that file is of type '.o'.\n", out_file);
+        }
+    }
+    linker_destruct(linker);
+
+cleanup:
+    for (unsigned i = 0; i < object_count; i++)
+        object_destruct(objects[i]);
+    free(objects);
+    return status;
+}
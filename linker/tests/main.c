@@ -0,0 +1,62 @@
+#include "../../common/object.h"
+#include "../src/linker.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Relocatable objects assembled by gassemble -c, which its own tests check */
+#define OBJECTS "../assembler/tests/test_programs/"
+
+static void test_link_call(void) {
+    object_t *objects[] = {object_read(OBJECTS "reloc_main_h.o"), object_read(OBJECTS "reloc_lib_h.o")};
+    assert(objects[0] != NULL && objects[1] != NULL);
+
+    // Both text sections come first, then the data of reloc_lib
+    Linker *linker = linker_construct(objects, 2);
+    assert(linker_link(linker));
+    const uint16_t image[] = {0x6204, 0xf080, 0xff03, 0x7f7d, 0x0008, 0x1e00, 0x0002, 0x8008, 0x0003};
+    assert(linker->length == sizeof(image) / sizeof(image[0]));
+    assert(!memcmp(linker->image, image, sizeof(image)));
+    assert((linker->image[2] & 0x7F) == 3); // The extern BL reaches Square at 5
+    assert(linker->image[4] == 0x0008);      // The LDR = literal holds the address of value
+
+    linker_destruct(linker);
+    object_destruct(objects[0]);
+    object_destruct(objects[1]);
+}
+
+static void test_link_undefined(void) {
+    object_t *objects[] = {object_read(OBJECTS "reloc_main_h.o")};
+    assert(objects[0] != NULL);
+
+    // Square and value are declared with .extern, but nothing exports them
+    Linker *linker = linker_construct(objects, 1);
+    assert(!linker_link(linker));
+
+    linker_destruct(linker);
+    object_destruct(objects[0]);
+}
+
+static void test_link_duplicate(void) {
+    object_t *objects[] = {object_read(OBJECTS "reloc_main_h.o"), object_read(OBJECTS "reloc_lib_h.o"),
+                           object_read(OBJECTS "reloc_lib_h.o")};
+    assert(objects[0] != NULL && objects[1] != NULL && objects[2] != NULL);
+
+    // Square and value are exported twice
+    Linker *linker = linker_construct(objects, 3);
+    assert(!linker_link(linker));
+
+    linker_destruct(linker);
+    for (unsigned i = 0; i < 3; i++)
+        object_destruct(objects[i]);
+}
+
+int main(void) {
+    printf("Running tests...\n");
+
+    test_link_call();
+    test_link_undefined();
+    test_link_duplicate();
+    return 0;
+}
@@ -0,0 +1,395 @@
+/* Implements the generation of emulator handlers from the microcode. */
+#include "handlers.h"
+#include "../../common/isa.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Most effects one state can have: a write to each temporary, a register, memory and the condition test */
+#define MAX_EFFECTS 8
+
+/* Temporary registers of the datapath, which are written by fetch before any instruction reads them */
+typedef enum Temp { TempT1, TempT2, TempMar, TempMdr, TempIr, TEMP_COUNT } temp_t;
+static const char *TEMP_NAMES[TEMP_COUNT] = {"t1", "t2", "mar", "mdr", "ir"};
+#define READS(temp) (1u << (temp))
+
+/* Effects which write no temporary: a statement on the registers, flags or memory, and the failed condition */
+#define DEST_STATEMENT -1
+#define DEST_EXIT -2
+
+/* ALU operations of the emulator, indexed by the low bits of the opcode, which aop passes to the ALU */
+static const char *ALU_OPERATIONS[] = {
+    "ALU_NOOP", "ALU_ADD", "ALU_SUB", "ALU_MUL", "ALU_DIV", "ALU_AND", "ALU_OR",
+    "ALU_NOT",  "ALU_LSL", "ALU_RB",  "ALU_LSR", "ALU_ROL", "ALU_ROR",
+};
+
+/* Signals which drive the bus with a value of their own, and the value */
+static const struct {
+    const char *signal;
+    const char *value;
+    unsigned reads;
+} BUS_DRIVERS[] = {
+    {"t2oe", "t2", READS(TempT2)},
+    {"coe", "1", 0},
+    {"ui4", "(word_t)(ir & 0xF)", READS(TempIr)},
+    {"ui7", "(word_t)(ir & 0x7F)", READS(TempIr)},
+    {"ui9", "(word_t)(ir & 0x1FF)", READS(TempIr)},
+    {"si7", "(word_t)(((ir & 0x7F) ^ 0x40) - 0x40)", READS(TempIr)},
+    {"si9", "(word_t)(((ir & 0x1FF) ^ 0x100) - 0x100)", READS(TempIr)},
+};
+
+/* Signals which select the register read or written through the bus, and the register */
+static const struct {
+    const char *signal;
+    const char *reg;
+    unsigned reads;
+} SELECTORS[] = {
+    {"rd", "r[(ir >> 9) & 3]", READS(TempIr)},
+    {"rx", "r[(ir >> 7) & 3]", READS(TempIr)},
+    {"ry", "r[(ir >> 5) & 3]", READS(TempIr)},
+    {"srd", "r[(ir >> 7) & 3]", READS(TempIr)},
+    {"srx", "r[(ir >> 5) & 3]", READS(TempIr)},
+    {"sry", "r[(ir >> 3) & 3]", READS(TempIr)},
+    {"pcoe", "r[REG_PC]", 0},
+    {"spoe", "r[REG_SP]", 0},
+    {"lroe", "r[REG_LR]", 0},
+};
+
+/* What a state does in its cycle */
+typedef struct Effect {
+    int dest;       // Temporary written, or DEST_STATEMENT or DEST_EXIT
+    bool always;    // Whether the value is worked out even if the temporary is never read, for what else it does
+    bool assigned;  // Whether the temporary is read before it is written again, so the value is written to it
+    bool kept;      // Whether the handler works it out at all
+    unsigned reads; // Temporaries read, as READS bits
+    char text[128]; // Value written to the temporary, or the whole statement
+} effect_t;
+
+/* An opcode's path from fetch to the next fetch, with the effects of each state on it */
+typedef struct Handler {
+    unsigned *states;
+    unsigned length;
+    effect_t *effects; // MAX_EFFECTS for each state on the path
+    unsigned *counts;  // Effects of each state on the path
+    unsigned skipped;  // States of the next fetch done by the last state, which prefetches
+    unsigned removed;  // Effects left out, since their results are never used
+    unsigned used;     // Temporaries the handler uses, as READS bits
+} handler_t;
+
+static void fail(const char *state, const char *problem) {
+    printf("Could not generate handlers: state '%s' %s.\n", state, problem);
+    exit(EXIT_FAILURE);
+}
+
+static bool has(signal_bf_t code, const char *signal) {
+    signal_bf_t field = 0;
+    signal_field(signal, &field);
+    return code & field;
+}
+
+__attribute__((format(printf, 6, 7))) static void add_effect(effect_t *effects, unsigned *count, int dest, bool always,
+                                                            unsigned reads, const char *format, ...) {
+    effect_t *effect = &effects[(*count)++];
+    *effect = (effect_t){dest, always, true, true, reads, ""};
+    va_list args;
+    va_start(args, format);
+    vsnprintf(effect->text, sizeof(effect->text), format, args);
+    va_end(args);
+}
+
+/* Works out the effects of a state in an opcode's path, which has taken cycles once it is done, counting an ALU
+ * operation whose result nothing latches as removed. Returns their count.
+ */
+static unsigned state_effects(const mcode_t *microcode, unsigned state, unsigned opcode, unsigned cycles,
+                              effect_t *effects, unsigned *removed) {
+    const char *name = microcode->names[state];
+    signal_bf_t code = microcode->code[state];
+    unsigned count = 0;
+
+    // The register read or written through the bus
+    const char *reg = NULL;
+    unsigned reg_reads = 0, selectors = 0;
+    for (unsigned i = 0; i < sizeof(SELECTORS) / sizeof(SELECTORS[0]); i++) {
+        if (!has(code, SELECTORS[i].signal)) continue;
+        reg = SELECTORS[i].reg;
+        reg_reads = SELECTORS[i].reads;
+        selectors++;
+    }
+    bool regr = has(code, "regr"), regw = has(code, "regw");
+    if (selectors > 1) fail(name, "selects more than one register");
+    if ((regr || regw) && reg == NULL) fail(name, "reads or writes a register without selecting one");
+    if (regr && regw) fail(name, "both reads and writes a register through the bus");
+
+    // The value on the bus
+    const char *bus = NULL;
+    unsigned bus_reads = 0, drivers = 0;
+    for (unsigned i = 0; i < sizeof(BUS_DRIVERS) / sizeof(BUS_DRIVERS[0]); i++) {
+        if (!has(code, BUS_DRIVERS[i].signal)) continue;
+        bus = BUS_DRIVERS[i].value;
+        bus_reads = BUS_DRIVERS[i].reads;
+        drivers++;
+    }
+    if (regr) {
+        bus = reg;
+        bus_reads = reg_reads;
+        drivers++;
+    }
+    if (has(code, "mdroe") && has(code, "mdrget")) {
+        bus = "mdr";
+        bus_reads = READS(TempMdr);
+        drivers++;
+    }
+    if (drivers > 1) fail(name, "drives the bus from more than one source");
+
+    // The ALU, whose inputs are t1 (or zero) and the bus
+    const char *operation = NULL;
+    unsigned operations = 0, operation_reads = 0;
+    if (has(code, "aadd")) operation = "ALU_ADD", operations++;
+    if (has(code, "asub")) operation = "ALU_SUB", operations++;
+    if (has(code, "anop")) operation = "ALU_NOOP", operations++;
+    if (has(code, "aop")) {
+        if ((opcode & 0xF) >= sizeof(ALU_OPERATIONS) / sizeof(ALU_OPERATIONS[0]))
+            fail(name, "passes an opcode to the ALU which is not an ALU operation");
+        operation = ALU_OPERATIONS[opcode & 0xF];
+        operations++;
+    }
+    if (has(code, "ashift")) operation = "ALU_SHIFTS[(ir >> 9) & 3]", operation_reads = READS(TempIr), operations++;
+    if (operations > 1) fail(name, "selects more than one ALU operation");
+    if (operation == NULL) operation = "ALU_NOOP";
+
+    bool t2ce = has(code, "t2ce"), frce = has(code, "frce"), mdrce = has(code, "mdrce");
+    bool reads_bus = has(code, "t1ce") || has(code, "marce") || has(code, "irce") || regw || t2ce || frce ||
+                     (mdrce && has(code, "mdrput"));
+    if (reads_bus && bus == NULL) fail(name, "reads the bus, which nothing drives");
+    if (has(code, "ibread") && has(code, "ibwrite")) fail(name, "both reads and writes memory");
+    if (frce && has(code, "ctest")) fail(name, "tests a condition on the flags it writes");
+
+    const char *a = has(code, "t1oe") ? "t1" : "0";
+    unsigned alu_reads = (has(code, "t1oe") ? READS(TempT1) : 0) | bus_reads | operation_reads;
+    if (frce && t2ce) {
+        add_effect(effects, &count, TempT2, true, alu_reads, "cpu_alu(cpu, %s, %s, %s)", operation, a, bus);
+    } else if (frce) {
+        add_effect(effects, &count, DEST_STATEMENT, true, alu_reads, "cpu_alu(cpu, %s, %s, %s);", operation, a, bus);
+    } else if (t2ce) {
+        add_effect(effects, &count, TempT2, false, alu_reads, "alu(%s, %s, %s, &alu_flags)", operation, a, bus);
+    } else if (operations > 0) {
+        (*removed)++;
+    }
+    if (has(code, "t1ce")) add_effect(effects, &count, TempT1, false, bus_reads, "%s", bus);
+    if (has(code, "marce")) add_effect(effects, &count, TempMar, false, bus_reads, "%s", bus);
+
+    // Prefetching latches PC as the state began, which a register written in the same state must not be
+    if (has(code, "pcf")) {
+        if (has(code, "t1ce") || has(code, "marce")) fail(name, "latches t1 or mar from both the bus and PC");
+        if (regw && has(code, "pcoe")) fail(name, "prefetches from PC as it writes PC");
+        add_effect(effects, &count, TempT1, false, 0, "r[REG_PC]");
+        add_effect(effects, &count, TempMar, false, 0, "r[REG_PC]");
+    }
+    if (has(code, "irce")) add_effect(effects, &count, TempIr, false, bus_reads, "%s", bus);
+    if (mdrce && has(code, "ibread")) {
+        add_effect(effects, &count, TempMdr, false, READS(TempMar), "cpu->memory[mar]");
+    } else if (mdrce && has(code, "mdrput")) {
+        add_effect(effects, &count, TempMdr, false, bus_reads, "%s", bus);
+    } else if (mdrce) {
+        fail(name, "loads mdr from neither memory nor the bus");
+    }
+    if (regw) add_effect(effects, &count, DEST_STATEMENT, true, reg_reads | bus_reads, "%s = %s;", reg, bus);
+    if (has(code, "ibwrite"))
+        add_effect(effects, &count, DEST_STATEMENT, true, READS(TempMar) | READS(TempMdr), "cpu->memory[mar] = mdr;");
+
+    // A condition which fails goes back to fetch once this state is done
+    if (has(code, "ctest")) {
+        add_effect(effects, &count, DEST_EXIT, true, READS(TempIr),
+                   "if (!condition_holds((ConditionCode)((ir >> 7) & 0xF), cpu->flags)) {\n"
+                   "        cpu->cycles += %u;\n"
+                   "        return;\n"
+                   "    }",
+                   cycles);
+    }
+    return count;
+}
+
+/* Finds an opcode's path through the microcode and what each state on it does, leaving out effects on temporaries
+ * which are never read. The path ends once it goes on to a state which fetches, and a state which prefetches has done
+ * the work of the states before that one: the handler starts from fetch anyway, but leaves their cycles to the next
+ * instruction. Returns false if the path never comes back to fetch.
+ */
+static bool build_handler(const mcode_t *microcode, unsigned opcode, handler_t *handler) {
+    unsigned limit = microcode->len + 1;
+    handler->states = malloc(sizeof(unsigned) * limit);
+    handler->length = 0;
+
+    // Fetch and decode, up to the state whose next state the decode ROM gives, and then the opcode's own states
+    unsigned state = 0;
+    for (; !microcode->decodes[state]; state = microcode->next[state]) {
+        if (handler->length == limit - 1) fail(microcode->names[0], "never reaches the decode ROM");
+        handler->states[handler->length++] = state;
+    }
+    handler->states[handler->length++] = state;
+    int position;
+    for (state = microcode->decode[opcode]; (position = microcode_fetch_position(microcode, state)) < 0;
+         state = microcode->decodes[state] ? microcode->decode[opcode] : microcode->next[state]) {
+        if (handler->length == limit) {
+            free(handler->states);
+            return false;
+        }
+        handler->states[handler->length++] = state;
+    }
+    handler->skipped = (unsigned)position;
+
+    handler->effects = malloc(sizeof(effect_t) * MAX_EFFECTS * handler->length);
+    handler->counts = malloc(sizeof(unsigned) * handler->length);
+    handler->removed = 0;
+    handler->used = 0;
+    for (unsigned i = 0; i < handler->length; i++) {
+        handler->counts[i] = state_effects(microcode, handler->states[i], opcode, i + 1,
+                                           &handler->effects[i * MAX_EFFECTS], &handler->removed);
+    }
+
+    // Nothing is live after the path, or after a failed condition, since the next fetch writes every temporary
+    unsigned live = 0;
+    for (unsigned i = handler->length; i-- > 0;) {
+        unsigned written = 0, read = 0;
+        for (unsigned e = 0; e < handler->counts[i]; e++) {
+            effect_t *effect = &handler->effects[i * MAX_EFFECTS + e];
+            if (effect->dest < 0) {
+                read |= effect->reads;
+                continue;
+            }
+            written |= READS(effect->dest);
+            effect->assigned = live & READS(effect->dest);
+            effect->kept = effect->assigned || effect->always;
+            if (effect->kept) read |= effect->reads;
+            if (effect->assigned) handler->used |= READS(effect->dest);
+            handler->removed += !effect->kept;
+        }
+        live = (live & ~written) | read;
+        handler->used |= read;
+    }
+    if (live != 0) {
+        for (unsigned temp = 0; temp < TEMP_COUNT; temp++) {
+            if (live & READS(temp)) printf("Could not generate handlers: %s is read before it is written.\n",
+                                           TEMP_NAMES[temp]);
+        }
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+static void free_handler(handler_t *handler) {
+    free(handler->states);
+    free(handler->effects);
+    free(handler->counts);
+}
+
+/* Writes the effects of one state. Statements on registers, flags and memory come first, since they read the values
+ * temporaries had before the state. A temporary is written once no other effect of the state reads it, and a failed
+ * condition leaves last.
+ */
+static void write_state(FILE *fptr, const mcode_t *microcode, unsigned state, const effect_t *effects,
+                        unsigned count) {
+    fprintf(fptr, "    // %s\n", microcode->names[state]);
+    bool done[MAX_EFFECTS] = {false};
+    for (unsigned e = 0; e < count; e++) {
+        done[e] = !effects[e].kept || effects[e].dest == DEST_STATEMENT;
+        if (effects[e].kept && done[e]) fprintf(fptr, "    %s\n", effects[e].text);
+    }
+
+    for (unsigned written = 1; written > 0;) {
+        written = 0;
+        for (unsigned e = 0; e < count; e++) {
+            if (done[e] || effects[e].dest < 0) continue;
+            bool read = false;
+            for (unsigned other = 0; other < count; other++)
+                read |= other != e && !done[other] && (effects[other].reads & READS(effects[e].dest));
+            if (read) continue;
+            if (effects[e].assigned) {
+                fprintf(fptr, "    %s = %s;\n", TEMP_NAMES[effects[e].dest], effects[e].text);
+            } else {
+                fprintf(fptr, "    %s;\n", effects[e].text);
+            }
+            done[e] = true;
+            written++;
+        }
+    }
+    for (unsigned e = 0; e < count; e++) {
+        if (done[e]) continue;
+        if (effects[e].dest != DEST_EXIT) fail(microcode->names[state], "reads and writes temporaries in a cycle");
+        fprintf(fptr, "    %s\n", effects[e].text);
+    }
+}
+
+/* Writes a handler for every opcode whose path comes back to fetch, and a table of them, as C for the emulator. */
+void write_handlers(const mcode_t *microcode, const char *source, const char *file_path) {
+    handler_t handlers[OPCODE_COUNT];
+    bool built[OPCODE_COUNT] = {false};
+    unsigned count = 0, removed = 0;
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (!microcode->decoded[op]) continue;
+        built[op] = build_handler(microcode, op, &handlers[op]);
+        if (!built[op]) {
+            printf("Opcode $%02x never returns to fetch, so it has no handler.\n", op);
+            continue;
+        }
+        count++;
+        removed += handlers[op].removed;
+    }
+
+    FILE *fptr = fopen(file_path, "w");
+    if (fptr == NULL) {
+        printf("Could not write to file '%s'.\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fptr, "/* Handlers for each opcode, generated by mcasm --handlers from %s. Do not edit; generate them\n"
+                  " * again with make handlers once the microcode changes.\n"
+                  " */\n"
+                  "#include \"handlers.h\"\n",
+            source);
+
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (!built[op]) continue;
+        const handler_t *handler = &handlers[op];
+        fprintf(fptr, "\n/* $%02x %s: ", op, ISA[op].mnemonic != NULL ? ISA[op].mnemonic : "");
+        for (unsigned i = 0; i < handler->length; i++)
+            fprintf(fptr, "%s%s", i > 0 ? ", " : "", microcode->names[handler->states[i]]);
+        fprintf(fptr, " (%u cycles) */\n", handler->length - handler->skipped);
+
+        fprintf(fptr, "static void _handle_%02x(Cpu *cpu) {\n", op);
+        fprintf(fptr, "    word_t *r = cpu->registers;\n");
+        if (handler->used) {
+            fprintf(fptr, "    word_t");
+            const char *separator = " ";
+            for (unsigned temp = 0; temp < TEMP_COUNT; temp++) {
+                if (!(handler->used & READS(temp))) continue;
+                fprintf(fptr, "%s%s", separator, TEMP_NAMES[temp]);
+                separator = ", ";
+            }
+            fprintf(fptr, ";\n");
+        }
+        bool flags = false;
+        for (unsigned i = 0; i < handler->length * MAX_EFFECTS; i++) {
+            const effect_t *effect = &handler->effects[i];
+            flags |= i % MAX_EFFECTS < handler->counts[i / MAX_EFFECTS] && effect->kept &&
+                     strstr(effect->text, "&alu_flags") != NULL;
+        }
+        // Only an ALU operation which writes the flag register keeps its flags
+        if (flags) fprintf(fptr, "    uint8_t alu_flags;\n");
+        for (unsigned i = 0; i < handler->length; i++)
+            write_state(fptr, microcode, handler->states[i], &handler->effects[i * MAX_EFFECTS], handler->counts[i]);
+        fprintf(fptr, "    cpu->cycles += %u;\n}\n", handler->length - handler->skipped);
+    }
+
+    fprintf(fptr, "\nconst Handler HANDLERS[ISA_OPCODE_COUNT] = {\n");
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (built[op]) fprintf(fptr, "    [0x%02x] = _handle_%02x,\n", op, op);
+    }
+    fprintf(fptr, "};\n");
+    fclose(fptr);
+
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (built[op]) free_handler(&handlers[op]);
+    }
+    printf("Wrote %u handlers to '%s', leaving out %u operations whose results are never used.\n", count, file_path,
+           removed);
+}
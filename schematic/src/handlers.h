@@ -0,0 +1,12 @@
+/* Generates C handlers for the emulator (gemu) from the microcode. Each opcode's handler is its path through the state
+ * machine, from fetch to the next fetch, unrolled into the datapath operations its states' signals cause. Temporary
+ * registers (t1, t2, mar, mdr and ir) hold nothing from one instruction to the next, so an operation which writes one
+ * whose value is never read is left out. A handler adds the cycles of its path, so it stays cycle accurate.
+ */
+#ifndef _HANDLERS_H_
+#define _HANDLERS_H_
+#include "microcode.h"
+
+void write_handlers(const mcode_t *microcode, const char *source, const char *file_path);
+
+#endif // _HANDLERS_H_
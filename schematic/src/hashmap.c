@@ -1,110 +1,94 @@
 /* Implements the hash map data structure for mapping state names to their signals, and signals to their values. */
 #include "hashmap.h"
-#include <math.h>
+#include "../../common/signals.h"
+#include "signal_hash.h" // Generated by make
 #include <stdlib.h>
 #include <string.h>
 
-static const char *VALID_SIGNALS[] = {
-    "t1oe", "t1ce", "t2oe", "t2ce",  "rd",    "rx",    "ry",    "ccoe",   "regw",   "regr",   "pcoe",    "spoe",
-    "lroe", "froe", "frce", "ui4",   "ui7",   "ui9",   "si7",   "si9",    "aadd",   "asub",   "anop",    "aop",
-    "coe",  "irce", "ctest", "marce", "maroe", "mdrce", "mdroe", "mdrput", "mdrget", "ibread", "ibwrite",
-};
-static const unsigned SIGNAL_COUNT = sizeof(VALID_SIGNALS) / sizeof(char *);
+/* Perfect hash of the signals: the top SIGNAL_SLOT_BITS of each signal's hash with SIGNAL_SEED are all different, so a
+ * signal is found with one hash and one comparison. SIGNAL_SLOTS holds the index of the signal in each slot, or -1. They
+ * are found by tools/signal_hash.c, which make runs again whenever the signals change.
+ */
+_Static_assert(SIGNAL_HASH_COUNT == SIGNAL_COUNT, "signal_hash.h is out of date, run make again");
+_Static_assert(SIGNAL_COUNT + STATE_ADDRESS_BITS <= sizeof(signal_bf_t) * 8, "Signals must fit in a microcode word");
 
-/* Internal hash function */
-static unsigned hash_fn(const char *name, unsigned table_len) {
-    unsigned value = 0;
-    while (*name++)
-        value += *name;
-    return value % table_len;
-}
+/* Most slots which may be full before the table grows, in quarters */
+#define MAX_LOAD_QUARTERS 3
 
-/* Creates a new hash map entry. */
-static hmap_entry_t *entry_construct(const char *name, signal_bf_t value, hmap_entry_t *next) {
-    hmap_entry_t *entry = malloc(sizeof(hmap_entry_t));
-    entry->name = name;
-    entry->value = value;
-    entry->next = next;
-    return entry;
+/* Finds the slot holding a name, or the empty slot where it would go. */
+static hmap_entry_t *find_slot(const hmap_t *hmap, const char *name, uint32_t hash) {
+    unsigned mask = hmap->__backing_len - 1;
+    for (unsigned index = hash & mask;; index = (index + 1) & mask) {
+        hmap_entry_t *entry = &hmap->entries[index];
+        if (entry->name == NULL || (entry->hash == hash && !strcmp(entry->name, name))) return entry;
+    }
 }
 
-/* Destroys hash map entry chain in sequence. */
-static void entry_destruct(hmap_entry_t *entry) {
-    if (entry == NULL) return;
-    for (hmap_entry_t *cur = entry; cur->next != NULL;) {
-        hmap_entry_t *next = cur->next;
-        free(cur);
-        cur = next;
+/* Doubles the table, placing every entry again. */
+static void grow(hmap_t *hmap) {
+    hmap_entry_t *old = hmap->entries;
+    unsigned old_len = hmap->__backing_len;
+    hmap->__backing_len *= 2;
+    hmap->entries = calloc(hmap->__backing_len, sizeof(hmap_entry_t));
+    for (unsigned i = 0; i < old_len; i++) {
+        if (old[i].name != NULL) *find_slot(hmap, old[i].name, old[i].hash) = old[i];
     }
+    free(old);
 }
 
-/* Creates a new hash map */
+/* Creates a new hash map with room for at least length entries before it grows */
 hmap_t *hmap_construct(unsigned length) {
     hmap_t *map = malloc(sizeof(hmap_t));
-    map->__backing_len = length;
+    map->__backing_len = 8;
+    while (map->__backing_len * MAX_LOAD_QUARTERS < length * 4)
+        map->__backing_len *= 2;
     map->key_count = 0;
-    map->entries = malloc(sizeof(hmap_entry_t) * length);
-    for (unsigned i = 0; i < length; i++) {
-        map->entries[i] = NULL; // Mark as empty
-    }
-    map->hash = hash_fn;
+    map->entries = calloc(map->__backing_len, sizeof(hmap_entry_t)); // All empty
     return map;
 }
 
 /* Destroys a hash map */
 void hmap_destruct(hmap_t *hmap) {
-    for (unsigned i = 0; i < hmap->__backing_len; i++)
-        entry_destruct(hmap->entries[i]);
+    free(hmap->entries);
     free(hmap);
 }
 
-/* Adds an entry to the hash map */
+/* Adds an entry to the hash map, or updates the value of a name it already has */
 void hmap_add_entry(hmap_t *hmap, const char *name, signal_bf_t value) {
-    unsigned index = hmap->hash(name, hmap->__backing_len);
-    hmap->key_count++;
-    hmap_entry_t *entry = hmap->entries[index];
-
-    // Assigned index is empty
-    if (entry == NULL) {
-        hmap->entries[index] = entry_construct(name, value, NULL);
+    uint32_t hash = hmap_hash(name, 0);
+    hmap_entry_t *entry = find_slot(hmap, name, hash);
+    if (entry->name != NULL) {
+        entry->value = value;
         return;
     }
 
-    // Check if name already exists
-    for (; strcmp(entry->name, name) && entry->next != NULL; entry = entry->next)
-        ;
-
-    if (entry->next == NULL) {
-        // Must add to chain
-        hmap_entry_t *new = entry_construct(name, value, hmap->entries[index]);
-        hmap->entries[index] = new;
-        return;
+    // Grow before the table gets too full for probes to stay short
+    if ((hmap->key_count + 1) * 4 > hmap->__backing_len * MAX_LOAD_QUARTERS) {
+        grow(hmap);
+        entry = find_slot(hmap, name, hash);
     }
-
-    // Name exists, update value
-    entry->value = value;
+    *entry = (hmap_entry_t){name, value, hash};
+    hmap->key_count++;
 }
 
 /* Gets an entry from the hash map */
 signal_bf_t *hmap_get(hmap_t *hmap, const char *name) {
-    hmap_entry_t *entry = hmap->entries[hmap->hash(name, hmap->__backing_len)];
-    if (entry == NULL) return NULL;
-
-    // Cycle through chain until key matches
-    for (; strcmp(entry->name, name) && entry->next != NULL; entry = entry->next)
-        ;
+    hmap_entry_t *entry = find_slot(hmap, name, hmap_hash(name, 0));
+    return entry->name != NULL ? &entry->value : NULL;
+}
 
-    if (!strcmp(entry->name, name)) return &entry->value;
-    return NULL;
+/* Looks up the bit of a signal in a microcode word. Returns false if it is not a valid signal. */
+bool signal_field(const char *name, signal_bf_t *field) {
+    int index = SIGNAL_SLOTS[hmap_hash(name, SIGNAL_SEED) >> (32 - SIGNAL_SLOT_BITS)];
+    if (index < 0 || strcmp(SIGNAL_NAMES[index], name)) return false;
+    *field = (signal_bf_t)1 << (index + STATE_ADDRESS_BITS); // LSBs reserved for next state address
+    return true;
 }
 
-/* Initializes a hash map of valid signals. */
-hmap_t *valid_signals(void) {
-    hmap_t *signals = hmap_construct(SIGNAL_COUNT / 2);
+/* Looks up the name of the signal at a bit of a microcode word. Returns NULL if no signal is there. */
+const char *signal_name(signal_bf_t field) {
     for (unsigned i = 0; i < SIGNAL_COUNT; i++) {
-        signal_bf_t field = powl(2, i);
-        field = field << STATE_ADDRESS_BITS; // LSBs reserved for next state address
-        hmap_add_entry(signals, VALID_SIGNALS[i], field);
+        if (field == (signal_bf_t)1 << (i + STATE_ADDRESS_BITS)) return SIGNAL_NAMES[i];
     }
-    return signals;
+    return NULL;
 }
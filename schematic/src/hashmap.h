@@ -1,32 +1,50 @@
 /* Defines the hash map data structure for mapping state names to their signals, and signals to their values. */
 #ifndef _HASHMAP_H_
 #define _HASHMAP_H_
+#include <stdbool.h>
 #include <stdint.h>
 
 // Subject to change if more signals are added
 #define signal_bf_t uint64_t
+
+// Bits of a next state address, and of each decode ROM entry, from 8 to 12 (make STATE_ADDRESS_BITS=N)
+#ifndef STATE_ADDRESS_BITS
 #define STATE_ADDRESS_BITS 8
+#endif
+#if STATE_ADDRESS_BITS < 8 || STATE_ADDRESS_BITS > 12
+#error "STATE_ADDRESS_BITS must be from 8 to 12"
+#endif
 
-/* Hash map entries (chained) */
+/* Hash map slots (open addressing, probed linearly) */
 typedef struct Entry {
-    const char *name;
+    const char *name; // NULL for an empty slot
     signal_bf_t value;
-    struct Entry *next;
+    uint32_t hash; // Of the name, kept so that probing and growing compare names only when their hashes match
 } hmap_entry_t;
 
 /* Hash map data structure */
 typedef struct StateHashmap {
-    unsigned __backing_len;
-    unsigned key_count;
-    hmap_entry_t **entries;
-    unsigned (*hash)(const char *, unsigned);
+    unsigned __backing_len; // Always a power of two
+    unsigned key_count;     // Distinct names in the map
+    hmap_entry_t *entries;
 } hmap_t;
 
+/* Hash function (32 bit FNV-1a, whose offset basis is mixed with a seed), shared with the signal hash generator */
+static inline uint32_t hmap_hash(const char *name, uint32_t seed) {
+    uint32_t value = 2166136261u ^ seed;
+    for (; *name; name++) {
+        value ^= (unsigned char)*name;
+        value *= 16777619u;
+    }
+    return value;
+}
+
 hmap_t *hmap_construct(unsigned length);
 void hmap_destruct(hmap_t *hmap);
 
 void hmap_add_entry(hmap_t *hmap, const char *name, signal_bf_t value);
 signal_bf_t *hmap_get(hmap_t *hmap, const char *name);
 
-hmap_t *valid_signals(void);
+bool signal_field(const char *name, signal_bf_t *field);
+const char *signal_name(signal_bf_t field) __attribute__((const));
 #endif // _HASHMAP_H_
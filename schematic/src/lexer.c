@@ -33,27 +33,19 @@ static bool is_microcode_file(const char *file_path) {
 static bool is_whitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
 
 /* Reads the next character */
-static void lexer_read_char(Lexer *lexer) { lexer->character = fgetc(lexer->stream); }
+static void lexer_read_char(Lexer *lexer) {
+    if (lexer->offset < lexer->length) lexer->offset++;
+    lexer->character = lexer->offset < lexer->length ? (unsigned char)lexer->buffer[lexer->offset] : EOF;
+}
 
 /* Detects if the lexer has hit the end of the file */
 bool lexer_finished(Lexer *lexer) { return lexer->character == EOF; }
 
-/* Grabs a slice of the file input. */
-static char *lexer_slice(Lexer *lexer, long start) {
-    size_t length = ftell(lexer->stream) - (start - 1);
-
-    // Store identifier
-    char *slice = malloc(length + 1);
-
-    fseek(lexer->stream, -length, SEEK_CUR); // Send file stream to start position of slice
-    fseek(lexer->stream, 0, SEEK_CUR);       // Reset stream (saw on StackOverflow lol)
-
-    fgets(slice, length, lexer->stream);
-    fseek(lexer->stream, 1, SEEK_CUR);
-    fseek(lexer->stream, 0, SEEK_CUR);
-
-    slice[length] = '\0'; // Add null terminator
-
+/* Copies the input from start up to end. */
+static char *lexer_slice(Lexer *lexer, size_t start, size_t end) {
+    char *slice = malloc(end - start + 1);
+    memcpy(slice, &lexer->buffer[start], end - start);
+    slice[end - start] = '\0';
     return slice;
 }
 
@@ -72,10 +64,10 @@ static token_t *lexer_read_ident(Lexer *lexer, bool ns) {
 
     if (ns) lexer_read_char(lexer); // Skip preceding #
 
-    long start = ftell(lexer->stream);
+    size_t start = lexer->offset;
     while (isalnum(lexer->character) || lexer->character == '_')
         lexer_read_char(lexer);
-    char *name = lexer_slice(lexer, start);
+    char *name = lexer_slice(lexer, start, lexer->offset);
 
     // Skip intermediate white space which is allowed
     while (lexer->character == ' ' || lexer->character == '\t' || lexer->character == '\r')
@@ -94,12 +86,13 @@ static token_t *lexer_read_ident(Lexer *lexer, bool ns) {
     return token_construct(NULL, TokenIllegal);
 }
 
-token_t *lexer_read_opcode(Lexer *lexer) {
+static token_t *lexer_read_opcode(Lexer *lexer) {
     lexer_read_char(lexer); // Skip preceding $
-    long start = ftell(lexer->stream);
+    size_t start = lexer->offset;
 
     while (isxdigit(lexer->character))
         lexer_read_char(lexer);
+    size_t end = lexer->offset;
 
     // Skip intermediate white space which is allowed
     while (lexer->character == ' ' || lexer->character == '\t' || lexer->character == '\r')
@@ -107,7 +100,7 @@ token_t *lexer_read_opcode(Lexer *lexer) {
 
     if (lexer->character == ',' || lexer->character == '\n' || lexer->character == ';') {
         if (lexer->character != ';') lexer_read_char(lexer);
-        return token_construct(lexer_slice(lexer, start), TokenOpcode);
+        return token_construct(lexer_slice(lexer, start, end), TokenOpcode);
     }
 
     return token_construct(NULL, TokenIllegal);
@@ -130,7 +123,9 @@ token_t *lexer_next_token(Lexer *lexer) {
     return token;
 }
 
-/* Creates a lexer, handling file errors. */
+/* Creates a lexer, handling file errors. The whole file is read into memory, so that tokens are copied straight out of
+ * it.
+ */
 Lexer *lexer_construct(const char *filepath) {
     if (!is_microcode_file(filepath)) {
         printf("Fatal: %s is not a gol-16 microcode (%s) file.\n", filepath, SUFFIX);
@@ -142,20 +137,26 @@ Lexer *lexer_construct(const char *filepath) {
         printf("Fatal: %s could not be read from.", filepath);
         exit(EXIT_FAILURE);
     }
+    fseek(fptr, 0, SEEK_END);
+    long size = ftell(fptr);
+    rewind(fptr);
+
     Lexer *lexer = malloc(sizeof(Lexer));
-    lexer->stream = fptr;
-    lexer_read_char(lexer); // Read first char
+    lexer->length = size > 0 ? (size_t)size : 0;
+    lexer->buffer = malloc(lexer->length + 1);
+    if (fread(lexer->buffer, 1, lexer->length, fptr) != lexer->length) {
+        printf("Fatal: %s could not be read from.", filepath);
+        exit(EXIT_FAILURE);
+    }
+    fclose(fptr);
+
+    lexer->offset = 0;
+    lexer->character = lexer->length > 0 ? (unsigned char)lexer->buffer[0] : EOF; // Read first char
     return lexer;
 }
 
 /* Frees a lexer. */
 void lexer_destruct(Lexer *lexer) {
-    fclose(lexer->stream);
+    free(lexer->buffer);
     free(lexer);
 }
-
-/* Resets the lexer to the file start. */
-void lexer_reset(Lexer *lexer) {
-    rewind(lexer->stream);
-    lexer_read_char(lexer);
-}
@@ -3,6 +3,7 @@
 #define _LEXER_H_
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Tokens */
 enum TokenType {
@@ -24,8 +25,10 @@ void token_destruct(token_t *token);
 
 /* Lexer */
 typedef struct Lexer {
-    FILE *stream;
-    char character;
+    char *buffer;  // The whole file
+    size_t length; // Bytes in buffer
+    size_t offset; // Of the current character
+    int character; // EOF once the buffer is used up
 } Lexer;
 
 Lexer *lexer_construct(const char *filepath);
@@ -33,5 +36,4 @@ void lexer_destruct(Lexer *lexer);
 
 token_t *lexer_next_token(Lexer *lexer);
 bool lexer_finished(Lexer *lexer);
-void lexer_reset(Lexer *lexer);
 #endif // _LEXER_H_
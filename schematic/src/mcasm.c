@@ -1,185 +1,335 @@
 /* Tool for assembling micro code into binary from a gol-16 microcode file */
+#include "../../common/isa.h"
+#include "../../common/mcrom.h"
+#include "../../common/mix.h"
+#include "handlers.h"
 #include "hashmap.h"
 #include "lexer.h"
+#include "microcode.h"
+#include "vertical.h"
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define OPCODE_COUNT 32
-static uint8_t DECODE_ROM[OPCODE_COUNT] = {0};
+/* A next state reference, resolved once every state has been seen */
+typedef struct Fixup {
+    unsigned state; // State which refers to the next state
+    char *name;     // Name of the next state
+} fixup_t;
 
-typedef struct MicroCode {
-    unsigned len;
-    signal_bf_t *code;
-} mcode_t;
-
-mcode_t *microcode_construct(unsigned len);
 void write_microcode(mcode_t *microcode, const char *file_path);
-void write_decode_rom(const char *file_path);
-void record_states(Lexer *lexer, hmap_t *states);
-void record_microcode(Lexer *lexer, mcode_t *microcode, hmap_t *states, hmap_t *signals);
+void write_decode_rom(mcode_t *microcode, const char *file_path);
+void write_vertical(const mcode_t *microcode, const char *rom_path, const char *fields_path);
+void assemble(Lexer *lexer, mcode_t *microcode, hmap_t *states);
+void report_cycles(const mcode_t *microcode, const char *mix_file);
+void write_cycles(const mcode_t *microcode, const char *source_path, const char *file_path);
+
+static void usage(void) {
+    puts("USAGE: mcasm [-O] [--cycles] [--mix FILE] [--vertical] [--handlers FILE.c] [--timing FILE.h] MICROCODE.gmc");
+}
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 2) {
+    // Options come before the file
+    bool minimize = false, cycles = false, vertical = false;
+    const char *mix_file = NULL, *handlers_file = NULL, *timing_file = NULL;
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (!strcmp(argv[arg], "-O")) {
+            minimize = true; // Minimize the state machine before it is written
+        } else if (!strcmp(argv[arg], "--cycles")) {
+            cycles = true;
+        } else if (!strcmp(argv[arg], "--mix") && arg + 1 < argc - 1) {
+            mix_file = argv[++arg];
+            cycles = true;
+        } else if (!strcmp(argv[arg], "--vertical")) {
+            vertical = true; // Also write the field-encoded ROM
+        } else if (!strcmp(argv[arg], "--handlers") && arg + 1 < argc - 1) {
+            handlers_file = argv[++arg]; // Written instead of the ROMs
+        } else if (!strcmp(argv[arg], "--timing") && arg + 1 < argc - 1) {
+            timing_file = argv[++arg]; // Written instead of the ROMs
+        } else {
+            break;
+        }
+    }
+    if (arg != argc - 1) {
         puts("Please provide a path to the micro-code file.");
+        usage();
         return EXIT_FAILURE;
     }
-    const char *file_path = argv[1];
+    const char *file_path = argv[arg];
     Lexer *lexer = lexer_construct(file_path);
 
-    hmap_t *signals = valid_signals(); // Signal lookup
-
-    // State lookup construction
-    hmap_t *states = hmap_construct(15);
-    record_states(lexer, states);
-
-    lexer_reset(lexer); // Reset for pass 2
-
-    // Create microcode
-    mcode_t *mcode = microcode_construct(states->key_count);
-    record_microcode(lexer, mcode, states, signals);
+    // State lookup, which grows with the states
+    hmap_t *states = hmap_construct(64);
+    mcode_t *mcode = microcode_construct();
+    assemble(lexer, mcode, states);
 
     // Clean up
     lexer_destruct(lexer);
-    hmap_destruct(signals);
     hmap_destruct(states);
 
-    // Write microcode file
-    write_microcode(mcode, "./mcode.o");
+    if (minimize) microcode_minimize(mcode);
+    if (mcode->len > 1u << STATE_ADDRESS_BITS) {
+        printf("Address count of %u exceeds state address bit limit of %d.\n", mcode->len, STATE_ADDRESS_BITS);
+        exit(EXIT_FAILURE);
+    }
+    if (cycles) report_cycles(mcode, mix_file);
 
-    // Write decode ROM file
-    write_decode_rom("./decode.o");
+    if (handlers_file != NULL || timing_file != NULL) {
+        if (handlers_file != NULL) write_handlers(mcode, file_path, handlers_file);
+        if (timing_file != NULL) write_cycles(mcode, file_path, timing_file);
+    } else {
+        // Write microcode file
+        write_microcode(mcode, "./mcode.o");
 
-    free(mcode);
+        // Write decode ROM file
+        write_decode_rom(mcode, "./decode.o");
+
+        if (vertical) write_vertical(mcode, "./vmcode.o", "./vmcode.fields");
+    }
+
+    microcode_destruct(mcode);
     puts("Success!");
     return EXIT_SUCCESS;
 }
 
-/* Allocate microcode buffer. */
-mcode_t *microcode_construct(unsigned len) {
-    mcode_t *mcode = malloc(sizeof(mcode_t));
-    mcode->code = malloc(sizeof(signal_bf_t) * len);
-    mcode->len = len;
-    for (unsigned i = 0; i < len; i++)
-        mcode->code[i] = 0;
-    return mcode;
-}
-
-/* Write microcode buffer to output file. */
+/* Writes the microcode ROM container, with a word for each state. */
 void write_microcode(mcode_t *microcode, const char *file_path) {
-    FILE *fptr = fopen("./mcode.o", "wb");
-
-    if (fptr == NULL) {
+    signal_bf_t *words = malloc(sizeof(signal_bf_t) * (microcode->len + 1));
+    for (unsigned i = 0; i < microcode->len; i++)
+        words[i] = microcode_word(microcode, i);
+    if (!mcrom_write(words, microcode->len, STATE_ADDRESS_BITS, file_path)) {
         printf("Could not write to file '%s'.\n", file_path);
         exit(EXIT_FAILURE);
     }
-
-    // Write one byte at a time to preserve big-endianness
-    size_t signal_size = sizeof(signal_bf_t);
-    for (unsigned i = 0; i < microcode->len; i++) {
-        for (size_t b = 0; b < signal_size; b++) {
-            signal_bf_t mask = 0xFF;
-            unsigned shift_dist = (signal_size - b - 1) * 8;
-            mask = mask << shift_dist;
-            uint8_t byte_chunk = (microcode->code[i] & mask) >> shift_dist;
-            fwrite(&byte_chunk, 1, 1, fptr);
-        }
-    }
-    fclose(fptr);
+    free(words);
 }
 
-/* Writes decode ROM contents to a file. */
-void write_decode_rom(const char *file_path) {
+/* Writes decode ROM contents to a file: the state each opcode begins at, in STATE_ADDRESS_BITS, packed big-endian
+ * from opcode 0. Since there are 32 opcodes, the ROM is a whole 4 * STATE_ADDRESS_BITS bytes.
+ */
+void write_decode_rom(mcode_t *microcode, const char *file_path) {
     FILE *fptr = fopen(file_path, "wb");
     if (fptr == NULL) {
         printf("Could not write to file '%s'\n", file_path);
         exit(EXIT_FAILURE);
     }
 
-    // Find the lowest multiple of STATE_ADDRESS_BITS which forms an whole number of bytes
-    unsigned multiple = 1;
-    while ((multiple * STATE_ADDRESS_BITS) % 8 != 0)
-        multiple++;
-    // unsigned num_bytes = (multiple * STATE_ADDRESS_BITS) / 8; // Number of bytes required
-
-    // TODO make this dynamic based on STATE_ADDRESS_BITS instead of hard-coded for value 8
-    for (unsigned i = 0; i < OPCODE_COUNT; i++)
-        fwrite(&DECODE_ROM[i], 1, 1, fptr);
+    uint8_t rom[OPCODE_COUNT * STATE_ADDRESS_BITS / 8] = {0};
+    for (unsigned i = 0, bit = 0; i < OPCODE_COUNT; i++) {
+        for (unsigned b = STATE_ADDRESS_BITS; b-- > 0; bit++) {
+            if ((microcode->decode[i] >> b) & 1) rom[bit / 8] |= 0x80 >> (bit % 8);
+        }
+    }
+    fwrite(rom, 1, sizeof(rom), fptr);
     fclose(fptr);
 }
 
 /* Throw illegal token error. */
-void illegal_token(const char *val) {
-    printf("Illegal token '%s'\n", val);
-    exit(EXIT_FAILURE);
-}
+/* Writes the vertical microcode ROM and its decoder description. Both are read back, to check that every state decodes
+ * to the word the horizontal ROM holds.
+ */
+void write_vertical(const mcode_t *microcode, const char *rom_path, const char *fields_path) {
+    vertical_t vertical;
+    vertical_construct(&vertical, microcode);
+    unsigned bytes = vertical_bytes(&vertical);
+    size_t size = (size_t)bytes * microcode->len;
+    uint8_t *rom = malloc(size + 1);
+    for (unsigned i = 0; i < microcode->len; i++) {
+        uint64_t word = vertical_encode(&vertical, microcode_word(microcode, i));
+        for (unsigned b = 0; b < bytes; b++)
+            rom[i * bytes + b] = (uint8_t)(word >> ((bytes - b - 1) * 8));
+    }
 
-/* Stores defined states in a hash map. */
-void record_states(Lexer *lexer, hmap_t *states) {
+    FILE *fptr = fopen(rom_path, "wb");
+    if (fptr == NULL || fwrite(rom, 1, size, fptr) != size || fclose(fptr) != 0) {
+        printf("Could not write to file '%s'.\n", rom_path);
+        exit(EXIT_FAILURE);
+    }
+    if (!vertical_write(&vertical, fields_path)) {
+        printf("Could not write to file '%s'.\n", fields_path);
+        exit(EXIT_FAILURE);
+    }
 
-    signal_bf_t state_count = 0;
-    while (!lexer_finished(lexer)) {
-        token_t *token = lexer_next_token(lexer);
-        if (state_count >> STATE_ADDRESS_BITS != 0) {
-            printf("Address count of %lld exceeds state address bit limit of %d.\n", state_count, STATE_ADDRESS_BITS);
+    // Decode the ROM as read back with the fields as read back
+    vertical_t decoder;
+    fptr = fopen(rom_path, "rb");
+    bool read = fptr != NULL && fread(rom, 1, size + 1, fptr) == size;
+    if (fptr != NULL) fclose(fptr);
+    if (!read || !vertical_read(&decoder, fields_path)) {
+        printf("Could not read back '%s' and '%s'.\n", rom_path, fields_path);
+        exit(EXIT_FAILURE);
+    }
+    unsigned signals = 0;
+    for (unsigned f = 0; f < decoder.field_count; f++)
+        signals += decoder.fields[f].count;
+    for (unsigned i = 0; i < microcode->len; i++) {
+        uint64_t word = 0;
+        for (unsigned b = 0; b < bytes; b++)
+            word = word << 8 | rom[i * bytes + b];
+        if (vertical_decode(&decoder, word) != microcode_word(microcode, i)) {
+            printf("State '%s' does not decode from the vertical microcode to its word.\n", microcode->names[i]);
             exit(EXIT_FAILURE);
         }
-
-        if (token->type == TokenIllegal) illegal_token(token->name);
-
-        if (token->type == TokenState) {
-            hmap_add_entry(states, token->name, state_count++);
-            token->name = NULL; // Prevents name string from being freed later
-        }
-
-        token_destruct(token); // Free as we go
     }
+    free(rom);
+    printf("Encoded %u signals in %u fields, %u bits a word instead of %u: %zu bytes of ROM instead of %zu.\n", signals,
+           decoder.field_count, decoder.width, (unsigned)sizeof(signal_bf_t) * 8, size,
+           sizeof(signal_bf_t) * microcode->len);
 }
 
-/* Store the signals and next states within the code. */
-void record_microcode(Lexer *lexer, mcode_t *microcode, hmap_t *states, hmap_t *signals) {
+static void illegal_token(const char *val) {
+    printf("Illegal token '%s'\n", val);
+    exit(EXIT_FAILURE);
+}
 
-    signal_bf_t cur_state = -1;
+/* Stops on a token which must follow a state, but comes before any. */
+static void require_state(unsigned count, const token_t *token) {
+    if (count > 0) return;
+    printf("'%s' comes before the first state.\n", token->name);
+    exit(EXIT_FAILURE);
+}
 
-    while (!lexer_finished(lexer)) {
-        token_t *token = lexer_next_token(lexer);
+/* Assembles the signals and next states of every state in one pass. A next state may be defined after the state which
+ * refers to it, so its address is filled in once every state has been seen.
+ */
+void assemble(Lexer *lexer, mcode_t *microcode, hmap_t *states) {
+    fixup_t *fixups = NULL;
+    unsigned fixup_count = 0, fixup_capacity = 0;
+    unsigned cur_state = 0;
 
+    for (token_t *token = lexer_next_token(lexer); token->type != TokenEOF; token = lexer_next_token(lexer)) {
         switch (token->type) {
         case TokenIllegal:
             illegal_token(token->name);
+            break;
+        case TokenState:
+            if (hmap_get(states, token->name) != NULL) {
+                printf("State '%s' is defined more than once.\n", token->name);
+                exit(EXIT_FAILURE);
+            }
+            cur_state = microcode_add_state(microcode, token->name);
+            hmap_add_entry(states, token->name, cur_state);
+            token->name = NULL; // Now owned by the microcode
+            break;
         case TokenSignal: {
-            signal_bf_t *bitmask = hmap_get(signals, token->name);
-            if (bitmask == NULL) {
+            require_state(microcode->len, token);
+            signal_bf_t bitmask;
+            if (!signal_field(token->name, &bitmask)) {
                 printf("Invalid signal: '%s'\n", token->name);
                 exit(EXIT_FAILURE);
             }
-            microcode->code[cur_state] |= *bitmask;
+            microcode->code[cur_state] |= bitmask;
             break;
         }
-        case TokenState:
-            cur_state = *hmap_get(states, token->name);
-            break;
-        case TokenNS: {
-            signal_bf_t *bitmask = hmap_get(states, token->name);
-            if (bitmask == NULL) {
-                printf("Invalid state: '%s'\n", token->name);
-                return exit(EXIT_FAILURE);
+        case TokenNS:
+            require_state(microcode->len, token);
+            if (fixup_count == fixup_capacity) {
+                fixup_capacity = fixup_capacity == 0 ? 64 : fixup_capacity * 2;
+                fixups = realloc(fixups, sizeof(fixup_t) * fixup_capacity);
             }
-            microcode->code[cur_state] |= *bitmask;
+            fixups[fixup_count++] = (fixup_t){cur_state, token->name};
+            microcode->decodes[cur_state] = false;
+            token->name = NULL; // Now owned by the fixup
             break;
-        }
         case TokenOpcode: {
-            unsigned op = strtol(token->name, NULL, 16);
-            DECODE_ROM[op] = cur_state;
+            require_state(microcode->len, token);
+            unsigned long op = strtoul(token->name, NULL, 16);
+            if (op >= OPCODE_COUNT) {
+                printf("Opcode '$%s' is not below $%x.\n", token->name, OPCODE_COUNT);
+                exit(EXIT_FAILURE);
+            }
+            microcode->decode[op] = cur_state;
+            microcode->decoded[op] = true;
             break;
         }
         case TokenEOF:
-            return; // Token stream depleted
+            break;
         }
-
         token_destruct(token); // Delete as used
     }
+
+    for (unsigned i = 0; i < fixup_count; i++) {
+        signal_bf_t *address = hmap_get(states, fixups[i].name);
+        if (address == NULL) {
+            printf("Invalid state: '%s'\n", fixups[i].name);
+            exit(EXIT_FAILURE);
+        }
+        microcode->next[fixups[i].state] = *address;
+        free(fixups[i].name);
+    }
+    free(fixups);
+}
+
+/* Prints the states each opcode passes through, from one fetch to the next, and so its cycles. Given an instruction mix
+ * from gemu --mix, also prints the cycles per instruction of the mix.
+ */
+void report_cycles(const mcode_t *microcode, const char *mix_file) {
+    mix_t mix;
+    if (mix_file != NULL && !mix_read(&mix, mix_file)) {
+        printf("Could not read instruction mix '%s'.\n", mix_file);
+        exit(EXIT_FAILURE);
+    }
+
+    int fetch = microcode_path(microcode, 0, true);
+    printf("; States of each opcode from one fetch to the next, including %d to fetch and decode\n", fetch);
+    printf("; %-12s%-8s%-11s%s\n", "OPCODE", "TAKEN", "NOT TAKEN", "BEGINS AT");
+    uint64_t cycles = 0, instructions = 0;
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        uint64_t executed = mix_file != NULL ? mix.executed[op] : 0;
+        instructions += executed;
+        const char *mnemonic = ISA[op].mnemonic != NULL ? ISA[op].mnemonic : "";
+        if (!microcode->decoded[op]) {
+            if (executed > 0)
+                printf("$%02x %s ran %" PRIu64 " times, but has no states, so it is counted as no cycles.\n", op,
+                       mnemonic, executed);
+            continue;
+        }
+
+        unsigned state = microcode->decode[op], taken, not_taken;
+        if (!microcode_cycles(microcode, op, &taken, &not_taken)) {
+            printf("  $%02x %-8snever returns to fetch from '%s'\n", op, mnemonic, microcode->names[state]);
+            continue;
+        }
+        printf("  $%02x %-8s%-8u%-11u%s\n", op, mnemonic, taken, not_taken, microcode->names[state]);
+        if (mix_file != NULL) cycles += (executed - mix.not_taken[op]) * taken + mix.not_taken[op] * not_taken;
+    }
+
+    if (mix_file == NULL) return;
+    if (instructions == 0) {
+        printf("The instruction mix '%s' has no instructions.\n", mix_file);
+    } else {
+        printf("Weighted CPI of %s: %.3f, from %" PRIu64 " cycles over %" PRIu64 " instructions.\n", mix_file,
+               (double)cycles / (double)instructions, cycles, instructions);
+    }
+}
+
+/* Writes the cycles of each opcode as a C header, which every tool that counts cycles takes them from. */
+void write_cycles(const mcode_t *microcode, const char *source_path, const char *file_path) {
+    FILE *fptr = fopen(file_path, "w");
+    if (fptr == NULL) {
+        printf("Could not write to file '%s'.\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fptr, "/* Cycles of each opcode, generated by mcasm --timing from %s. Do not edit; generate them again with\n"
+                  " * make cycles in schematic once the microcode changes.\n"
+                  " */\n"
+                  "#ifndef _CYCLES_H_\n#define _CYCLES_H_\n\n"
+                  "/* X(opcode, cycles taken, cycles not taken) */\n"
+                  "#define ISA_CYCLES(X)",
+            source_path);
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        unsigned taken = 0, not_taken = 0;
+        if (microcode->decoded[op] && !microcode_cycles(microcode, op, &taken, &not_taken)) {
+            printf("Could not count the cycles of $%02x: its path never returns to fetch.\n", op);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(fptr, " \\\n    X(0x%02X, %u, %u)", op, taken, not_taken);
+    }
+    fprintf(fptr, "\n\n#endif // _CYCLES_H_\n");
+    fclose(fptr);
 }
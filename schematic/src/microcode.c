@@ -0,0 +1,218 @@
+/* Implements the microcode buffer, and minimization of the state machine it describes. */
+#include "microcode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Allocate microcode buffer, which grows as states are added. */
+mcode_t *microcode_construct(void) {
+    mcode_t *mcode = calloc(1, sizeof(mcode_t));
+    mcode->__capacity = 64;
+    mcode->code = malloc(sizeof(signal_bf_t) * mcode->__capacity);
+    mcode->next = malloc(sizeof(unsigned) * mcode->__capacity);
+    mcode->names = malloc(sizeof(char *) * mcode->__capacity);
+    mcode->decodes = malloc(sizeof(bool) * mcode->__capacity);
+    return mcode;
+}
+
+void microcode_destruct(mcode_t *microcode) {
+    for (unsigned i = 0; i < microcode->len; i++)
+        free(microcode->names[i]);
+    free(microcode->names);
+    free(microcode->code);
+    free(microcode->next);
+    free(microcode->decodes);
+    free(microcode);
+}
+
+/* Adds a state with no signals, taking its name. Until it is given a next state, the decode ROM gives it one. Returns
+ * its address.
+ */
+unsigned microcode_add_state(mcode_t *microcode, char *name) {
+    if (microcode->len == microcode->__capacity) {
+        microcode->__capacity *= 2;
+        microcode->code = realloc(microcode->code, sizeof(signal_bf_t) * microcode->__capacity);
+        microcode->next = realloc(microcode->next, sizeof(unsigned) * microcode->__capacity);
+        microcode->names = realloc(microcode->names, sizeof(char *) * microcode->__capacity);
+        microcode->decodes = realloc(microcode->decodes, sizeof(bool) * microcode->__capacity);
+    }
+    microcode->code[microcode->len] = 0;
+    microcode->next[microcode->len] = 0;
+    microcode->names[microcode->len] = name;
+    microcode->decodes[microcode->len] = true;
+    return microcode->len++;
+}
+
+/* Returns the word of a state in the microcode ROM. A state whose next state the decode ROM gives has zero there. */
+signal_bf_t microcode_word(const mcode_t *microcode, unsigned state) {
+    return microcode->code[state] | (microcode->decodes[state] ? 0 : microcode->next[state]);
+}
+
+/* A state's place in the partition, sorted to split the blocks of the partition */
+typedef struct StateKey {
+    signal_bf_t signals; // Its block, or its signals for the first partition
+    long next;           // Block of its next state, or -1 if the decode ROM gives it
+    unsigned state;
+} state_key_t;
+
+static int compare_keys(const void *a, const void *b) {
+    const state_key_t *x = a, *y = b;
+    if (x->signals != y->signals) return x->signals < y->signals ? -1 : 1;
+    if (x->next != y->next) return x->next < y->next ? -1 : 1;
+    return (x->state > y->state) - (x->state < y->state);
+}
+
+/* Numbers the blocks of sorted keys in order of their first state. Returns the number of blocks. */
+static unsigned number_blocks(const state_key_t *keys, unsigned count, unsigned *block) {
+    unsigned blocks = 0;
+    for (unsigned i = 0; i < count; i++) {
+        bool same = i > 0 && keys[i].signals == keys[i - 1].signals && keys[i].next == keys[i - 1].next;
+        if (!same) blocks++;
+        block[keys[i].state] = blocks - 1;
+    }
+    return blocks;
+}
+
+/* Marks the states which can run: fetch, every state which begins an opcode, and every state they go on to. */
+static unsigned mark_reachable(const mcode_t *microcode, bool *reachable) {
+    unsigned *work = malloc(sizeof(unsigned) * (microcode->len + OPCODE_COUNT + 1));
+    unsigned work_count = 0, count = 0;
+    work[work_count++] = 0; // Fetch, where the state machine starts
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (microcode->decoded[op]) work[work_count++] = microcode->decode[op];
+    }
+
+    while (work_count > 0) {
+        unsigned state = work[--work_count];
+        if (reachable[state]) continue;
+        reachable[state] = true;
+        count++;
+        if (!microcode->decodes[state]) work[work_count++] = microcode->next[state];
+    }
+    free(work);
+    return count;
+}
+
+/* Minimizes the state machine: states which can never run are removed, and states which assert the same signals and go
+ * on to equivalent states are merged, by splitting the states into blocks until every state in a block goes on to the
+ * same block. Fetch stays at address 0, and the states left keep their order. Reports what it saved.
+ */
+void microcode_minimize(mcode_t *microcode) {
+    unsigned len = microcode->len;
+    if (len == 0) return;
+    bool *reachable = calloc(len, sizeof(bool));
+    unsigned kept = mark_reachable(microcode, reachable);
+
+    state_key_t *keys = malloc(sizeof(state_key_t) * kept);
+    unsigned *block = malloc(sizeof(unsigned) * len);
+    unsigned count = 0;
+    for (unsigned s = 0; s < len; s++) {
+        if (!reachable[s]) {
+            printf("Removed state '%s', which can never run.\n", microcode->names[s]);
+            continue;
+        }
+        keys[count++] = (state_key_t){microcode->code[s], microcode->decodes[s] ? -1 : 0, s};
+    }
+    qsort(keys, kept, sizeof(state_key_t), compare_keys);
+    unsigned blocks = number_blocks(keys, kept, block);
+
+    // Split blocks by the block of the next state until none splits
+    for (unsigned previous = 0; blocks != previous;) {
+        previous = blocks;
+        for (unsigned i = 0; i < kept; i++) {
+            unsigned s = keys[i].state;
+            keys[i].signals = block[s];
+            keys[i].next = microcode->decodes[s] ? -1 : (long)block[microcode->next[s]];
+        }
+        qsort(keys, kept, sizeof(state_key_t), compare_keys);
+        blocks = number_blocks(keys, kept, block);
+    }
+
+    // Each block keeps its first state, at an address in the order of those states
+    unsigned *address = malloc(sizeof(unsigned) * blocks);
+    unsigned *first = malloc(sizeof(unsigned) * blocks);
+    for (unsigned b = 0; b < blocks; b++)
+        address[b] = len;
+    unsigned next_address = 0;
+    for (unsigned s = 0; s < len; s++) {
+        if (!reachable[s]) continue;
+        if (address[block[s]] == len) {
+            address[block[s]] = next_address++;
+            first[block[s]] = s;
+        } else {
+            printf("Merged state '%s' into '%s'.\n", microcode->names[s], microcode->names[first[block[s]]]);
+        }
+    }
+
+    for (unsigned s = 0, at = 0; s < len; s++) {
+        if (!reachable[s] || first[block[s]] != s) {
+            free(microcode->names[s]);
+            continue;
+        }
+        microcode->next[at] = microcode->decodes[s] ? 0 : address[block[microcode->next[s]]];
+        microcode->code[at] = microcode->code[s];
+        microcode->names[at] = microcode->names[s];
+        microcode->decodes[at++] = microcode->decodes[s];
+    }
+    for (unsigned op = 0; op < OPCODE_COUNT; op++) {
+        if (microcode->decoded[op]) microcode->decode[op] = address[block[microcode->decode[op]]];
+    }
+    microcode->len = next_address;
+
+    printf("Minimized %u states to %u, removing %u which can never run and merging %u.\n", len, next_address,
+           len - kept, kept - next_address);
+    free(reachable);
+    free(keys);
+    free(block);
+    free(address);
+    free(first);
+}
+
+/* Returns how far into fetching and decoding an instruction a state is, from 0 for fetch up to the state whose next
+ * state the decode ROM gives, or -1 if it does not fetch. A state which prefetches goes on to one of these, having done
+ * the work of those before it.
+ */
+int microcode_fetch_position(const mcode_t *microcode, unsigned state) {
+    unsigned at = 0;
+    for (int position = 0; position <= (int)microcode->len; position++) {
+        if (at == state) return position;
+        if (microcode->decodes[at]) return -1;
+        at = microcode->next[at];
+    }
+    return -1;
+}
+
+/* Counts the states, and so the cycles, from a state until the next fetch. A path which reaches a state whose next
+ * state the decode ROM gives stops there, counting it, so the path from fetch is the states which fetch and decode an
+ * instruction. A path from any other state stops once it goes on to a state which fetches, less the states before it,
+ * whose work it did while it finished, so a short path may be no cycles at all. When taken is false, a condition test
+ * fails, and its path stops at the test too. Returns -1 if the path never comes back to fetch.
+ */
+int microcode_path(const mcode_t *microcode, unsigned state, bool taken) {
+    signal_bf_t ctest = 0;
+    signal_field("ctest", &ctest);
+    bool fetching = microcode_fetch_position(microcode, state) >= 0;
+    for (int length = 0; length <= (int)microcode->len; length++) {
+        int position = length > 0 && !fetching ? microcode_fetch_position(microcode, state) : -1;
+        if (position >= 0) return length - position;
+        if (state == 0 && length > 0) return length;
+        if (microcode->decodes[state] || (!taken && (microcode->code[state] & ctest))) return length + 1;
+        state = microcode->next[state];
+    }
+    return -1;
+}
+
+/* Finds the cycles of an opcode from its fetch to the next fetch, which are the states that fetch and decode it and the
+ * states of its path, when a branch is taken and when it is not. Returns false if no state begins the opcode's
+ * execution, or its path never comes back to fetch.
+ */
+bool microcode_cycles(const mcode_t *microcode, unsigned opcode, unsigned *taken, unsigned *not_taken) {
+    if (!microcode->decoded[opcode]) return false;
+    int fetch = microcode_path(microcode, 0, true);
+    int path_taken = microcode_path(microcode, microcode->decode[opcode], true);
+    int path_not_taken = microcode_path(microcode, microcode->decode[opcode], false);
+    if (fetch < 0 || path_taken < 0 || path_not_taken < 0) return false;
+    *taken = (unsigned)(fetch + path_taken);
+    *not_taken = (unsigned)(fetch + path_not_taken);
+    return true;
+}
@@ -0,0 +1,33 @@
+/* Defines the microcode of the gol-16 as it is assembled: the signals and next state of each state, and the decode ROM,
+ * which gives the state each opcode's execution begins at. A microcode word is the signals with the next state address
+ * in its lowest STATE_ADDRESS_BITS.
+ */
+#ifndef _MICROCODE_H_
+#define _MICROCODE_H_
+#include "hashmap.h"
+#include <stdbool.h>
+
+#define OPCODE_COUNT 32
+
+typedef struct MicroCode {
+    unsigned len;
+    unsigned __capacity;
+    signal_bf_t *code;             // Indexed by state, its signals
+    unsigned *next;                // Indexed by state, its next state
+    char **names;                  // Indexed by state
+    bool *decodes;                 // Indexed by state, whether it has no #next, so the decode ROM gives its next
+    unsigned decode[OPCODE_COUNT]; // Indexed by opcode, the state its execution begins at
+    bool decoded[OPCODE_COUNT];    // Indexed by opcode, whether any state begins its execution
+} mcode_t;
+
+mcode_t *microcode_construct(void);
+void microcode_destruct(mcode_t *microcode);
+
+unsigned microcode_add_state(mcode_t *microcode, char *name);
+signal_bf_t microcode_word(const mcode_t *microcode, unsigned state);
+void microcode_minimize(mcode_t *microcode);
+int microcode_fetch_position(const mcode_t *microcode, unsigned state);
+int microcode_path(const mcode_t *microcode, unsigned state, bool taken);
+bool microcode_cycles(const mcode_t *microcode, unsigned opcode, unsigned *taken, unsigned *not_taken);
+
+#endif // _MICROCODE_H_
@@ -0,0 +1,155 @@
+/* Implements vertical microcode: finding the fields, encoding and decoding words, and the decoder description. */
+#include "vertical.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bits a field needs to hold zero and a value for each of its signals */
+__attribute__((const)) static unsigned field_width(unsigned count) {
+    unsigned width = 0;
+    while ((1u << width) < count + 1)
+        width++;
+    return width;
+}
+
+static unsigned popcount(signal_bf_t bits) {
+    unsigned count = 0;
+    for (; bits; bits &= bits - 1)
+        count++;
+    return count;
+}
+
+/* Finds the fields of the microcode. Each signal, the one asserted alongside the most others first, goes into the first
+ * field with no signal it is ever asserted with, or into a field of its own.
+ */
+void vertical_construct(vertical_t *vertical, const mcode_t *microcode) {
+    signal_bf_t together[SIGNAL_BITS] = {0}; // Indexed by signal, the signals asserted with it in any state
+    unsigned order[SIGNAL_BITS], count = 0;
+    for (unsigned i = 0; i < SIGNAL_BITS; i++) {
+        signal_bf_t bit = (signal_bf_t)1 << (i + STATE_ADDRESS_BITS);
+        bool used = false;
+        for (unsigned s = 0; s < microcode->len; s++) {
+            if (!(microcode->code[s] & bit)) continue;
+            together[i] |= microcode->code[s] & ~bit;
+            used = true;
+        }
+        if (used) order[count++] = i;
+    }
+
+    // Insertion sort, keeping the order of the signals in a word between those asserted with as many others
+    for (unsigned i = 1; i < count; i++) {
+        unsigned signal = order[i], j = i;
+        for (; j > 0 && popcount(together[order[j - 1]]) < popcount(together[signal]); j--)
+            order[j] = order[j - 1];
+        order[j] = signal;
+    }
+
+    memset(vertical, 0, sizeof(vertical_t));
+    signal_bf_t members[SIGNAL_BITS] = {0}; // Indexed by field, the signals in it
+    for (unsigned i = 0; i < count; i++) {
+        unsigned signal = order[i], f = 0;
+        while (f < vertical->field_count && (members[f] & together[signal]))
+            f++;
+        if (f == vertical->field_count) vertical->field_count++;
+        vfield_t *field = &vertical->fields[f];
+        field->signals[field->count++] = (signal_bf_t)1 << (signal + STATE_ADDRESS_BITS);
+        members[f] |= field->signals[field->count - 1];
+    }
+
+    vertical->width = STATE_ADDRESS_BITS;
+    for (unsigned f = 0; f < vertical->field_count; f++) {
+        vertical->fields[f].lsb = vertical->width;
+        vertical->fields[f].width = field_width(vertical->fields[f].count);
+        vertical->width += vertical->fields[f].width;
+    }
+}
+
+/* Returns the bytes of a word in the ROM. */
+unsigned vertical_bytes(const vertical_t *vertical) { return (vertical->width + 7) / 8; }
+
+/* Encodes a horizontal microcode word. A field whose signals are not exclusive in the word keeps only the first. */
+uint64_t vertical_encode(const vertical_t *vertical, signal_bf_t word) {
+    uint64_t encoded = word & ((1u << STATE_ADDRESS_BITS) - 1);
+    for (unsigned f = 0; f < vertical->field_count; f++) {
+        const vfield_t *field = &vertical->fields[f];
+        for (unsigned i = 0; i < field->count; i++) {
+            if (!(word & field->signals[i])) continue;
+            encoded |= (uint64_t)(i + 1) << field->lsb;
+            break;
+        }
+    }
+    return encoded;
+}
+
+/* Decodes a vertical microcode word back into a horizontal one. A field value with no signal asserts nothing. */
+signal_bf_t vertical_decode(const vertical_t *vertical, uint64_t word) {
+    signal_bf_t decoded = word & ((1u << STATE_ADDRESS_BITS) - 1);
+    for (unsigned f = 0; f < vertical->field_count; f++) {
+        const vfield_t *field = &vertical->fields[f];
+        unsigned value = (word >> field->lsb) & ((1u << field->width) - 1);
+        if (value > 0 && value <= field->count) decoded |= field->signals[value - 1];
+    }
+    return decoded;
+}
+
+/* Writes the decoder description. Returns false if the file could not be written. */
+bool vertical_write(const vertical_t *vertical, const char *file_path) {
+    FILE *fptr = fopen(file_path, "w");
+    if (fptr == NULL) return false;
+    fprintf(fptr, "; gol-16 vertical microcode, %u bits a word in %u big-endian bytes\n", vertical->width,
+            vertical_bytes(vertical));
+    fprintf(fptr, "; A field holding N asserts its Nth signal, and zero asserts none\n");
+    fprintf(fptr, "next 0 %u\n", STATE_ADDRESS_BITS);
+    for (unsigned f = 0; f < vertical->field_count; f++) {
+        const vfield_t *field = &vertical->fields[f];
+        fprintf(fptr, "field %u %u", field->lsb, field->width);
+        for (unsigned i = 0; i < field->count; i++)
+            fprintf(fptr, " %s", signal_name(field->signals[i]));
+        fprintf(fptr, "\n");
+    }
+    return fclose(fptr) == 0;
+}
+
+/* Reads a decoder description. Returns false if it cannot be read, or does not describe fields which fit in a word and
+ * hold valid signals.
+ */
+bool vertical_read(vertical_t *vertical, const char *file_path) {
+    FILE *fptr = fopen(file_path, "r");
+    if (fptr == NULL) return false;
+    memset(vertical, 0, sizeof(vertical_t));
+    vertical->width = STATE_ADDRESS_BITS;
+
+    bool valid = true, next = false;
+    char line[1024];
+    while (valid && fgets(line, sizeof(line), fptr) != NULL) {
+        char *token = strtok(line, " \t\r\n");
+        if (token == NULL || token[0] == ';') continue;
+
+        unsigned lsb, width;
+        char *lsb_token = strtok(NULL, " \t\r\n"), *width_token = strtok(NULL, " \t\r\n");
+        valid = lsb_token != NULL && width_token != NULL && sscanf(lsb_token, "%u", &lsb) == 1 &&
+                sscanf(width_token, "%u", &width) == 1 && width < 32 && lsb + width <= 64;
+        if (!valid) break;
+        if (!strcmp(token, "next")) {
+            valid = !next && lsb == 0 && width == STATE_ADDRESS_BITS;
+            next = true;
+            continue;
+        }
+        if (strcmp(token, "field") || vertical->field_count == SIGNAL_BITS) {
+            valid = false;
+            break;
+        }
+
+        vfield_t *field = &vertical->fields[vertical->field_count++];
+        field->lsb = lsb;
+        field->width = width;
+        for (char *name = strtok(NULL, " \t\r\n"); valid && name != NULL; name = strtok(NULL, " \t\r\n")) {
+            valid = field->count < SIGNAL_BITS && signal_field(name, &field->signals[field->count]);
+            field->count++;
+        }
+        valid &= field->count < (1u << width);
+        if (lsb + width > vertical->width) vertical->width = lsb + width;
+    }
+    fclose(fptr);
+    return valid && next;
+}
@@ -0,0 +1,42 @@
+/* Defines vertical microcode, whose words encode the signals in fields rather than with a bit each. Signals which no
+ * state asserts together are exclusive, and share a field: a field holding N asserts its Nth signal, and zero asserts
+ * none of them. Signals which no state asserts have no field.
+ *
+ * A word is the next state address in its lowest STATE_ADDRESS_BITS, followed by each field in turn. The ROM holds a
+ * word for each state, big-endian in as few bytes as hold one. The decoder description lists the fields, one a line:
+ *
+ *   ; Comment
+ *   next LSB WIDTH
+ *   field LSB WIDTH SIGNAL...
+ */
+#ifndef _VERTICAL_H_
+#define _VERTICAL_H_
+#include "microcode.h"
+#include <stdint.h>
+
+/* Most signals a microcode word can have, and so most fields */
+#define SIGNAL_BITS (sizeof(signal_bf_t) * 8 - STATE_ADDRESS_BITS)
+
+typedef struct VerticalField {
+    unsigned lsb;
+    unsigned width;
+    unsigned count;
+    signal_bf_t signals[SIGNAL_BITS]; // Bit of each signal in a horizontal word, in order of their values from 1
+} vfield_t;
+
+typedef struct Vertical {
+    unsigned width; // Bits of a word, including the next state address
+    unsigned field_count;
+    vfield_t fields[SIGNAL_BITS];
+} vertical_t;
+
+void vertical_construct(vertical_t *vertical, const mcode_t *microcode);
+unsigned vertical_bytes(const vertical_t *vertical);
+
+uint64_t vertical_encode(const vertical_t *vertical, signal_bf_t word);
+signal_bf_t vertical_decode(const vertical_t *vertical, uint64_t word);
+
+bool vertical_write(const vertical_t *vertical, const char *file_path);
+bool vertical_read(vertical_t *vertical, const char *file_path);
+
+#endif // _VERTICAL_H_
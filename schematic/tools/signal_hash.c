@@ -0,0 +1,73 @@
+/* Finds a perfect hash of the control signals and writes it as a C header, which mcasm is built with. Run by make
+ * whenever the signals change, so that looking up a signal never has to search for the hash.
+ *
+ * USAGE: signal_hash OUTPUT.h
+ */
+#include "../../common/signals.h"
+#include "../src/hashmap.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Most bits of a slot, and seeds tried for each number of bits */
+#define MAX_SLOT_BITS 12
+#define SEED_TRIES 65536
+
+static int8_t slots[1 << MAX_SLOT_BITS]; // Index of the signal in each slot, or -1
+
+/* Searches for a seed which gives every signal a slot of its own, from the fewest slot bits which leave the table at
+ * most half full, widening the table if no seed is found. Returns the slot bits, or 0 if no seed was found.
+ */
+static unsigned find_seed(uint32_t *seed) {
+    unsigned bits = 1;
+    while ((1u << bits) < 2 * SIGNAL_COUNT)
+        bits++;
+    for (; bits <= MAX_SLOT_BITS; bits++) {
+        for (*seed = 0; *seed < SEED_TRIES; (*seed)++) {
+            memset(slots, -1, 1u << bits);
+            unsigned i = 0;
+            for (; i < SIGNAL_COUNT; i++) {
+                int8_t *slot = &slots[hmap_hash(SIGNAL_NAMES[i], *seed) >> (32 - bits)];
+                if (*slot >= 0) break;
+                *slot = (int8_t)i;
+            }
+            if (i == SIGNAL_COUNT) return bits;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        puts("USAGE: signal_hash OUTPUT.h");
+        return EXIT_FAILURE;
+    }
+
+    uint32_t seed;
+    unsigned bits = find_seed(&seed);
+    if (bits == 0) {
+        printf("Could not find a perfect hash of the signals.\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *fptr = fopen(argv[1], "w");
+    if (fptr == NULL) {
+        printf("Could not write to file '%s'.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(fptr, "/* Generated by tools/signal_hash.c from common/signals.h when mcasm is built. Do not edit. */\n");
+    fprintf(fptr, "#define SIGNAL_HASH_COUNT %d\n", SIGNAL_COUNT);
+    fprintf(fptr, "#define SIGNAL_SEED %" PRIu32 "u\n", seed);
+    fprintf(fptr, "#define SIGNAL_SLOT_BITS %u\n", bits);
+    fprintf(fptr, "static const int8_t SIGNAL_SLOTS[1 << SIGNAL_SLOT_BITS] = {");
+    for (unsigned i = 0; i < 1u << bits; i++)
+        fprintf(fptr, "%s%d,", i % 16 == 0 ? "\n    " : " ", slots[i]);
+    fprintf(fptr, "\n};\n");
+
+    if (fclose(fptr) != 0) {
+        printf("Could not write to file '%s'.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
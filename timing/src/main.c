@@ -0,0 +1,196 @@
+/* A static timing analyzer for gol-16 images (gtime) */
+#include "../../common/addrmap.h"
+#include "../../common/object.h"
+#include "../../common/timing.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Comment which bounds the loop whose header is the next statement */
+#define LOOP_ANNOTATION "@loop"
+
+static void usage(void) { puts("USAGE: gtime PROGRAM.o [PROGRAM.map]"); }
+
+/* The lines of a source file named by the address map */
+typedef struct Source {
+    char **lines; // Indexed by line less one, without their new lines
+    unsigned long count;
+} source_t;
+
+/* Reads a flat image of big-endian words. */
+static uint16_t *_read_image(const char *file_path, unsigned long *length) {
+    FILE *fptr = fopen(file_path, "rb");
+    if (fptr == NULL) return NULL;
+
+    fseek(fptr, 0, SEEK_END);
+    long bytes = ftell(fptr);
+    rewind(fptr);
+    *length = bytes > 0 ? bytes / 2 : 0;
+    uint16_t *words = malloc(sizeof(uint16_t) * (*length + 1));
+    if (fread(words, sizeof(uint16_t), *length, fptr) != *length) {
+        free(words);
+        words = NULL;
+    } else {
+        object_swap_words(words, *length);
+    }
+    fclose(fptr);
+    return words;
+}
+
+/* Reads a source file. A file which cannot be read has no lines, so it has no annotations and no labels. */
+static source_t _read_source(const char *file_path) {
+    source_t source = {NULL, 0};
+    FILE *fptr = fopen(file_path, "r");
+    if (fptr == NULL) {
+        fprintf(stderr, "Could not read source '%s', so its loops have no bounds.\n", file_path);
+        return source;
+    }
+    char text[1024];
+    while (fgets(text, sizeof(text), fptr) != NULL) {
+        text[strcspn(text, "\r\n")] = '\0';
+        source.lines = realloc(source.lines, sizeof(char *) * (source.count + 1));
+        source.lines[source.count] = malloc(strlen(text) + 1);
+        strcpy(source.lines[source.count++], text);
+    }
+    fclose(fptr);
+    return source;
+}
+
+/* Returns the address of the first statement at or after a line of a file, or -1 if there is none. */
+static long _statement_after(const addrmap_t *map, unsigned file, unsigned long line) {
+    long address = -1;
+    unsigned long best = 0;
+    for (unsigned long i = 0; i < map->count; i++) {
+        const addrmap_entry_t *entry = &map->entries[i];
+        if (entry->file != file || entry->line < line || (address >= 0 && entry->line >= best)) continue;
+        address = entry->address;
+        best = entry->line;
+    }
+    return address;
+}
+
+/* Bounds loops by the annotations in a source file: "; @loop N" for a header which runs N times each time the loop is
+ * entered, or "; @loop MIN..MAX". An annotation applies to the next statement, so it may be written on the header, on
+ * its label, or on a line of its own before them.
+ */
+static void _read_bounds(timing_t *timing, const addrmap_t *map, unsigned file, const source_t *source) {
+    for (unsigned long line = 1; line <= source->count; line++) {
+        const char *comment = strchr(source->lines[line - 1], ';');
+        const char *annotation = comment != NULL ? strstr(comment, LOOP_ANNOTATION) : NULL;
+        if (annotation == NULL) continue;
+
+        unsigned min, max;
+        int read = sscanf(annotation + strlen(LOOP_ANNOTATION), " %u..%u", &min, &max);
+        long header = _statement_after(map, file, line);
+        if (read < 1 || (read == 2 && max < min) || header < 0) {
+            fprintf(stderr, "%s:%lu: Ignoring loop bound, which should be '%s N' or '%s MIN..MAX' before a "
+                            "statement.\n",
+                    map->files[file], line, LOOP_ANNOTATION, LOOP_ANNOTATION);
+            continue;
+        }
+        timing_bound(timing, (uint16_t)header, min, read == 2 ? max : min);
+    }
+}
+
+/* Returns whether a word at the start of a line is an operator rather than a label, ignoring case. */
+static bool _is_operator(const char *word, size_t length) {
+    if ((length == 3 && !strncasecmp(word, "DCD", 3)) || (length == 3 && !strncasecmp(word, "EQU", 3))) return true;
+    for (unsigned op = 0; op < ISA_OPCODE_COUNT + 4; op++) {
+        const char *mnemonic = op < ISA_OPCODE_COUNT ? ISA[op].mnemonic : ISA_SHIFTS[op - ISA_OPCODE_COUNT];
+        size_t size = mnemonic != NULL ? strlen(mnemonic) : 0;
+        if (size == 0 || length < size || strncasecmp(word, mnemonic, size)) continue;
+        if (length == size) return true;
+        bool branch = op < ISA_OPCODE_COUNT && ISA[op].layout == LayoutBranch;
+        for (unsigned cond = 0; branch && cond < 16; cond++) {
+            const char *suffix = ISA_CONDITIONS[cond];
+            if (suffix != NULL && strlen(suffix) == length - size && !strncasecmp(word + size, suffix, length - size))
+                return true;
+        }
+    }
+    return false;
+}
+
+/* Finds the label of a statement: on its own line, or alone on the lines before it. Returns its length, or zero. */
+static size_t _label(const source_t *source, unsigned long line, const char **label) {
+    for (unsigned long at = line; at >= 1 && at <= source->count; at--) {
+        const char *text = source->lines[at - 1];
+        size_t length = 0;
+        while (isalnum((unsigned char)text[length]) || text[length] == '_')
+            length++;
+        if (length > 0 && !_is_operator(text, length)) {
+            *label = text;
+            return length;
+        }
+        // Only blank and comment lines may come between a label and its statement
+        const char *rest = text + strspn(text, " \t");
+        if (length > 0 || (at != line && *rest != '\0' && *rest != ';')) return 0;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    timing_cycles_t cycles;
+    timing_cycles_isa(&cycles);
+
+    unsigned long length;
+    uint16_t *words = _read_image(argv[1], &length);
+    if (words == NULL) {
+        fprintf(stderr, "Could not read %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    addrmap_t *map = argc == 3 ? addrmap_read(argv[2]) : addrmap_construct();
+    if (map == NULL) {
+        fprintf(stderr, "Could not read address map '%s'.\n", argv[2]);
+        free(words);
+        return EXIT_FAILURE;
+    }
+
+    timing_t *timing = timing_construct(words, length, &cycles);
+    source_t *sources = calloc(map->file_count + 1, sizeof(source_t));
+    for (unsigned file = 0; file < map->file_count; file++) {
+        sources[file] = _read_source(map->files[file]);
+        _read_bounds(timing, map, file, &sources[file]);
+    }
+    timing_analyze(timing);
+
+    bool bounded = true;
+    printf("; Timing of %s, in cycles from the fetch of each function's entry to the fetch after it returns\n",
+           argv[1]);
+    printf("; %-6s%-12s%-12s%s\n", "ENTRY", "BCET", "WCET", "FUNCTION");
+    for (unsigned i = 0; i < timing->function_count; i++) {
+        const timing_function_t *function = &timing->functions[i];
+        const addrmap_entry_t *entry = addrmap_lookup(map, function->entry);
+        const char *label = "";
+        size_t label_length = 0;
+        if (entry != NULL && entry->address == function->entry)
+            label_length = _label(&sources[entry->file], entry->line, &label);
+
+        if (function->problem == NULL) {
+            printf("  %04x  %-12" PRIu64 "%-12" PRIu64 "%.*s\n", function->entry, function->bcet, function->wcet,
+                   (int)label_length, label);
+        } else {
+            printf("  %04x  %-12s%-12s%.*s%s%s at %04x\n", function->entry, "-", "-", (int)label_length, label,
+                   label_length > 0 ? ": " : "", function->problem, function->problem_at);
+            bounded = false;
+        }
+    }
+
+    for (unsigned file = 0; file < map->file_count; file++) {
+        for (unsigned long line = 0; line < sources[file].count; line++)
+            free(sources[file].lines[line]);
+        free(sources[file].lines);
+    }
+    free(sources);
+    timing_destruct(timing);
+    addrmap_destruct(map);
+    free(words);
+    return bounded ? EXIT_SUCCESS : EXIT_FAILURE;
+}